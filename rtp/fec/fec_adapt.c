@@ -0,0 +1,155 @@
+/*
+ * Copyright 2023 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/rtp-sdr *
+ *
+ * This is based on other projects:
+ *      IDEA: https://github.com/OpenResearchInstitute/ka9q-sdr (not use any code of this)
+ *       RTP: https://github.com/Daxbot/librtp/
+ *       FEC: https://github.com/wesen/poc
+ *    SOCKET: https://github.com/njh/mast
+ *    OTHERS: see individual files
+ *
+ *    please contact their authors for more information.
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "fec_adapt.h"
+
+// Initialize an adaptive FEC controller. The controller starts without parity (n == k) until losses are reported.
+void fec_adapt_init(fec_adapt_t *ad, unsigned int k, unsigned int n_max, double target) {
+    assert(ad != NULL);
+    assert((k > 0 && k <= n_max) || "k is out of range");
+    assert((n_max <= 255) || "n is too big");
+
+    ad->k = k;
+    ad->n = k;
+    ad->n_max = n_max;
+    ad->loss = 0;
+    ad->target = target > 0 ? target : FEC_ADAPT_TARGET;
+    ad->reports = 0;
+}
+
+// Probability that a (k, n) group can not be decoded, i.e. that more than n - k of its n packets are lost,
+// when packets are lost independently with probability loss.
+double fec_adapt_residual(unsigned int k, unsigned int n, double loss) {
+    if (loss <= 0)
+        return 0;
+    if (loss >= 1)
+        return 1;
+
+    // Sum the binomial distribution up to n - k losses, the group is recovered in all those cases.
+    double pmf = pow(1 - loss, n);
+    double ratio = loss / (1 - loss);
+    double recovered = pmf;
+
+    unsigned int i;
+    for (i = 0; i < n - k; i++) {
+        pmf *= ((double) (n - i) / (i + 1)) * ratio;
+        recovered += pmf;
+    }
+
+    return recovered >= 1 ? 0 : 1 - recovered;
+}
+
+// Update the controller with the fraction lost field of a receiver report (fixed point, 8 bits).
+// Losses are tracked with a fast attack and slow release average. n is raised at once when the residual
+// group loss would exceed the target and lowered by one step per report, so parity is only spent while the link loses packets.
+// Returns 1 if n changed, 0 otherwise.
+int fec_adapt_update(fec_adapt_t *ad, unsigned char fraction) {
+    assert(ad != NULL);
+
+    double p = fraction / 256.0;
+
+    if (ad->reports++ == 0 || p > ad->loss)
+        ad->loss += (p - ad->loss) / 2;
+    else
+        ad->loss += (p - ad->loss) / 8;
+
+    unsigned int n = ad->k;
+    if (ad->loss >= FEC_ADAPT_LOSS_FLOOR) {
+        while (n < ad->n_max && fec_adapt_residual(ad->k, n, ad->loss) > ad->target)
+            n++;
+    }
+
+    // Release one parity packet at a time.
+    if (n < ad->n)
+        n = ad->n - 1;
+
+    if (n == ad->n)
+        return 0;
+
+    ad->n = n;
+
+    return 1;
+}
+
+#ifdef FEC_ADAPT_TEST
+#include <stdio.h>
+
+void testit(char *name, unsigned int result, unsigned int should) {
+    if (result == should) {
+        printf("Test %s was successful\n", name);
+    }
+    else {
+        printf("Test %s was not successful, %u should have been %u\n", name, result, should);
+    }
+}
+
+int main(void) {
+    fec_adapt_t ad;
+    int i;
+
+    fec_adapt_init(&ad, 16, 32, 1e-4);
+    testit("clean link sends no parity", ad.n, 16);
+
+    for (i = 0; i < 4; i++)
+        fec_adapt_update(&ad, 0);
+    testit("clean link sends no parity", ad.n, 16);
+
+    // 5% loss.
+    for (i = 0; i < 8; i++)
+        fec_adapt_update(&ad, 13);
+    testit("lossy link gets parity", ad.n > 16, 1);
+    testit("lossy link meets target", fec_adapt_residual(ad.k, ad.n, ad.loss) <= ad.target, 1);
+
+    // Loss goes away, parity is released step by step.
+    unsigned int n = ad.n;
+    fec_adapt_update(&ad, 0);
+    testit("parity released slowly", ad.n >= n - 1, 1);
+    for (i = 0; i < 64; i++)
+        fec_adapt_update(&ad, 0);
+    testit("parity released on clean link", ad.n, 16);
+
+    // Total loss saturates at n_max.
+    for (i = 0; i < 8; i++)
+        fec_adapt_update(&ad, 255);
+    testit("saturated link uses n_max", ad.n, 32);
+
+    return 0;
+}
+#endif /* FEC_ADAPT_TEST */
@@ -0,0 +1,65 @@
+/*
+ * Copyright 2023 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/rtp-sdr *
+ *
+ * This is based on other projects:
+ *      IDEA: https://github.com/OpenResearchInstitute/ka9q-sdr (not use any code of this)
+ *       RTP: https://github.com/Daxbot/librtp/
+ *       FEC: https://github.com/wesen/poc
+ *    SOCKET: https://github.com/njh/mast
+ *    OTHERS: see individual files
+ *
+ *    please contact their authors for more information.
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef FEC_ADAPT_H_
+#define FEC_ADAPT_H_
+
+// Default residual group loss probability the controller aims for.
+#ifndef FEC_ADAPT_TARGET
+#define FEC_ADAPT_TARGET (1e-4)
+#endif
+
+// Smoothed loss probability below which the link is considered clean and no parity is sent.
+#ifndef FEC_ADAPT_LOSS_FLOOR
+#define FEC_ADAPT_LOSS_FLOOR (0.5 / 256.0)
+#endif
+
+// Adaptive FEC controller structure.
+// Tracks the loss fraction reported by the receiver (RTCP SR/RR) and chooses the n parameter for the next FEC groups.
+typedef struct fec_adapt_s {
+    unsigned int k;       // k FEC parameter. Source packets per group.
+    unsigned int n;       // n FEC parameter chosen for the next group. n == k means no parity.
+    unsigned int n_max;   // Upper bound for n.
+          double loss;    // Smoothed packet loss probability.
+          double target;  // Residual group loss probability target.
+    unsigned int reports; // Number of loss reports processed.
+} fec_adapt_t;
+
+  void fec_adapt_init(fec_adapt_t *ad, unsigned int k, unsigned int n_max, double target);
+   int fec_adapt_update(fec_adapt_t *ad, unsigned char fraction);
+double fec_adapt_residual(unsigned int k, unsigned int n, double loss);
+
+#endif /* FEC_ADAPT_H_ */
@@ -34,6 +34,13 @@
  *
  */
 
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define GF_SIMD_X86
+#endif
+
 #include "fec_galois.h"
 
 // Polynomial representation of field elements.
@@ -48,6 +55,55 @@ gf gf_mul[256][256] = { { 0 } };
 // Precomputed inverse table.
 gf gf_inv[256] = { 0 };
 
+// Split multiplication tables (low and high nibble of the multiplicand).
+gf gf_mul_lo[256][16] __attribute__((aligned(16))) = { { 0 } };
+gf gf_mul_hi[256][16] __attribute__((aligned(16))) = { { 0 } };
+
+#ifdef GF_SIMD_X86
+// Nibble lookups done with byte shuffles, 32 bytes at a time. Returns the number of bytes processed.
+__attribute__((target("avx2")))
+static int gf_row_avx2(gf *a, const gf *b, gf c, int k, int accumulate) {
+    const __m256i lo_tbl = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i*) gf_mul_lo[c]));
+    const __m256i hi_tbl = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i*) gf_mul_hi[c]));
+    const __m256i mask = _mm256_set1_epi8(0x0f);
+    int i = 0;
+
+    for (; i + 32 <= k; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i*) (b + i));
+        __m256i lo = _mm256_shuffle_epi8(lo_tbl, _mm256_and_si256(x, mask));
+        __m256i hi = _mm256_shuffle_epi8(hi_tbl, _mm256_and_si256(_mm256_srli_epi64(x, 4), mask));
+        __m256i r = _mm256_xor_si256(lo, hi);
+        if (accumulate)
+            r = _mm256_xor_si256(r, _mm256_loadu_si256((const __m256i*) (a + i)));
+        _mm256_storeu_si256((__m256i*) (a + i), r);
+    }
+    return i;
+}
+
+// Same as above, 16 bytes at a time.
+__attribute__((target("ssse3")))
+static int gf_row_ssse3(gf *a, const gf *b, gf c, int k, int accumulate) {
+    const __m128i lo_tbl = _mm_load_si128((const __m128i*) gf_mul_lo[c]);
+    const __m128i hi_tbl = _mm_load_si128((const __m128i*) gf_mul_hi[c]);
+    const __m128i mask = _mm_set1_epi8(0x0f);
+    int i = 0;
+
+    for (; i + 16 <= k; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i*) (b + i));
+        __m128i lo = _mm_shuffle_epi8(lo_tbl, _mm_and_si128(x, mask));
+        __m128i hi = _mm_shuffle_epi8(hi_tbl, _mm_and_si128(_mm_srli_epi64(x, 4), mask));
+        __m128i r = _mm_xor_si128(lo, hi);
+        if (accumulate)
+            r = _mm_xor_si128(r, _mm_loadu_si128((const __m128i*) (a + i)));
+        _mm_storeu_si128((__m128i*) (a + i), r);
+    }
+    return i;
+}
+#endif
+
+// Vector part of the row kernel, selected at runtime by gf_init (NULL: scalar only).
+static int (*gf_row_simd)(gf *a, const gf *b, gf c, int k, int accumulate) = NULL;
+
 // A primitive polynomial.
 
 // A primitive polynomial for gf{2^8}, namely 1 + x^2 + x^3 + x^4 + x^8
@@ -112,14 +168,75 @@ void gf_init(void) {
     gf_inv[1] = 1;
     for (i = 2; i < 256; i++)
         gf_inv[i] = gf_polys[255 - gf_logs[i]];
+
+    // Compute split tables. Multiplication distributes over addition, so c * x = c * lo(x) + c * hi(x).
+    for (i = 0; i < 256; i++) {
+        int j;
+        for (j = 0; j < 16; j++) {
+            gf_mul_lo[i][j] = gf_mul[i][j];
+            gf_mul_hi[i][j] = gf_mul[i][j << 4];
+        }
+    }
+
+    // Pick the widest shuffle kernel the running cpu supports.
+#ifdef GF_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        gf_row_simd = gf_row_avx2;
+    else if (__builtin_cpu_supports("ssse3"))
+        gf_row_simd = gf_row_ssse3;
+#endif
+}
+
+// Multiplies a row by a constant using the split tables.
+// The bulk goes through the vector kernel picked for this cpu, the remainder is done with the full table.
+// If accumulate is set computes a = a + c * b, otherwise a = c * b.
+static inline void gf_row_kernel(gf *a, const gf *b, gf c, int k, int accumulate) {
+    int i = 0;
+
+    if (gf_row_simd != NULL)
+        i = gf_row_simd(a, b, c, k, accumulate);
+
+    const gf *mul = gf_mul[c];
+    if (accumulate) {
+        for (; i < k; i++)
+            a[i] = GF_ADD(a[i], mul[b[i]]);
+    }
+    else {
+        for (; i < k; i++)
+            a[i] = mul[b[i]];
+    }
 }
 
 // Computes addition of a row multiplied by a constant.
 // Computes a = a + c * b, a, b in gf{2^8}^k, c in gf{2^8}.
+// This is the multiply-accumulate primitive shared by the data path (encode / decode) and the matrix code.
 void gf_add_mul(gf *a, gf *b, gf c, int k) {
-    int i;
-    for (i = 0; i < k; i++)
-        a[i] = GF_ADD(a[i], GF_MUL(c, b[i]));
+    if (c == 0)
+        return;
+
+    if (c == 1) {
+        int i;
+        for (i = 0; i < k; i++)
+            a[i] = GF_ADD(a[i], b[i]);
+        return;
+    }
+
+    gf_row_kernel(a, b, c, k, 1);
+}
+
+// Multiplies a row by a constant in place.
+// Computes a = c * a, a in gf{2^8}^k, c in gf{2^8}.
+void gf_mul_row(gf *a, gf c, int k) {
+    if (c == 1)
+        return;
+
+    if (c == 0) {
+        memset(a, 0, k * sizeof(gf));
+        return;
+    }
+
+    gf_row_kernel(a, a, c, k, 0);
 }
 
 #ifdef GALOIS_TEST
@@ -136,6 +253,7 @@ void testit(char *name, int result, int should) {
 
 int main(void) {
     gf a, b, c;
+    int n;
 
     gf_init();
     a = 1;
@@ -146,6 +264,29 @@ int main(void) {
     testit("(37 * 78) * 37 = (37 * 37) * 78", GF_MUL(GF_MUL(b, c), b), GF_MUL(GF_MUL(b, b), c));
     testit("b * b^-1 = 1", GF_MUL(b, GF_INV(b)), 1);
 
+    // Compare the row kernels against the multiplication table, including the scalar tail.
+    gf row_a[77], row_b[77], row_r[77];
+    int i, j, ok;
+    for (i = 0; i < 77; i++) {
+        row_a[i] = (gf) (i * 7 + 3);
+        row_b[i] = (gf) (i * 13 + 11);
+    }
+    for (n = 0, ok = 1; ok && n <= 255; n++) {
+        c = (gf) n;
+        memcpy(row_r, row_a, sizeof(row_r));
+        gf_add_mul(row_r, row_b, c, 77);
+        for (j = 0; j < 77; j++)
+            if (row_r[j] != GF_ADD(row_a[j], GF_MUL(c, row_b[j])))
+                ok = 0;
+
+        memcpy(row_r, row_b, sizeof(row_r));
+        gf_mul_row(row_r, c, 77);
+        for (j = 0; j < 77; j++)
+            if (row_r[j] != GF_MUL(c, row_b[j]))
+                ok = 0;
+    }
+    testit("row kernels match gf_mul", ok, 1);
+
     return 0;
 }
 
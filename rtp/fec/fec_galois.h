@@ -53,8 +53,14 @@ extern gf gf_mul[256][256];
 // Precomputed inverse table.
 extern gf gf_inv[256];
 
+// Split multiplication tables for the vectorized row kernels.
+// gf_mul_lo[c][x] = c * x and gf_mul_hi[c][x] = c * (x << 4), for x < 16.
+extern gf gf_mul_lo[256][16];
+extern gf gf_mul_hi[256][16];
+
 void gf_init(void);
 void gf_add_mul(gf *a, gf *b, gf c, int k);
+void gf_mul_row(gf *a, gf c, int k);
 
 #define GF_MUL(x, y) (gf_mul[(x)][(y)])
 #define GF_ADD(x, y) ((x) ^ (y))
@@ -51,141 +51,96 @@ void matrix_print(gf *a, int m, int n) {
 }
 
 // Matrix multiplication.
-//Computes c = a * b, with a in gf{2^8}^{n times k}, b in gf{2^8}^{k times m}, c in gf{2^8}^{n \times m}.
+// Computes c = a * b, with a in gf{2^8}^{n times k}, b in gf{2^8}^{k times m}, c in gf{2^8}^{n \times m}.
+// Each row of c is built as a linear combination of the rows of b, so the inner loop is the vectorized gf_add_mul.
 void matrix_mul(gf *a, gf *b, gf *c, int n, int k, int m) {
     int row;
 
     for (row = 0; row < n; row++) {
-        int col;
-        for (col = 0; col < m; col++) {
-            gf *pa = a + row * k;
-            gf *pb = b + col;
-            gf acc = 0;
+        gf *pa = a + row * k;
+        gf *pc = c + row * m;
 
-            int i;
-            for (i = 0; i < k; i++, pa++, pb += m)
-                acc = GF_ADD(acc, GF_MUL(*pa, *pb));
+        memset(pc, 0, m * sizeof(gf));
 
-            c[row * m + col] = acc;
-        }
+        int i;
+        for (i = 0; i < k; i++)
+            gf_add_mul(pc, b + i * m, pa[i], m);
     }
 }
 
 // Computes the inverse of a matrix.
-// Computes the inverse of a into a using Gauss-Jordan elimination.
-// Transform the matrix using pivoting and Gauss elimination to bring it into the form of the identity matrix,
-// and apply the transformations to the identity matrix.
+// Computes the inverse of a into a using Gauss-Jordan elimination with partial (row) pivoting.
+// Every step is a whole-row operation (swap, scale, multiply-accumulate) so the work is done by the vectorized row kernels.
+// The pivot search is a conditional select over the column and does not branch per element.
 // Returns 0 on error, 1 on success
 int matrix_inv(gf *a, int k) {
     // Bookkeeping on the pivoting.
-    int indxc[k];
     int indxr[k];
 
     // id_row is used to compare the pivot row to the corresponding identity row in order to speed up computation.
     gf id_row[k];
+    gf tmp[k];
 
-    // ipiv marks elements already used as pivots.
-    int ipiv[k];
-    
-    // Initialize id_row and ipiv.
-    int i;
-    for (i = 0; i < k; i++) {
-        id_row[i] = 0;
-        ipiv[i] = 0;
-    }
+    memset(id_row, 0, k * sizeof(gf));
 
     int col;
     for (col = 0; col < k; col++) {
-        // Look for a non-zero element to use as pivot.
-        int irow = -1, icol = -1;
+        // Look for the first non-zero element on or below the diagonal to use as pivot.
+        int irow = -1;
+        int row;
+        for (row = k - 1; row >= col; row--)
+            irow = (a[row * k + col] != 0) ? row : irow;
 
-        // First check the diagonal.
-        if ((ipiv[col] != 1) && (a[col * k + col] != 0)) {
-            irow = col;
-            icol = col;
-        }
-        else {
-            // Then search the matrix.
-            int row;
-            for (row = 0; row < k; row++) {
-                if (ipiv[row] != 1) {
-                    for (i = 0; i < k; i++) {
-                        if (ipiv[i] == 0) {
-                            if (a[row * k + i] != 0) {
-                                irow = row;
-                                icol = i;
-                                goto found_pivot;
-                            }
-                        }
-                        else if (ipiv[i] > 1) {
-                            fprintf(stderr, "Singular matrix\n");
-                            return 0;
-                        }
-                    }
-                }
-            }
+        if (irow < 0) {
             fprintf(stderr, "Pivot not found\n");
             return 0;
         }
 
-        found_pivot:
-        // Now we got a pivot element in icol and irow.
-        ++(ipiv[icol]);
-
         // Swap rows so the pivot is on the diagonal.
-        if (irow != icol) {
-            gf tmp;
-            for (i = 0; i < k; i++) {
-                tmp = a[irow * k + i];
-                a[irow * k + i] = a[icol * k + i];
-                a[icol * k + i] = tmp;
-            }
+        if (irow != col) {
+            memcpy(tmp, a + irow * k, k * sizeof(gf));
+            memcpy(a + irow * k, a + col * k, k * sizeof(gf));
+            memcpy(a + col * k, tmp, k * sizeof(gf));
         }
 
         // Remember the pivot position.
         indxr[col] = irow;
-        indxc[col] = icol;
-        gf *pivot_row = a + icol * k;
+        gf *pivot_row = a + col * k;
 
         // Divide pivot row with the pivot element.
-        gf c = pivot_row[icol];
-        if (c == 0) {
-            fprintf(stderr, "Singular matrix\n");
-            return 0;
-        }
-        else if (c != 1) {
-            c = GF_INV(c);
-            pivot_row[icol] = 1;
-            for (i = 0; i < k; i++)
-                pivot_row[i] = GF_MUL(c, pivot_row[i]);
+        gf c = pivot_row[col];
+        if (c != 1) {
+            pivot_row[col] = 1;
+            gf_mul_row(pivot_row, GF_INV(c), k);
         }
 
         // Reduce rows. If the pivot row is the identity row, we don't need to subtract the pivot row
-        id_row[icol] = 1;
-        if (bcmp(pivot_row, id_row, k * sizeof(gf)) != 0) {
+        id_row[col] = 1;
+        if (memcmp(pivot_row, id_row, k * sizeof(gf)) != 0) {
             gf *p;
+            int i;
             for (p = a, i = 0; i < k; i++, p += k) {
                 // Don't reduce the pivot row.
-                if (i != icol) {
-                    gf c = p[icol];
+                if (i != col) {
+                    gf c = p[col];
                     // Zero out the element corresponding to the pivot element and subtract the pivot row multiplied by the zeroed out element.
-                    p[icol] = 0;
+                    p[col] = 0;
                     gf_add_mul(p, pivot_row, c, k);
                 }
             }
         }
-        id_row[icol] = 0;
+        id_row[col] = 0;
     }
 
     // Descramble the solution.
     for (col = k - 1; col >= 0; col--) {
-        if (indxr[col] != indxc[col]) {
+        if (indxr[col] != col) {
             int row;
             gf tmp;
             for (row = 0; row < k; row++) {
                 tmp = a[row * k + indxr[col]];
-                a[row * k + indxr[col]] = a[row * k + indxc[col]];
-                a[row * k + indxc[col]] = tmp;
+                a[row * k + indxr[col]] = a[row * k + col];
+                a[row * k + col] = tmp;
             }
         }
     }
@@ -285,6 +240,30 @@ int main(void) {
     for (i = 0; i < 16; i++)
         testit("vandermonde invert matrix", vand1[i], vand2[i]);
 
+    // Invert a permutation matrix, which needs a row swap for every pivot.
+    gf perm[4 * 4] = { 0, 1, 0, 0, 1, 0, 0, 0, 0, 0, 0, 1, 0, 0, 1, 0 };
+    gf perm_inv[4 * 4];
+    memcpy(perm_inv, perm, sizeof(perm));
+    testit("invert permutation matrix", matrix_inv(perm_inv, 4), 1);
+    for (i = 0; i < 16; i++)
+        testit("invert permutation matrix", perm_inv[i], perm[i]);
+
+    // Invert a large Vandermonde matrix and check a * a^-1 = 1.
+    enum { K = 200 };
+    static gf big[K * K], big_inv[K * K], big_id[K * K];
+    int row, col, ok;
+    for (row = 0; row < K; row++)
+        for (col = 0; col < K; col++)
+            big[row * K + col] = gf_polys[((K - 1 - row) * col) % 255];
+    memcpy(big_inv, big, sizeof(big));
+    testit("invert large matrix", matrix_inv(big_inv, K), 1);
+    matrix_mul(big, big_inv, big_id, K, K, K);
+    for (row = 0, ok = 1; row < K; row++)
+        for (col = 0; col < K; col++)
+            if (big_id[row * K + col] != (row == col))
+                ok = 0;
+    testit("invert large matrix", ok, 1);
+
     return 0;
 }
 
@@ -56,7 +56,8 @@ void fec_pkt_init(fec_pkt_t *pkt) {
     pkt->payload = pkt->data + FEC_PKT_HDR_SIZE;
 }
 
-static void fec_pkt_pack(fec_pkt_t *pkt) {
+// Pack the header into the data buffer. Returns the length of the packet, header included.
+ssize_t fec_pkt_pack(fec_pkt_t *pkt) {
     assert(pkt != NULL);
 
     unsigned char *ptr = pkt->data;
@@ -71,6 +72,8 @@ static void fec_pkt_pack(fec_pkt_t *pkt) {
     UINT16_PACK(ptr, pkt->hdr.fec_len);
     UINT16_PACK(ptr, pkt->hdr.len);
     UINT32_PACK(ptr, pkt->hdr.group_tstamp);
+
+    return FEC_PKT_HDR_SIZE + pkt->hdr.len;
 }
 
 // Send a FEC packet to file descriptor using send.
@@ -76,6 +76,7 @@ typedef struct fec_pkt_s {
 } fec_pkt_t;
 
    void fec_pkt_init(fec_pkt_t *pkt);
+ssize_t fec_pkt_pack(fec_pkt_t *pkt);
 ssize_t fec_pkt_send(fec_pkt_t *pkt, int fd);
 ssize_t fec_pkt_sendto(fec_pkt_t *pkt, int fd, struct sockaddr *to, socklen_t tolen);
     int fec_pkt_read(fec_pkt_t *pkt, int fd);
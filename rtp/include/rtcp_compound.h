@@ -0,0 +1,288 @@
+/*
+ * Copyright 2023 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/rtp-sdr *
+ *
+ * This is based on other projects:
+ *      IDEA: https://github.com/OpenResearchInstitute/ka9q-sdr (not use any code of this)
+ *       RTP: https://github.com/Daxbot/librtp/
+ *       FEC: https://github.com/wesen/poc
+ *    SOCKET: https://github.com/njh/mast
+ *    OTHERS: see individual files
+ *
+ *    please contact their authors for more information.
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/**
+ * @defgroup compound Compound RTCP
+ * @brief Build and walk compound RTCP packets without the allocator.
+ *
+ * The builder writes SR/RR/SDES/BYE/APP blocks straight into one caller
+ * supplied buffer (stack, arena or a registered i/o buffer) and fills in the
+ * block headers as it goes. The parser walks a received datagram block by
+ * block and hands out views into it: nothing is copied or allocated, the
+ * views are valid as long as the datagram is.
+ */
+
+#ifndef RTCP_COMPOUND_H_
+#define RTCP_COMPOUND_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "rtcp_header.h"
+#include "rtcp_report.h"
+#include "rtcp_sdes.h"
+#include "rtp_ntp.h"
+
+/**
+ * @brief Compound packet under construction.
+ */
+typedef struct rtcp_compound {
+    uint8_t *buffer; /**< Destination buffer. */
+     size_t size;    /**< Size of the destination buffer. */
+     size_t length;  /**< Bytes written so far. */
+     size_t block;   /**< Offset of the open block (SIZE_MAX: none). */
+     size_t chunk;   /**< Offset of the open SDES chunk (SIZE_MAX: none). */
+       bool error;   /**< A block did not fit. */
+} rtcp_compound;
+
+/**
+ * @brief View of one block of a received compound packet.
+ */
+typedef struct rtcp_view {
+          uint8_t pt;    /**< Packet type (RTCP_SR...). */
+          uint8_t count; /**< Report, source or chunk count (APP: subtype). */
+    const uint8_t *data; /**< Block, header included. */
+           size_t size;  /**< Block size, padding included. */
+} rtcp_view;
+
+/**
+ * @brief SDES item iterator.
+ */
+typedef struct rtcp_sdes_cursor {
+      size_t offset;   /**< Offset of the next item or chunk in the block (0: start). */
+    uint32_t ssrc;     /**< Source of the current chunk. */
+     uint8_t chunks;   /**< Chunks not started yet. */
+        bool in_chunk; /**< Inside a chunk. */
+} rtcp_sdes_cursor;
+
+/**
+ * @brief Start a compound packet.
+ *
+ * @param [out] packet - builder.
+ * @param [in] buffer - destination.
+ * @param [in] size - size of the destination.
+ */
+void rtcp_compound_init(rtcp_compound *packet, uint8_t *buffer, size_t size);
+
+/**
+ * @brief Open a sender report. Report blocks follow with rtcp_compound_report().
+ *
+ * @param [in] packet - builder.
+ * @param [in] ssrc - sender.
+ * @param [in] ntp - wallclock of the report.
+ * @param [in] rtp_ts - RTP timestamp matching ntp.
+ * @param [in] pkt_count - packets sent.
+ * @param [in] byte_count - payload octets sent.
+ * @return 0 on success.
+ */
+int rtcp_compound_sr(rtcp_compound *packet, uint32_t ssrc, ntp_tv ntp, uint32_t rtp_ts, uint32_t pkt_count, uint32_t byte_count);
+
+/**
+ * @brief Open a receiver report. Report blocks follow with rtcp_compound_report().
+ *
+ * @param [in] packet - builder.
+ * @param [in] ssrc - reporter.
+ * @return 0 on success.
+ */
+int rtcp_compound_rr(rtcp_compound *packet, uint32_t ssrc);
+
+/**
+ * @brief Append a report block to the open SR or RR.
+ *
+ * @param [in] packet - builder.
+ * @param [in] report - report block.
+ * @return 0 on success.
+ */
+int rtcp_compound_report(rtcp_compound *packet, const rtcp_report *report);
+
+/**
+ * @brief Open an SDES packet. Chunks follow with rtcp_compound_sdes_chunk().
+ *
+ * @param [in] packet - builder.
+ * @return 0 on success.
+ */
+int rtcp_compound_sdes(rtcp_compound *packet);
+
+/**
+ * @brief Start a chunk of the open SDES packet.
+ *
+ * @param [in] packet - builder.
+ * @param [in] ssrc - source described.
+ * @return 0 on success.
+ */
+int rtcp_compound_sdes_chunk(rtcp_compound *packet, uint32_t ssrc);
+
+/**
+ * @brief Append an item to the open SDES chunk.
+ *
+ * @param [in] packet - builder.
+ * @param [in] type - item type.
+ * @param [in] data - item text.
+ * @param [in] length - item length (at most 255).
+ * @return 0 on success.
+ */
+int rtcp_compound_sdes_item(rtcp_compound *packet, rtcp_sdes_type type, const void *data, uint8_t length);
+
+/**
+ * @brief Append a BYE packet.
+ *
+ * @param [in] packet - builder.
+ * @param [in] ssrcs - sources leaving.
+ * @param [in] count - number of sources (at most 31).
+ * @param [in] reason - reason for leaving (may be NULL).
+ * @return 0 on success.
+ */
+int rtcp_compound_bye(rtcp_compound *packet, const uint32_t *ssrcs, uint8_t count, const char *reason);
+
+/**
+ * @brief Append an APP packet.
+ *
+ * @param [in] packet - builder.
+ * @param [in] subtype - application subtype (0-31).
+ * @param [in] ssrc - source.
+ * @param [in] name - four ASCII characters.
+ * @param [in] data - application data, padded to 32 bits.
+ * @param [in] size - size of the application data.
+ * @return 0 on success.
+ */
+int rtcp_compound_app(rtcp_compound *packet, uint8_t subtype, uint32_t ssrc, uint32_t name, const void *data, size_t size);
+
+/**
+ * @brief Close the last block.
+ *
+ * @param [in] packet - builder.
+ * @return length of the compound packet or -1 if it did not fit.
+ */
+int rtcp_compound_finish(rtcp_compound *packet);
+
+/**
+ * @brief Walk a compound packet.
+ *
+ * The first block must be an RTCP packet type (rtcp_type()), so an RTP
+ * packet sharing the port is rejected. Unknown packet types are handed out
+ * as well, for the caller to skip.
+ *
+ * @param [in] buffer - received datagram.
+ * @param [in] size - size of the datagram.
+ * @param [in,out] offset - walk position, 0 to start.
+ * @param [out] view - next block.
+ * @return 1 a block was found, 0 at the end, -1 if the datagram is malformed.
+ */
+int rtcp_compound_next(const uint8_t *buffer, size_t size, size_t *offset, rtcp_view *view);
+
+/**
+ * @brief SSRC of the sender of the block (SR, RR, APP; first source of SDES and BYE).
+ *
+ * @param [in] view - block.
+ * @return uint32_t
+ */
+uint32_t rtcp_view_ssrc(const rtcp_view *view);
+
+/**
+ * @brief Sender info of an SR.
+ *
+ * @param [in] view - block.
+ * @param [out] ntp - wallclock of the report.
+ * @param [out] rtp_ts - RTP timestamp matching ntp.
+ * @param [out] pkt_count - packets sent (may be NULL).
+ * @param [out] byte_count - payload octets sent (may be NULL).
+ * @return 0 on success, -1 if the block is not an SR.
+ */
+int rtcp_view_sender(const rtcp_view *view, ntp_tv *ntp, uint32_t *rtp_ts, uint32_t *pkt_count, uint32_t *byte_count);
+
+/**
+ * @brief Report block of an SR or RR.
+ *
+ * @param [in] view - block.
+ * @param [in] index - report number.
+ * @param [out] report - report block.
+ * @return 0 on success, -1 if there is no such report.
+ */
+int rtcp_view_report(const rtcp_view *view, uint8_t index, rtcp_report *report);
+
+/**
+ * @brief Report block of an SR or RR about a source.
+ *
+ * @param [in] view - block.
+ * @param [in] ssrc - source reported.
+ * @param [out] report - report block.
+ * @return 0 on success, -1 if the source is not reported.
+ */
+int rtcp_view_find_report(const rtcp_view *view, uint32_t ssrc, rtcp_report *report);
+
+/**
+ * @brief Next item of an SDES block.
+ *
+ * @param [in] view - block.
+ * @param [in,out] cursor - zeroed to start.
+ * @param [out] ssrc - source described.
+ * @param [out] type - item type.
+ * @param [out] data - item text (not terminated).
+ * @param [out] length - item length.
+ * @return 1 an item was found, 0 at the end, -1 if the block is malformed.
+ */
+int rtcp_view_sdes_next(const rtcp_view *view, rtcp_sdes_cursor *cursor, uint32_t *ssrc, rtcp_sdes_type *type, const uint8_t **data, uint8_t *length);
+
+/**
+ * @brief Source of a BYE.
+ *
+ * @param [in] view - block.
+ * @param [in] index - source number (< view->count).
+ * @return uint32_t
+ */
+uint32_t rtcp_view_bye_source(const rtcp_view *view, uint8_t index);
+
+/**
+ * @brief Reason of a BYE.
+ *
+ * @param [in] view - block.
+ * @param [out] reason - reason text (not terminated).
+ * @return length of the reason, 0 if none.
+ */
+uint8_t rtcp_view_bye_reason(const rtcp_view *view, const uint8_t **reason);
+
+/**
+ * @brief Name and data of an APP packet.
+ *
+ * @param [in] view - block.
+ * @param [out] name - four ASCII characters.
+ * @param [out] data - application data.
+ * @return size of the application data or -1 if the block is not an APP.
+ */
+int rtcp_view_app(const rtcp_view *view, uint32_t *name, const uint8_t **data);
+
+#endif // RTCP_COMPOUND_H_
@@ -106,10 +106,27 @@ int rtcp_type(const uint8_t *buffer, size_t size);
  *  over all RTCP packets sent and received by this participant. The size
  *  should include lower-layer transport and network protocol headers.
  * @param [in] initial - true if the application has not yet sent an RTCP packet.
- * @return Deterministic calculated interval in seconds.
+ * @return Randomized interval in seconds, until the next report.
  */
 double rtcp_interval(int members, int senders, double rtcp_bw, bool we_sent, double avg_rtcp_size, bool initial);
 
+/**
+ * @brief Calculates the deterministic RTCP interval Td in seconds: the
+ *  interval of rtcp_interval() before randomization and compensation.
+ *
+ * @see IETF RFC3550 "Timing Out an SSRC" (§6.3.5)
+ *
+ * @param [in] members - the current estimate for the number of session members.
+ * @param [in] senders - the current estimate for the number of session senders.
+ * @param [in] rtcp_bw - the target RTCP bandwidth (in bits/s).
+ * @param [in] we_sent - true if the application has sent data since the 2nd
+ *  previous RTCP report was transmitted.
+ * @param [in] avg_rtcp_size - the average compound RTCP packet size, in octets.
+ * @param [in] initial - true if the application has not yet sent an RTCP packet.
+ * @return Deterministic calculated interval in seconds.
+ */
+double rtcp_interval_deterministic(int members, int senders, double rtcp_bw, bool we_sent, double avg_rtcp_size, bool initial);
+
 /**
  * @brief Recompute the next RTCP packet transmission time.
  *
@@ -0,0 +1,159 @@
+/*
+ * Copyright 2023 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/rtp-sdr *
+ *
+ * This is based on other projects:
+ *      IDEA: https://github.com/OpenResearchInstitute/ka9q-sdr (not use any code of this)
+ *       RTP: https://github.com/Daxbot/librtp/
+ *       FEC: https://github.com/wesen/poc
+ *    SOCKET: https://github.com/njh/mast
+ *    OTHERS: see individual files
+ *
+ *    please contact their authors for more information.
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/**
+ * @defgroup clock Sender clock
+ * @brief Maps RTP timestamps of a source to absolute (NTP) time.
+ *
+ * Every SR pairs the sender's RTP timestamp with its wallclock. A least
+ * squares line through the most recent pairs gives the sender's sample
+ * clock offset and rate, so the absolute time of any sample is one multiply
+ * away. The sums behind the fit are updated as SRs arrive and leave the
+ * window.
+ */
+
+#ifndef RTP_CLOCK_H_
+#define RTP_CLOCK_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "rtp_ntp.h"
+
+/**
+ * @brief SRs kept for the fit.
+ */
+#ifndef LIBRTP_CLOCK_WINDOW
+#define LIBRTP_CLOCK_WINDOW (8)
+#endif
+
+/**
+ * @brief Seconds an SR may lie off the fitted line before the fit restarts from it
+ *        (an RTP timestamp jump on the same source).
+ */
+#ifndef LIBRTP_CLOCK_RESYNC
+#define LIBRTP_CLOCK_RESYNC (0.1)
+#endif
+
+/**
+ * @brief Sender clock mapping.
+ */
+typedef struct rtp_clock {
+    uint32_t id;                        /**< Source identifier. */
+    uint32_t rate;                      /**< Nominal RTP clock rate (Hz). */
+     uint8_t count;                     /**< SRs in the window. */
+     uint8_t head;                      /**< Slot of the next SR. */
+     uint8_t age;                       /**< SRs since the sums were rebased. */
+     int64_t x[LIBRTP_CLOCK_WINDOW];    /**< Extended RTP timestamps of the SRs. */
+      ntp_ts y[LIBRTP_CLOCK_WINDOW];    /**< NTP timestamps of the SRs. */
+    uint32_t last_ts;                   /**< RTP timestamp of the last SR. */
+     int64_t last_x;                    /**< Extended RTP timestamp of the last SR. */
+     int64_t ref_x;                     /**< Origin of the sums (RTP). */
+      ntp_ts ref_y;                     /**< Origin of the sums (NTP). */
+      double sx, sy, sxx, sxy;          /**< Regression sums, relative to the origin. */
+     int64_t anchor_x;                  /**< A point on the fitted line (RTP). */
+      ntp_ts anchor_y;                  /**< A point on the fitted line (NTP). */
+      double slope;                     /**< NTP units (2^-32 s) per RTP tick. */
+} rtp_clock;
+
+/**
+ * @brief Allocate a sender clock.
+ *
+ * @return rtp_clock*
+ */
+rtp_clock* rtp_clock_create(void);
+
+/**
+ * @brief Free a sender clock.
+ *
+ * @param [out] c - clock to free.
+ */
+void rtp_clock_free(rtp_clock *c);
+
+/**
+ * @brief Initialize (or restart) a sender clock.
+ *
+ * @param [out] c - clock.
+ * @param [in] id - source identifier.
+ * @param [in] rate - nominal RTP clock rate (Hz).
+ */
+void rtp_clock_init(rtp_clock *c, uint32_t id, uint32_t rate);
+
+/**
+ * @brief Add the NTP/RTP timestamp pair of an SR and refit. A pair more than
+ *        LIBRTP_CLOCK_RESYNC off the current line restarts the fit.
+ *
+ * @param [in] c - clock.
+ * @param [in] ntp - NTP timestamp of the SR.
+ * @param [in] rtp_ts - RTP timestamp of the SR.
+ */
+void rtp_clock_update(rtp_clock *c, ntp_ts ntp, uint32_t rtp_ts);
+
+/**
+ * @brief Whether the clock has seen enough SRs to estimate the rate.
+ *
+ * @param [in] c - clock.
+ * @return true with at least two SRs.
+ */
+bool rtp_clock_valid(const rtp_clock *c);
+
+/**
+ * @brief Absolute time of an RTP timestamp, within 2^31 ticks of the last SR.
+ *
+ * @param [in] c - clock (at least one SR).
+ * @param [in] rtp_ts - RTP timestamp (e.g. of a sample).
+ * @return NTP timestamp.
+ */
+ntp_ts rtp_clock_to_ntp(const rtp_clock *c, uint32_t rtp_ts);
+
+/**
+ * @brief RTP timestamp of the sender at an absolute time.
+ *
+ * @param [in] c - clock (at least one SR).
+ * @param [in] ntp - NTP timestamp.
+ * @return RTP timestamp.
+ */
+uint32_t rtp_clock_to_rtp(const rtp_clock *c, ntp_ts ntp);
+
+/**
+ * @brief Sender clock rate error against the nominal rate.
+ *
+ * @param [in] c - clock.
+ * @return parts per million, positive if the sender clock runs fast.
+ */
+double rtp_clock_drift_ppm(const rtp_clock *c);
+
+#endif // RTP_CLOCK_H_
@@ -0,0 +1,166 @@
+/*
+ * Copyright 2023 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/rtp-sdr *
+ *
+ * This is based on other projects:
+ *      IDEA: https://github.com/OpenResearchInstitute/ka9q-sdr (not use any code of this)
+ *       RTP: https://github.com/Daxbot/librtp/
+ *       FEC: https://github.com/wesen/poc
+ *    SOCKET: https://github.com/njh/mast
+ *    OTHERS: see individual files
+ *
+ *    please contact their authors for more information.
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/**
+ * @defgroup loop Event loop
+ * @brief epoll based event loop for RTP/RTCP sockets and timers.
+ *
+ * One thread can service many sessions: sockets are registered edge-triggered
+ * (the callback must read until rtp_socket_try_recv() returns 0) and timers
+ * are timerfds on the same epoll set, so pacing and RTCP intervals need no
+ * extra thread.
+ */
+
+#ifndef RTP_LOOP_H_
+#define RTP_LOOP_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "rtp_socket.h"
+
+/**
+ * @brief Socket events.
+ */
+enum {
+    RTP_LOOP_IN  = 1 << 0, /**< socket is readable */
+    RTP_LOOP_OUT = 1 << 1, /**< socket is writable */
+    RTP_LOOP_ERR = 1 << 2  /**< error or hang up */
+};
+
+typedef struct rtp_loop_s rtp_loop_t;               /**< opaque event loop */
+typedef struct rtp_loop_source_s rtp_loop_source_t; /**< opaque registered socket or timer */
+
+/**
+ * @brief Socket callback.
+ *
+ * @param [in] loop - event loop.
+ * @param [in] sock - socket with pending events.
+ * @param [in] events - RTP_LOOP_IN / RTP_LOOP_OUT / RTP_LOOP_ERR mask.
+ * @param [in] arg - user argument.
+ */
+typedef void (*rtp_loop_io_cb)(rtp_loop_t *loop, rtp_socket_t *sock, uint32_t events, void *arg);
+
+/**
+ * @brief Timer callback.
+ *
+ * @param [in] loop - event loop.
+ * @param [in] expirations - number of expirations since the last call (more than 1 if the loop fell behind).
+ * @param [in] arg - user argument.
+ */
+typedef void (*rtp_loop_timer_cb)(rtp_loop_t *loop, uint64_t expirations, void *arg);
+
+/**
+ * @brief Allocate a new event loop.
+ *
+ * @return rtp_loop_t* or NULL on failure.
+ */
+rtp_loop_t* rtp_loop_create(void);
+
+/**
+ * @brief Free an event loop and all its sources. Registered sockets are not closed.
+ *
+ * @param [out] loop - loop to free.
+ */
+void rtp_loop_free(rtp_loop_t *loop);
+
+/**
+ * @brief Register a socket. The socket is switched to non-blocking mode.
+ *
+ * @param [in] loop - event loop.
+ * @param [in] sock - socket to watch.
+ * @param [in] events - RTP_LOOP_IN and/or RTP_LOOP_OUT.
+ * @param [in] cb - callback.
+ * @param [in] arg - user argument.
+ * @return source or NULL on failure.
+ */
+rtp_loop_source_t* rtp_loop_add_socket(rtp_loop_t *loop, rtp_socket_t *sock, uint32_t events, rtp_loop_io_cb cb, void *arg);
+
+/**
+ * @brief Register a timer.
+ *
+ * @param [in] loop - event loop.
+ * @param [in] first_ns - delay to the first expiration in nanoseconds (0: disarmed).
+ * @param [in] interval_ns - period in nanoseconds (0: one shot).
+ * @param [in] cb - callback.
+ * @param [in] arg - user argument.
+ * @return source or NULL on failure.
+ */
+rtp_loop_source_t* rtp_loop_add_timer(rtp_loop_t *loop, uint64_t first_ns, uint64_t interval_ns, rtp_loop_timer_cb cb, void *arg);
+
+/**
+ * @brief Re-arm a timer, e.g. for the next randomized RTCP interval.
+ *
+ * @param [in] source - timer source.
+ * @param [in] first_ns - delay to the first expiration in nanoseconds (0: disarm).
+ * @param [in] interval_ns - period in nanoseconds (0: one shot).
+ * @return 0 on success.
+ */
+int rtp_loop_timer_set(rtp_loop_source_t *source, uint64_t first_ns, uint64_t interval_ns);
+
+/**
+ * @brief Unregister a socket or timer. Safe to call from a callback.
+ *
+ * @param [in] loop - event loop.
+ * @param [in] source - source to remove.
+ */
+void rtp_loop_remove(rtp_loop_t *loop, rtp_loop_source_t *source);
+
+/**
+ * @brief Wait for events and dispatch them once.
+ *
+ * @param [in] loop - event loop.
+ * @param [in] timeout_ms - maximum wait in milliseconds (-1: forever).
+ * @return number of dispatched events or -1 on failure.
+ */
+int rtp_loop_run_once(rtp_loop_t *loop, int timeout_ms);
+
+/**
+ * @brief Dispatch events until rtp_loop_stop() is called.
+ *
+ * @param [in] loop - event loop.
+ * @return 0 on success.
+ */
+int rtp_loop_run(rtp_loop_t *loop);
+
+/**
+ * @brief Make rtp_loop_run() return after the current dispatch.
+ *
+ * @param [in] loop - event loop.
+ */
+void rtp_loop_stop(rtp_loop_t *loop);
+
+#endif // RTP_LOOP_H_
@@ -38,6 +38,7 @@
 #define RTP_NTP_H_
 
 #include <stdint.h>
+#include <time.h>
 
 /**
  * @brief NTP timeval.
@@ -47,6 +48,117 @@ typedef struct ntp_tv {
     uint32_t frac; /**< Fractional seconds (2^32). */
 } ntp_tv;
 
+/**
+ * @brief NTP timestamp as 32.32 fixed point: seconds since Jan 1, 1900 in the
+ *        upper half, fraction in the lower half. Also used for durations.
+ *        Plain integer arithmetic applies: sums and differences wrap with the era.
+ */
+typedef uint64_t ntp_ts;
+
+/**
+ * @brief Converts an NTP timeval to fixed point.
+ *
+ * @param [in] ntp - NTP timeval.
+ * @return ntp_ts
+ */
+ntp_ts ntp_pack(ntp_tv ntp);
+
+/**
+ * @brief Converts a fixed point NTP timestamp to a timeval.
+ *
+ * @param [in] t - NTP timestamp.
+ * @return ntp_tv
+ */
+ntp_tv ntp_unpack(ntp_ts t);
+
+/**
+ * @brief Sum of two NTP timestamps or durations.
+ *
+ * @param [in] a - first timestamp.
+ * @param [in] b - second timestamp.
+ * @return a + b.
+ */
+ntp_ts ntp_ts_add(ntp_ts a, ntp_ts b);
+
+/**
+ * @brief Difference of two NTP timestamps.
+ *
+ * @param [in] a - first timestamp.
+ * @param [in] b - second timestamp.
+ * @return a - b.
+ */
+ntp_ts ntp_ts_sub(ntp_ts a, ntp_ts b);
+
+/**
+ * @brief Compares two NTP timestamps less than half an era (68 years) apart.
+ *
+ * @param [in] a - first timestamp.
+ * @param [in] b - second timestamp.
+ * @return <0, 0 or >0 as a is before, equal to or after b.
+ */
+int ntp_ts_cmp(ntp_ts a, ntp_ts b);
+
+/**
+ * @brief Middle 32 bits of an NTP timestamp (NTP short format, e.g. LSR and DLSR).
+ *
+ * @param [in] t - NTP timestamp.
+ * @return NTP short format timestamp.
+ */
+uint32_t ntp_ts_short(ntp_ts t);
+
+/**
+ * @brief Expands an NTP short format value (e.g. a round trip) to fixed point.
+ *
+ * @param [in] s - NTP short format value.
+ * @return ntp_ts
+ */
+ntp_ts ntp_ts_from_short(uint32_t s);
+
+/**
+ * @brief Converts a duration in nanoseconds to fixed point.
+ *
+ * @param [in] ns - nanoseconds.
+ * @return ntp_ts
+ */
+ntp_ts ntp_ts_from_ns(uint64_t ns);
+
+/**
+ * @brief Converts a fixed point duration to nanoseconds (rounded).
+ *
+ * @param [in] t - duration.
+ * @return nanoseconds.
+ */
+uint64_t ntp_ts_to_ns(ntp_ts t);
+
+/**
+ * @brief Converts a timespec to fixed point.
+ *
+ * CLOCK_REALTIME values are shifted to the NTP epoch, other clocks
+ * (e.g. CLOCK_MONOTONIC) keep their own origin.
+ *
+ * @param [in] clock - clock the timespec was read from.
+ * @param [in] ts - time.
+ * @return ntp_ts
+ */
+ntp_ts ntp_ts_from_timespec(clockid_t clock, const struct timespec *ts);
+
+/**
+ * @brief Converts a fixed point timestamp to a timespec of the given clock.
+ *
+ * @param [in] clock - clock of the result (see ntp_ts_from_timespec()).
+ * @param [in] t - NTP timestamp.
+ * @param [out] ts - time.
+ */
+void ntp_ts_to_timespec(clockid_t clock, ntp_ts t, struct timespec *ts);
+
+/**
+ * @brief Reads a clock as fixed point (see ntp_ts_from_timespec()).
+ *
+ * @param [in] clock - e.g. CLOCK_REALTIME for SR timestamps, CLOCK_MONOTONIC for intervals.
+ * @return ntp_ts
+ */
+ntp_ts ntp_ts_now(clockid_t clock);
+
 /**
  * @brief Converts an NTP timestamp to its double representation.
  *
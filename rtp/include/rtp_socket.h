@@ -37,11 +37,19 @@
 #ifndef RTP_SOCKET_H_
 #define RTP_SOCKET_H_
 
+#include <stdint.h>
+#include <stdbool.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <time.h>
 
 //#define LOG
 
+#define RTP_SOCKET_GSO_MAX_SEGMENTS (64)    // kernel limit of segments per UDP_SEGMENT send
+#define RTP_SOCKET_GSO_MAX_BYTES    (65507) // largest UDP payload (super-buffer or GRO receive)
+#define RTP_SOCKET_MAX_SHARDS       (64)    // receive sockets sharing one port
+#define RTP_SOCKET_RX_CMSG_SPACE    (CMSG_SPACE(3 * sizeof(struct timespec)) + CMSG_SPACE(sizeof(uint32_t))) // receive timestamp and drop count
+
 enum {
     DO_BIND_SOCKET,
     DONT_BIND_SOCKET
@@ -64,6 +72,10 @@ typedef struct rtp_socket_s {
              int fd;
              int joined_group;
     unsigned int if_index;
+             bool no_gso;     // UDP_SEGMENT rejected, send one datagram per segment
+         uint32_t zc_next;    // id of the next MSG_ZEROCOPY send
+         uint64_t rx_tstamp;  // kernel arrival time of the last datagram received (ns, CLOCK_REALTIME), 0: unknown
+         uint32_t rx_dropped; // datagrams the kernel dropped so far because the receive buffer was full
 
     struct sockaddr_storage dest_addr;
     struct sockaddr_storage src_addr;
@@ -75,9 +87,27 @@ typedef struct rtp_socket_s {
 } rtp_socket_t;
 
  int rtp_socket_open_recv(rtp_socket_t *sock, const char *address, uint16_t port, const char *ifname);
+// count reuseport receive sockets on one port (e.g. one per worker core), a stream always lands on socks[ssrc % count]
+ int rtp_socket_open_recv_shards(rtp_socket_t *socks, unsigned int count, const char *address, uint16_t port, const char *ifname);
+ int rtp_socket_steer_ssrc(rtp_socket_t *sock, unsigned int count);
  int rtp_socket_open_send(rtp_socket_t *sock, const char *address, uint16_t port, const char *ifname);
  int rtp_socket_recv(rtp_socket_t *sock, void *data, unsigned int len);
+ int rtp_socket_try_recv(rtp_socket_t *sock, void *data, unsigned int len);
+ int rtp_socket_recv_gro(rtp_socket_t *sock, void *data, unsigned int len, unsigned int *segment);
+ int rtp_socket_try_recv_gro(rtp_socket_t *sock, void *data, unsigned int len, unsigned int *segment);
  int rtp_socket_send(rtp_socket_t *sock, void *data, unsigned int len);
+ int rtp_socket_send_gso(rtp_socket_t *sock, void *data, unsigned int len, unsigned int segment);
+ int rtp_socket_set_gro(rtp_socket_t *sock, bool enable);
+ int rtp_socket_set_zerocopy(rtp_socket_t *sock, bool enable);
+ int rtp_socket_send_zc(rtp_socket_t *sock, void *data, unsigned int len, unsigned int segment, uint32_t *id);
+ int rtp_socket_zc_reap(rtp_socket_t *sock, uint32_t *lo, uint32_t *hi, bool *copied);
+ int rtp_socket_set_rcvbuf(rtp_socket_t *sock, unsigned int bytes);
+ int rtp_socket_set_sndbuf(rtp_socket_t *sock, unsigned int bytes);
+ int rtp_socket_set_busy_poll(rtp_socket_t *sock, unsigned int usecs, bool prefer);
+ int rtp_socket_set_nonblock(rtp_socket_t *sock, bool nonblock);
 void rtp_socket_close(rtp_socket_t *sock);
 
+// Update rx_tstamp and rx_dropped from the control data of a datagram received on sock (RTP_SOCKET_RX_CMSG_SPACE room)
+void rtp_socket_rx_cmsg(rtp_socket_t *sock, struct msghdr *msg);
+
 #endif /* RTP_SOCKET_H_ */
@@ -0,0 +1,179 @@
+/*
+ * Copyright 2023 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/rtp-sdr *
+ *
+ * This is based on other projects:
+ *      IDEA: https://github.com/OpenResearchInstitute/ka9q-sdr (not use any code of this)
+ *       RTP: https://github.com/Daxbot/librtp/
+ *       FEC: https://github.com/wesen/poc
+ *    SOCKET: https://github.com/njh/mast
+ *    OTHERS: see individual files
+ *
+ *    please contact their authors for more information.
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/**
+ * @defgroup source_table Source table
+ * @brief Per-SSRC receiver state for many senders.
+ *
+ * Open addressing with linear probing over a compact array of (ssrc, index)
+ * slots, so a lookup touches one or two cache lines however many sources are
+ * tracked. The records live in a fixed pool sized at creation and never
+ * move: pointers stay valid until the source is removed.
+ */
+
+#ifndef RTP_SOURCE_TABLE_H_
+#define RTP_SOURCE_TABLE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "rtp_source.h"
+#include "rtp_ntp.h"
+
+/**
+ * @brief Source flags.
+ */
+enum {
+    RTP_SOURCE_SENDER = 1 << 0, /**< RTP or an SR was received from the source */
+};
+
+/**
+ * @brief Source table record.
+ */
+typedef struct rtp_source_entry {
+    rtp_source source;   /**< Sequence, loss and jitter state. */
+      uint64_t last_seen; /**< Time of the last RTP/RTCP packet, in the caller's clock. */
+      uint32_t flags;     /**< RTP_SOURCE_* flags. */
+          void *user;     /**< User data, e.g. where the stream is routed to. */
+} rtp_source_entry;
+
+typedef struct rtp_source_table_s rtp_source_table_t; /**< opaque source table */
+
+/**
+ * @brief Called for every source that expires.
+ *
+ * @param [in] entry - source about to be removed.
+ * @param [in] arg - user argument.
+ */
+typedef void (*rtp_source_table_cb)(rtp_source_entry *entry, void *arg);
+
+/**
+ * @brief Allocate a source table.
+ *
+ * @param [in] max_sources - most sources tracked at the same time.
+ * @return rtp_source_table_t* or NULL on failure.
+ */
+rtp_source_table_t* rtp_source_table_create(unsigned int max_sources);
+
+/**
+ * @brief Free a source table.
+ *
+ * @param [out] table - table to free.
+ */
+void rtp_source_table_free(rtp_source_table_t *table);
+
+/**
+ * @brief Number of sources tracked.
+ *
+ * @param [in] table - table.
+ * @return unsigned int
+ */
+unsigned int rtp_source_table_count(rtp_source_table_t *table);
+
+/**
+ * @brief Look up a source.
+ *
+ * @param [in] table - table.
+ * @param [in] id - source identifier.
+ * @return rtp_source_entry* or NULL if the source is unknown.
+ */
+rtp_source_entry* rtp_source_table_find(rtp_source_table_t *table, uint32_t id);
+
+/**
+ * @brief Look up a source, adding it if unknown (e.g. to route it before its first packet).
+ *
+ * @param [in] table - table.
+ * @param [in] id - source identifier.
+ * @param [in] now - current time, last_seen of an added source.
+ * @return rtp_source_entry* or NULL if the table is full.
+ */
+rtp_source_entry* rtp_source_table_add(rtp_source_table_t *table, uint32_t id, uint64_t now);
+
+/**
+ * @brief Account an RTP packet: the source is added on its first packet,
+ *        then its sequence is validated (rtp_source_update_seq()).
+ *
+ * @param [in] table - table.
+ * @param [in] id - SSRC of the packet.
+ * @param [in] seq - sequence number of the packet.
+ * @param [in] now - arrival time.
+ * @param [out] entry - source record (NULL if the table is full).
+ * @return 0 the packet is valid.
+ * @return -1 the packet should be discarded or the table is full.
+ */
+int rtp_source_table_rtp(rtp_source_table_t *table, uint32_t id, uint16_t seq, uint64_t now, rtp_source_entry **entry);
+
+/**
+ * @brief Account an RTCP SR: the source is added if unknown and its LSR updated.
+ *
+ * @param [in] table - table.
+ * @param [in] id - SSRC of the sender.
+ * @param [in] ntp - NTP timestamp of the report.
+ * @param [in] now - arrival time.
+ * @return rtp_source_entry* or NULL if the table is full.
+ */
+rtp_source_entry* rtp_source_table_sr(rtp_source_table_t *table, uint32_t id, ntp_tv ntp, uint64_t now);
+
+/**
+ * @brief Remove a source, e.g. on RTCP BYE.
+ *
+ * @param [in] table - table.
+ * @param [in] id - source identifier.
+ */
+void rtp_source_table_remove(rtp_source_table_t *table, uint32_t id);
+
+/**
+ * @brief Remove the sources not heard from since now - timeout.
+ *
+ * @param [in] table - table.
+ * @param [in] now - current time.
+ * @param [in] timeout - inactivity limit, same clock as now.
+ * @param [in] cb - called before each removal (may be NULL).
+ * @param [in] arg - user argument.
+ * @return number of sources removed.
+ */
+unsigned int rtp_source_table_expire(rtp_source_table_t *table, uint64_t now, uint64_t timeout, rtp_source_table_cb cb, void *arg);
+
+/**
+ * @brief Iterate over the sources.
+ *
+ * @param [in] table - table.
+ * @param [in] prev - previous record, NULL to start.
+ * @return next rtp_source_entry* or NULL at the end.
+ */
+rtp_source_entry* rtp_source_table_next(rtp_source_table_t *table, rtp_source_entry *prev);
+
+#endif // RTP_SOURCE_TABLE_H_
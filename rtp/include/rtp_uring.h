@@ -0,0 +1,185 @@
+/*
+ * Copyright 2023 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/rtp-sdr *
+ *
+ * This is based on other projects:
+ *      IDEA: https://github.com/OpenResearchInstitute/ka9q-sdr (not use any code of this)
+ *       RTP: https://github.com/Daxbot/librtp/
+ *       FEC: https://github.com/wesen/poc
+ *    SOCKET: https://github.com/njh/mast
+ *    OTHERS: see individual files
+ *
+ *    please contact their authors for more information.
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/**
+ * @defgroup uring io_uring transport
+ * @brief io_uring based RTP send/receive path.
+ *
+ * RX arms one multishot recvmsg per socket that picks its buffers from a
+ * provided buffer ring, so a stream of datagrams costs no syscall per packet.
+ * TX builds packets directly in registered (fixed) buffers and queues sends
+ * that are submitted in batches; with RTP_URING_SQPOLL a kernel thread picks
+ * up the submissions and the application makes no syscall at all while busy.
+ *
+ * A ring is not thread safe: use one ring per thread (e.g. one for tx and one
+ * for rx of a session). rtp_uring_create() returns NULL when io_uring is not
+ * available and callers are expected to fall back to rtp_socket_send() /
+ * rtp_socket_recv().
+ */
+
+#ifndef RTP_URING_H_
+#define RTP_URING_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "rtp_socket.h"
+
+/**
+ * @brief Ring flags.
+ */
+enum {
+    RTP_URING_SQPOLL = 1 << 0 /**< kernel thread polls the submission queue */
+};
+
+typedef struct rtp_uring_s rtp_uring_t; /**< opaque io_uring transport */
+
+/**
+ * @brief Received datagram callback.
+ *
+ * @param [in] data - datagram, valid only during the call.
+ * @param [in] len - datagram length.
+ * @param [in] arg - user argument.
+ */
+typedef void (*rtp_uring_recv_cb)(const uint8_t *data, unsigned int len, void *arg);
+
+/**
+ * @brief Allocate a new ring.
+ *
+ * @param [in] entries - submission queue entries.
+ * @param [in] buffers - rx provided buffers and tx registered buffers (rounded up to a power of 2).
+ * @param [in] buffer_size - size of every buffer (largest datagram).
+ * @param [in] flags - RTP_URING_SQPOLL.
+ * @return rtp_uring_t* or NULL if io_uring is not available.
+ */
+rtp_uring_t* rtp_uring_create(unsigned int entries, unsigned int buffers, unsigned int buffer_size, uint32_t flags);
+
+/**
+ * @brief Free a ring. Pending operations are cancelled, sockets are not closed.
+ *
+ * @param [out] ring - ring to free.
+ */
+void rtp_uring_free(rtp_uring_t *ring);
+
+/**
+ * @brief Pseudo socket that becomes readable when completions are pending,
+ *        to be registered with rtp_loop_add_socket().
+ *
+ * @param [in] ring - ring.
+ * @return rtp_socket_t*
+ */
+rtp_socket_t* rtp_uring_notify(rtp_uring_t *ring);
+
+/**
+ * @brief Arm the multishot receive on a socket. A ring receives from one socket,
+ *        calling it again for an armed socket does nothing.
+ *
+ * @param [in] ring - ring.
+ * @param [in] sock - open receive socket.
+ * @return 0 on success.
+ */
+ int rtp_uring_recv_start(rtp_uring_t *ring, rtp_socket_t *sock);
+
+/**
+ * @brief Reap completions: received datagrams are passed to cb and their buffers recycled,
+ *        finished sends release their buffers. The multishot receive is re-armed if the
+ *        kernel stopped it.
+ *
+ * @param [in] ring - ring.
+ * @param [in] cb - received datagram callback (may be NULL on a tx only ring).
+ * @param [in] arg - user argument.
+ * @param [in] wait - block until at least one completion is available.
+ * @return number of received datagrams or -1 on failure.
+ */
+ int rtp_uring_poll(rtp_uring_t *ring, rtp_uring_recv_cb cb, void *arg, bool wait);
+
+/**
+ * @brief Kernel arrival time of the datagram being passed to the receive callback.
+ *        The rx_tstamp and rx_dropped fields of the receive socket are kept up to date as well.
+ *
+ * @param [in] ring - ring.
+ * @return ns since the epoch (CLOCK_REALTIME) or 0 if the socket gave no timestamp.
+ */
+uint64_t rtp_uring_rx_tstamp(rtp_uring_t *ring);
+
+/**
+ * @brief Get a free registered tx buffer, reaping finished sends if needed.
+ *
+ * @param [in] ring - ring.
+ * @param [out] slot - buffer slot to pass to rtp_uring_send().
+ * @return buffer of buffer_size bytes or NULL if every buffer is in flight.
+ */
+uint8_t* rtp_uring_send_buffer(rtp_uring_t *ring, unsigned int *slot);
+
+/**
+ * @brief Queue a send of a registered buffer to the socket destination.
+ *        Nothing is sent before rtp_uring_submit().
+ *
+ * @param [in] ring - ring.
+ * @param [in] sock - open send socket.
+ * @param [in] slot - slot returned by rtp_uring_send_buffer().
+ * @param [in] len - datagram length.
+ * @return 0 on success.
+ */
+ int rtp_uring_send(rtp_uring_t *ring, rtp_socket_t *sock, unsigned int slot, unsigned int len);
+
+/**
+ * @brief Give back a buffer taken with rtp_uring_send_buffer() that will not be sent.
+ *
+ * @param [in] ring - ring.
+ * @param [in] slot - slot returned by rtp_uring_send_buffer().
+ */
+void rtp_uring_send_release(rtp_uring_t *ring, unsigned int slot);
+
+/**
+ * @brief Number of sends the kernel completed with an error since the last call, as seen by
+ *        rtp_uring_poll(). The count is reset and errno is set to the error of the last one.
+ *
+ * @param [in] ring - ring.
+ * @return failed sends.
+ */
+unsigned int rtp_uring_send_errors(rtp_uring_t *ring);
+
+/**
+ * @brief Submit the queued operations. With RTP_URING_SQPOLL a syscall is made only
+ *        to wake up an idle poller thread.
+ *
+ * @param [in] ring - ring.
+ * @return number of submitted operations or -1 on failure.
+ */
+ int rtp_uring_submit(rtp_uring_t *ring);
+
+#endif // RTP_URING_H_
@@ -0,0 +1,183 @@
+/*
+ * Copyright 2023 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/rtp-sdr *
+ *
+ * This is based on other projects:
+ *      IDEA: https://github.com/OpenResearchInstitute/ka9q-sdr (not use any code of this)
+ *       RTP: https://github.com/Daxbot/librtp/
+ *       FEC: https://github.com/wesen/poc
+ *    SOCKET: https://github.com/njh/mast
+ *    OTHERS: see individual files
+ *
+ *    please contact their authors for more information.
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+/**
+ * @defgroup xdp AF_XDP transport
+ * @brief Kernel bypass RTP send/receive path.
+ *
+ * An XDP program on the interface steers IPv4/UDP datagrams for one port to
+ * an AF_XDP socket bound to one queue; everything else goes on to the kernel
+ * stack. Received payloads are handed out straight from the UMEM frame pool,
+ * and transmit payloads are built in UMEM frames behind Ethernet/IPv4/UDP
+ * headers filled in here, so no packet is copied by the application.
+ *
+ * Copy (generic, SKB) mode works on any interface, e.g. a veth pair, while
+ * driver and zero copy modes need NIC support. IPv4 only; datagrams must fit
+ * one UMEM frame, see rtp_xdp_max_payload() (IP fragments are passed on to
+ * the kernel stack).
+ * Like rtp_uring, rx and tx may run on two different threads, but each
+ * direction must stay on one thread.
+ */
+
+#ifndef RTP_XDP_H_
+#define RTP_XDP_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "rtp_socket.h"
+
+/**
+ * @brief Socket flags.
+ */
+enum {
+    RTP_XDP_SKB_MODE = 1 << 0, /**< generic XDP and copy mode: works on any interface */
+    RTP_XDP_DRV_MODE = 1 << 1, /**< native driver XDP */
+    RTP_XDP_ZEROCOPY = 1 << 2  /**< zero copy UMEM (native mode on a supporting NIC) */
+};
+
+#define RTP_XDP_FRAMES     4096 /**< default UMEM frames, half for rx and half for tx */
+#define RTP_XDP_FRAME_SIZE 4096 /**< default UMEM frame size (power of 2, at most a page) */
+#define RTP_XDP_HEADERS    42   /**< Ethernet + IPv4 + UDP header bytes in front of the payload */
+
+typedef struct rtp_xdp_s rtp_xdp_t; /**< opaque AF_XDP socket */
+
+/**
+ * @brief Received payload callback.
+ *
+ * @param [in] data - UDP payload in the UMEM frame, valid only during the call.
+ * @param [in] len - payload length.
+ * @param [in] arg - user argument.
+ */
+typedef void (*rtp_xdp_recv_cb)(const uint8_t *data, unsigned int len, void *arg);
+
+/**
+ * @brief Create an AF_XDP socket on an interface queue and attach the steering program.
+ *
+ * @param [in] ifname - network interface.
+ * @param [in] queue - interface rx/tx queue.
+ * @param [in] port - UDP destination port steered to the socket (also the tx source port).
+ * @param [in] frames - UMEM frames (0: RTP_XDP_FRAMES).
+ * @param [in] frame_size - UMEM frame size, a power of 2 from 2048 to the page size (0: RTP_XDP_FRAME_SIZE).
+ * @param [in] flags - RTP_XDP_SKB_MODE / RTP_XDP_DRV_MODE / RTP_XDP_ZEROCOPY.
+ * @return rtp_xdp_t* or NULL if AF_XDP is not available.
+ */
+rtp_xdp_t* rtp_xdp_create(const char *ifname, uint32_t queue, uint16_t port, uint32_t frames, uint32_t frame_size, uint32_t flags);
+
+/**
+ * @brief Detach the program and free the socket.
+ *
+ * @param [out] xdp - socket to free.
+ */
+void rtp_xdp_free(rtp_xdp_t *xdp);
+
+/**
+ * @brief Pseudo socket that becomes readable when datagrams are pending,
+ *        to be registered with rtp_loop_add_socket().
+ *
+ * @param [in] xdp - socket.
+ * @return rtp_socket_t*
+ */
+rtp_socket_t* rtp_xdp_notify(rtp_xdp_t *xdp);
+
+/**
+ * @brief Largest UDP payload that fits a received UMEM frame.
+ *
+ * @param [in] xdp - socket.
+ * @return payload bytes.
+ */
+unsigned int rtp_xdp_max_payload(rtp_xdp_t *xdp);
+
+/**
+ * @brief Set the transmit destination from an open send socket (address and port)
+ *        and the next hop hardware address.
+ *
+ * @param [in] xdp - socket.
+ * @param [in] sock - open send socket (IPv4).
+ * @param [in] mac - next hop hardware address (NULL: neighbour table or multicast mapping).
+ * @return 0 on success.
+ */
+ int rtp_xdp_set_dest(rtp_xdp_t *xdp, rtp_socket_t *sock, const uint8_t *mac);
+
+/**
+ * @brief Hand every received datagram to cb and give the frames back to the fill ring.
+ *
+ * @param [in] xdp - socket.
+ * @param [in] cb - received payload callback.
+ * @param [in] arg - user argument.
+ * @param [in] wait - block until at least one datagram is available.
+ * @return number of received datagrams or -1 on failure.
+ */
+ int rtp_xdp_recv(rtp_xdp_t *xdp, rtp_xdp_recv_cb cb, void *arg, bool wait);
+
+/**
+ * @brief Get a free UMEM frame for a datagram, reaping completed sends if needed.
+ *
+ * @param [in] xdp - socket.
+ * @param [out] frame - frame to pass to rtp_xdp_send().
+ * @param [out] size - room for the payload.
+ * @return payload area of the frame or NULL if every tx frame is in flight.
+ */
+uint8_t* rtp_xdp_send_buffer(rtp_xdp_t *xdp, unsigned int *frame, unsigned int *size);
+
+/**
+ * @brief Add the headers and queue a frame for transmission.
+ *        Nothing is sent before rtp_xdp_submit().
+ *
+ * @param [in] xdp - socket.
+ * @param [in] frame - frame returned by rtp_xdp_send_buffer().
+ * @param [in] len - payload length.
+ * @return 0 on success.
+ */
+ int rtp_xdp_send(rtp_xdp_t *xdp, unsigned int frame, unsigned int len);
+
+/**
+ * @brief Give back a frame taken with rtp_xdp_send_buffer() that will not be sent.
+ *
+ * @param [in] xdp - socket.
+ * @param [in] frame - frame returned by rtp_xdp_send_buffer().
+ */
+void rtp_xdp_send_release(rtp_xdp_t *xdp, unsigned int frame);
+
+/**
+ * @brief Publish the queued frames and kick the kernel if it asks for it.
+ *
+ * @param [in] xdp - socket.
+ * @return number of published frames or -1 on failure.
+ */
+ int rtp_xdp_submit(rtp_xdp_t *xdp);
+
+#endif // RTP_XDP_H_
@@ -0,0 +1,577 @@
+/*
+ * Copyright 2023 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/rtp-sdr *
+ *
+ * This is based on other projects:
+ *      IDEA: https://github.com/OpenResearchInstitute/ka9q-sdr (not use any code of this)
+ *       RTP: https://github.com/Daxbot/librtp/
+ *       FEC: https://github.com/wesen/poc
+ *    SOCKET: https://github.com/njh/mast
+ *    OTHERS: see individual files
+ *
+ *    please contact their authors for more information.
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include "rtcp_compound.h"
+#include "rtcp_util.h"
+#include "rtp_util.h"
+
+/**
+ * @brief No block or chunk open.
+ * @private
+ */
+#define RTCP_COMPOUND_NONE (SIZE_MAX)
+
+/**
+ * @brief Largest value of the 5 bit count field.
+ * @private
+ */
+#define RTCP_COMPOUND_MAX_COUNT (31)
+
+// Room for n more bytes, or NULL (and the error latched) if the buffer is full.
+static uint8_t* _reserve(rtcp_compound *packet, size_t n) {
+    if (packet->error || packet->size - packet->length < n) {
+        packet->error = true;
+        return NULL;
+    }
+
+    uint8_t *p = packet->buffer + packet->length;
+    packet->length += n;
+
+    return p;
+}
+
+// End the SDES chunk: at least one null octet (the END item), then up to the next 32-bit boundary.
+static void _close_chunk(rtcp_compound *packet) {
+    if (packet->chunk == RTCP_COMPOUND_NONE)
+        return;
+
+    size_t pad = 4 - ((packet->length - packet->chunk) % 4);
+    uint8_t *p = _reserve(packet, pad);
+    if (p != NULL)
+        memset(p, 0, pad);
+
+    packet->chunk = RTCP_COMPOUND_NONE;
+}
+
+// Write the length of the open block.
+static void _close(rtcp_compound *packet) {
+    if (packet->block == RTCP_COMPOUND_NONE)
+        return;
+
+    _close_chunk(packet);
+    if (!packet->error)
+        write_u16(packet->buffer + packet->block + 2, (uint16_t) ((packet->length - packet->block) / 4 - 1));
+
+    packet->block = RTCP_COMPOUND_NONE;
+}
+
+static int _open(rtcp_compound *packet, uint8_t pt, uint8_t count, size_t fixed) {
+    _close(packet);
+
+    uint8_t *p = _reserve(packet, 4 + fixed);
+    if (p == NULL)
+        return RTCP_ERROR;
+
+    p[0] = 0x80 | count; // version 2, no padding
+    p[1] = pt;
+    write_u16(p + 2, 0);
+    packet->block = p - packet->buffer;
+
+    return RTCP_OK;
+}
+
+// Bump the count field of the open block.
+static int _count(rtcp_compound *packet) {
+    uint8_t *p = packet->buffer + packet->block;
+
+    if ((p[0] & 0x1f) == RTCP_COMPOUND_MAX_COUNT)
+        return RTCP_ERROR;
+
+    p[0]++;
+
+    return RTCP_OK;
+}
+
+void rtcp_compound_init(rtcp_compound *packet, uint8_t *buffer, size_t size) {
+    assert(packet != NULL);
+    assert(buffer != NULL);
+
+    packet->buffer = buffer;
+    packet->size = size;
+    packet->length = 0;
+    packet->block = RTCP_COMPOUND_NONE;
+    packet->chunk = RTCP_COMPOUND_NONE;
+    packet->error = false;
+}
+
+int rtcp_compound_sr(rtcp_compound *packet, uint32_t ssrc, ntp_tv ntp, uint32_t rtp_ts, uint32_t pkt_count, uint32_t byte_count) {
+    assert(packet != NULL);
+
+    if (_open(packet, RTCP_SR, 0, 24) < 0)
+        return RTCP_ERROR;
+
+    uint8_t *p = packet->buffer + packet->block;
+    write_u32(p + 4, ssrc);
+    write_u32(p + 8, ntp.sec);
+    write_u32(p + 12, ntp.frac);
+    write_u32(p + 16, rtp_ts);
+    write_u32(p + 20, pkt_count);
+    write_u32(p + 24, byte_count);
+
+    return RTCP_OK;
+}
+
+int rtcp_compound_rr(rtcp_compound *packet, uint32_t ssrc) {
+    assert(packet != NULL);
+
+    if (_open(packet, RTCP_RR, 0, 4) < 0)
+        return RTCP_ERROR;
+
+    write_u32(packet->buffer + packet->block + 4, ssrc);
+
+    return RTCP_OK;
+}
+
+int rtcp_compound_report(rtcp_compound *packet, const rtcp_report *report) {
+    assert(packet != NULL);
+    assert(report != NULL);
+
+    if (packet->block == RTCP_COMPOUND_NONE)
+        return RTCP_ERROR;
+
+    uint8_t pt = packet->buffer[packet->block + 1];
+    if ((pt != RTCP_SR && pt != RTCP_RR) || _count(packet) < 0)
+        return RTCP_ERROR;
+
+    uint8_t *p = _reserve(packet, 24);
+    if (p == NULL)
+        return RTCP_ERROR;
+
+    return rtcp_report_serialize(report, p, 24) < 0 ? RTCP_ERROR : RTCP_OK;
+}
+
+int rtcp_compound_sdes(rtcp_compound *packet) {
+    assert(packet != NULL);
+
+    return _open(packet, RTCP_SDES, 0, 0);
+}
+
+int rtcp_compound_sdes_chunk(rtcp_compound *packet, uint32_t ssrc) {
+    assert(packet != NULL);
+
+    if (packet->block == RTCP_COMPOUND_NONE || packet->buffer[packet->block + 1] != RTCP_SDES)
+        return RTCP_ERROR;
+
+    _close_chunk(packet);
+    if (_count(packet) < 0)
+        return RTCP_ERROR;
+
+    uint8_t *p = _reserve(packet, 4);
+    if (p == NULL)
+        return RTCP_ERROR;
+
+    write_u32(p, ssrc);
+    packet->chunk = p - packet->buffer;
+
+    return RTCP_OK;
+}
+
+int rtcp_compound_sdes_item(rtcp_compound *packet, rtcp_sdes_type type, const void *data, uint8_t length) {
+    assert(packet != NULL);
+    assert(data != NULL || length == 0);
+
+    if (packet->chunk == RTCP_COMPOUND_NONE || type == RTCP_SDES_END)
+        return RTCP_ERROR;
+
+    uint8_t *p = _reserve(packet, 2 + length);
+    if (p == NULL)
+        return RTCP_ERROR;
+
+    p[0] = type;
+    p[1] = length;
+    memcpy(p + 2, data, length);
+
+    return RTCP_OK;
+}
+
+int rtcp_compound_bye(rtcp_compound *packet, const uint32_t *ssrcs, uint8_t count, const char *reason) {
+    assert(packet != NULL);
+    assert(ssrcs != NULL || count == 0);
+
+    if (count > RTCP_COMPOUND_MAX_COUNT || _open(packet, RTCP_BYE, count, 4 * count) < 0)
+        return RTCP_ERROR;
+
+    uint8_t *p = packet->buffer + packet->block + 4;
+    for (uint8_t i = 0; i < count; ++i)
+        write_u32(p + 4 * i, ssrcs[i]);
+
+    if (reason != NULL) {
+        size_t length = strlen(reason);
+        if (length > 0xff)
+            length = 0xff;
+
+        size_t padded = (1 + length + 3) & ~3U;
+        p = _reserve(packet, padded);
+        if (p == NULL)
+            return RTCP_ERROR;
+
+        p[0] = (uint8_t) length;
+        memcpy(p + 1, reason, length);
+        memset(p + 1 + length, 0, padded - 1 - length);
+    }
+
+    return RTCP_OK;
+}
+
+int rtcp_compound_app(rtcp_compound *packet, uint8_t subtype, uint32_t ssrc, uint32_t name, const void *data, size_t size) {
+    assert(packet != NULL);
+    assert(data != NULL || size == 0);
+
+    if (subtype > RTCP_COMPOUND_MAX_COUNT || _open(packet, RTCP_APP, subtype, 8) < 0)
+        return RTCP_ERROR;
+
+    uint8_t *p = packet->buffer + packet->block;
+    write_u32(p + 4, ssrc);
+    write_u32(p + 8, name);
+
+    size_t padded = (size + 3) & ~(size_t) 3;
+    p = _reserve(packet, padded);
+    if (p == NULL)
+        return RTCP_ERROR;
+
+    memcpy(p, data, size);
+    memset(p + size, 0, padded - size);
+
+    return RTCP_OK;
+}
+
+int rtcp_compound_finish(rtcp_compound *packet) {
+    assert(packet != NULL);
+
+    _close(packet);
+
+    return packet->error ? RTCP_ERROR : (int) packet->length;
+}
+
+int rtcp_compound_next(const uint8_t *buffer, size_t size, size_t *offset, rtcp_view *view) {
+    assert(buffer != NULL);
+    assert(offset != NULL);
+    assert(view != NULL);
+
+    if (*offset >= size)
+        return 0;
+
+    if (*offset == 0 && rtcp_type(buffer, size) < 0)
+        return RTCP_ERROR;
+
+    const uint8_t *p = buffer + *offset;
+    size_t left = size - *offset;
+    if (left < 4 || (p[0] >> 6) != 2)
+        return RTCP_ERROR;
+
+    size_t length = (read_u16(p + 2) + 1) * 4U;
+    if (length > left)
+        return RTCP_ERROR;
+
+    view->pt = p[1];
+    view->count = p[0] & 0x1f;
+    view->data = p;
+    view->size = length;
+
+    // Only the last block may be padded, the last octet is the padding count
+    if (p[0] & 0x20) {
+        uint8_t pad = p[length - 1];
+        if (length != left || pad == 0 || pad > length - 4)
+            return RTCP_ERROR;
+        view->size -= pad;
+    }
+
+    *offset += length;
+
+    return 1;
+}
+
+uint32_t rtcp_view_ssrc(const rtcp_view *view) {
+    assert(view != NULL);
+
+    return view->size >= 8 ? read_u32(view->data + 4) : 0;
+}
+
+int rtcp_view_sender(const rtcp_view *view, ntp_tv *ntp, uint32_t *rtp_ts, uint32_t *pkt_count, uint32_t *byte_count) {
+    assert(view != NULL);
+
+    if (view->pt != RTCP_SR || view->size < 28)
+        return RTCP_ERROR;
+
+    if (ntp != NULL) {
+        ntp->sec = read_u32(view->data + 8);
+        ntp->frac = read_u32(view->data + 12);
+    }
+    if (rtp_ts != NULL)
+        *rtp_ts = read_u32(view->data + 16);
+    if (pkt_count != NULL)
+        *pkt_count = read_u32(view->data + 20);
+    if (byte_count != NULL)
+        *byte_count = read_u32(view->data + 24);
+
+    return RTCP_OK;
+}
+
+int rtcp_view_report(const rtcp_view *view, uint8_t index, rtcp_report *report) {
+    assert(view != NULL);
+    assert(report != NULL);
+
+    size_t base;
+    if (view->pt == RTCP_SR)
+        base = 28;
+    else if (view->pt == RTCP_RR)
+        base = 8;
+    else
+        return RTCP_ERROR;
+
+    size_t offset = base + 24 * (size_t) index;
+    if (index >= view->count || offset + 24 > view->size)
+        return RTCP_ERROR;
+
+    return rtcp_report_parse(report, view->data + offset, 24);
+}
+
+int rtcp_view_find_report(const rtcp_view *view, uint32_t ssrc, rtcp_report *report) {
+    assert(view != NULL);
+    assert(report != NULL);
+
+    for (uint8_t i = 0; i < view->count; ++i) {
+        if (rtcp_view_report(view, i, report) < 0)
+            return RTCP_ERROR;
+        if (report->ssrc == ssrc)
+            return RTCP_OK;
+    }
+
+    return RTCP_ERROR;
+}
+
+int rtcp_view_sdes_next(const rtcp_view *view, rtcp_sdes_cursor *cursor, uint32_t *ssrc, rtcp_sdes_type *type, const uint8_t **data, uint8_t *length) {
+    assert(view != NULL);
+    assert(cursor != NULL);
+
+    if (view->pt != RTCP_SDES)
+        return RTCP_ERROR;
+
+    if (cursor->offset == 0) {
+        cursor->offset = 4;
+        cursor->chunks = view->count;
+        cursor->in_chunk = false;
+    }
+
+    while (1) {
+        if (!cursor->in_chunk) {
+            if (cursor->chunks == 0)
+                return 0;
+            if (cursor->offset + 4 > view->size)
+                return RTCP_ERROR;
+            cursor->ssrc = read_u32(view->data + cursor->offset);
+            cursor->offset += 4;
+            cursor->chunks--;
+            cursor->in_chunk = true;
+        }
+
+        if (cursor->offset >= view->size)
+            return RTCP_ERROR;
+
+        const uint8_t *p = view->data + cursor->offset;
+        if (p[0] == RTCP_SDES_END) {
+            // Chunks start on a 32-bit boundary, as does the block
+            cursor->offset = (cursor->offset + 4) & ~(size_t) 3;
+            cursor->in_chunk = false;
+            continue;
+        }
+
+        if (cursor->offset + 2 > view->size || cursor->offset + 2 + p[1] > view->size)
+            return RTCP_ERROR;
+
+        if (ssrc != NULL)
+            *ssrc = cursor->ssrc;
+        if (type != NULL)
+            *type = (rtcp_sdes_type) p[0];
+        if (data != NULL)
+            *data = p + 2;
+        if (length != NULL)
+            *length = p[1];
+        cursor->offset += 2 + p[1];
+
+        return 1;
+    }
+}
+
+uint32_t rtcp_view_bye_source(const rtcp_view *view, uint8_t index) {
+    assert(view != NULL);
+
+    size_t offset = 4 + 4 * (size_t) index;
+    if (view->pt != RTCP_BYE || index >= view->count || offset + 4 > view->size)
+        return 0;
+
+    return read_u32(view->data + offset);
+}
+
+uint8_t rtcp_view_bye_reason(const rtcp_view *view, const uint8_t **reason) {
+    assert(view != NULL);
+    assert(reason != NULL);
+
+    size_t offset = 4 + 4 * (size_t) view->count;
+    if (view->pt != RTCP_BYE || offset >= view->size || offset + 1 + view->data[offset] > view->size)
+        return 0;
+
+    *reason = view->data + offset + 1;
+
+    return view->data[offset];
+}
+
+int rtcp_view_app(const rtcp_view *view, uint32_t *name, const uint8_t **data) {
+    assert(view != NULL);
+
+    if (view->pt != RTCP_APP || view->size < 12)
+        return RTCP_ERROR;
+
+    if (name != NULL)
+        *name = read_u32(view->data + 8);
+    if (data != NULL)
+        *data = view->data + 12;
+
+    return (int) (view->size - 12);
+}
+
+#ifdef RTCP_COMPOUND_TEST
+#include <stdio.h>
+
+void testit(char *name, int result, int should) {
+    if (result == should) {
+        printf("Test %s was successful\n", name);
+    }
+    else {
+        printf("Test %s was not successful, %d should have been %d\n", name, result, should);
+    }
+}
+
+int main(void) {
+    uint8_t buffer[512], small[40];
+    rtcp_compound packet;
+    rtcp_report report = { 0 }, parsed;
+    rtcp_sdes_cursor cursor = { 0 };
+    rtcp_sdes_type type;
+    rtcp_view view;
+    ntp_tv ntp = { 0x83aa7e80, 0x12345678 }, ntp_back;
+    uint32_t ssrcs[2] = { 0x11111111, 0x22222222 }, ssrc, rtp_ts, pkts, octets;
+    const uint8_t *data;
+    uint8_t length;
+    size_t offset = 0;
+    int len, ret;
+
+    // SR with two reports, SDES with two chunks, BYE with a reason.
+    rtcp_compound_init(&packet, buffer, sizeof(buffer));
+    testit("sr", rtcp_compound_sr(&packet, 0xdeadbeef, ntp, 1000, 10, 1400), RTCP_OK);
+    report.ssrc = ssrcs[0];
+    report.last_seq = 77;
+    report.jitter = 5;
+    testit("report 1", rtcp_compound_report(&packet, &report), RTCP_OK);
+    report.ssrc = ssrcs[1];
+    testit("report 2", rtcp_compound_report(&packet, &report), RTCP_OK);
+    testit("sdes", rtcp_compound_sdes(&packet), RTCP_OK);
+    testit("report outside sr", rtcp_compound_report(&packet, &report), RTCP_ERROR);
+    testit("sdes chunk 1", rtcp_compound_sdes_chunk(&packet, 0xdeadbeef), RTCP_OK);
+    testit("sdes cname", rtcp_compound_sdes_item(&packet, RTCP_SDES_CNAME, "rx@sdr", 6), RTCP_OK);
+    testit("sdes chunk 2", rtcp_compound_sdes_chunk(&packet, ssrcs[0]), RTCP_OK);
+    testit("sdes name", rtcp_compound_sdes_item(&packet, RTCP_SDES_NAME, "abcd", 4), RTCP_OK);
+    testit("bye", rtcp_compound_bye(&packet, ssrcs, 2, "done"), RTCP_OK);
+    len = rtcp_compound_finish(&packet);
+    testit("length is 32 bit aligned", len > 0 && len % 4 == 0, 1);
+
+    // Walk it back.
+    testit("next sr", rtcp_compound_next(buffer, len, &offset, &view), 1);
+    testit("sr type", view.pt, RTCP_SR);
+    testit("sr count", view.count, 2);
+    testit("sr ssrc", rtcp_view_ssrc(&view) == 0xdeadbeef, 1);
+    testit("sender info", rtcp_view_sender(&view, &ntp_back, &rtp_ts, &pkts, &octets), RTCP_OK);
+    testit("sender fields", ntp_back.sec == ntp.sec && ntp_back.frac == ntp.frac && rtp_ts == 1000 && pkts == 10 && octets == 1400, 1);
+    testit("find report", rtcp_view_find_report(&view, ssrcs[1], &parsed), RTCP_OK);
+    testit("report fields", parsed.ssrc == ssrcs[1] && parsed.last_seq == 77 && parsed.jitter == 5, 1);
+    testit("report out of range", rtcp_view_report(&view, 2, &parsed), RTCP_ERROR);
+
+    testit("next sdes", rtcp_compound_next(buffer, len, &offset, &view), 1);
+    testit("sdes type", view.pt, RTCP_SDES);
+    ret = rtcp_view_sdes_next(&view, &cursor, &ssrc, &type, &data, &length);
+    testit("sdes item 1", ret == 1 && ssrc == 0xdeadbeef && type == RTCP_SDES_CNAME && length == 6 && !memcmp(data, "rx@sdr", 6), 1);
+    ret = rtcp_view_sdes_next(&view, &cursor, &ssrc, &type, &data, &length);
+    testit("sdes item 2", ret == 1 && ssrc == ssrcs[0] && type == RTCP_SDES_NAME && length == 4 && !memcmp(data, "abcd", 4), 1);
+    testit("sdes end", rtcp_view_sdes_next(&view, &cursor, &ssrc, &type, &data, &length), 0);
+
+    testit("next bye", rtcp_compound_next(buffer, len, &offset, &view), 1);
+    testit("bye sources", rtcp_view_bye_source(&view, 0) == ssrcs[0] && rtcp_view_bye_source(&view, 1) == ssrcs[1], 1);
+    testit("bye reason", rtcp_view_bye_reason(&view, &data) == 4 && !memcmp(data, "done", 4), 1);
+    testit("end of compound", rtcp_compound_next(buffer, len, &offset, &view), 0);
+
+    // RR that does not fit latches the error.
+    rtcp_compound_init(&packet, small, sizeof(small));
+    testit("rr", rtcp_compound_rr(&packet, 0xdeadbeef), RTCP_OK);
+    testit("report fits", rtcp_compound_report(&packet, &report), RTCP_OK);
+    testit("report overflows", rtcp_compound_report(&packet, &report), RTCP_ERROR);
+    testit("finish overflow", rtcp_compound_finish(&packet), RTCP_ERROR);
+
+    // Malformed input.
+    offset = 0;
+    testit("empty", rtcp_compound_next(buffer, 0, &offset, &view), 0);
+    offset = 0;
+    testit("truncated block", rtcp_compound_next(buffer, len - 4, &offset, &view) == 1 && rtcp_compound_next(buffer, len - 4, &offset, &view) == 1
+            && rtcp_compound_next(buffer, len - 4, &offset, &view) == RTCP_ERROR, 1);
+    memcpy(small, buffer, 32);
+    small[0] = (small[0] & 0x3f) | 0x40;
+    offset = 0;
+    testit("bad version", rtcp_compound_next(small, 32, &offset, &view), RTCP_ERROR);
+    memcpy(small, buffer, 32);
+    small[1] = 96;
+    offset = 0;
+    testit("rtp on the rtcp port", rtcp_compound_next(small, 32, &offset, &view), RTCP_ERROR);
+    memcpy(small, buffer, 32);
+    small[0] |= 0x20;
+    small[31] = 0;
+    offset = 0;
+    testit("zero padding", rtcp_compound_next(small, 32, &offset, &view), RTCP_ERROR);
+    view.pt = RTCP_SDES;
+    view.count = 1;
+    view.data = buffer;
+    view.size = 10;
+    memset(&cursor, 0, sizeof(cursor));
+    buffer[8] = RTCP_SDES_CNAME;
+    buffer[9] = 200;
+    testit("sdes item past the block", rtcp_view_sdes_next(&view, &cursor, &ssrc, &type, &data, &length), RTCP_ERROR);
+
+    return 0;
+}
+
+#endif /* RTCP_COMPOUND_TEST */
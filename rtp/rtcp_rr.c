@@ -53,6 +53,9 @@ rtcp_rr* rtcp_rr_create(void) {
 void rtcp_rr_free(rtcp_rr *packet) {
     assert(packet != NULL);
 
+    if (packet->reports)
+        free(packet->reports);
+
     if (packet->ext_data)
         free(packet->ext_data);
 
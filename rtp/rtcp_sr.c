@@ -53,6 +53,9 @@ rtcp_sr* rtcp_sr_create(void) {
 void rtcp_sr_free(rtcp_sr *packet) {
     assert(packet != NULL);
 
+    if (packet->reports)
+        free(packet->reports);
+
     if (packet->ext_data)
         free(packet->ext_data);
 
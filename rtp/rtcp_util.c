@@ -53,17 +53,11 @@ int rtcp_type(const uint8_t *buffer, size_t size) {
     return RTCP_ERROR;
 }
 
-double rtcp_interval(int members, int senders, double rtcp_bw, bool we_sent, double avg_rtcp_size, bool initial) {
+double rtcp_interval_deterministic(int members, int senders, double rtcp_bw, bool we_sent, double avg_rtcp_size, bool initial) {
     const double MIN_TIME = LIBRTP_RTCP_MIN_TIME;
     const double SENDER_BW_FRACTION = LIBRTP_RTCP_SENDER_BW_FRACTION;
     const double RCVR_BW_FRACTION = (1.0 - SENDER_BW_FRACTION);
 
-    /*
-     * To compensate for "timer reconsideration" converging to a
-     * value below the intended average.
-     */
-    static const double COMPENSATION = 2.71828 - 1.5;
-
     /*
      * Very first call at application start-up uses half the min
      * delay for quicker notification while still allowing some time
@@ -105,6 +99,18 @@ double rtcp_interval(int members, int senders, double rtcp_bw, bool we_sent, dou
     if (t < min_time)
         t = min_time;
 
+    return t;
+}
+
+double rtcp_interval(int members, int senders, double rtcp_bw, bool we_sent, double avg_rtcp_size, bool initial) {
+    /*
+     * To compensate for "timer reconsideration" converging to a
+     * value below the intended average.
+     */
+    static const double COMPENSATION = 2.71828 - 1.5;
+
+    double t = rtcp_interval_deterministic(members, senders, rtcp_bw, we_sent, avg_rtcp_size, initial);
+
     /*
      * To avoid traffic bursts from unintended synchronization with
      * other sites, we then pick our actual next report interval as a
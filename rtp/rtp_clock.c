@@ -0,0 +1,258 @@
+/*
+ * Copyright 2023 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/rtp-sdr *
+ *
+ * This is based on other projects:
+ *      IDEA: https://github.com/OpenResearchInstitute/ka9q-sdr (not use any code of this)
+ *       RTP: https://github.com/Daxbot/librtp/
+ *       FEC: https://github.com/wesen/poc
+ *    SOCKET: https://github.com/njh/mast
+ *    OTHERS: see individual files
+ *
+ *    please contact their authors for more information.
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#include "rtp_clock.h"
+
+/**
+ * @brief 2^32 as a double: NTP units per second.
+ * @private
+ */
+#define LIBRTP_CLOCK_NTP_UNIT (4294967296.0)
+
+// Accumulate (or remove, sign -1) one pair into the sums.
+static void _sum(rtp_clock *c, int slot, double sign) {
+    double dx = (double) (c->x[slot] - c->ref_x);
+    double dy = (double) (int64_t) (c->y[slot] - c->ref_y);
+
+    c->sx += sign * dx;
+    c->sy += sign * dy;
+    c->sxx += sign * dx * dx;
+    c->sxy += sign * dx * dy;
+}
+
+// Move the origin to the oldest pair so the sums stay small, then recompute them.
+static void _rebase(rtp_clock *c) {
+    int oldest = (c->head + LIBRTP_CLOCK_WINDOW - c->count) % LIBRTP_CLOCK_WINDOW;
+
+    c->ref_x = c->x[oldest];
+    c->ref_y = c->y[oldest];
+    c->sx = c->sy = c->sxx = c->sxy = 0;
+    for (int i = 0; i < c->count; ++i)
+        _sum(c, (oldest + i) % LIBRTP_CLOCK_WINDOW, 1.0);
+    c->age = 0;
+}
+
+static void _fit(rtp_clock *c) {
+    const double nominal = LIBRTP_CLOCK_NTP_UNIT / c->rate;
+    double n = c->count;
+    double mx = c->sx / n;
+    double my = c->sy / n;
+    double vxx = c->sxx - c->sx * mx;
+    double vxy = c->sxy - c->sx * my;
+
+    c->slope = (c->count >= 2 && vxx > 0) ? vxy / vxx : nominal;
+
+    // A rate off by more than 1% is not a drifting clock but a sender restart or a bad SR
+    if (fabs(c->slope / nominal - 1.0) > 0.01)
+        c->slope = nominal;
+
+    // The fitted line passes through the mean, anchor it at the nearest tick
+    c->anchor_x = c->ref_x + llround(mx);
+    c->anchor_y = c->ref_y + (ntp_ts) llround(my + c->slope * ((double) (c->anchor_x - c->ref_x) - mx));
+}
+
+rtp_clock* rtp_clock_create(void) {
+    rtp_clock *c = (rtp_clock*) malloc(sizeof(rtp_clock));
+    if (c)
+        memset(c, 0, sizeof(rtp_clock));
+
+    return c;
+}
+
+void rtp_clock_free(rtp_clock *c) {
+    assert(c != NULL);
+
+    free(c);
+}
+
+void rtp_clock_init(rtp_clock *c, uint32_t id, uint32_t rate) {
+    assert(c != NULL);
+    assert(rate > 0);
+
+    memset(c, 0, sizeof(rtp_clock));
+    c->id = id;
+    c->rate = rate;
+    c->slope = LIBRTP_CLOCK_NTP_UNIT / rate;
+}
+
+void rtp_clock_update(rtp_clock *c, ntp_ts ntp, uint32_t rtp_ts) {
+    assert(c != NULL);
+
+    // The timestamps jumped: the old pairs describe another line
+    if (c->count > 0 && fabs((double) (int64_t) (ntp - rtp_clock_to_ntp(c, rtp_ts))) > LIBRTP_CLOCK_RESYNC * LIBRTP_CLOCK_NTP_UNIT)
+        rtp_clock_init(c, c->id, c->rate);
+
+    int64_t x = c->count ? c->last_x + (int32_t) (rtp_ts - c->last_ts) : rtp_ts;
+
+    if (c->count == 0) {
+        c->ref_x = x;
+        c->ref_y = ntp;
+    }
+
+    // Drop the oldest pair once the window is full
+    if (c->count == LIBRTP_CLOCK_WINDOW)
+        _sum(c, c->head, -1.0);
+    else
+        c->count++;
+
+    c->x[c->head] = x;
+    c->y[c->head] = ntp;
+    _sum(c, c->head, 1.0);
+    c->head = (c->head + 1) % LIBRTP_CLOCK_WINDOW;
+    c->last_x = x;
+    c->last_ts = rtp_ts;
+
+    if (++c->age >= LIBRTP_CLOCK_WINDOW)
+        _rebase(c);
+
+    _fit(c);
+}
+
+bool rtp_clock_valid(const rtp_clock *c) {
+    assert(c != NULL);
+
+    return c->count >= 2;
+}
+
+ntp_ts rtp_clock_to_ntp(const rtp_clock *c, uint32_t rtp_ts) {
+    assert(c != NULL);
+
+    int64_t x = c->last_x + (int32_t) (rtp_ts - c->last_ts);
+
+    return c->anchor_y + (ntp_ts) llround(c->slope * (double) (x - c->anchor_x));
+}
+
+uint32_t rtp_clock_to_rtp(const rtp_clock *c, ntp_ts ntp) {
+    assert(c != NULL);
+
+    return (uint32_t) (c->anchor_x + llround((double) (int64_t) (ntp - c->anchor_y) / c->slope));
+}
+
+double rtp_clock_drift_ppm(const rtp_clock *c) {
+    assert(c != NULL);
+
+    return (LIBRTP_CLOCK_NTP_UNIT / c->rate / c->slope - 1.0) * 1e6;
+}
+
+#ifdef RTP_CLOCK_TEST
+#include <stdio.h>
+
+#define TEST_RATE  (1536000.0)
+#define TEST_PPM   (20.0)
+#define TEST_T0    (3.9e9)
+
+void testit(char *name, int result, int should) {
+    if (result == should) {
+        printf("Test %s was successful\n", name);
+    }
+    else {
+        printf("Test %s was not successful, %d should have been %d\n", name, result, should);
+    }
+}
+
+static ntp_ts _ntp(double t) {
+    double s = floor(t);
+
+    return ((uint64_t) s << 32) + (uint64_t) llround((t - s) * LIBRTP_CLOCK_NTP_UNIT);
+}
+
+static double _sec(ntp_ts t) {
+    return (double) (t >> 32) + (double) (uint32_t) t / LIBRTP_CLOCK_NTP_UNIT;
+}
+
+// RTP timestamp of a sender running TEST_PPM fast, starting just short of the 32 bit wrap.
+static uint32_t _rtp(double t, uint32_t offset) {
+    return offset + 0xfff00000u + (uint32_t) (uint64_t) llround((t - TEST_T0) * TEST_RATE * (1.0 + TEST_PPM * 1e-6));
+}
+
+int main(void) {
+    rtp_clock c;
+    uint32_t seed = 1, q;
+    double t = TEST_T0, jitter, err, worst = 0;
+    int k, back = 0;
+
+    rtp_clock_init(&c, 1, (uint32_t) TEST_RATE);
+    testit("not valid before an SR", rtp_clock_valid(&c), 0);
+
+    // An SR every 5 s with up to 50 us of wallclock jitter.
+    for (k = 0; k < 40; k++) {
+        t = TEST_T0 + k * 5.0;
+        seed = seed * 1103515245u + 12345u;
+        jitter = ((double) (seed >> 8) / (1 << 24) - 0.5) * 100e-6;
+        rtp_clock_update(&c, _ntp(t + jitter), _rtp(t, 0));
+        if (k == 0)
+            testit("not valid after one SR", rtp_clock_valid(&c), 0);
+        if (k < LIBRTP_CLOCK_WINDOW)
+            continue;
+
+        // A sample 2.5 s after the SR.
+        q = _rtp(t + 2.5, 0);
+        err = fabs(_sec(rtp_clock_to_ntp(&c, q)) - (t + 2.5));
+        if (err > worst)
+            worst = err;
+        if (rtp_clock_to_rtp(&c, rtp_clock_to_ntp(&c, q)) != q)
+            back++;
+    }
+    testit("valid", rtp_clock_valid(&c), 1);
+    testit("window full", c.count, LIBRTP_CLOCK_WINDOW);
+    testit("drift within 2 ppm", fabs(rtp_clock_drift_ppm(&c) - TEST_PPM) < 2.0, 1);
+    testit("sample time within 100 us", worst < 100e-6, 1);
+    testit("to_rtp inverts to_ntp", back, 0);
+
+    // The sender restarts its timestamps: the fit starts over from the new pair.
+    t += 5.0;
+    rtp_clock_update(&c, _ntp(t), _rtp(t, 0x40000000u));
+    testit("jump restarts the fit", c.count, 1);
+    testit("jump maps the new pair", fabs(_sec(rtp_clock_to_ntp(&c, _rtp(t, 0x40000000u))) - t) < 1e-6, 1);
+    t += 5.0;
+    rtp_clock_update(&c, _ntp(t), _rtp(t, 0x40000000u));
+    testit("refit after jump", c.count, 2);
+    testit("refit after jump valid", rtp_clock_valid(&c), 1);
+
+    // A small step stays on the line.
+    t += 5.0;
+    rtp_clock_update(&c, _ntp(t + 0.001), _rtp(t, 0x40000000u));
+    testit("jitter keeps the fit", c.count, 3);
+
+    return 0;
+}
+
+#endif /* RTP_CLOCK_TEST */
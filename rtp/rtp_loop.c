@@ -0,0 +1,309 @@
+/*
+ * Copyright 2023 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/rtp-sdr *
+ *
+ * This is based on other projects:
+ *      IDEA: https://github.com/OpenResearchInstitute/ka9q-sdr (not use any code of this)
+ *       RTP: https://github.com/Daxbot/librtp/
+ *       FEC: https://github.com/wesen/poc
+ *    SOCKET: https://github.com/njh/mast
+ *    OTHERS: see individual files
+ *
+ *    please contact their authors for more information.
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+
+#include "rtp_util.h"
+#include "rtp_loop.h"
+
+/**
+ * @brief Maximum events returned by one epoll_wait().
+ * @private
+ */
+#define RTP_LOOP_MAX_EVENTS (64)
+
+typedef enum {
+    RTP_LOOP_SOCKET,
+    RTP_LOOP_TIMER,
+    RTP_LOOP_WAKEUP
+} rtp_loop_source_type;
+
+struct rtp_loop_source_s {
+    rtp_loop_source_type type;
+                     int fd;
+            rtp_socket_t *sock;
+          rtp_loop_io_cb io_cb;
+       rtp_loop_timer_cb timer_cb;
+                    void *arg;
+                    bool removed;
+      rtp_loop_source_t *next;
+};
+
+struct rtp_loop_s {
+                  int epfd;
+        volatile bool running;
+    rtp_loop_source_t wakeup;  // stop notification
+    rtp_loop_source_t *sources; // registered sources
+    rtp_loop_source_t *dead;    // sources removed during a dispatch
+};
+
+static void _ns_to_timespec(uint64_t ns, struct timespec *ts) {
+    ts->tv_sec = (time_t) (ns / 1000000000ULL);
+    ts->tv_nsec = (long) (ns % 1000000000ULL);
+}
+
+static void _unlink_source(rtp_loop_t *loop, rtp_loop_source_t *source) {
+    rtp_loop_source_t **p;
+    for (p = &loop->sources; *p; p = &(*p)->next) {
+        if (*p == source) {
+            *p = source->next;
+            break;
+        }
+    }
+}
+
+static void _free_dead(rtp_loop_t *loop) {
+    while (loop->dead) {
+        rtp_loop_source_t *next = loop->dead->next;
+        free(loop->dead);
+        loop->dead = next;
+    }
+}
+
+rtp_loop_t* rtp_loop_create(void) {
+    rtp_loop_t *loop = (rtp_loop_t*) malloc(sizeof(rtp_loop_t));
+    if (!loop)
+        return NULL;
+
+    memset(loop, 0, sizeof(rtp_loop_t));
+
+    loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+    loop->wakeup.type = RTP_LOOP_WAKEUP;
+    loop->wakeup.fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (loop->epfd < 0 || loop->wakeup.fd < 0) {
+        rtp_loop_free(loop);
+        return NULL;
+    }
+
+    struct epoll_event ev = { .events = EPOLLIN | EPOLLET, .data.ptr = &loop->wakeup };
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, loop->wakeup.fd, &ev) < 0) {
+        rtp_loop_free(loop);
+        return NULL;
+    }
+
+    return loop;
+}
+
+void rtp_loop_free(rtp_loop_t *loop) {
+    assert(loop != NULL);
+
+    while (loop->sources)
+        rtp_loop_remove(loop, loop->sources);
+    _free_dead(loop);
+
+    if (loop->wakeup.fd >= 0)
+        close(loop->wakeup.fd);
+    if (loop->epfd >= 0)
+        close(loop->epfd);
+
+    free(loop);
+}
+
+rtp_loop_source_t* rtp_loop_add_socket(rtp_loop_t *loop, rtp_socket_t *sock, uint32_t events, rtp_loop_io_cb cb, void *arg) {
+    assert(loop != NULL);
+    assert(sock != NULL);
+    assert(cb != NULL);
+
+    if (sock->fd < 0 || rtp_socket_set_nonblock(sock, true) < 0)
+        return NULL;
+
+    rtp_loop_source_t *source = (rtp_loop_source_t*) calloc(1, sizeof(rtp_loop_source_t));
+    if (!source)
+        return NULL;
+
+    source->type = RTP_LOOP_SOCKET;
+    source->fd = sock->fd;
+    source->sock = sock;
+    source->io_cb = cb;
+    source->arg = arg;
+
+    struct epoll_event ev = { .events = EPOLLET, .data.ptr = source };
+    if (events & RTP_LOOP_IN)
+        ev.events |= EPOLLIN;
+    if (events & RTP_LOOP_OUT)
+        ev.events |= EPOLLOUT;
+
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, source->fd, &ev) < 0) {
+        free(source);
+        return NULL;
+    }
+
+    source->next = loop->sources;
+    loop->sources = source;
+
+    return source;
+}
+
+rtp_loop_source_t* rtp_loop_add_timer(rtp_loop_t *loop, uint64_t first_ns, uint64_t interval_ns, rtp_loop_timer_cb cb, void *arg) {
+    assert(loop != NULL);
+    assert(cb != NULL);
+
+    rtp_loop_source_t *source = (rtp_loop_source_t*) calloc(1, sizeof(rtp_loop_source_t));
+    if (!source)
+        return NULL;
+
+    source->type = RTP_LOOP_TIMER;
+    source->timer_cb = cb;
+    source->arg = arg;
+    source->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (source->fd < 0) {
+        free(source);
+        return NULL;
+    }
+
+    struct epoll_event ev = { .events = EPOLLIN | EPOLLET, .data.ptr = source };
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, source->fd, &ev) < 0 || rtp_loop_timer_set(source, first_ns, interval_ns) < 0) {
+        close(source->fd);
+        free(source);
+        return NULL;
+    }
+
+    source->next = loop->sources;
+    loop->sources = source;
+
+    return source;
+}
+
+int rtp_loop_timer_set(rtp_loop_source_t *source, uint64_t first_ns, uint64_t interval_ns) {
+    assert(source != NULL);
+
+    if (source->type != RTP_LOOP_TIMER)
+        return RTP_ERROR;
+
+    struct itimerspec its;
+    _ns_to_timespec(first_ns, &its.it_value);
+    _ns_to_timespec(interval_ns, &its.it_interval);
+
+    return timerfd_settime(source->fd, 0, &its, NULL) < 0 ? RTP_ERROR : RTP_OK;
+}
+
+void rtp_loop_remove(rtp_loop_t *loop, rtp_loop_source_t *source) {
+    assert(loop != NULL);
+
+    if (source == NULL || source->removed)
+        return;
+
+    epoll_ctl(loop->epfd, EPOLL_CTL_DEL, source->fd, NULL);
+    if (source->type == RTP_LOOP_TIMER)
+        close(source->fd);
+
+    // Events for this source may still be pending in the current dispatch,
+    // so it is only released after the dispatch is done.
+    source->removed = true;
+    _unlink_source(loop, source);
+    source->next = loop->dead;
+    loop->dead = source;
+}
+
+int rtp_loop_run_once(rtp_loop_t *loop, int timeout_ms) {
+    assert(loop != NULL);
+
+    struct epoll_event events[RTP_LOOP_MAX_EVENTS];
+
+    int n = epoll_wait(loop->epfd, events, RTP_LOOP_MAX_EVENTS, timeout_ms);
+    if (n < 0)
+        return errno == EINTR ? 0 : RTP_ERROR;
+
+    for (int i = 0; i < n; i++) {
+        rtp_loop_source_t *source = (rtp_loop_source_t*) events[i].data.ptr;
+        if (source->removed)
+            continue;
+
+        switch (source->type) {
+            case RTP_LOOP_SOCKET: {
+                uint32_t mask = 0;
+                if (events[i].events & EPOLLIN)
+                    mask |= RTP_LOOP_IN;
+                if (events[i].events & EPOLLOUT)
+                    mask |= RTP_LOOP_OUT;
+                if (events[i].events & (EPOLLERR | EPOLLHUP))
+                    mask |= RTP_LOOP_ERR;
+                source->io_cb(loop, source->sock, mask, source->arg);
+            }
+                break;
+
+            case RTP_LOOP_TIMER: {
+                uint64_t expirations;
+                if (read(source->fd, &expirations, sizeof(expirations)) == sizeof(expirations) && expirations > 0)
+                    source->timer_cb(loop, expirations, source->arg);
+            }
+                break;
+
+            case RTP_LOOP_WAKEUP: {
+                uint64_t value;
+                while (read(source->fd, &value, sizeof(value)) == sizeof(value))
+                    ;
+            }
+                break;
+        }
+    }
+
+    _free_dead(loop);
+
+    return n;
+}
+
+int rtp_loop_run(rtp_loop_t *loop) {
+    assert(loop != NULL);
+
+    loop->running = true;
+    while (loop->running) {
+        if (rtp_loop_run_once(loop, -1) < 0)
+            return RTP_ERROR;
+    }
+
+    return RTP_OK;
+}
+
+void rtp_loop_stop(rtp_loop_t *loop) {
+    assert(loop != NULL);
+
+    uint64_t one = 1;
+
+    loop->running = false;
+    if (write(loop->wakeup.fd, &one, sizeof(one)) < 0) {
+        // counter overflow only, the loop is awake anyway
+    }
+}
@@ -48,6 +48,12 @@
  */
 #define LIBRTP_NTP_FRAC (4294967296.0)
 
+/**
+ * @brief Nanoseconds per second.
+ * @private
+ */
+#define LIBRTP_NTP_NSEC (1000000000ULL)
+
 double ntp_to_double(ntp_tv ntp) {
     double s = (double) ntp.sec;
     s += (double) ntp.frac / LIBRTP_NTP_FRAC;
@@ -81,8 +87,149 @@ uint32_t ntp_short(ntp_tv ntp) {
 }
 
 ntp_tv ntp_diff(ntp_tv a, ntp_tv b) {
-    double s1 = ntp_to_double(a);
-    double s2 = ntp_to_double(b);
+    return ntp_unpack(ntp_pack(a) - ntp_pack(b));
+}
+
+ntp_ts ntp_pack(ntp_tv ntp) {
+    return ((uint64_t) ntp.sec << 32) | ntp.frac;
+}
+
+ntp_tv ntp_unpack(ntp_ts t) {
+    ntp_tv ntp;
+    ntp.sec = (uint32_t) (t >> 32);
+    ntp.frac = (uint32_t) t;
+
+    return ntp;
+}
+
+ntp_ts ntp_ts_add(ntp_ts a, ntp_ts b) {
+    return a + b;
+}
+
+ntp_ts ntp_ts_sub(ntp_ts a, ntp_ts b) {
+    return a - b;
+}
+
+int ntp_ts_cmp(ntp_ts a, ntp_ts b) {
+    int64_t d = (int64_t) (a - b);
+
+    return (d > 0) - (d < 0);
+}
+
+uint32_t ntp_ts_short(ntp_ts t) {
+    return (uint32_t) (t >> 16);
+}
+
+ntp_ts ntp_ts_from_short(uint32_t s) {
+    return (uint64_t) s << 16;
+}
+
+ntp_ts ntp_ts_from_ns(uint64_t ns) {
+    // Fraction: ns * 2^32 / 10^9, exact below one second (2^30 * 2^32 fits)
+    return ((ns / LIBRTP_NTP_NSEC) << 32) | (((ns % LIBRTP_NTP_NSEC) << 32) / LIBRTP_NTP_NSEC);
+}
+
+uint64_t ntp_ts_to_ns(ntp_ts t) {
+    return (t >> 32) * LIBRTP_NTP_NSEC + (((t & 0xffffffffULL) * LIBRTP_NTP_NSEC + 0x80000000ULL) >> 32);
+}
+
+ntp_ts ntp_ts_from_timespec(clockid_t clock, const struct timespec *ts) {
+    uint64_t sec = (uint64_t) ts->tv_sec;
+
+    if (clock == CLOCK_REALTIME)
+        sec += LIBRTP_NTP_UNIX_OFFSET;
+
+    return (sec << 32) | (((uint64_t) ts->tv_nsec << 32) / LIBRTP_NTP_NSEC);
+}
+
+void ntp_ts_to_timespec(clockid_t clock, ntp_ts t, struct timespec *ts) {
+    uint64_t ns = ntp_ts_to_ns(t & 0xffffffffULL);
+    uint64_t sec = (t >> 32) + ns / LIBRTP_NTP_NSEC;
+
+    if (clock == CLOCK_REALTIME)
+        sec -= LIBRTP_NTP_UNIX_OFFSET;
+
+    ts->tv_sec = (time_t) sec;
+    ts->tv_nsec = (long) (ns % LIBRTP_NTP_NSEC);
+}
+
+ntp_ts ntp_ts_now(clockid_t clock) {
+    struct timespec ts;
+
+    clock_gettime(clock, &ts);
+
+    return ntp_ts_from_timespec(clock, &ts);
+}
 
-    return ntp_from_double(s1 - s2);
+#ifdef RTP_NTP_TEST
+#include <stdio.h>
+
+void testit(char *name, int result, int should) {
+    if (result == should) {
+        printf("Test %s was successful\n", name);
+    }
+    else {
+        printf("Test %s was not successful, %d should have been %d\n", name, result, should);
+    }
 }
+
+int main(void) {
+    ntp_tv tv = { 0x83aa7e80, 0x80000000 };
+    ntp_ts a, b;
+    struct timespec ts, back;
+    uint64_t ns;
+    int i, ok;
+
+    a = ntp_pack(tv);
+    testit("pack", a == 0x83aa7e8080000000ULL, 1);
+    testit("unpack sec", ntp_unpack(a).sec == tv.sec, 1);
+    testit("unpack frac", ntp_unpack(a).frac == tv.frac, 1);
+
+    // Half a second plus half a second carries into the seconds.
+    b = ntp_ts_add(a, ntp_ts_from_ns(500000000ULL));
+    testit("add carries", ntp_unpack(b).sec == tv.sec + 1 && ntp_unpack(b).frac == 0, 1);
+    testit("sub", ntp_ts_sub(b, a) == 0x80000000ULL, 1);
+    testit("cmp after", ntp_ts_cmp(b, a), 1);
+    testit("cmp before", ntp_ts_cmp(a, b), -1);
+    testit("cmp equal", ntp_ts_cmp(a, a), 0);
+
+    // The era rolls over in 2036, ordering must survive it.
+    a = 0xffffffff00000000ULL;
+    b = ntp_ts_add(a, ntp_ts_from_ns(2000000000ULL));
+    testit("add wraps era", (int) (b >> 32), 1);
+    testit("cmp across era", ntp_ts_cmp(b, a), 1);
+    testit("sub across era", ntp_ts_sub(b, a) == ((uint64_t) 2 << 32), 1);
+
+    a = 0x0001234567890000ULL;
+    testit("short", ntp_ts_short(a) == 0x23456789, 1);
+    testit("short agrees with ntp_short", ntp_ts_short(a) == ntp_short(ntp_unpack(a)), 1);
+    testit("from short", ntp_ts_from_short(0x00018000) == 0x0000000180000000ULL, 1);
+
+    for (i = 0, ok = 1, ns = 1; i < 1000; i++) {
+        ns = (ns * 6364136223846793005ULL + 1442695040888963407ULL);
+        if (ntp_ts_to_ns(ntp_ts_from_ns(ns % (100 * LIBRTP_NTP_NSEC))) != ns % (100 * LIBRTP_NTP_NSEC))
+            ok = 0;
+    }
+    testit("ns round trip", ok, 1);
+    testit("one second", ntp_ts_from_ns(LIBRTP_NTP_NSEC) == ((uint64_t) 1 << 32), 1);
+
+    ts.tv_sec = 1700000000;
+    ts.tv_nsec = 999999999;
+    a = ntp_ts_from_timespec(CLOCK_REALTIME, &ts);
+    testit("realtime epoch", (int) ((a >> 32) - ts.tv_sec == LIBRTP_NTP_UNIX_OFFSET), 1);
+    ntp_ts_to_timespec(CLOCK_REALTIME, a, &back);
+    testit("realtime round trip", back.tv_sec == ts.tv_sec && back.tv_nsec == ts.tv_nsec, 1);
+
+    a = ntp_ts_from_timespec(CLOCK_MONOTONIC, &ts);
+    testit("monotonic keeps origin", (int) ((a >> 32) == (uint64_t) ts.tv_sec), 1);
+    ntp_ts_to_timespec(CLOCK_MONOTONIC, a, &back);
+    testit("monotonic round trip", back.tv_sec == ts.tv_sec && back.tv_nsec == ts.tv_nsec, 1);
+
+    a = ntp_ts_now(CLOCK_MONOTONIC);
+    b = ntp_ts_now(CLOCK_MONOTONIC);
+    testit("now is monotonic", ntp_ts_cmp(b, a) >= 0, 1);
+
+    return 0;
+}
+
+#endif /* RTP_NTP_TEST */
@@ -54,7 +54,9 @@
 #include <sys/socket.h>
 
 #include <fcntl.h>
+#include <poll.h>
 #include <netinet/in.h>
+#include <netinet/udp.h>
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <ifaddrs.h>
@@ -62,6 +64,18 @@
 #include <errno.h>
 #include <time.h>
 
+#ifdef HAVE_LINUX_ERRQUEUE_H
+#include <linux/errqueue.h>
+#endif
+
+#ifdef HAVE_LINUX_NET_TSTAMP_H
+#include <linux/net_tstamp.h>
+#endif
+
+#ifdef HAVE_LINUX_FILTER_H
+#include <linux/filter.h>
+#endif
+
 #include "rtp_socket.h"
 #include "rtp_util.h"
 
@@ -423,6 +437,23 @@ static int _set_multicast_loopback(rtp_socket_t *sock, char loop) {
     return retval;
 }
 
+// Ask the kernel to stamp every received datagram: hardware (NIC) stamps where the driver has them
+// enabled, software stamps taken at the device otherwise. Best effort, rx_tstamp stays 0 without them.
+static void _enable_timestamps(rtp_socket_t *sock) {
+#if defined(HAVE_LINUX_NET_TSTAMP_H) && defined(SO_TIMESTAMPING)
+    int flags = SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_RAW_HARDWARE | SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+    if (setsockopt(sock->fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) == 0)
+        return;
+#endif
+#ifdef SO_TIMESTAMPNS
+    int on = 1;
+    if (setsockopt(sock->fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on)) == 0)
+        return;
+#endif
+
+    rtp_socket_debug("Receive timestamps not available");
+}
+
 int rtp_socket_open_recv(rtp_socket_t *sock, const char *address, uint16_t port_i, const char *ifname) {
     int is_multicast, err;
     char port[6];
@@ -454,9 +485,64 @@ int rtp_socket_open_recv(rtp_socket_t *sock, const char *address, uint16_t port_
         rtp_socket_warn("Error checking if address is multicast");
     }
 
+    _enable_timestamps(sock);
+
+#ifdef SO_RXQ_OVFL
+    int on = 1;
+    if (setsockopt(sock->fd, SOL_SOCKET, SO_RXQ_OVFL, &on, sizeof(on)) < 0)
+        rtp_socket_debug("SO_RXQ_OVFL failed: %s", strerror(errno));
+#endif
+
     return RTP_OK;
 }
 
+int rtp_socket_open_recv_shards(rtp_socket_t *socks, unsigned int count, const char *address, uint16_t port, const char *ifname) {
+    unsigned int idx;
+
+    if (count == 0 || count > RTP_SOCKET_MAX_SHARDS)
+        return RTP_ERROR;
+
+    // The reuseport group indexes the sockets in bind order, which is the shard number
+    for (idx = 0; idx < count; idx++) {
+        if (rtp_socket_open_recv(&socks[idx], address, port, ifname) != RTP_OK)
+            goto fail;
+    }
+
+    if (count > 1 && rtp_socket_steer_ssrc(&socks[0], count) != RTP_OK)
+        goto fail;
+
+    return RTP_OK;
+
+fail:
+    while (idx-- > 0)
+        rtp_socket_close(&socks[idx]);
+    return RTP_ERROR;
+}
+
+int rtp_socket_steer_ssrc(rtp_socket_t *sock, unsigned int count) {
+#if defined(HAVE_LINUX_FILTER_H) && defined(SO_ATTACH_REUSEPORT_CBPF)
+    // Runs on the udp payload: shard = rtp ssrc % count
+    struct sock_filter code[] = {
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, 8),
+        BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, count),
+        BPF_STMT(BPF_RET | BPF_A, 0),
+    };
+    struct sock_fprog prog = { .len = sizeof(code) / sizeof(code[0]), .filter = code };
+
+    if (count == 0)
+        return RTP_ERROR;
+
+    if (setsockopt(sock->fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) < 0) {
+        rtp_socket_warn("SO_ATTACH_REUSEPORT_CBPF failed: %s", strerror(errno));
+        return RTP_ERROR;
+    }
+
+    return RTP_OK;
+#else
+    return RTP_ERROR;
+#endif
+}
+
 int rtp_socket_open_send(rtp_socket_t *sock, const char *address, uint16_t port_i, const char *ifname) {
     int is_multicast;
     char port[6];
@@ -488,36 +574,315 @@ int rtp_socket_open_send(rtp_socket_t *sock, const char *address, uint16_t port_
     return RTP_OK;
 }
 
-int rtp_socket_recv(rtp_socket_t *sock, void *data, unsigned int len) {
-    fd_set readfds;
-    struct timeval timeout;
-    int packet_len, retval;
-
-    timeout.tv_sec = 60;
-    timeout.tv_usec = 0;
+// Wait until the socket is readable. Returns 1 if readable, 0 on timeout, RTP_ERROR on failure.
+static int _wait_readable(rtp_socket_t *sock) {
+    struct pollfd pfd;
+    int timeout = 60;
+    int retval;
 
     // Watch socket to see when it has input.
-    FD_ZERO(&readfds);
-    FD_SET(sock->fd, &readfds);
-    retval = select(FD_SETSIZE, &readfds, NULL, NULL, &timeout);
+    // poll() instead of select() so descriptors above FD_SETSIZE work when many sessions share a process
+    pfd.fd = sock->fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    retval = poll(&pfd, 1, timeout * 1000);
 
     // Check return value
     if (retval == -1) {
-        perror("select()");
+        perror("poll()");
         return RTP_ERROR;
 
     }
     else if (retval == 0) {
-        rtp_socket_warn("Timed out waiting for packet after %ld seconds", timeout.tv_sec);
+        rtp_socket_warn("Timed out waiting for packet after %d seconds", timeout);
         return RTP_OK;
     }
 
+    return 1;
+}
+
+// Kernel arrival time in ns from a SCM_TIMESTAMPNS / SCM_TIMESTAMPING cmsg, 0 if it carries none.
+static uint64_t _cmsg_tstamp(struct cmsghdr *cmsg) {
+    struct timespec ts[3];
+
+    if (cmsg->cmsg_level != SOL_SOCKET)
+        return 0;
+
+#ifdef SCM_TIMESTAMPING
+    if (cmsg->cmsg_type == SCM_TIMESTAMPING) {
+        // ts[0] software, ts[2] raw hardware
+        memcpy(ts, CMSG_DATA(cmsg), sizeof(ts));
+        if (ts[2].tv_sec || ts[2].tv_nsec)
+            ts[0] = ts[2];
+        return (uint64_t) ts[0].tv_sec * 1000000000ULL + ts[0].tv_nsec;
+    }
+#endif
+#ifdef SCM_TIMESTAMPNS
+    if (cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+        memcpy(ts, CMSG_DATA(cmsg), sizeof(ts[0]));
+        return (uint64_t) ts[0].tv_sec * 1000000000ULL + ts[0].tv_nsec;
+    }
+#endif
+
+    return 0;
+}
+
+void rtp_socket_rx_cmsg(rtp_socket_t *sock, struct msghdr *msg) {
+    struct cmsghdr *cmsg;
+    uint64_t tstamp;
+
+    sock->rx_tstamp = 0;
+    for (cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+        if ((tstamp = _cmsg_tstamp(cmsg)) != 0)
+            sock->rx_tstamp = tstamp;
+#ifdef SO_RXQ_OVFL
+        // Cumulative count, only sent while it is not zero
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL)
+            memcpy(&sock->rx_dropped, CMSG_DATA(cmsg), sizeof(sock->rx_dropped));
+#endif
+    }
+}
+
+// recvmsg() returning the UDP_GRO segment size, or the datagram length if it was not coalesced.
+// The kernel arrival time and drop count are left in sock->rx_tstamp and sock->rx_dropped.
+static int _recv_gro(rtp_socket_t *sock, void *data, unsigned int len, unsigned int *segment, int flags) {
+    char control[CMSG_SPACE(sizeof(int)) + RTP_SOCKET_RX_CMSG_SPACE];
+    struct iovec iov = { .iov_base = data, .iov_len = len };
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    int packet_len = recvmsg(sock->fd, &msg, flags);
+    if (packet_len <= 0)
+        return packet_len;
+
+    rtp_socket_rx_cmsg(sock, &msg);
+    *segment = packet_len;
+#ifdef UDP_GRO
+    for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+            int gso_size;
+            memcpy(&gso_size, CMSG_DATA(cmsg), sizeof(gso_size));
+            if (gso_size > 0)
+                *segment = gso_size;
+        }
+    }
+#endif
+
+    return packet_len;
+}
+
+int rtp_socket_recv(rtp_socket_t *sock, void *data, unsigned int len) {
+    int retval = _wait_readable(sock);
+    if (retval <= 0)
+        return retval;
+
     // Packet is waiting - read it in
-    packet_len = recv(sock->fd, data, len, 0);
+    unsigned int segment;
+    return _recv_gro(sock, data, len, &segment, 0);
+}
+
+int rtp_socket_recv_gro(rtp_socket_t *sock, void *data, unsigned int len, unsigned int *segment) {
+    int retval = _wait_readable(sock);
+    if (retval <= 0)
+        return retval;
+
+    return _recv_gro(sock, data, len, segment, 0);
+}
+
+int rtp_socket_try_recv(rtp_socket_t *sock, void *data, unsigned int len) {
+    unsigned int segment;
+    int packet_len = _recv_gro(sock, data, len, &segment, MSG_DONTWAIT);
+
+    if (packet_len < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+            return RTP_OK;
+
+        rtp_socket_warn("receiving packet failed: %s", strerror(errno));
+        return RTP_ERROR;
+    }
 
     return packet_len;
 }
 
+int rtp_socket_try_recv_gro(rtp_socket_t *sock, void *data, unsigned int len, unsigned int *segment) {
+    int packet_len = _recv_gro(sock, data, len, segment, MSG_DONTWAIT);
+
+    if (packet_len < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+            return RTP_OK;
+
+        rtp_socket_warn("receiving packet failed: %s", strerror(errno));
+        return RTP_ERROR;
+    }
+
+    return packet_len;
+}
+
+int rtp_socket_set_gro(rtp_socket_t *sock, bool enable) {
+#ifdef UDP_GRO
+    int val = enable;
+    if (setsockopt(sock->fd, SOL_UDP, UDP_GRO, &val, sizeof(val)) < 0) {
+        rtp_socket_warn("UDP_GRO failed: %s", strerror(errno));
+        return RTP_ERROR;
+    }
+
+    return RTP_OK;
+#else
+    return enable ? RTP_ERROR : RTP_OK;
+#endif
+}
+
+// sendmsg() to the destination, with a UDP_SEGMENT cmsg if len holds more than one segment.
+static int _send_segments(rtp_socket_t *sock, void *data, unsigned int len, unsigned int segment, int flags) {
+    char control[CMSG_SPACE(sizeof(uint16_t))];
+    struct iovec iov = { .iov_base = data, .iov_len = len };
+    struct msghdr msg;
+
+    memset(&msg, 0, sizeof(msg));
+    memset(control, 0, sizeof(control));
+    msg.msg_name = &sock->dest_addr;
+    msg.msg_namelen = _sockaddr_len(sock->dest_addr.ss_family);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+
+#ifdef UDP_SEGMENT
+    if (len > segment) {
+        struct cmsghdr *cmsg;
+        uint16_t gso_size = segment;
+
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_UDP;
+        cmsg->cmsg_type = UDP_SEGMENT;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+        memcpy(CMSG_DATA(cmsg), &gso_size, sizeof(gso_size));
+    }
+#endif
+
+    return sendmsg(sock->fd, &msg, flags);
+}
+
+int rtp_socket_send_gso(rtp_socket_t *sock, void *data, unsigned int len, unsigned int segment) {
+    if (len <= segment)
+        return rtp_socket_send(sock, data, len);
+
+#ifdef UDP_SEGMENT
+    if (!sock->no_gso) {
+        int nbytes = _send_segments(sock, data, len, segment, 0);
+        if (nbytes >= 0)
+            return nbytes;
+
+        // No segmentation offload on this route (e.g. checksum offload disabled): stop trying
+        if (errno != EIO && errno != EINVAL && errno != ENOPROTOOPT && errno != EOPNOTSUPP) {
+            rtp_socket_warn("sending packet failed: %s", strerror(errno));
+            return nbytes;
+        }
+        rtp_socket_warn("UDP_SEGMENT failed: %s", strerror(errno));
+        sock->no_gso = true;
+    }
+#endif
+
+    // One datagram per segment
+    unsigned int offset;
+    int nbytes = 0;
+    for (offset = 0; offset < len; offset += segment) {
+        unsigned int size = len - offset < segment ? len - offset : segment;
+        int sent = rtp_socket_send(sock, (uint8_t*) data + offset, size);
+        if (sent <= 0)
+            return sent;
+        nbytes += sent;
+    }
+
+    return nbytes;
+}
+
+int rtp_socket_set_zerocopy(rtp_socket_t *sock, bool enable) {
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY) && defined(HAVE_LINUX_ERRQUEUE_H)
+    int val = enable;
+    if (setsockopt(sock->fd, SOL_SOCKET, SO_ZEROCOPY, &val, sizeof(val)) < 0) {
+        rtp_socket_warn("SO_ZEROCOPY failed: %s", strerror(errno));
+        return RTP_ERROR;
+    }
+
+    return RTP_OK;
+#else
+    return enable ? RTP_ERROR : RTP_OK;
+#endif
+}
+
+int rtp_socket_send_zc(rtp_socket_t *sock, void *data, unsigned int len, unsigned int segment, uint32_t *id) {
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY) && defined(HAVE_LINUX_ERRQUEUE_H)
+    if (sock->no_gso && len > segment)
+        return RTP_ERROR;
+
+    int nbytes = _send_segments(sock, data, len, segment, MSG_ZEROCOPY);
+    if (nbytes < 0) {
+        // ENOBUFS: out of optmem for pinned pages, the caller sends a copy instead
+        if (errno != ENOBUFS)
+            rtp_socket_warn("zerocopy send failed: %s", strerror(errno));
+        return nbytes;
+    }
+
+    // The kernel numbers successful zerocopy sends of a socket from 0
+    *id = sock->zc_next++;
+
+    return nbytes;
+#else
+    return RTP_ERROR;
+#endif
+}
+
+int rtp_socket_zc_reap(rtp_socket_t *sock, uint32_t *lo, uint32_t *hi, bool *copied) {
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY) && defined(HAVE_LINUX_ERRQUEUE_H)
+    char control[CMSG_SPACE(sizeof(struct sock_extended_err)) + CMSG_SPACE(sizeof(struct sockaddr_storage))];
+    struct msghdr msg;
+    struct cmsghdr *cmsg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    if (recvmsg(sock->fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+            return RTP_OK;
+        return RTP_ERROR;
+    }
+
+    for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        struct sock_extended_err serr;
+
+        if (!((cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) || (cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR)))
+            continue;
+
+        memcpy(&serr, CMSG_DATA(cmsg), sizeof(serr));
+        if (serr.ee_errno != 0 || serr.ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+            continue;
+
+        // One notification covers the range of sends [ee_info, ee_data]
+        *lo = serr.ee_info;
+        *hi = serr.ee_data;
+        *copied = (serr.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) != 0;
+        return 1;
+    }
+
+    // Some other error report: consumed, nothing completed
+    *lo = 1;
+    *hi = 0;
+    *copied = false;
+    return 1;
+#else
+    return RTP_OK;
+#endif
+}
+
 int rtp_socket_send(rtp_socket_t *sock, void *data, unsigned int len) {
     rtp_socket_debug("Sending %d byte packet", len);
 
@@ -530,6 +895,76 @@ int rtp_socket_send(rtp_socket_t *sock, void *data, unsigned int len) {
     return nbytes;
 }
 
+// Set a socket buffer size, forced past the net.core.[rw]mem_max limit when privileged (CAP_NET_ADMIN).
+// Returns the usable size the kernel granted.
+static int _set_buffer(rtp_socket_t *sock, int force_opt, int opt, unsigned int bytes) {
+    int val = bytes;
+    socklen_t len = sizeof(val);
+
+    if (setsockopt(sock->fd, SOL_SOCKET, force_opt, &val, sizeof(val)) < 0 && setsockopt(sock->fd, SOL_SOCKET, opt, &val, sizeof(val)) < 0) {
+        rtp_socket_warn("setting socket buffer failed: %s", strerror(errno));
+        return RTP_ERROR;
+    }
+
+    // The kernel reports twice the size it was asked for, half of it is bookkeeping overhead
+    if (getsockopt(sock->fd, SOL_SOCKET, opt, &val, &len) < 0)
+        return RTP_ERROR;
+
+    return val / 2;
+}
+
+int rtp_socket_set_rcvbuf(rtp_socket_t *sock, unsigned int bytes) {
+    return _set_buffer(sock, SO_RCVBUFFORCE, SO_RCVBUF, bytes);
+}
+
+int rtp_socket_set_sndbuf(rtp_socket_t *sock, unsigned int bytes) {
+    return _set_buffer(sock, SO_SNDBUFFORCE, SO_SNDBUF, bytes);
+}
+
+int rtp_socket_set_busy_poll(rtp_socket_t *sock, unsigned int usecs, bool prefer) {
+    int ret = RTP_OK;
+
+#ifdef SO_BUSY_POLL
+    int val = usecs;
+    // Above net.core.busy_read this needs CAP_NET_ADMIN
+    if (setsockopt(sock->fd, SOL_SOCKET, SO_BUSY_POLL, &val, sizeof(val)) < 0) {
+        rtp_socket_warn("SO_BUSY_POLL failed: %s", strerror(errno));
+        ret = RTP_ERROR;
+    }
+#else
+    if (usecs)
+        ret = RTP_ERROR;
+#endif
+
+#ifdef SO_PREFER_BUSY_POLL
+    int on = prefer;
+    // Keep the device interrupts deferred while the application polls
+    if (setsockopt(sock->fd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &on, sizeof(on)) < 0) {
+        rtp_socket_warn("SO_PREFER_BUSY_POLL failed: %s", strerror(errno));
+        ret = RTP_ERROR;
+    }
+#else
+    if (prefer)
+        ret = RTP_ERROR;
+#endif
+
+    return ret;
+}
+
+int rtp_socket_set_nonblock(rtp_socket_t *sock, bool nonblock) {
+    int flags = fcntl(sock->fd, F_GETFL, 0);
+    if (flags < 0)
+        return RTP_ERROR;
+
+    flags = nonblock ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+    if (fcntl(sock->fd, F_SETFL, flags) < 0) {
+        rtp_socket_warn("F_SETFL failed: %s", strerror(errno));
+        return RTP_ERROR;
+    }
+
+    return RTP_OK;
+}
+
 void rtp_socket_close(rtp_socket_t *sock) {
     // Drop Multicast membership
     if (sock->joined_group) {
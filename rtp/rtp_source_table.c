@@ -0,0 +1,414 @@
+/*
+ * Copyright 2023 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/rtp-sdr *
+ *
+ * This is based on other projects:
+ *      IDEA: https://github.com/OpenResearchInstitute/ka9q-sdr (not use any code of this)
+ *       RTP: https://github.com/Daxbot/librtp/
+ *       FEC: https://github.com/wesen/poc
+ *    SOCKET: https://github.com/njh/mast
+ *    OTHERS: see individual files
+ *
+ *    please contact their authors for more information.
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "rtp_util.h"
+#include "rtp_source_table.h"
+
+/**
+ * @brief Unused slot.
+ * @private
+ */
+#define RTP_SOURCE_TABLE_EMPTY (UINT32_MAX)
+
+typedef struct {
+    uint32_t id;
+    uint32_t idx; // record index or RTP_SOURCE_TABLE_EMPTY
+} rtp_source_slot;
+
+struct rtp_source_table_s {
+     rtp_source_slot *slots;
+            uint32_t mask;     // slots - 1 (power of two)
+            uint32_t shift;    // 32 - log2(slots)
+    rtp_source_entry *records;
+                bool *in_use;
+            uint32_t *free;    // stack of free record indexes
+            uint32_t free_n;
+            uint32_t max;
+};
+
+// Fibonacci hashing: spreads sequential or hand picked SSRCs over the whole table.
+static inline uint32_t _home(const rtp_source_table_t *table, uint32_t id) {
+    return (uint32_t) (id * 2654435769u) >> table->shift;
+}
+
+// Slot holding id, or the empty slot where it would go.
+static uint32_t _probe(const rtp_source_table_t *table, uint32_t id) {
+    uint32_t pos = _home(table, id);
+
+    while (table->slots[pos].idx != RTP_SOURCE_TABLE_EMPTY && table->slots[pos].id != id)
+        pos = (pos + 1) & table->mask;
+
+    return pos;
+}
+
+static rtp_source_entry* _insert(rtp_source_table_t *table, uint32_t pos, uint32_t id, uint16_t seq) {
+    if (table->free_n == 0)
+        return NULL;
+
+    uint32_t idx = table->free[--table->free_n];
+    rtp_source_entry *entry = &table->records[idx];
+
+    memset(entry, 0, sizeof(*entry));
+    rtp_source_init(&entry->source, id, seq);
+    table->in_use[idx] = true;
+    table->slots[pos].id = id;
+    table->slots[pos].idx = idx;
+
+    return entry;
+}
+
+// Backward shift deletion: no tombstones, probe sequences stay as short as if the entry never existed.
+static void _remove_slot(rtp_source_table_t *table, uint32_t pos) {
+    uint32_t idx = table->slots[pos].idx;
+    uint32_t next = pos;
+
+    table->in_use[idx] = false;
+    table->free[table->free_n++] = idx;
+
+    while (1) {
+        table->slots[pos].idx = RTP_SOURCE_TABLE_EMPTY;
+
+        // Find the next entry that may move into the hole: its home is not within (pos, next]
+        while (1) {
+            next = (next + 1) & table->mask;
+            if (table->slots[next].idx == RTP_SOURCE_TABLE_EMPTY)
+                return;
+
+            uint32_t home = _home(table, table->slots[next].id);
+            if (((next - home) & table->mask) >= ((next - pos) & table->mask))
+                break;
+        }
+
+        table->slots[pos] = table->slots[next];
+        pos = next;
+    }
+}
+
+rtp_source_table_t* rtp_source_table_create(unsigned int max_sources) {
+    uint32_t size = 2, bits = 1, idx;
+
+    if (max_sources == 0 || max_sources > (1u << 30))
+        return NULL;
+
+    // At most half full
+    while (size < 2 * max_sources) {
+        size <<= 1;
+        bits++;
+    }
+
+    rtp_source_table_t *table = (rtp_source_table_t*) malloc(sizeof(rtp_source_table_t));
+    if (!table)
+        return NULL;
+
+    memset(table, 0, sizeof(rtp_source_table_t));
+    table->mask = size - 1;
+    table->shift = 32 - bits;
+    table->max = max_sources;
+    table->slots = (rtp_source_slot*) malloc(size * sizeof(rtp_source_slot));
+    table->records = (rtp_source_entry*) malloc(max_sources * sizeof(rtp_source_entry));
+    table->in_use = (bool*) calloc(max_sources, sizeof(bool));
+    table->free = (uint32_t*) malloc(max_sources * sizeof(uint32_t));
+    if (!table->slots || !table->records || !table->in_use || !table->free) {
+        rtp_source_table_free(table);
+        return NULL;
+    }
+
+    for (idx = 0; idx < size; idx++)
+        table->slots[idx].idx = RTP_SOURCE_TABLE_EMPTY;
+
+    // Hand out low indexes first
+    for (idx = 0; idx < max_sources; idx++)
+        table->free[idx] = max_sources - 1 - idx;
+    table->free_n = max_sources;
+
+    return table;
+}
+
+void rtp_source_table_free(rtp_source_table_t *table) {
+    if (!table)
+        return;
+
+    free(table->slots);
+    free(table->records);
+    free(table->in_use);
+    free(table->free);
+    free(table);
+}
+
+unsigned int rtp_source_table_count(rtp_source_table_t *table) {
+    assert(table != NULL);
+
+    return table->max - table->free_n;
+}
+
+rtp_source_entry* rtp_source_table_find(rtp_source_table_t *table, uint32_t id) {
+    assert(table != NULL);
+
+    uint32_t pos = _probe(table, id);
+    if (table->slots[pos].idx == RTP_SOURCE_TABLE_EMPTY)
+        return NULL;
+
+    return &table->records[table->slots[pos].idx];
+}
+
+rtp_source_entry* rtp_source_table_add(rtp_source_table_t *table, uint32_t id, uint64_t now) {
+    assert(table != NULL);
+
+    uint32_t pos = _probe(table, id);
+    if (table->slots[pos].idx != RTP_SOURCE_TABLE_EMPTY)
+        return &table->records[table->slots[pos].idx];
+
+    rtp_source_entry *e = _insert(table, pos, id, 0);
+    if (e)
+        e->last_seen = now;
+
+    return e;
+}
+
+int rtp_source_table_rtp(rtp_source_table_t *table, uint32_t id, uint16_t seq, uint64_t now, rtp_source_entry **entry) {
+    assert(table != NULL);
+
+    uint32_t pos = _probe(table, id);
+    rtp_source_entry *e;
+
+    if (table->slots[pos].idx != RTP_SOURCE_TABLE_EMPTY)
+        e = &table->records[table->slots[pos].idx];
+    else
+        e = _insert(table, pos, id, seq);
+
+    if (entry)
+        *entry = e;
+    if (!e)
+        return RTP_ERROR;
+
+    e->last_seen = now;
+    e->flags |= RTP_SOURCE_SENDER;
+
+    return rtp_source_update_seq(&e->source, seq) == RTP_OK ? RTP_OK : RTP_ERROR;
+}
+
+rtp_source_entry* rtp_source_table_sr(rtp_source_table_t *table, uint32_t id, ntp_tv ntp, uint64_t now) {
+    assert(table != NULL);
+
+    uint32_t pos = _probe(table, id);
+    rtp_source_entry *e;
+
+    if (table->slots[pos].idx != RTP_SOURCE_TABLE_EMPTY)
+        e = &table->records[table->slots[pos].idx];
+    else
+        e = _insert(table, pos, id, 0);
+
+    if (!e)
+        return NULL;
+
+    e->last_seen = now;
+    e->flags |= RTP_SOURCE_SENDER;
+    rtp_source_update_lsr(&e->source, ntp);
+
+    return e;
+}
+
+void rtp_source_table_remove(rtp_source_table_t *table, uint32_t id) {
+    assert(table != NULL);
+
+    uint32_t pos = _probe(table, id);
+    if (table->slots[pos].idx != RTP_SOURCE_TABLE_EMPTY)
+        _remove_slot(table, pos);
+}
+
+unsigned int rtp_source_table_expire(rtp_source_table_t *table, uint64_t now, uint64_t timeout, rtp_source_table_cb cb, void *arg) {
+    assert(table != NULL);
+
+    unsigned int removed = 0;
+    uint32_t idx;
+
+    for (idx = 0; idx < table->max; idx++) {
+        rtp_source_entry *e = &table->records[idx];
+        if (!table->in_use[idx] || now - e->last_seen <= timeout)
+            continue;
+
+        if (cb)
+            cb(e, arg);
+        _remove_slot(table, _probe(table, e->source.id));
+        removed++;
+    }
+
+    return removed;
+}
+
+rtp_source_entry* rtp_source_table_next(rtp_source_table_t *table, rtp_source_entry *prev) {
+    assert(table != NULL);
+
+    uint32_t idx = prev ? (uint32_t) (prev - table->records) + 1 : 0;
+
+    for (; idx < table->max; idx++) {
+        if (table->in_use[idx])
+            return &table->records[idx];
+    }
+
+    return NULL;
+}
+
+#ifdef RTP_SOURCE_TABLE_TEST
+#include <stdio.h>
+
+#define TEST_MAX     (32)
+#define TEST_CLUSTER (6)
+
+void testit(char *name, int result, int should) {
+    if (result == should) {
+        printf("Test %s was successful\n", name);
+    }
+    else {
+        printf("Test %s was not successful, %d should have been %d\n", name, result, should);
+    }
+}
+
+// Ids whose home slot is home, so they share one probe sequence.
+static int _colliding(rtp_source_table_t *table, uint32_t home, uint32_t *ids, int n) {
+    uint32_t id;
+    int found = 0;
+
+    for (id = 1; found < n && id != 0; id++) {
+        if (_home(table, id) == home)
+            ids[found++] = id;
+    }
+
+    return found;
+}
+
+static void _count_cb(rtp_source_entry *entry, void *arg) {
+    (void) entry;
+    (*(int*) arg)++;
+}
+
+int main(void) {
+    rtp_source_table_t *table = rtp_source_table_create(TEST_MAX);
+    uint32_t ids[TEST_CLUSTER], next[2], seed = 1, id;
+    bool present[256] = { false };
+    rtp_source_entry *e;
+    int i, ok, n, expired = 0;
+
+    // A cluster at the last slot wraps to the start, followed by ids homed just after it.
+    testit("cluster ids", _colliding(table, table->mask, ids, TEST_CLUSTER), TEST_CLUSTER);
+    testit("next ids", _colliding(table, 1, next, 2), 2);
+    for (i = 0; i < TEST_CLUSTER; i++)
+        rtp_source_table_add(table, ids[i], 100);
+    for (i = 0; i < 2; i++)
+        rtp_source_table_add(table, next[i], 100);
+    testit("count", rtp_source_table_count(table), TEST_CLUSTER + 2);
+
+    // Deleting from the head and the middle of the chain shifts the rest back.
+    rtp_source_table_remove(table, ids[0]);
+    rtp_source_table_remove(table, ids[3]);
+    testit("removed head gone", rtp_source_table_find(table, ids[0]) == NULL, 1);
+    testit("removed middle gone", rtp_source_table_find(table, ids[3]) == NULL, 1);
+    for (i = 0, ok = 1; i < TEST_CLUSTER; i++) {
+        if (i != 0 && i != 3 && (rtp_source_table_find(table, ids[i]) == NULL || rtp_source_table_find(table, ids[i])->source.id != ids[i]))
+            ok = 0;
+    }
+    for (i = 0; i < 2; i++) {
+        if (rtp_source_table_find(table, next[i]) == NULL)
+            ok = 0;
+    }
+    testit("chain still found", ok, 1);
+    testit("entry moved home", table->slots[table->mask].id == ids[1], 1);
+    testit("count after remove", rtp_source_table_count(table), TEST_CLUSTER);
+
+    // No tombstones: the table empties completely.
+    for (i = 0; i < TEST_CLUSTER; i++)
+        rtp_source_table_remove(table, ids[i]);
+    for (i = 0; i < 2; i++)
+        rtp_source_table_remove(table, next[i]);
+    for (i = 0, ok = 1; i <= (int) table->mask; i++) {
+        if (table->slots[i].idx != RTP_SOURCE_TABLE_EMPTY)
+            ok = 0;
+    }
+    testit("all slots empty", ok, 1);
+
+    // Random adds and removes against a reference set.
+    for (i = 0, ok = 1; i < 20000; i++) {
+        seed = seed * 1103515245u + 12345u;
+        id = (seed >> 16) & 0xff;
+        if (present[id]) {
+            rtp_source_table_remove(table, id + 1);
+            present[id] = false;
+        }
+        else if (rtp_source_table_count(table) < TEST_MAX) {
+            if (rtp_source_table_add(table, id + 1, 100) == NULL)
+                ok = 0;
+            present[id] = true;
+        }
+        for (n = 0; n < 256; n++) {
+            if ((rtp_source_table_find(table, n + 1) != NULL) != present[n])
+                ok = 0;
+        }
+    }
+    testit("random matches reference", ok, 1);
+
+    for (n = 0; rtp_source_table_count(table) < TEST_MAX; n++)
+        rtp_source_table_add(table, 1000 + n, 100);
+    testit("add when full", rtp_source_table_add(table, 999, 100) == NULL, 1);
+    for (e = rtp_source_table_next(table, NULL), n = 0; e != NULL; e = rtp_source_table_next(table, e))
+        n++;
+    testit("next walks all", n, TEST_MAX);
+
+    // Only the entries seen since 200 survive.
+    for (e = rtp_source_table_next(table, NULL), n = 0; n < 4; e = rtp_source_table_next(table, e))
+        ids[n++] = e->source.id;
+    for (n = 0; n < 4; n++)
+        rtp_source_table_rtp(table, ids[n], 1, 200, NULL);
+    n = rtp_source_table_expire(table, 300, 150, _count_cb, &expired);
+    testit("expire count", n, TEST_MAX - 4);
+    testit("expire callback", expired, TEST_MAX - 4);
+    testit("survivors", rtp_source_table_count(table), 4);
+    for (i = 0, ok = 1; i < 4; i++) {
+        e = rtp_source_table_find(table, ids[i]);
+        if (e == NULL || !(e->flags & RTP_SOURCE_SENDER) || e->last_seen != 200)
+            ok = 0;
+    }
+    testit("survivors found", ok, 1);
+
+    rtp_source_table_free(table);
+
+    return 0;
+}
+
+#endif /* RTP_SOURCE_TABLE_TEST */
@@ -0,0 +1,571 @@
+/*
+ * Copyright 2023 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/rtp-sdr *
+ *
+ * This is based on other projects:
+ *      IDEA: https://github.com/OpenResearchInstitute/ka9q-sdr (not use any code of this)
+ *       RTP: https://github.com/Daxbot/librtp/
+ *       FEC: https://github.com/wesen/poc
+ *    SOCKET: https://github.com/njh/mast
+ *    OTHERS: see individual files
+ *
+ *    please contact their authors for more information.
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+
+#include "rtp_util.h"
+#include "rtp_uring.h"
+
+#ifdef HAVE_LINUX_IO_URING_H
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+/**
+ * @brief Provided buffer group of the receive buffers.
+ * @private
+ */
+#define RTP_URING_BGID (0)
+
+/**
+ * @brief Idle time in milliseconds before the sq poller thread goes to sleep.
+ * @private
+ */
+#define RTP_URING_SQ_IDLE (100)
+
+/**
+ * @brief Completion tags (stored in user_data, tx also carries the slot).
+ * @private
+ */
+#define RTP_URING_RX (1ULL << 32)
+#define RTP_URING_TX (2ULL << 32)
+
+struct rtp_uring_s {
+                         int fd;
+                    uint32_t flags;
+
+    // submission queue
+                    unsigned *sq_head;
+                    unsigned *sq_tail;
+                    unsigned *sq_flags;
+                    unsigned *sq_array;
+                    unsigned sq_mask;
+                    unsigned sq_entries;
+                    unsigned sq_local_tail; // tail of the queued, not yet submitted entries
+        struct io_uring_sqe *sqes;
+
+    // completion queue
+                    unsigned *cq_head;
+                    unsigned *cq_tail;
+                    unsigned cq_mask;
+        struct io_uring_cqe *cqes;
+
+                        void *sq_ptr;
+                      size_t sq_len;
+                        void *cq_ptr;
+                      size_t cq_len;
+                      size_t sqes_len;
+
+    // rx provided buffer ring
+    struct io_uring_buf_ring *br;
+                      size_t br_len;
+                    uint8_t *rx_bufs;
+                    unsigned buf_count;
+                    unsigned buf_size;
+                    unsigned rx_stride; // buf_size plus the recvmsg header and control data in front of the payload
+               rtp_socket_t *rx_sock;
+                        bool rx_armed;
+               struct msghdr rx_msg;
+
+    // tx registered buffers
+                    uint8_t *tx_bufs;
+                    unsigned *tx_free;  // stack of free slots
+                    unsigned tx_free_n;
+                    unsigned tx_errors; // failed sends not yet taken by rtp_uring_send_errors()
+                         int tx_errno;  // error of the last failed send
+
+               rtp_socket_t notify;
+};
+
+static inline unsigned _load_acquire(unsigned *p) {
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static inline void _store_release(unsigned *p, unsigned v) {
+    __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+
+static int _setup(unsigned entries, struct io_uring_params *p) {
+    return (int) syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int _enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int _register(int fd, unsigned opcode, void *arg, unsigned nr_args) {
+    return (int) syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static unsigned _pow2(unsigned v) {
+    unsigned p = 1;
+    while (p < v)
+        p <<= 1;
+    return p;
+}
+
+static int _map_rings(rtp_uring_t *ring, struct io_uring_params *p) {
+    ring->sq_len = p->sq_off.array + p->sq_entries * sizeof(unsigned);
+    ring->cq_len = p->cq_off.cqes + p->cq_entries * sizeof(struct io_uring_cqe);
+
+    if (p->features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_len > ring->sq_len)
+            ring->sq_len = ring->cq_len;
+        ring->cq_len = 0;
+    }
+
+    ring->sq_ptr = mmap(NULL, ring->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ptr == MAP_FAILED) {
+        ring->sq_ptr = NULL;
+        return RTP_ERROR;
+    }
+
+    if (ring->cq_len) {
+        ring->cq_ptr = mmap(NULL, ring->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ptr == MAP_FAILED) {
+            ring->cq_ptr = NULL;
+            return RTP_ERROR;
+        }
+    } else {
+        ring->cq_ptr = ring->sq_ptr;
+    }
+
+    ring->sqes_len = p->sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        return RTP_ERROR;
+    }
+
+    uint8_t *sq = ring->sq_ptr, *cq = ring->cq_ptr;
+    ring->sq_head = (unsigned*) (sq + p->sq_off.head);
+    ring->sq_tail = (unsigned*) (sq + p->sq_off.tail);
+    ring->sq_flags = (unsigned*) (sq + p->sq_off.flags);
+    ring->sq_array = (unsigned*) (sq + p->sq_off.array);
+    ring->sq_mask = *(unsigned*) (sq + p->sq_off.ring_mask);
+    ring->sq_entries = p->sq_entries;
+    ring->sq_local_tail = *ring->sq_tail;
+
+    ring->cq_head = (unsigned*) (cq + p->cq_off.head);
+    ring->cq_tail = (unsigned*) (cq + p->cq_off.tail);
+    ring->cq_mask = *(unsigned*) (cq + p->cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*) (cq + p->cq_off.cqes);
+
+    return RTP_OK;
+}
+
+static int _setup_buffers(rtp_uring_t *ring) {
+    unsigned idx;
+
+    // rx: provided buffer ring, the kernel picks a buffer per received datagram
+    ring->br_len = ring->buf_count * sizeof(struct io_uring_buf);
+    ring->br = mmap(NULL, ring->br_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring->br == MAP_FAILED) {
+        ring->br = NULL;
+        return RTP_ERROR;
+    }
+
+    ring->rx_stride = ring->buf_size + sizeof(struct io_uring_recvmsg_out) + RTP_SOCKET_RX_CMSG_SPACE;
+    ring->rx_bufs = malloc((size_t) ring->buf_count * ring->rx_stride);
+    ring->tx_bufs = malloc((size_t) ring->buf_count * ring->buf_size);
+    ring->tx_free = malloc(ring->buf_count * sizeof(unsigned));
+    if (!ring->rx_bufs || !ring->tx_bufs || !ring->tx_free)
+        return RTP_ERROR;
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t) (uintptr_t) ring->br;
+    reg.ring_entries = ring->buf_count;
+    reg.bgid = RTP_URING_BGID;
+    if (_register(ring->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+        return RTP_ERROR;
+
+    for (idx = 0; idx < ring->buf_count; idx++) {
+        struct io_uring_buf *buf = &ring->br->bufs[idx];
+        buf->addr = (uint64_t) (uintptr_t) (ring->rx_bufs + (size_t) idx * ring->rx_stride);
+        buf->len = ring->rx_stride;
+        buf->bid = idx;
+    }
+    __atomic_store_n(&ring->br->tail, (uint16_t) ring->buf_count, __ATOMIC_RELEASE);
+
+    // tx: registered buffers, pinned once instead of per send
+    struct iovec *iov = malloc(ring->buf_count * sizeof(struct iovec));
+    if (!iov)
+        return RTP_ERROR;
+    for (idx = 0; idx < ring->buf_count; idx++) {
+        iov[idx].iov_base = ring->tx_bufs + (size_t) idx * ring->buf_size;
+        iov[idx].iov_len = ring->buf_size;
+        ring->tx_free[idx] = ring->buf_count - 1 - idx;
+    }
+    ring->tx_free_n = ring->buf_count;
+
+    int ret = _register(ring->fd, IORING_REGISTER_BUFFERS, iov, ring->buf_count);
+    free(iov);
+
+    return ret < 0 ? RTP_ERROR : RTP_OK;
+}
+
+static struct io_uring_sqe* _get_sqe(rtp_uring_t *ring) {
+    unsigned head = _load_acquire(ring->sq_head);
+
+    if (ring->sq_local_tail - head >= ring->sq_entries) {
+        // queue full: push what we have
+        if (rtp_uring_submit(ring) < 0)
+            return NULL;
+        head = _load_acquire(ring->sq_head);
+        if (ring->sq_local_tail - head >= ring->sq_entries)
+            return NULL;
+    }
+
+    unsigned idx = ring->sq_local_tail & ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_array[idx] = idx;
+    ring->sq_local_tail++;
+
+    return sqe;
+}
+
+static void _recycle_rx(rtp_uring_t *ring, unsigned bid) {
+    uint16_t tail = ring->br->tail;
+    struct io_uring_buf *buf = &ring->br->bufs[tail & (ring->buf_count - 1)];
+
+    buf->addr = (uint64_t) (uintptr_t) (ring->rx_bufs + (size_t) bid * ring->rx_stride);
+    buf->len = ring->rx_stride;
+    buf->bid = bid;
+    __atomic_store_n(&ring->br->tail, (uint16_t) (tail + 1), __ATOMIC_RELEASE);
+}
+
+static int _arm_rx(rtp_uring_t *ring) {
+    struct io_uring_sqe *sqe = _get_sqe(ring);
+    if (!sqe)
+        return RTP_ERROR;
+
+    // Only the payload, its receive timestamp and the drop count are wanted: no source address
+    memset(&ring->rx_msg, 0, sizeof(ring->rx_msg));
+    ring->rx_msg.msg_controllen = RTP_SOCKET_RX_CMSG_SPACE;
+
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = ring->rx_sock->fd;
+    sqe->addr = (uint64_t) (uintptr_t) &ring->rx_msg;
+    sqe->len = 1;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = RTP_URING_BGID;
+    sqe->user_data = RTP_URING_RX;
+    ring->rx_armed = true;
+
+    return RTP_OK;
+}
+
+rtp_uring_t* rtp_uring_create(unsigned int entries, unsigned int buffers, unsigned int buffer_size, uint32_t flags) {
+    struct io_uring_params p;
+    rtp_uring_t *ring = (rtp_uring_t*) malloc(sizeof(rtp_uring_t));
+    if (!ring)
+        return NULL;
+
+    memset(ring, 0, sizeof(rtp_uring_t));
+    ring->flags = flags;
+    ring->buf_count = _pow2(buffers < 2 ? 2 : buffers);
+    ring->buf_size = buffer_size;
+
+    memset(&p, 0, sizeof(p));
+    if (flags & RTP_URING_SQPOLL) {
+        p.flags |= IORING_SETUP_SQPOLL;
+        p.sq_thread_idle = RTP_URING_SQ_IDLE;
+    }
+
+    // Room for the completions of every buffer plus the multishot receive
+    p.flags |= IORING_SETUP_CQSIZE;
+    p.cq_entries = _pow2(2 * ring->buf_count + entries);
+
+    ring->fd = _setup(entries, &p);
+    if (ring->fd < 0 && (flags & RTP_URING_SQPOLL)) {
+        // sq polling may need privileges: degrade to a plain ring
+        p.flags &= ~IORING_SETUP_SQPOLL;
+        ring->flags &= ~RTP_URING_SQPOLL;
+        ring->fd = _setup(entries, &p);
+    }
+    ring->notify.fd = ring->fd;
+
+    if (ring->fd < 0 || _map_rings(ring, &p) != RTP_OK || _setup_buffers(ring) != RTP_OK) {
+        rtp_uring_free(ring);
+        return NULL;
+    }
+
+    return ring;
+}
+
+void rtp_uring_free(rtp_uring_t *ring) {
+    assert(ring != NULL);
+
+    // Closing the ring cancels the pending operations
+    if (ring->sqes)
+        munmap(ring->sqes, ring->sqes_len);
+    if (ring->cq_ptr && ring->cq_ptr != ring->sq_ptr)
+        munmap(ring->cq_ptr, ring->cq_len);
+    if (ring->sq_ptr)
+        munmap(ring->sq_ptr, ring->sq_len);
+    if (ring->fd >= 0)
+        close(ring->fd);
+    if (ring->br)
+        munmap(ring->br, ring->br_len);
+
+    free(ring->rx_bufs);
+    free(ring->tx_bufs);
+    free(ring->tx_free);
+    free(ring);
+}
+
+rtp_socket_t* rtp_uring_notify(rtp_uring_t *ring) {
+    return &ring->notify;
+}
+
+int rtp_uring_recv_start(rtp_uring_t *ring, rtp_socket_t *sock) {
+    if (ring->rx_sock == sock && ring->rx_armed)
+        return RTP_OK;
+
+    ring->rx_sock = sock;
+
+    if (_arm_rx(ring) != RTP_OK)
+        return RTP_ERROR;
+
+    return rtp_uring_submit(ring) < 0 ? RTP_ERROR : RTP_OK;
+}
+
+int rtp_uring_poll(rtp_uring_t *ring, rtp_uring_recv_cb cb, void *arg, bool wait) {
+    unsigned head = *ring->cq_head;
+    unsigned tail = _load_acquire(ring->cq_tail);
+    int received = 0;
+
+    if (head == tail && wait) {
+        unsigned to_submit = 0, flags = IORING_ENTER_GETEVENTS;
+        _store_release(ring->sq_tail, ring->sq_local_tail);
+        if (!(ring->flags & RTP_URING_SQPOLL)) {
+            to_submit = ring->sq_local_tail - _load_acquire(ring->sq_head);
+        } else {
+            // Queued entries would wait for the poller until it wakes up by itself
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+            if (_load_acquire(ring->sq_flags) & IORING_SQ_NEED_WAKEUP)
+                flags |= IORING_ENTER_SQ_WAKEUP;
+        }
+        if (_enter(ring->fd, to_submit, 1, flags) < 0 && errno != EINTR)
+            return RTP_ERROR;
+        tail = _load_acquire(ring->cq_tail);
+    }
+
+    for (; head != tail; head++) {
+        struct io_uring_cqe *cqe = &ring->cqes[head & ring->cq_mask];
+
+        if (cqe->user_data & RTP_URING_TX) {
+            // Only the first completion of a send carries its result, the notification has 0
+            if (cqe->res < 0) {
+                ring->tx_errors++;
+                ring->tx_errno = -cqe->res;
+            }
+            // Zero copy sends post a second (notification) completion once the buffer is released
+            if (!(cqe->flags & IORING_CQE_F_MORE))
+                ring->tx_free[ring->tx_free_n++] = (unsigned) (cqe->user_data & 0xffffffffU);
+            continue;
+        }
+
+        if (!(cqe->flags & IORING_CQE_F_MORE))
+            ring->rx_armed = false;
+
+        if (cqe->res < 0) {
+            // ENOBUFS: every buffer was in use, re-armed below once recycled
+            if (cqe->res != -ENOBUFS) {
+                _store_release(ring->cq_head, head + 1);
+                return RTP_ERROR;
+            }
+            continue;
+        }
+
+        if (!(cqe->flags & IORING_CQE_F_BUFFER))
+            continue;
+
+        unsigned bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+        uint8_t *buf = ring->rx_bufs + (size_t) bid * ring->rx_stride;
+        struct io_uring_recvmsg_out *out = (struct io_uring_recvmsg_out*) buf;
+        // The name and control areas take the room asked for in rx_msg, whatever the kernel filled in
+        unsigned offset = sizeof(*out) + ring->rx_msg.msg_namelen + ring->rx_msg.msg_controllen;
+
+        if (cb && (unsigned) cqe->res >= offset && !(out->flags & MSG_TRUNC)) {
+            struct msghdr msg = { .msg_control = buf + sizeof(*out) + ring->rx_msg.msg_namelen, .msg_controllen = out->controllen };
+            rtp_socket_rx_cmsg(ring->rx_sock, &msg);
+            cb(buf + offset, (unsigned) cqe->res - offset, arg);
+            received++;
+        }
+
+        _recycle_rx(ring, bid);
+    }
+    _store_release(ring->cq_head, head);
+
+    if (ring->rx_sock && !ring->rx_armed) {
+        if (_arm_rx(ring) != RTP_OK || rtp_uring_submit(ring) < 0)
+            return RTP_ERROR;
+    }
+
+    return received;
+}
+
+uint64_t rtp_uring_rx_tstamp(rtp_uring_t *ring) {
+    return ring->rx_sock != NULL ? ring->rx_sock->rx_tstamp : 0;
+}
+
+uint8_t* rtp_uring_send_buffer(rtp_uring_t *ring, unsigned int *slot) {
+    if (ring->tx_free_n == 0) {
+        // Pick up finished sends; received datagrams are not expected on a tx ring
+        if (rtp_uring_poll(ring, NULL, NULL, false) < 0 || ring->tx_free_n == 0)
+            return NULL;
+    }
+
+    *slot = ring->tx_free[--ring->tx_free_n];
+
+    return ring->tx_bufs + (size_t) *slot * ring->buf_size;
+}
+
+int rtp_uring_send(rtp_uring_t *ring, rtp_socket_t *sock, unsigned int slot, unsigned int len) {
+    struct io_uring_sqe *sqe = _get_sqe(ring);
+    if (!sqe) {
+        ring->tx_free[ring->tx_free_n++] = slot;
+        return RTP_ERROR;
+    }
+
+    sqe->opcode = IORING_OP_SEND_ZC;
+    sqe->fd = sock->fd;
+    sqe->addr = (uint64_t) (uintptr_t) (ring->tx_bufs + (size_t) slot * ring->buf_size);
+    sqe->len = len;
+    sqe->ioprio = IORING_RECVSEND_FIXED_BUF;
+    sqe->buf_index = slot;
+    sqe->addr2 = (uint64_t) (uintptr_t) &sock->dest_addr;
+    sqe->addr_len = sock->dest_addr.ss_family == AF_INET6 ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in);
+    sqe->user_data = RTP_URING_TX | slot;
+
+    return RTP_OK;
+}
+
+void rtp_uring_send_release(rtp_uring_t *ring, unsigned int slot) {
+    ring->tx_free[ring->tx_free_n++] = slot;
+}
+
+unsigned int rtp_uring_send_errors(rtp_uring_t *ring) {
+    unsigned int errors = ring->tx_errors;
+
+    if (errors > 0)
+        errno = ring->tx_errno;
+    ring->tx_errors = 0;
+
+    return errors;
+}
+
+int rtp_uring_submit(rtp_uring_t *ring) {
+    unsigned to_submit = ring->sq_local_tail - _load_acquire(ring->sq_head);
+
+    if (to_submit == 0)
+        return 0;
+
+    _store_release(ring->sq_tail, ring->sq_local_tail);
+
+    if (ring->flags & RTP_URING_SQPOLL) {
+        // The poller sees the new tail by itself unless it went idle
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (_load_acquire(ring->sq_flags) & IORING_SQ_NEED_WAKEUP) {
+            if (_enter(ring->fd, 0, 0, IORING_ENTER_SQ_WAKEUP) < 0)
+                return RTP_ERROR;
+        }
+        return to_submit;
+    }
+
+    int ret = _enter(ring->fd, to_submit, 0, 0);
+
+    return ret < 0 ? RTP_ERROR : ret;
+}
+
+#else // HAVE_LINUX_IO_URING_H
+
+rtp_uring_t* rtp_uring_create(unsigned int entries, unsigned int buffers, unsigned int buffer_size, uint32_t flags) {
+    return NULL;
+}
+
+void rtp_uring_free(rtp_uring_t *ring) {
+}
+
+rtp_socket_t* rtp_uring_notify(rtp_uring_t *ring) {
+    return NULL;
+}
+
+int rtp_uring_recv_start(rtp_uring_t *ring, rtp_socket_t *sock) {
+    return RTP_ERROR;
+}
+
+int rtp_uring_poll(rtp_uring_t *ring, rtp_uring_recv_cb cb, void *arg, bool wait) {
+    return RTP_ERROR;
+}
+
+uint64_t rtp_uring_rx_tstamp(rtp_uring_t *ring) {
+    return 0;
+}
+
+uint8_t* rtp_uring_send_buffer(rtp_uring_t *ring, unsigned int *slot) {
+    return NULL;
+}
+
+int rtp_uring_send(rtp_uring_t *ring, rtp_socket_t *sock, unsigned int slot, unsigned int len) {
+    return RTP_ERROR;
+}
+
+void rtp_uring_send_release(rtp_uring_t *ring, unsigned int slot) {
+}
+
+unsigned int rtp_uring_send_errors(rtp_uring_t *ring) {
+    return 0;
+}
+
+int rtp_uring_submit(rtp_uring_t *ring) {
+    return RTP_ERROR;
+}
+
+#endif // HAVE_LINUX_IO_URING_H
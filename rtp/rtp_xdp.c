@@ -0,0 +1,644 @@
+/*
+ * Copyright 2023 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/rtp-sdr *
+ *
+ * This is based on other projects:
+ *      IDEA: https://github.com/OpenResearchInstitute/ka9q-sdr (not use any code of this)
+ *       RTP: https://github.com/Daxbot/librtp/
+ *       FEC: https://github.com/wesen/poc
+ *    SOCKET: https://github.com/njh/mast
+ *    OTHERS: see individual files
+ *
+ *    please contact their authors for more information.
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include "config.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <assert.h>
+
+#include "rtp_util.h"
+#include "rtp_xdp.h"
+
+#ifdef HAVE_LINUX_IF_XDP_H
+
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/if_xdp.h>
+#include <linux/if_link.h>
+#include <linux/bpf.h>
+
+#ifndef AF_XDP
+#define AF_XDP 44
+#endif
+#ifndef SOL_XDP
+#define SOL_XDP 283
+#endif
+
+/**
+ * @brief Fill / rx / tx / completion ring entries.
+ * @private
+ */
+#define RTP_XDP_RING_SIZE (2048)
+
+typedef struct {
+    uint32_t *producer;
+    uint32_t *consumer;
+    uint32_t *flags;
+        void *desc;
+    uint32_t mask;
+    uint32_t size;
+    uint32_t local; // producer (fill, tx) or consumer (rx, completion) index owned by us
+        void *map;
+      size_t map_len;
+} _xdp_ring_t;
+
+struct rtp_xdp_s {
+             int fd;
+             int map_fd;
+             int prog_fd;
+             int link_fd;
+    unsigned int if_index;
+        uint32_t queue;
+        uint16_t port;
+
+         uint8_t *umem;
+          size_t umem_len;
+        uint32_t frames;
+        uint32_t frame_size;
+
+     _xdp_ring_t fill;
+     _xdp_ring_t comp;
+     _xdp_ring_t rx;
+     _xdp_ring_t tx;
+
+        uint64_t *tx_free; // stack of free tx frame addresses
+        uint32_t tx_free_n;
+        uint32_t tx_outstanding;
+
+    // transmit headers
+         uint8_t src_mac[6];
+         uint8_t dst_mac[6];
+        uint32_t src_ip;   // network order
+        uint32_t dst_ip;   // network order
+        uint16_t dst_port; // network order
+        uint16_t ip_id;
+
+    rtp_socket_t notify;
+};
+
+static inline uint32_t _load_acquire(uint32_t *p) {
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static inline void _store_release(uint32_t *p, uint32_t v) {
+    __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+
+static int _bpf(int cmd, union bpf_attr *attr) {
+    return (int) syscall(__NR_bpf, cmd, attr, sizeof(*attr));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// steering program
+
+#define _INSN(c, d, s, o, i) ((struct bpf_insn) { .code = (c), .dst_reg = (d), .src_reg = (s), .off = (o), .imm = (i) })
+
+#define _LDX_W(d, s, o)   _INSN(BPF_LDX | BPF_MEM | BPF_W, d, s, o, 0)
+#define _LDX_H(d, s, o)   _INSN(BPF_LDX | BPF_MEM | BPF_H, d, s, o, 0)
+#define _LDX_B(d, s, o)   _INSN(BPF_LDX | BPF_MEM | BPF_B, d, s, o, 0)
+#define _MOV_X(d, s)      _INSN(BPF_ALU64 | BPF_MOV | BPF_X, d, s, 0, 0)
+#define _MOV_K(d, i)      _INSN(BPF_ALU64 | BPF_MOV | BPF_K, d, 0, 0, i)
+#define _ADD_K(d, i)      _INSN(BPF_ALU64 | BPF_ADD | BPF_K, d, 0, 0, i)
+#define _AND_K(d, i)      _INSN(BPF_ALU64 | BPF_AND | BPF_K, d, 0, 0, i)
+#define _JGT_X(d, s, o)   _INSN(BPF_JMP | BPF_JGT | BPF_X, d, s, o, 0)
+#define _JNE_K(d, i, o)   _INSN(BPF_JMP | BPF_JNE | BPF_K, d, 0, o, i)
+#define _JSET_K(d, i, o)  _INSN(BPF_JMP | BPF_JSET | BPF_K, d, 0, o, i)
+#define _CALL(f)          _INSN(BPF_JMP | BPF_CALL, 0, 0, 0, f)
+#define _EXIT()           _INSN(BPF_JMP | BPF_EXIT, 0, 0, 0, 0)
+#define _LD_MAP_FD(d, fd) _INSN(BPF_LD | BPF_DW | BPF_IMM, d, BPF_PSEUDO_MAP_FD, 0, fd), _INSN(0, 0, 0, 0, 0)
+
+// Redirect IPv4/UDP (no options, not fragmented) to port into the xsk of the rx queue, pass the rest.
+// Packet halfwords are loaded in network order, hence the htons() of the constants.
+static int _load_program(rtp_xdp_t *xdp) {
+    struct bpf_insn prog[] = {
+        _MOV_X(6, 1),                            // r6 = ctx
+        _LDX_W(2, 6, 0),                         // r2 = data
+        _LDX_W(3, 6, 4),                         // r3 = data_end
+        _MOV_X(4, 2),
+        _ADD_K(4, RTP_XDP_HEADERS),
+        _JGT_X(4, 3, 16),                        // headers out of bounds: pass
+        _LDX_H(5, 2, 12),
+        _JNE_K(5, htons(0x0800), 14),            // not IPv4: pass
+        _LDX_B(5, 2, 14),
+        _JNE_K(5, 0x45, 12),                     // IP options: pass
+        _LDX_B(5, 2, 23),
+        _JNE_K(5, IPPROTO_UDP, 10),               // not UDP: pass
+        _LDX_H(5, 2, 20),
+        _JSET_K(5, htons(0x3fff), 8),            // fragment: pass
+        _LDX_H(5, 2, 36),
+        _JNE_K(5, htons(xdp->port), 6),          // other port: pass
+        _LDX_W(2, 6, 16),                        // r2 = rx_queue_index
+        _LD_MAP_FD(1, xdp->map_fd),
+        _MOV_K(3, XDP_PASS),                     // no socket on this queue: pass
+        _CALL(BPF_FUNC_redirect_map),
+        _EXIT(),
+        _MOV_K(0, XDP_PASS),
+        _EXIT(),
+    };
+    union bpf_attr attr;
+    char license[] = "Dual MIT/GPL";
+
+    memset(&attr, 0, sizeof(attr));
+    attr.map_type = BPF_MAP_TYPE_XSKMAP;
+    attr.key_size = sizeof(uint32_t);
+    attr.value_size = sizeof(uint32_t);
+    attr.max_entries = xdp->queue + 1;
+    xdp->map_fd = _bpf(BPF_MAP_CREATE, &attr);
+    if (xdp->map_fd < 0) {
+        rtp_socket_warn("XSKMAP create failed: %s", strerror(errno));
+        return RTP_ERROR;
+    }
+
+    // the map fd is only known now
+    prog[17].imm = xdp->map_fd;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.prog_type = BPF_PROG_TYPE_XDP;
+    attr.insns = (uint64_t) (uintptr_t) prog;
+    attr.insn_cnt = sizeof(prog) / sizeof(prog[0]);
+    attr.license = (uint64_t) (uintptr_t) license;
+    xdp->prog_fd = _bpf(BPF_PROG_LOAD, &attr);
+    if (xdp->prog_fd < 0) {
+        rtp_socket_warn("XDP program load failed: %s", strerror(errno));
+        return RTP_ERROR;
+    }
+
+    return RTP_OK;
+}
+
+static int _attach_program(rtp_xdp_t *xdp, uint32_t flags) {
+    union bpf_attr attr;
+    uint32_t key = xdp->queue, value = xdp->fd;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.map_fd = xdp->map_fd;
+    attr.key = (uint64_t) (uintptr_t) &key;
+    attr.value = (uint64_t) (uintptr_t) &value;
+    if (_bpf(BPF_MAP_UPDATE_ELEM, &attr) < 0) {
+        rtp_socket_warn("XSKMAP update failed: %s", strerror(errno));
+        return RTP_ERROR;
+    }
+
+    // The link detaches the program when its fd is closed, even if the process dies
+    memset(&attr, 0, sizeof(attr));
+    attr.link_create.prog_fd = xdp->prog_fd;
+    attr.link_create.target_ifindex = xdp->if_index;
+    attr.link_create.attach_type = BPF_XDP;
+    attr.link_create.flags = (flags & RTP_XDP_SKB_MODE) ? XDP_FLAGS_SKB_MODE : (flags & RTP_XDP_DRV_MODE) ? XDP_FLAGS_DRV_MODE : 0;
+    xdp->link_fd = _bpf(BPF_LINK_CREATE, &attr);
+    if (xdp->link_fd < 0) {
+        rtp_socket_warn("XDP attach failed: %s", strerror(errno));
+        return RTP_ERROR;
+    }
+
+    return RTP_OK;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// rings
+
+static int _map_ring(rtp_xdp_t *xdp, _xdp_ring_t *ring, struct xdp_ring_offset *off, size_t desc_size, off_t pgoff) {
+    ring->map_len = off->desc + RTP_XDP_RING_SIZE * desc_size;
+    ring->map = mmap(NULL, ring->map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, xdp->fd, pgoff);
+    if (ring->map == MAP_FAILED) {
+        ring->map = NULL;
+        return RTP_ERROR;
+    }
+
+    ring->producer = (uint32_t*) ((uint8_t*) ring->map + off->producer);
+    ring->consumer = (uint32_t*) ((uint8_t*) ring->map + off->consumer);
+    ring->flags = (uint32_t*) ((uint8_t*) ring->map + off->flags);
+    ring->desc = (uint8_t*) ring->map + off->desc;
+    ring->size = RTP_XDP_RING_SIZE;
+    ring->mask = RTP_XDP_RING_SIZE - 1;
+
+    return RTP_OK;
+}
+
+static int _setup_socket(rtp_xdp_t *xdp, uint32_t flags) {
+    struct xdp_umem_reg reg;
+    struct xdp_mmap_offsets off;
+    socklen_t optlen = sizeof(off);
+    int size = RTP_XDP_RING_SIZE;
+    uint32_t idx;
+
+    xdp->fd = socket(AF_XDP, SOCK_RAW | SOCK_CLOEXEC, 0);
+    if (xdp->fd < 0) {
+        rtp_socket_warn("AF_XDP socket failed: %s", strerror(errno));
+        return RTP_ERROR;
+    }
+    xdp->notify.fd = xdp->fd;
+
+    xdp->umem_len = (size_t) xdp->frames * xdp->frame_size;
+    xdp->umem = mmap(NULL, xdp->umem_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (xdp->umem == MAP_FAILED) {
+        xdp->umem = NULL;
+        return RTP_ERROR;
+    }
+
+    memset(&reg, 0, sizeof(reg));
+    reg.addr = (uint64_t) (uintptr_t) xdp->umem;
+    reg.len = xdp->umem_len;
+    reg.chunk_size = xdp->frame_size;
+    if (setsockopt(xdp->fd, SOL_XDP, XDP_UMEM_REG, &reg, sizeof(reg)) < 0) {
+        rtp_socket_warn("XDP_UMEM_REG failed: %s", strerror(errno));
+        return RTP_ERROR;
+    }
+
+    if (setsockopt(xdp->fd, SOL_XDP, XDP_UMEM_FILL_RING, &size, sizeof(size)) < 0
+            || setsockopt(xdp->fd, SOL_XDP, XDP_UMEM_COMPLETION_RING, &size, sizeof(size)) < 0
+            || setsockopt(xdp->fd, SOL_XDP, XDP_RX_RING, &size, sizeof(size)) < 0
+            || setsockopt(xdp->fd, SOL_XDP, XDP_TX_RING, &size, sizeof(size)) < 0
+            || getsockopt(xdp->fd, SOL_XDP, XDP_MMAP_OFFSETS, &off, &optlen) < 0) {
+        rtp_socket_warn("AF_XDP ring setup failed: %s", strerror(errno));
+        return RTP_ERROR;
+    }
+
+    if (_map_ring(xdp, &xdp->fill, &off.fr, sizeof(uint64_t), XDP_UMEM_PGOFF_FILL_RING) != RTP_OK
+            || _map_ring(xdp, &xdp->comp, &off.cr, sizeof(uint64_t), XDP_UMEM_PGOFF_COMPLETION_RING) != RTP_OK
+            || _map_ring(xdp, &xdp->rx, &off.rx, sizeof(struct xdp_desc), XDP_PGOFF_RX_RING) != RTP_OK
+            || _map_ring(xdp, &xdp->tx, &off.tx, sizeof(struct xdp_desc), XDP_PGOFF_TX_RING) != RTP_OK)
+        return RTP_ERROR;
+
+    // First half of the frames feeds rx, the second half is the tx pool
+    uint32_t rx_frames = xdp->frames / 2;
+    if (rx_frames > RTP_XDP_RING_SIZE)
+        rx_frames = RTP_XDP_RING_SIZE;
+    for (idx = 0; idx < rx_frames; idx++)
+        ((uint64_t*) xdp->fill.desc)[idx & xdp->fill.mask] = (uint64_t) idx * xdp->frame_size;
+    xdp->fill.local = rx_frames;
+    _store_release(xdp->fill.producer, xdp->fill.local);
+
+    xdp->tx_free = malloc((xdp->frames - rx_frames) * sizeof(uint64_t));
+    if (!xdp->tx_free)
+        return RTP_ERROR;
+    for (idx = xdp->frames; idx > rx_frames; idx--)
+        xdp->tx_free[xdp->tx_free_n++] = (uint64_t) (idx - 1) * xdp->frame_size;
+
+    struct sockaddr_xdp sxdp;
+    memset(&sxdp, 0, sizeof(sxdp));
+    sxdp.sxdp_family = AF_XDP;
+    sxdp.sxdp_ifindex = xdp->if_index;
+    sxdp.sxdp_queue_id = xdp->queue;
+    sxdp.sxdp_flags = XDP_USE_NEED_WAKEUP | ((flags & RTP_XDP_ZEROCOPY) ? XDP_ZEROCOPY : (flags & RTP_XDP_SKB_MODE) ? XDP_COPY : 0);
+    if (bind(xdp->fd, (struct sockaddr*) &sxdp, sizeof(sxdp)) < 0) {
+        rtp_socket_warn("AF_XDP bind failed: %s", strerror(errno));
+        return RTP_ERROR;
+    }
+
+    return RTP_OK;
+}
+
+static void _unmap_ring(_xdp_ring_t *ring) {
+    if (ring->map)
+        munmap(ring->map, ring->map_len);
+}
+
+// Ones' complement checksum of the IPv4 header.
+static uint16_t _ip_checksum(const uint8_t *hdr) {
+    uint32_t sum = 0;
+    int idx;
+
+    for (idx = 0; idx < 20; idx += 2)
+        sum += (hdr[idx] << 8) | hdr[idx + 1];
+    while (sum >> 16)
+        sum = (sum & 0xffff) + (sum >> 16);
+
+    return ~sum & 0xffff;
+}
+
+// Next hop hardware address of an IPv4 destination from the neighbour table.
+static int _lookup_neighbour(uint32_t ip, unsigned int if_index, uint8_t *mac) {
+    char line[256], ifname[IF_NAMESIZE], ip_str[64], hw[64], dev[IF_NAMESIZE + 1];
+    unsigned int type, flags, m[6];
+    int found = RTP_ERROR;
+
+    FILE *arp = fopen("/proc/net/arp", "r");
+    if (!arp)
+        return RTP_ERROR;
+
+    if_indextoname(if_index, ifname);
+    while (fgets(line, sizeof(line), arp)) {
+        struct in_addr addr;
+        if (sscanf(line, "%63s 0x%x 0x%x %63s %*s %16s", ip_str, &type, &flags, hw, dev) != 5)
+            continue;
+        if (inet_pton(AF_INET, ip_str, &addr) != 1 || addr.s_addr != ip || strcmp(dev, ifname) != 0 || !(flags & 0x2))
+            continue;
+        if (sscanf(hw, "%x:%x:%x:%x:%x:%x", &m[0], &m[1], &m[2], &m[3], &m[4], &m[5]) == 6) {
+            int n;
+            for (n = 0; n < 6; n++)
+                mac[n] = m[n];
+            found = RTP_OK;
+        }
+        break;
+    }
+    fclose(arp);
+
+    return found;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+rtp_xdp_t* rtp_xdp_create(const char *ifname, uint32_t queue, uint16_t port, uint32_t frames, uint32_t frame_size, uint32_t flags) {
+    rtp_xdp_t *xdp = (rtp_xdp_t*) malloc(sizeof(rtp_xdp_t));
+    if (!xdp)
+        return NULL;
+
+    memset(xdp, 0, sizeof(rtp_xdp_t));
+    xdp->fd = xdp->map_fd = xdp->prog_fd = xdp->link_fd = -1;
+    xdp->queue = queue;
+    xdp->port = port;
+    xdp->frames = frames ? frames : RTP_XDP_FRAMES;
+    xdp->frame_size = frame_size ? frame_size : RTP_XDP_FRAME_SIZE;
+
+    xdp->if_index = if_nametoindex(ifname);
+    if (xdp->if_index == 0) {
+        rtp_socket_warn("Network interface not found: %s", ifname);
+        free(xdp);
+        return NULL;
+    }
+
+    // Source hardware address for the transmit headers
+    struct ifreq ifr;
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
+    if (fd >= 0 && ioctl(fd, SIOCGIFHWADDR, &ifr) == 0)
+        memcpy(xdp->src_mac, ifr.ifr_hwaddr.sa_data, 6);
+    if (fd >= 0)
+        close(fd);
+
+    if (_setup_socket(xdp, flags) != RTP_OK || _load_program(xdp) != RTP_OK || _attach_program(xdp, flags) != RTP_OK) {
+        rtp_xdp_free(xdp);
+        return NULL;
+    }
+
+    return xdp;
+}
+
+void rtp_xdp_free(rtp_xdp_t *xdp) {
+    assert(xdp != NULL);
+
+    if (xdp->link_fd >= 0)
+        close(xdp->link_fd);
+    if (xdp->prog_fd >= 0)
+        close(xdp->prog_fd);
+    if (xdp->map_fd >= 0)
+        close(xdp->map_fd);
+
+    _unmap_ring(&xdp->fill);
+    _unmap_ring(&xdp->comp);
+    _unmap_ring(&xdp->rx);
+    _unmap_ring(&xdp->tx);
+    if (xdp->fd >= 0)
+        close(xdp->fd);
+    if (xdp->umem)
+        munmap(xdp->umem, xdp->umem_len);
+
+    free(xdp->tx_free);
+    free(xdp);
+}
+
+rtp_socket_t* rtp_xdp_notify(rtp_xdp_t *xdp) {
+    return &xdp->notify;
+}
+
+unsigned int rtp_xdp_max_payload(rtp_xdp_t *xdp) {
+    // The kernel keeps XDP_PACKET_HEADROOM in front of every received frame
+    return xdp->frame_size - XDP_PACKET_HEADROOM - RTP_XDP_HEADERS;
+}
+
+int rtp_xdp_set_dest(rtp_xdp_t *xdp, rtp_socket_t *sock, const uint8_t *mac) {
+    struct sockaddr_in *dst = (struct sockaddr_in*) &sock->dest_addr;
+    struct sockaddr_in *src = (struct sockaddr_in*) &sock->src_addr;
+
+    if (sock->dest_addr.ss_family != AF_INET) {
+        rtp_socket_warn("AF_XDP transmit supports IPv4 only");
+        return RTP_ERROR;
+    }
+
+    xdp->dst_ip = dst->sin_addr.s_addr;
+    xdp->dst_port = dst->sin_port;
+    xdp->src_ip = sock->src_addr.ss_family == AF_INET ? src->sin_addr.s_addr : 0;
+
+    if (mac != NULL) {
+        memcpy(xdp->dst_mac, mac, 6);
+    } else if (IN_MULTICAST(ntohl(xdp->dst_ip))) {
+        uint32_t group = ntohl(xdp->dst_ip);
+        uint8_t mcast[6] = { 0x01, 0x00, 0x5e, (group >> 16) & 0x7f, (group >> 8) & 0xff, group & 0xff };
+        memcpy(xdp->dst_mac, mcast, 6);
+    } else if (_lookup_neighbour(xdp->dst_ip, xdp->if_index, xdp->dst_mac) != RTP_OK) {
+        rtp_socket_warn("No neighbour entry for the destination, send a packet through the kernel first");
+        return RTP_ERROR;
+    }
+
+    return RTP_OK;
+}
+
+int rtp_xdp_recv(rtp_xdp_t *xdp, rtp_xdp_recv_cb cb, void *arg, bool wait) {
+    uint32_t prod = _load_acquire(xdp->rx.producer);
+    int received = 0;
+
+    if (prod == xdp->rx.local && wait) {
+        struct pollfd pfd = { .fd = xdp->fd, .events = POLLIN };
+        if (poll(&pfd, 1, -1) < 0 && errno != EINTR)
+            return RTP_ERROR;
+        prod = _load_acquire(xdp->rx.producer);
+    }
+
+    for (; xdp->rx.local != prod; xdp->rx.local++) {
+        struct xdp_desc *desc = &((struct xdp_desc*) xdp->rx.desc)[xdp->rx.local & xdp->rx.mask];
+        uint64_t addr = desc->addr;
+        const uint8_t *pkt = xdp->umem + addr;
+
+        // The program only steers IPv4/UDP without options, so the payload is at a fixed offset
+        if (desc->len > RTP_XDP_HEADERS) {
+            unsigned int udp_len = (pkt[38] << 8) | pkt[39];
+            unsigned int len = desc->len - RTP_XDP_HEADERS;
+            if (udp_len >= 8 && udp_len - 8 < len)
+                len = udp_len - 8;
+            cb(pkt + RTP_XDP_HEADERS, len, arg);
+            received++;
+        }
+
+        // Give the frame back to the kernel (the descriptor may point past the headroom)
+        ((uint64_t*) xdp->fill.desc)[xdp->fill.local++ & xdp->fill.mask] = addr - (addr % xdp->frame_size);
+    }
+    _store_release(xdp->rx.consumer, xdp->rx.local);
+    _store_release(xdp->fill.producer, xdp->fill.local);
+
+    if (_load_acquire(xdp->fill.flags) & XDP_RING_NEED_WAKEUP)
+        recvfrom(xdp->fd, NULL, 0, MSG_DONTWAIT, NULL, NULL);
+
+    return received;
+}
+
+uint8_t* rtp_xdp_send_buffer(rtp_xdp_t *xdp, unsigned int *frame, unsigned int *size) {
+    if (xdp->tx_free_n == 0) {
+        // Collect the frames the kernel has finished sending
+        uint32_t prod = _load_acquire(xdp->comp.producer);
+        for (; xdp->comp.local != prod; xdp->comp.local++) {
+            xdp->tx_free[xdp->tx_free_n++] = ((uint64_t*) xdp->comp.desc)[xdp->comp.local & xdp->comp.mask];
+            xdp->tx_outstanding--;
+        }
+        _store_release(xdp->comp.consumer, xdp->comp.local);
+
+        if (xdp->tx_free_n == 0) {
+            rtp_xdp_submit(xdp);
+            return NULL;
+        }
+    }
+
+    uint64_t addr = xdp->tx_free[--xdp->tx_free_n];
+    *frame = addr / xdp->frame_size;
+    *size = xdp->frame_size - RTP_XDP_HEADERS;
+
+    return xdp->umem + addr + RTP_XDP_HEADERS;
+}
+
+int rtp_xdp_send(rtp_xdp_t *xdp, unsigned int frame, unsigned int len) {
+    uint64_t addr = (uint64_t) frame * xdp->frame_size;
+    uint8_t *pkt = xdp->umem + addr;
+
+    if (xdp->tx.local - _load_acquire(xdp->tx.consumer) >= xdp->tx.size) {
+        xdp->tx_free[xdp->tx_free_n++] = addr;
+        return RTP_ERROR;
+    }
+
+    // Ethernet
+    memcpy(pkt, xdp->dst_mac, 6);
+    memcpy(pkt + 6, xdp->src_mac, 6);
+    write_u16(pkt + 12, 0x0800);
+
+    // IPv4, don't fragment
+    uint8_t *ip = pkt + 14;
+    ip[0] = 0x45;
+    ip[1] = 0;
+    write_u16(ip + 2, 20 + 8 + len);
+    write_u16(ip + 4, xdp->ip_id++);
+    write_u16(ip + 6, 0x4000);
+    ip[8] = 64;
+    ip[9] = IPPROTO_UDP;
+    write_u16(ip + 10, 0);
+    memcpy(ip + 12, &xdp->src_ip, 4);
+    memcpy(ip + 16, &xdp->dst_ip, 4);
+    write_u16(ip + 10, _ip_checksum(ip));
+
+    // UDP, no checksum
+    uint8_t *udp = ip + 20;
+    write_u16(udp, xdp->port);
+    memcpy(udp + 2, &xdp->dst_port, 2);
+    write_u16(udp + 4, 8 + len);
+    write_u16(udp + 6, 0);
+
+    struct xdp_desc *desc = &((struct xdp_desc*) xdp->tx.desc)[xdp->tx.local++ & xdp->tx.mask];
+    desc->addr = addr;
+    desc->len = RTP_XDP_HEADERS + len;
+    desc->options = 0;
+    xdp->tx_outstanding++;
+
+    return RTP_OK;
+}
+
+void rtp_xdp_send_release(rtp_xdp_t *xdp, unsigned int frame) {
+    xdp->tx_free[xdp->tx_free_n++] = (uint64_t) frame * xdp->frame_size;
+}
+
+int rtp_xdp_submit(rtp_xdp_t *xdp) {
+    uint32_t queued = xdp->tx.local - *xdp->tx.producer;
+
+    _store_release(xdp->tx.producer, xdp->tx.local);
+
+    // Copy mode always needs the kick, native mode only when the driver went idle
+    if (xdp->tx_outstanding && (_load_acquire(xdp->tx.flags) & XDP_RING_NEED_WAKEUP)) {
+        if (sendto(xdp->fd, NULL, 0, MSG_DONTWAIT, NULL, 0) < 0 && errno != EAGAIN && errno != EBUSY && errno != ENOBUFS && errno != ENETDOWN)
+            return RTP_ERROR;
+    }
+
+    return queued;
+}
+
+#else // HAVE_LINUX_IF_XDP_H
+
+rtp_xdp_t* rtp_xdp_create(const char *ifname, uint32_t queue, uint16_t port, uint32_t frames, uint32_t frame_size, uint32_t flags) {
+    return NULL;
+}
+
+void rtp_xdp_free(rtp_xdp_t *xdp) {
+}
+
+rtp_socket_t* rtp_xdp_notify(rtp_xdp_t *xdp) {
+    return NULL;
+}
+
+unsigned int rtp_xdp_max_payload(rtp_xdp_t *xdp) {
+    return 0;
+}
+
+int rtp_xdp_set_dest(rtp_xdp_t *xdp, rtp_socket_t *sock, const uint8_t *mac) {
+    return RTP_ERROR;
+}
+
+int rtp_xdp_recv(rtp_xdp_t *xdp, rtp_xdp_recv_cb cb, void *arg, bool wait) {
+    return RTP_ERROR;
+}
+
+uint8_t* rtp_xdp_send_buffer(rtp_xdp_t *xdp, unsigned int *frame, unsigned int *size) {
+    return NULL;
+}
+
+int rtp_xdp_send(rtp_xdp_t *xdp, unsigned int frame, unsigned int len) {
+    return RTP_ERROR;
+}
+
+void rtp_xdp_send_release(rtp_xdp_t *xdp, unsigned int frame) {
+}
+
+int rtp_xdp_submit(rtp_xdp_t *xdp) {
+    return RTP_ERROR;
+}
+
+#endif // HAVE_LINUX_IF_XDP_H
@@ -0,0 +1,110 @@
+/*
+ * Copyright 2023 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/rtp-sdr *
+ *
+ * This is based on other projects:
+ *      IDEA: https://github.com/OpenResearchInstitute/ka9q-sdr (not use any code of this)
+ *       RTP: https://github.com/Daxbot/librtp/
+ *       FEC: https://github.com/wesen/poc
+ *    SOCKET: https://github.com/njh/mast
+ *    OTHERS: see individual files
+ *
+ *    please contact their authors for more information.
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef RTP_SDR_CAPTURE_H_
+#define RTP_SDR_CAPTURE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "rtp_sdr_iq.h"
+#include "rtp_sdr_rbuf.h"
+
+#define RTP_SDR_CAPTURE_ALIGN          4096 /**< O_DIRECT buffer, offset and length alignment */
+#define RTP_SDR_CAPTURE_CHUNK (8 * 1024 * 1024) /**< default bytes per write (direct) or per mapped window (mmap) */
+#define RTP_SDR_CAPTURE_BLOCK          4096 /**< samples per channel taken from the rings at a time */
+
+/**
+ * @enum RTP_SDR_CAPTURE_MODE
+ * @brief capture file i/o
+ *
+ */
+typedef enum RTP_SDR_CAPTURE_MODE {
+    RTP_SDR_CAPTURE_DIRECT = 0, /**< O_DIRECT writes of whole chunks from two aligned buffers, a writer thread flushes one while the other fills */
+    RTP_SDR_CAPTURE_MMAP   = 1  /**< rolling mapped window of the file: written back asynchronously when full, dropped from the page cache one window later */
+} rtp_sdr_capture_mode_t;       /**< capture file i/o data type */
+
+typedef struct rtp_sdr_capture_s rtp_sdr_capture_t; /**< opaque capture sink */
+
+/**
+ * @fn rtp_sdr_capture_t* rtp_sdr_capture_open(const char *path, rtp_sdr_capture_mode_t mode, iq_type_t type, uint8_t channels, size_t chunk)
+ * @brief Create a capture file. Samples are stored packed as little endian complex integers of the
+ *        i/q type (ci8, ci16_le, ci32_le for 24 and 32 bits), one per channel interleaved for every
+ *        timestamp. When the file system does not support O_DIRECT (e.g. tmpfs) buffered writes are used.
+ *
+ * @param path
+ * @param mode
+ * @param type i/q type of the rings
+ * @param channels rings written together
+ * @param chunk bytes per write or window, rounded up to RTP_SDR_CAPTURE_ALIGN (0: RTP_SDR_CAPTURE_CHUNK)
+ * @return sink or NULL on failure
+ */
+rtp_sdr_capture_t* rtp_sdr_capture_open(const char *path, rtp_sdr_capture_mode_t mode, iq_type_t type, uint8_t channels, size_t chunk);
+
+/**
+ * @fn size_t rtp_sdr_capture_write(rtp_sdr_capture_t *cap, rbuf_handle_t *channel)
+ * @brief Move every sample the rings hold in common to the file, e.g. session rx_iq_channel.
+ *        Blocks only when the disk falls a whole chunk behind.
+ *
+ * @param cap
+ * @param channel one ring per channel
+ * @return samples per channel written
+ */
+size_t rtp_sdr_capture_write(rtp_sdr_capture_t *cap, rbuf_handle_t *channel);
+
+/**
+ * @fn void rtp_sdr_capture_stats(rtp_sdr_capture_t *cap, uint64_t *samples, uint64_t *overruns)
+ * @brief Progress so far, as rtp_sdr_capture_close() reports it.
+ *
+ * @param cap
+ * @param samples samples per channel captured (NULL: not needed)
+ * @param overruns samples the rings overwrote before they could be captured, summed over the channels (NULL: not needed)
+ */
+void rtp_sdr_capture_stats(rtp_sdr_capture_t *cap, uint64_t *samples, uint64_t *overruns);
+
+/**
+ * @fn uint8_t rtp_sdr_capture_close(rtp_sdr_capture_t *cap, uint64_t *samples, uint64_t *overruns)
+ * @brief Flush, trim the file to the samples written and free the sink.
+ *
+ * @param cap
+ * @param samples samples per channel in the file (NULL: not needed)
+ * @param overruns samples the rings overwrote before they could be captured, summed over the channels (NULL: not needed)
+ * @return RTP_SDR_ERROR if a write failed
+ */
+uint8_t rtp_sdr_capture_close(rtp_sdr_capture_t *cap, uint64_t *samples, uint64_t *overruns);
+
+#endif /* RTP_SDR_CAPTURE_H_ */
@@ -0,0 +1,88 @@
+/*
+ * Copyright 2023 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/rtp-sdr *
+ *
+ * This is based on other projects:
+ *      IDEA: https://github.com/OpenResearchInstitute/ka9q-sdr (not use any code of this)
+ *       RTP: https://github.com/Daxbot/librtp/
+ *       FEC: https://github.com/wesen/poc
+ *    SOCKET: https://github.com/njh/mast
+ *    OTHERS: see individual files
+ *
+ *    please contact their authors for more information.
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+#ifndef RTP_SDR_CODEC_H_
+#define RTP_SDR_CODEC_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "rtp_sdr_rbuf.h"
+
+#define RTP_SDR_CODEC_ESCAPE   16 /**< rice quotient from which the residual is sent verbatim */
+#define RTP_SDR_CODEC_HEADER(qty) (2 + 2 * (qty)) /**< payload bytes ahead of the coded samples */
+
+/**
+ * @brief Lossless i/q payload codec, signed 16 bit components.
+ *
+ * A payload codes the samples of one packet and depends on no other packet, so a loss does not
+ * propagate. Every component stream (i and q of each channel) is predicted with the best of a fixed
+ * polynomial predictor of order 0, 1 or 2, its residuals zigzag mapped and rice coded with a
+ * parameter chosen for the packet, or sent verbatim if that is shorter:
+ *
+ *     u16 le   samples per channel
+ *     u8       per stream (channel 0 i, channel 0 q, channel 1 i, ...): order (bits 0-1, 3: verbatim) | k << 2
+ *     bits     per stream: order samples of 16 bits, then a rice code per residual (least significant bit first):
+ *              q = r >> k ones, a zero and the k low bits of r, or RTP_SDR_CODEC_ESCAPE ones and r in 18 bits
+ *
+ * A payload is never longer than RTP_SDR_CODEC_HEADER(qty) plus the samples sent raw.
+ */
+
+/**
+ * @fn size_t rtp_sdr_codec_encode(const iq_t *block, uint32_t samples, uint8_t qty, uint8_t *payload)
+ * @brief Code one packet.
+ *
+ * @param block channel ch sample n is block[ch * samples + n]
+ * @param samples samples per channel, at most UINT16_MAX
+ * @param qty channels
+ * @param payload room for RTP_SDR_CODEC_HEADER(qty) + samples * qty * 4 bytes
+ * @return payload length
+ */
+size_t rtp_sdr_codec_encode(const iq_t *block, uint32_t samples, uint8_t qty, uint8_t *payload);
+
+/**
+ * @fn int rtp_sdr_codec_decode(const uint8_t *payload, size_t len, uint8_t qty, iq_t *block, uint32_t max)
+ * @brief Decode one packet.
+ *
+ * @param payload
+ * @param len payload length
+ * @param qty channels
+ * @param block channel ch sample n is written to block[ch * samples + n]
+ * @param max most samples per channel block holds
+ * @return samples per channel or -1 if the payload is malformed or does not fit
+ */
+int rtp_sdr_codec_decode(const uint8_t *payload, size_t len, uint8_t qty, iq_t *block, uint32_t max);
+
+#endif /* RTP_SDR_CODEC_H_ */
@@ -0,0 +1,193 @@
+/*
+ * Copyright 2023 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/rtp-sdr *
+ *
+ * This is based on other projects:
+ *      IDEA: https://github.com/OpenResearchInstitute/ka9q-sdr (not use any code of this)
+ *       RTP: https://github.com/Daxbot/librtp/
+ *       FEC: https://github.com/wesen/poc
+ *    SOCKET: https://github.com/njh/mast
+ *    OTHERS: see individual files
+ *
+ *    please contact their authors for more information.
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef RTP_SDR_DEMUX_H_
+#define RTP_SDR_DEMUX_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "rtp_socket.h"
+#include "rtp_loop.h"
+#include "rtp_source_table.h"
+#include "rtp_sdr_iq.h"
+
+#define RTP_SDR_DEMUX_TIMEOUT_S 30 /**< seconds without packets before a route is dropped, and a refused ssrc is offered again */
+
+/**
+ * @fn session_iq_t (*rtp_sdr_demux_new_cb)(uint32_t ssrc, uint8_t pt, void *arg)
+ * @brief Called on the first packet of an unrouted ssrc. A refused stream is not offered again
+ *        before RTP_SDR_DEMUX_TIMEOUT_S.
+ *
+ * @param ssrc
+ * @param pt
+ * @param arg
+ * @return session to route the stream to, NULL to drop it
+ */
+typedef session_iq_t (*rtp_sdr_demux_new_cb)(uint32_t ssrc, uint8_t pt, void *arg);
+
+/**
+ * @fn void (*rtp_sdr_demux_release_cb)(uint32_t ssrc, session_iq_t session, void *arg)
+ * @brief Called when the demultiplexer drops a route by itself: the stream timed out or sent a BYE,
+ *        or the session returned by the new stream callback could not be routed (table full).
+ *        The session is no longer referenced and may be freed.
+ *
+ * @param ssrc
+ * @param session
+ * @param arg
+ */
+typedef void (*rtp_sdr_demux_release_cb)(uint32_t ssrc, session_iq_t session, void *arg);
+
+/**
+ * @struct rtp_sdr_demux_s
+ * @brief one rx socket shared by many i/q sessions
+ *
+ */
+typedef struct rtp_sdr_demux_s {
+                rtp_socket_t socket;       /**< shared rx socket */
+          rtp_source_table_t *routes;      /**< ssrc -> session (entry user data) */
+          rtp_source_table_t *rejected;    /**< ssrcs refused by the new stream callback, with the time of the refusal */
+                     uint8_t *buf;         /**< rx (UDP_GRO coalesced) datagram buffer */
+           rtp_loop_source_t *source;      /**< rx socket source of the attached loop */
+           rtp_loop_source_t *timer;       /**< route expiry timer of the attached loop */
+                  rtp_loop_t *loop;        /**< event loop the demultiplexer is attached to (NULL: none) */
+                    uint64_t swept;        /**< last route expiry sweep (ns since the epoch) */
+        rtp_sdr_demux_new_cb new_cb;       /**< unrouted stream callback (NULL: drop) */
+                        void *new_arg;     /**< unrouted stream callback argument */
+    rtp_sdr_demux_release_cb release_cb;   /**< dropped route callback (NULL: none) */
+                        void *release_arg; /**< dropped route callback argument */
+                    uint32_t unrouted;     /**< packets dropped: unknown ssrc or payload type not matching the session */
+                    uint32_t malformed;    /**< packets dropped: not rtp */
+} rtp_sdr_demux_t;                         /**< demultiplexer data type */
+
+/**
+ * @fn rtp_sdr_demux_t* rtp_sdr_demux_create(const char *host, uint16_t port, unsigned int max_streams)
+ * @brief Open the shared rx socket.
+ *
+ * @param host
+ * @param port
+ * @param max_streams most ssrcs routed at the same time
+ * @return demultiplexer or NULL on failure
+ */
+rtp_sdr_demux_t* rtp_sdr_demux_create(const char *host, uint16_t port, unsigned int max_streams);
+
+/**
+ * @fn void rtp_sdr_demux_free(rtp_sdr_demux_t *demux)
+ * @brief Detach from the loop, close the socket and free the demultiplexer. The sessions are not touched.
+ *
+ * @param demux
+ */
+void rtp_sdr_demux_free(rtp_sdr_demux_t *demux);
+
+/**
+ * @fn uint8_t rtp_sdr_demux_add(rtp_sdr_demux_t *demux, uint32_t ssrc, session_iq_t session)
+ * @brief Route a stream to a session. Packets whose payload type is not the session rx_type are dropped.
+ *        The session needs no rx socket of its own.
+ *
+ * @param demux
+ * @param ssrc
+ * @param session
+ * @return
+ */
+uint8_t rtp_sdr_demux_add(rtp_sdr_demux_t *demux, uint32_t ssrc, session_iq_t session);
+
+/**
+ * @fn void rtp_sdr_demux_remove(rtp_sdr_demux_t *demux, uint32_t ssrc)
+ * @brief Stop routing a stream. The release callback is not called.
+ *
+ * @param demux
+ * @param ssrc
+ */
+void rtp_sdr_demux_remove(rtp_sdr_demux_t *demux, uint32_t ssrc);
+
+/**
+ * @fn void rtp_sdr_demux_on_new(rtp_sdr_demux_t *demux, rtp_sdr_demux_new_cb cb, void *arg)
+ * @brief Set the callback that routes streams as they appear.
+ *
+ * @param demux
+ * @param cb
+ * @param arg
+ */
+void rtp_sdr_demux_on_new(rtp_sdr_demux_t *demux, rtp_sdr_demux_new_cb cb, void *arg);
+
+/**
+ * @fn void rtp_sdr_demux_on_release(rtp_sdr_demux_t *demux, rtp_sdr_demux_release_cb cb, void *arg)
+ * @brief Set the callback that hands back the sessions of dropped routes.
+ *
+ * @param demux
+ * @param cb
+ * @param arg
+ */
+void rtp_sdr_demux_on_release(rtp_sdr_demux_t *demux, rtp_sdr_demux_release_cb cb, void *arg);
+
+/**
+ * @fn unsigned int rtp_sdr_demux_expire(rtp_sdr_demux_t *demux)
+ * @brief Drop the routes silent for RTP_SDR_DEMUX_TIMEOUT_S and forget old refusals.
+ *        Runs once a second from the attached loop, and from rtp_sdr_demux_poll().
+ *
+ * @param demux
+ * @return routes dropped
+ */
+unsigned int rtp_sdr_demux_expire(rtp_sdr_demux_t *demux);
+
+/**
+ * @fn int rtp_sdr_demux_poll(rtp_sdr_demux_t *demux)
+ * @brief Dispatch every datagram already queued on the socket without blocking, then expire routes if due.
+ *
+ * @param demux
+ * @return datagrams read or -1 on failure
+ */
+int rtp_sdr_demux_poll(rtp_sdr_demux_t *demux);
+
+/**
+ * @fn uint8_t rtp_sdr_demux_loop_attach(rtp_sdr_demux_t *demux, rtp_loop_t *loop)
+ * @brief Dispatch from an event loop: one wakeup serves every stream on the socket.
+ *
+ * @param demux
+ * @param loop
+ * @return
+ */
+uint8_t rtp_sdr_demux_loop_attach(rtp_sdr_demux_t *demux, rtp_loop_t *loop);
+
+/**
+ * @fn void rtp_sdr_demux_loop_detach(rtp_sdr_demux_t *demux)
+ * @brief Remove the demultiplexer from its event loop.
+ *
+ * @param demux
+ */
+void rtp_sdr_demux_loop_detach(rtp_sdr_demux_t *demux);
+
+#endif /* RTP_SDR_DEMUX_H_ */
@@ -42,7 +42,16 @@
 
 #include "rtp_header.h"
 #include "rtp_socket.h"
+#include "rtp_source.h"
+#include "rtp_clock.h"
+#include "rtp_loop.h"
+#include "rtp_uring.h"
+#include "rtp_xdp.h"
 #include "rtp_sdr_rbuf.h"
+#include "rtp_sdr_resample.h"
+#include "fec.h"
+#include "fec_adapt.h"
+#include "fec_pkt.h"
 
 #define PRINT_SESION(s)                                               \
     printf("\n-------- SESSION --------\n");                          \
@@ -60,10 +69,23 @@
     printf("  tx_port: %d\n",(int)(*(s))->tx_port);                   \
     printf("  rx_port: %d\n",(int)(*(s))->rx_port);                   \
     printf("  host: %s\n",(*(s))->host);                              \
+    printf("  transport: %d\n",(int)(*(s))->transport);               \
     printf("-------------------------\n\n");
 
 #define RTP_PACKET_LENGTH 4096 /**< packet length */
 
+#define RTP_SDR_FEC_K      16 /**< default fec source packets per group */
+#define RTP_SDR_FEC_N_MAX  24 /**< default fec maximum packets per group (source + parity) */
+#define RTP_SDR_FEC_PARITY_SIZE (FEC_PKT_HDR_SIZE + RTP_PACKET_LENGTH) /**< room for one fec parity packet */
+
+#define RTP_SDR_URING_ENTRIES  64 /**< io_uring submission queue entries */
+#define RTP_SDR_URING_BUFFERS 256 /**< io_uring rx provided / tx registered buffers */
+
+#define RTP_SDR_SOCKET_BUF_MIN 262144 /**< smallest socket buffer set by rcp_iq_buffer_config() */
+
+#define RTP_SDR_ZC_BUFFERS       8 /**< tx zerocopy super-buffers (at most 8: busy bitmap) */
+#define RTP_SDR_ZC_MIN_BYTES 16384 /**< smallest send worth pinning instead of copying */
+
 /**
  * @enum RTP_SDR_ERROR
  * @brief rtp_sdr error types
@@ -81,11 +103,12 @@ enum RTP_SDR_ERROR {
  *
  */
 typedef enum IQ_TYPE {
-    IQ_PT8  = 97, /**< NON-standard payload type for raw I/Q stream - signed 8 bit version */
-    IQ_PT16 = 98, /**< NON-standard payload type for raw I/Q stream - signed 16 bit version */
-    IQ_PT24 = 99, /**< NON-standard payload type for raw I/Q stream - signed 24 bit version */
-    IQ_PT32 = 100 /**< NON-standard payload type for raw I/Q stream - signed 32 bit version */
-} iq_type_t;      /**< i/q type data type */
+    IQ_PT8  = 97,  /**< NON-standard payload type for raw I/Q stream - signed 8 bit version */
+    IQ_PT16 = 98,  /**< NON-standard payload type for raw I/Q stream - signed 16 bit version */
+    IQ_PT24 = 99,  /**< NON-standard payload type for raw I/Q stream - signed 24 bit version */
+    IQ_PT32 = 100, /**< NON-standard payload type for raw I/Q stream - signed 32 bit version */
+    IQ_PTC16 = 101 /**< NON-standard payload type for lossless compressed I/Q stream (rtp_sdr_codec.h) - signed 16 bit version */
+} iq_type_t;       /**< i/q type data type */
 
 /**
  * @enum SAMPLE_RATE
@@ -101,6 +124,52 @@ typedef enum SAMPLE_RATE {
     SR_1536K = 1536000 /**< sample rate 1536000 bps */
 } sample_rate_t;       /**< sample rate data type */
 
+/**
+ * @enum RTP_SDR_TRANSPORT
+ * @brief socket i/o backend
+ *
+ */
+typedef enum RTP_SDR_TRANSPORT {
+    RTP_SDR_SOCKET       = 0, /**< send/recv syscall per packet */
+    RTP_SDR_URING        = 1, /**< io_uring: multishot rx, batched tx from registered buffers */
+    RTP_SDR_URING_SQPOLL = 2  /**< io_uring with kernel submission polling: no syscall while busy */
+} rtp_sdr_transport_t;   /**< socket i/o backend data type */
+
+/**
+ * @struct rcp_iq_rx_stats_s
+ * @brief rx statistics
+ *
+ */
+typedef struct rcp_iq_rx_stats_s {
+    uint32_t received; /**< rtp packets received */
+     int32_t lost;     /**< rtp packets missing from the sequence */
+      double jitter;   /**< interarrival jitter in samples */
+    uint32_t dropped;  /**< datagrams dropped by the kernel, receive buffer full */
+} rcp_iq_rx_stats_t;   /**< rx statistics data type */
+
+/**
+ * @enum RCP_IQ_RX_EVENT
+ * @brief rx stream events
+ *
+ */
+typedef enum RCP_IQ_RX_EVENT {
+    RCP_IQ_RX_LOSS = 0 /**< rtp sequence gap: packets never received */
+} rcp_iq_rx_event_t;   /**< rx stream event data type */
+
+/**
+ * @brief rx stream event callback. Called from the rx path before the packet that revealed it is buffered.
+ *
+ * @param event
+ * @param sample rx samples put in every rx channel buffer before the event (rx_samples)
+ * @param samples samples zero filled for it (0: the rx buffers carry no hole for it)
+ * @param seq rtp sequence number of the first packet concerned
+ * @param packets packets concerned
+ * @param arg
+ */
+typedef void (*rcp_iq_rx_event_cb)(rcp_iq_rx_event_t event, uint64_t sample, uint32_t samples, uint16_t seq, uint32_t packets, void *arg);
+
+typedef struct rtp_sdr_rtcp_s rtp_sdr_rtcp_t; /**< rtcp engine (rtp_sdr_rtcp.h) */
+
 /**
  * @struct session_iq_s
  * @brief i/q session
@@ -108,7 +177,7 @@ typedef enum SAMPLE_RATE {
  */
 typedef struct session_iq_s {
              bool tx_enabled;       /**< enable tx */
-             bool use_fec;          /**< use fec correction frame */
+             bool use_fec;          /**< send fec parity (send only: parity is dropped on rx) */
        rtp_header *tx_header;       /**< tx rtp header */
        rtp_header *rx_header;       /**< rx rtp header */
           int32_t tx_frame_samples; /**< tx samples per frame */
@@ -118,8 +187,12 @@ typedef struct session_iq_s {
     rbuf_handle_t rx_iq_buffer;     /**< rx i/q circular buffer */
         iq_type_t tx_type;          /**< rtp payload type (with marker stripped) */
         iq_type_t rx_type;          /**< rtp payload type (with marker stripped) */
-          uint8_t tx_qty;           /**< quantity of transmitters */
-          uint8_t rx_qty;           /**< quantity of receivers */
+          uint8_t tx_qty;           /**< quantity of transmitters (channels interleaved in every tx packet) */
+          uint8_t rx_qty;           /**< quantity of receivers (channels interleaved in every rx packet) */
+    rbuf_handle_t *tx_iq_channel;   /**< tx i/q circular buffer of each channel, [0] is tx_iq_buffer */
+    rbuf_handle_t *rx_iq_channel;   /**< rx i/q circular buffer of each channel, [0] is rx_iq_buffer */
+             iq_t *tx_iq_storage;   /**< storage of the tx channel buffers past the first */
+             iq_t *rx_iq_storage;   /**< storage of the rx channel buffers past the first */
            double *tx_frequency;    /**< tx lo frequency */
            double *rx_frequency;    /**< rx lo frequency */
     sample_rate_t tx_sample_rate;   /**< tx nominal sampling rate */
@@ -129,12 +202,64 @@ typedef struct session_iq_s {
        const char *host;            /**< ip */
      rtp_socket_t tx_socket;        /**< tx socket */
      rtp_socket_t rx_socket;        /**< rx socket */
+      fec_adapt_t tx_fec;           /**< tx adaptive fec controller (rtcp thread) */
+         uint32_t tx_fec_kn;        /**< tx fec parameters chosen by the controller, k << 8 | n (atomic) */
+            fec_t *tx_fec_code;     /**< tx fec code of the current group (NULL: no parity) */
+        fec_pkt_t *tx_fec_pkt;      /**< tx fec parity packet being encoded */
+          uint8_t *tx_fec_parity;   /**< tx fec parity packets of the last group, waiting to be sent */
+         uint32_t tx_fec_par_len;   /**< tx fec length of each parity packet of the last group */
+          uint8_t tx_fec_par_n;     /**< tx fec parity packets of the last group */
+          uint8_t tx_fec_par_next;  /**< tx fec next parity packet of the last group to send */
+          uint8_t *tx_fec_buf;      /**< tx fec source packets of the current group */
+         uint32_t tx_fec_count;     /**< tx fec source packets in the current group */
+         uint32_t tx_fec_len;       /**< tx fec longest source packet in the current group */
+         uint32_t tx_fec_tstamp;    /**< tx fec send time of the current group (usecs) */
+          uint8_t tx_fec_seq;       /**< tx fec group sequence number */
+       rtp_loop_t *loop;            /**< event loop the session rx and rtcp are attached to (NULL: blocking api) */
+       rtp_loop_t *tx_loop;         /**< event loop of the tx pacing timer, loop unless attached split */
+             bool tx_park;          /**< stop the tx pacing timer while tx_iq_buffer is short of a packet */
+          uint8_t tx_parked;        /**< tx pacing timer stopped by tx_park until rcp_iq_tx_kick() (atomic) */
+rtp_loop_source_t *tx_source;       /**< tx pacing timer */
+rtp_loop_source_t *rx_source;       /**< rx socket source */
+rtp_sdr_transport_t transport;      /**< socket i/o backend in use */
+      rtp_uring_t *tx_uring;        /**< tx io_uring (NULL: socket path) */
+      rtp_uring_t *rx_uring;        /**< rx io_uring (NULL: socket path) */
+          uint8_t tx_gso_segments;  /**< tx packets per UDP_SEGMENT super-buffer (0, 1: off) */
+          uint8_t *tx_gso_buf;      /**< tx super-buffer */
+          uint8_t *rx_gro_buf;      /**< rx coalesced (UDP_GRO) datagram buffer (NULL: off) */
+        rtp_xdp_t *xdp;             /**< AF_XDP socket (NULL: kernel stack) */
+             bool xdp_tx;           /**< tx through the AF_XDP socket */
+             bool tx_zerocopy;      /**< tx super-buffers are sent with MSG_ZEROCOPY */
+          uint8_t *tx_zc_pool;      /**< tx zerocopy super-buffers */
+         uint32_t tx_zc_id[RTP_SDR_ZC_BUFFERS]; /**< tx zerocopy notification id of each busy super-buffer */
+          uint8_t tx_zc_busy;       /**< tx zerocopy super-buffers still pinned by the kernel (bitmap) */
+         uint32_t rx_busy_spin_us;  /**< busy poll: spin this long on an idle rx before sleeping */
+         uint32_t rx_busy_sleep_us; /**< busy poll: longest back-off sleep once idle (0: never sleep) */
+       rtp_source *rx_src;          /**< rx sender sequence, loss and interarrival jitter (NULL: nothing received yet) */
+             bool rx_coalesced;     /**< rx packet is a later segment of a coalesced (UDP_GRO) datagram: no arrival time of its own, no jitter update */
+         uint32_t tx_packets;       /**< tx rtp packets sent (SR sender's packet count) */
+         uint32_t tx_octets;        /**< tx rtp payload octets sent (SR sender's octet count) */
+         uint32_t tx_sent_seq;      /**< tx_sent_ntp, tx_sent_ts seqlock: odd while the tx thread writes them */
+           ntp_ts tx_sent_ntp;      /**< tx wallclock when the last packets went out (SR reference) */
+         uint32_t tx_sent_ts;       /**< tx rtp timestamp of the first of those packets */
+   rtp_sdr_rtcp_t *rtcp;            /**< rtcp engine (NULL: off) */
+        rtp_clock *rx_clock;        /**< rx sender sample clock to wallclock, from its SRs (NULL: no SR yet, rtcp thread only) */
+         uint32_t rx_clock_seq;     /**< rx_clock_snap seqlock: odd while the rtcp thread writes it, 0: no SR yet */
+        rtp_clock rx_clock_snap;    /**< rx_clock as published to the other threads */
+         uint32_t rx_next_ts;       /**< rx rtp timestamp following the last sample put in rx_iq_buffer */
+             bool rx_next_valid;    /**< rx_next_ts was set by a received packet */
+rtp_sdr_resample_t *rx_resample;    /**< rx drift compensation (NULL: off) */
+         uint32_t rx_resample_depth; /**< rx drift compensation: rx_iq_buffer depth kept (samples) */
+         uint64_t rx_samples;       /**< rx samples put in every rx channel buffer, zero fill included */
+         uint32_t rx_seq;           /**< rx_samples and rx channel buffers seqlock: odd while the rx thread writes them */
+rcp_iq_rx_event_cb rx_event_cb;     /**< rx stream event callback (NULL: off) */
+             void *rx_event_arg;    /**< rx stream event callback argument */
 } *session_iq_t;                    /**< i/q session data type */
 
 /**
  * @fn uint8_t rcp_iq_init(session_iq_t *session, iq_type_t txtype, iq_type_t rxtype, sample_rate_t tx_sample_rate, sample_rate_t rx_sample_rate, uint32_t duration,
         const char *host, uint16_t tx_port, uint16_t rx_port, bool use_fec, iq_t *tx_buffer, iq_t *rx_buffer, size_t buffer_size, uint8_t tx_qty,
-        uint8_t rx_qty);
+        uint8_t rx_qty, rtp_sdr_transport_t transport);
  * @brief
  *
  * @param session
@@ -144,17 +269,20 @@ typedef struct session_iq_s {
  * @param duration
  * @param host
  * @param port
- * @param use_fec
+ * @param use_fec send fec parity (see rcp_iq_fec_config(), send only)
  * @param tx_buffer
  * @param rx_buffer
  * @param buffer_size
- * @param tx_qty
- * @param rx_qty
+ * @param tx_qty tx channels: every packet interleaves one i/q sample of each per timestamp,
+ *        channel 0 uses tx_buffer and the others buffers of buffer_size allocated here (tx_iq_channel)
+ * @param rx_qty rx channels, same as tx_qty (rx_iq_channel). Lost rx packets are zero filled
+ *        in every channel buffer so that the channels stay sample aligned
+ * @param transport socket i/o backend, io_uring falls back to RTP_SDR_SOCKET when not available
  * @return
  */
 uint8_t rcp_iq_init(session_iq_t *session, iq_type_t txtype, iq_type_t rxtype, sample_rate_t tx_sample_rate, sample_rate_t rx_sample_rate, uint32_t duration,
         const char *host, uint16_t tx_port, uint16_t rx_port, bool use_fec, iq_t *tx_buffer, iq_t *rx_buffer, size_t buffer_size, uint8_t tx_qty,
-        uint8_t rx_qty);
+        uint8_t rx_qty, rtp_sdr_transport_t transport);
 
 /**
  * @fn void rcp_iq_deinit(session_iq_t *session)
@@ -164,6 +292,187 @@ uint8_t rcp_iq_init(session_iq_t *session, iq_type_t txtype, iq_type_t rxtype, s
  */
 void rcp_iq_deinit(session_iq_t *session);
 
+/**
+ * @fn uint8_t rcp_iq_fec_config(session_iq_t *session, uint8_t k, uint8_t n_max, double target)
+ * @brief Configure the adaptive tx fec. Parity is sent only while the receiver reports losses,
+ *        n is retuned per group between k (no parity) and n_max. The parity of a group goes out
+ *        through the session transport, one packet after each source packet of the next group.
+ *        Send only: this library has no fec decoder, the receive paths drop parity packets.
+ *
+ * @param session
+ * @param k source packets per group
+ * @param n_max maximum packets per group (source + parity)
+ * @param target residual group loss probability (0: default)
+ * @return
+ */
+uint8_t rcp_iq_fec_config(session_iq_t *session, uint8_t k, uint8_t n_max, double target);
+
+/**
+ * @fn uint8_t rcp_iq_rtcp_feedback(session_iq_t *session, const uint8_t *buffer, size_t size)
+ * @brief Process a received (compound) rtcp packet. Reception reports about the tx source
+ *        feed the adaptive fec controller.
+ *
+ * @param session
+ * @param buffer
+ * @param size
+ * @return
+ */
+uint8_t rcp_iq_rtcp_feedback(session_iq_t *session, const uint8_t *buffer, size_t size);
+
+/**
+ * @fn uint8_t rcp_iq_receive_payload(session_iq_t *session, const rtp_header *header, const uint8_t *payload, int payload_size, uint64_t arrival)
+ * @brief Unpack the payload of an rtp packet parsed elsewhere (e.g. by a demultiplexer) into the rx buffer
+ *        and account it in the rx statistics.
+ *
+ * @param session
+ * @param header parsed rtp header
+ * @param payload
+ * @param payload_size
+ * @param arrival ns since the epoch (0: now). The segments of a coalesced (UDP_GRO) datagram share the
+ *        arrival time of the datagram: the caller sets rx_coalesced for all but the first so they do not
+ *        read as a burst in the interarrival jitter.
+ * @return
+ */
+uint8_t rcp_iq_receive_payload(session_iq_t *session, const rtp_header *header, const uint8_t *payload, int payload_size, uint64_t arrival);
+
+/**
+ * @fn uint8_t rcp_iq_gso_config(session_iq_t *session, uint8_t segments)
+ * @brief Batch packets through UDP segmentation offload. Every tx period sends up to segments
+ *        consecutive packets as one super-buffer that the kernel splits into datagrams, and rx
+ *        accepts coalesced (UDP_GRO) datagrams. Call after opening the sockets.
+ *        The io_uring tx path does not batch.
+ *
+ * @param session
+ * @param segments packets per super-buffer, capped to the UDP payload limit (0, 1: off)
+ * @return RTP_SDR_ERROR for compressed tx (IQ_PTC16): its packets differ in size
+ */
+uint8_t rcp_iq_gso_config(session_iq_t *session, uint8_t segments);
+
+/**
+ * @fn uint8_t rcp_iq_zerocopy_config(session_iq_t *session, bool enable)
+ * @brief Send UDP_SEGMENT super-buffers of at least RTP_SDR_ZC_MIN_BYTES with MSG_ZEROCOPY
+ *        from a session pool instead of copying them into the kernel. A buffer is reused once
+ *        its completion is read from the socket error queue. Zerocopy turns itself off when
+ *        the kernel reports it had to copy anyway (e.g. loopback).
+ *        Call after opening the tx socket and rcp_iq_gso_config().
+ *
+ * @param session
+ * @param enable
+ * @return
+ */
+uint8_t rcp_iq_zerocopy_config(session_iq_t *session, bool enable);
+
+/**
+ * @fn uint8_t rcp_iq_buffer_config(session_iq_t *session, uint32_t latency_ms)
+ * @brief Size the socket buffers to absorb latency_ms of the stream at its sample rate
+ *        (at least RTP_SDR_SOCKET_BUF_MIN). Above net.core.rmem_max / wmem_max this needs
+ *        CAP_NET_ADMIN: RTP_SDR_WARNING if the kernel granted less.
+ *        Call after opening the sockets.
+ *
+ * @param session
+ * @param latency_ms
+ * @return
+ */
+uint8_t rcp_iq_buffer_config(session_iq_t *session, uint32_t latency_ms);
+
+/**
+ * @fn uint8_t rcp_iq_rx_stats(session_iq_t *session, rcp_iq_rx_stats_t *stats)
+ * @brief Read the rx statistics.
+ *
+ * @param session
+ * @param stats
+ * @return RTP_SDR_WARNING if no packet was received yet
+ */
+uint8_t rcp_iq_rx_stats(session_iq_t *session, rcp_iq_rx_stats_t *stats);
+
+/**
+ * @fn uint8_t rcp_iq_rx_time(session_iq_t *session, uint32_t rtp_ts, ntp_ts *time)
+ * @brief Absolute time of a received sample, from the sender's SRs (sender clock offset and drift).
+ *
+ * @param session
+ * @param rtp_ts rtp timestamp of the sample
+ * @param time NTP time of the sample
+ * @return RTP_SDR_WARNING if no SR was received yet
+ */
+uint8_t rcp_iq_rx_time(session_iq_t *session, uint32_t rtp_ts, ntp_ts *time);
+
+/**
+ * @fn uint8_t rcp_iq_rx_buffer_time(session_iq_t *session, uint32_t *rtp_ts, ntp_ts *time)
+ * @brief Timestamp of the oldest sample in rx_iq_buffer, the next one rtp_sdr_rbuf_get() returns.
+ *        Sample k after it has rtp timestamp rtp_ts + k. Meaningful while the rx is not lossy.
+ *
+ * @param session
+ * @param rtp_ts rtp timestamp of the sample
+ * @param time NTP time of the sample (NULL: not needed)
+ * @return RTP_SDR_WARNING if no SR was received yet
+ */
+uint8_t rcp_iq_rx_buffer_time(session_iq_t *session, uint32_t *rtp_ts, ntp_ts *time);
+
+/**
+ * @fn uint8_t rcp_iq_drift_config(session_iq_t *session, uint32_t depth_ms)
+ * @brief Compensate the sender / receiver sample clock drift on rx: the clock ratio is estimated from
+ *        rtp timestamps against local arrival times and the samples are resampled to exactly
+ *        rx_sample_rate of the local clock, steering rx_iq_buffer to hold depth_ms of samples.
+ *        Once enabled rx_iq_buffer holds resampled samples, rcp_iq_rx_buffer_time() is then approximate.
+ *
+ * @param session
+ * @param depth_ms buffer depth to keep, at most half of rx_iq_buffer (0: off)
+ * @return RTP_SDR_ERROR on multi-channel or compressed rx
+ */
+uint8_t rcp_iq_drift_config(session_iq_t *session, uint32_t depth_ms);
+
+/**
+ * @fn uint8_t rcp_iq_rx_event_config(session_iq_t *session, rcp_iq_rx_event_cb cb, void *arg)
+ * @brief Report rx losses and recoveries as they are detected, e.g. to annotate a capture.
+ *
+ * @param session
+ * @param cb callback, runs on the rx thread (NULL: off)
+ * @param arg
+ * @return RTP_SDR_OK
+ */
+uint8_t rcp_iq_rx_event_config(session_iq_t *session, rcp_iq_rx_event_cb cb, void *arg);
+
+/**
+ * @fn uint8_t rcp_iq_busy_poll_config(session_iq_t *session, uint32_t spin_us, uint32_t sleep_us)
+ * @brief Trade CPU for rx latency in rcp_iq_busy_poll(). The rx socket also busy polls the device
+ *        queue for spin_us in the kernel (SO_BUSY_POLL, SO_PREFER_BUSY_POLL), which needs
+ *        CAP_NET_ADMIN above net.core.busy_read: RTP_SDR_WARNING if the kernel refused.
+ *        Call after opening the rx socket.
+ *
+ * @param session
+ * @param spin_us keep spinning this long after the last datagram
+ * @param sleep_us then sleep 1, 2, 4 ... up to sleep_us between polls (0: spin forever)
+ * @return
+ */
+uint8_t rcp_iq_busy_poll_config(session_iq_t *session, uint32_t spin_us, uint32_t sleep_us);
+
+/**
+ * @fn uint8_t rcp_iq_busy_poll(session_iq_t *session, volatile bool *stop)
+ * @brief Receive by polling without blocking until *stop is set, instead of waiting for wakeups.
+ *        Meant for a thread of its own on an isolated core; do not attach the session rx to a loop.
+ *
+ * @param session
+ * @param stop
+ * @return
+ */
+uint8_t rcp_iq_busy_poll(session_iq_t *session, volatile bool *stop);
+
+/**
+ * @fn uint8_t rcp_iq_xdp_config(session_iq_t *session, const char *ifname, uint32_t queue, uint32_t flags, const uint8_t *mac)
+ * @brief Bypass the kernel stack with an AF_XDP socket on an interface queue. Datagrams for the
+ *        rx port are received from UMEM, and packets to the tx socket destination are built in UMEM
+ *        (IPv4 only, packets are shortened to fit a frame). Call after opening the sockets.
+ *        RTP_XDP_SKB_MODE works on any interface, e.g. a veth pair.
+ *
+ * @param session
+ * @param ifname network interface
+ * @param queue interface queue
+ * @param flags RTP_XDP_SKB_MODE / RTP_XDP_DRV_MODE / RTP_XDP_ZEROCOPY
+ * @param mac tx next hop hardware address (NULL: neighbour table or multicast mapping)
+ * @return
+ */
+uint8_t rcp_iq_xdp_config(session_iq_t *session, const char *ifname, uint32_t queue, uint32_t flags, const uint8_t *mac);
+
 /**
  * @fn uint8_t rcp_iq_transmit(session_iq_t *session)
  * @brief
@@ -174,6 +483,25 @@ void rcp_iq_deinit(session_iq_t *session);
  */
 uint8_t rcp_iq_transmit(session_iq_t *session);
 
+/**
+ * @fn uint32_t rcp_iq_tx_packet_samples(session_iq_t *session)
+ * @brief I/Q samples per channel carried by every tx packet: the tx buffers are sent in whole packets.
+ *
+ * @param session
+ * @return samples
+ */
+uint32_t rcp_iq_tx_packet_samples(session_iq_t *session);
+
+/**
+ * @fn uint8_t rcp_iq_transmit_unpaced(session_iq_t *session)
+ * @brief Send every whole packet the tx buffers hold right away, without pacing (e.g. load generation).
+ *        Not to be mixed with the tx of an attached loop: use a session with tx_enabled false there.
+ *
+ * @param session
+ * @return RTP_SDR_WARNING if not a packet was held, RTP_SDR_ERROR if a send failed
+ */
+uint8_t rcp_iq_transmit_unpaced(session_iq_t *session);
+
 /**
  * @fn uint8_t rcp_iq_receive(session_iq_t *session)
  * @brief
@@ -184,4 +512,47 @@ uint8_t rcp_iq_transmit(session_iq_t *session);
  */
 uint8_t rcp_iq_receive(session_iq_t *session);
 
+/**
+ * @fn uint8_t rcp_iq_loop_attach(session_iq_t *session, rtp_loop_t *loop)
+ * @brief Service the session from an event loop instead of blocking tx/rx threads.
+ *        The open rx socket is drained into the rx buffer when readable, and if tx is enabled
+ *        a timer sends one packet per packet duration from the tx buffer.
+ *        Sockets must be opened before attaching.
+ *
+ * @param session
+ * @param loop
+ * @return
+ */
+uint8_t rcp_iq_loop_attach(session_iq_t *session, rtp_loop_t *loop);
+
+/**
+ * @fn uint8_t rcp_iq_loop_attach_split(session_iq_t *session, rtp_loop_t *rx_loop, rtp_loop_t *tx_loop)
+ * @brief Same as rcp_iq_loop_attach() with the tx pacing timer on a loop of its own, e.g. to run
+ *        tx and rx on different threads. Rtcp runs with the rx.
+ *
+ * @param session
+ * @param rx_loop
+ * @param tx_loop
+ * @return
+ */
+uint8_t rcp_iq_loop_attach_split(session_iq_t *session, rtp_loop_t *rx_loop, rtp_loop_t *tx_loop);
+
+/**
+ * @fn void rcp_iq_tx_kick(session_iq_t *session)
+ * @brief With tx_park set, the tx pacing timer stops when tx_iq_buffer runs short of a packet so
+ *        that an idle session costs no wakeups. Call after putting samples in the tx buffers to
+ *        restart it; when it is running this is one atomic load. Callable from any thread.
+ *
+ * @param session
+ */
+void rcp_iq_tx_kick(session_iq_t *session);
+
+/**
+ * @fn void rcp_iq_loop_detach(session_iq_t *session)
+ * @brief Remove the session from its event loop.
+ *
+ * @param session
+ */
+void rcp_iq_loop_detach(session_iq_t *session);
+
 #endif /* RTP_IQ_H_ */
@@ -81,6 +81,15 @@ typedef struct iq_s {
     } q;                 /**< q component */
 } iq_t;                  /**< i/q data type */
 
+/**
+ * @enum RTP_SDR_RBUF_WAIT
+ * @brief side of the buffer to wait for
+ */
+enum RTP_SDR_RBUF_WAIT {
+    RTP_SDR_RBUF_DATA = 0, /**< consumer: the buffer holds at least the high watermark */
+    RTP_SDR_RBUF_ROOM = 1  /**< producer: the buffer holds at most the low watermark */
+};
+
 typedef struct rbuf_s rbuf_t;  /**< opaque circular buffer structure */
 typedef rbuf_t *rbuf_handle_t; /**< handle type, the way users interact with the API */
 
@@ -141,6 +150,48 @@ void rtp_sdr_rbuf_put(rbuf_handle_t *me, iq_t data);
  */
 int rtp_sdr_rbuf_try_put(rbuf_handle_t *me, iq_t data);
 
+/**
+ * @fn void rtp_sdr_rbuf_write(rbuf_handle_t *me, const iq_t *data, size_t count)
+ * @brief Put count values at once, like rtp_sdr_rbuf_put() old data is overwritten if the buffer is full
+ *        Requires: me is valid and created by circular_buf_init
+ * @param me
+ * @param data
+ * @param count
+ */
+void rtp_sdr_rbuf_write(rbuf_handle_t *me, const iq_t *data, size_t count);
+
+/**
+ * @fn size_t rtp_sdr_rbuf_reserve(rbuf_handle_t *me, iq_t **span)
+ * @brief Free storage following the newest value, to be filled in place and published with rtp_sdr_rbuf_commit()
+ *        Requires: me is valid and created by circular_buf_init, a single producer
+ *        Returns the number of values the span holds (0: the buffer is full), less than the free room when it wraps
+ * @param me
+ * @param span
+ * @return
+ */
+size_t rtp_sdr_rbuf_reserve(rbuf_handle_t *me, iq_t **span);
+
+/**
+ * @fn void rtp_sdr_rbuf_commit(rbuf_handle_t *me, size_t count)
+ * @brief Publish the first count values of the span returned by rtp_sdr_rbuf_reserve(), nothing is overwritten
+ *        Requires: me is valid and created by circular_buf_init, count at most the span returned
+ * @param me
+ * @param count
+ */
+void rtp_sdr_rbuf_commit(rbuf_handle_t *me, size_t count);
+
+/**
+ * @fn size_t rtp_sdr_rbuf_read(rbuf_handle_t *me, iq_t *data, size_t count)
+ * @brief Retrieve up to count values at once
+ *        Requires: me is valid and created by circular_buf_init
+ *        Returns the number of values retrieved
+ * @param me
+ * @param data
+ * @param count
+ * @return
+ */
+size_t rtp_sdr_rbuf_read(rbuf_handle_t *me, iq_t *data, size_t count);
+
 ///
 /**
  * @fn int rtp_sdr_rbuf_get(rbuf_handle_t me, iq_t *data)
@@ -198,6 +249,15 @@ size_t rtp_sdr_rbuf_capacity(rbuf_handle_t *me);
  */
 size_t rtp_sdr_rbuf_size(rbuf_handle_t *me);
 
+/**
+ * @fn uint64_t rtp_sdr_rbuf_dropped(rbuf_handle_t *me)
+ * @brief Count of values rtp_sdr_rbuf_put() / rtp_sdr_rbuf_write() overwrote before they were read
+ *        Requires: me is valid and created by circular_buf_init
+ * @param me
+ * @return
+ */
+uint64_t rtp_sdr_rbuf_dropped(rbuf_handle_t *me);
+
 /**
  * @fn int rtp_sdr_rbuf_peek(rbuf_handle_t me, iq_t *data, unsigned int look_ahead_counter)
  * @brief Look ahead at values stored in the circular buffer without removing the data
@@ -213,4 +273,53 @@ size_t rtp_sdr_rbuf_size(rbuf_handle_t *me);
  */
 int rtp_sdr_rbuf_peek(rbuf_handle_t *me, iq_t *data, unsigned int look_ahead_counter);
 
+/**
+ * @fn int rtp_sdr_rbuf_wait_config(rbuf_handle_t *me, size_t low, size_t high)
+ * @brief Make the buffer waitable. The consumer can block until it holds at least high values and
+ *        the producer until it drained to at most low. Put and get only signal when a waiter is
+ *        present and its watermark is reached, otherwise they stay lock-free and syscall-free.
+ *        Can be called again to move the watermarks.
+ *        Requires: me is valid and created by circular_buf_init, low < capacity, high <= capacity
+ *        Returns 0 on success, -1 on error
+ * @param me
+ * @param low room watermark
+ * @param high data watermark (0: 1)
+ * @return
+ */
+int rtp_sdr_rbuf_wait_config(rbuf_handle_t *me, size_t low, size_t high);
+
+/**
+ * @fn int rtp_sdr_rbuf_wait(rbuf_handle_t *me, int which, int timeout_ms)
+ * @brief Block on a futex until a watermark is reached
+ *        Requires: rtp_sdr_rbuf_wait_config() was called, one waiter per side
+ *        Returns 0 when it is reached, -1 on timeout
+ * @param me
+ * @param which RTP_SDR_RBUF_DATA / RTP_SDR_RBUF_ROOM
+ * @param timeout_ms (-1: forever)
+ * @return
+ */
+int rtp_sdr_rbuf_wait(rbuf_handle_t *me, int which, int timeout_ms);
+
+/**
+ * @fn int rtp_sdr_rbuf_wait_fd(rbuf_handle_t *me, int which)
+ * @brief Eventfd that also signals a watermark, to wait for it from epoll (e.g. an rtp_loop)
+ *        together with other events. It only fires after rtp_sdr_rbuf_wait_arm(). Closed by rtp_sdr_rbuf_free()
+ *        Requires: rtp_sdr_rbuf_wait_config() was called
+ *        Returns the fd or -1 on error
+ * @param me
+ * @param which RTP_SDR_RBUF_DATA / RTP_SDR_RBUF_ROOM
+ * @return
+ */
+int rtp_sdr_rbuf_wait_fd(rbuf_handle_t *me, int which);
+
+/**
+ * @fn int rtp_sdr_rbuf_wait_arm(rbuf_handle_t *me, int which)
+ * @brief Register an epoll waiter on the rtp_sdr_rbuf_wait_fd() of one side, and consume its previous signal
+ *        Returns 1 if the watermark is already reached (do not wait), 0 when armed, -1 on error
+ * @param me
+ * @param which RTP_SDR_RBUF_DATA / RTP_SDR_RBUF_ROOM
+ * @return
+ */
+int rtp_sdr_rbuf_wait_arm(rbuf_handle_t *me, int which);
+
 #endif // RTP_SDR_RBUF_H_
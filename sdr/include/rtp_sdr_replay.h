@@ -0,0 +1,112 @@
+/*
+ * Copyright 2023 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/rtp-sdr *
+ *
+ * This is based on other projects:
+ *      IDEA: https://github.com/OpenResearchInstitute/ka9q-sdr (not use any code of this)
+ *       RTP: https://github.com/Daxbot/librtp/
+ *       FEC: https://github.com/wesen/poc
+ *    SOCKET: https://github.com/njh/mast
+ *    OTHERS: see individual files
+ *
+ *    please contact their authors for more information.
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+#ifndef RTP_SDR_REPLAY_H_
+#define RTP_SDR_REPLAY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "rtp_sdr_iq.h"
+
+/**
+ * @enum RTP_SDR_REPLAY_PACE
+ * @brief replay timing
+ *
+ */
+typedef enum RTP_SDR_REPLAY_PACE {
+    RTP_SDR_REPLAY_PACED = 0, /**< the session tx pacing (attached loop or runner) sends at tx_sample_rate */
+    RTP_SDR_REPLAY_FAST  = 1  /**< rtp_sdr_replay_run() sends as fast as the socket takes it, the session tx must not be attached */
+} rtp_sdr_replay_pace_t;      /**< replay timing data type */
+
+typedef struct rtp_sdr_replay_s rtp_sdr_replay_t; /**< opaque replay source */
+
+/**
+ * @fn rtp_sdr_replay_t* rtp_sdr_replay_open(const char *base, session_iq_t *session, rtp_sdr_replay_pace_t pace)
+ * @brief Open a SigMF recording (rtp_sdr_sigmf.h) as the tx source of a session. The data file is mapped and
+ *        unpacked straight into the tx buffers, one span per channel, without intermediate copies. The
+ *        recording must have tx_qty channels of the tx i/q width (ci32_le for 24 and 32 bits); it is sent at the
+ *        session tx_sample_rate whatever its own. Sets the ROOM watermark of tx_iq_buffer.
+ *
+ * @param base recording path without suffix
+ * @param session
+ * @param pace
+ * @return replay or NULL if the recording can not be opened or does not match the session
+ */
+rtp_sdr_replay_t* rtp_sdr_replay_open(const char *base, session_iq_t *session, rtp_sdr_replay_pace_t pace);
+
+/**
+ * @fn uint8_t rtp_sdr_replay_seek(rtp_sdr_replay_t *replay, uint64_t sample)
+ * @brief Continue from another position of the recording.
+ *
+ * @param replay
+ * @param sample
+ * @return RTP_SDR_ERROR past the end
+ */
+uint8_t rtp_sdr_replay_seek(rtp_sdr_replay_t *replay, uint64_t sample);
+
+/**
+ * @fn size_t rtp_sdr_replay_feed(rtp_sdr_replay_t *replay)
+ * @brief Move as much of the recording as the tx buffers have room for, without blocking. Paced replays
+ *        wake the session tx up (rcp_iq_tx_kick()).
+ *
+ * @param replay
+ * @return samples per channel moved (0: tx buffers full or end of the recording)
+ */
+size_t rtp_sdr_replay_feed(rtp_sdr_replay_t *replay);
+
+/**
+ * @fn uint8_t rtp_sdr_replay_run(rtp_sdr_replay_t *replay, uint32_t repeat, volatile bool *stop)
+ * @brief Play the recording from the current position to the end, repeat times, blocking while the tx buffers
+ *        are full. The last partial packet is completed with zeros. Returns once everything was handed to the
+ *        session tx: a paced replay may still be sending the last buffered samples.
+ *
+ * @param replay
+ * @param repeat times played (0: until stopped)
+ * @param stop set to return early (NULL: never)
+ * @return RTP_SDR_WARNING if stopped, RTP_SDR_ERROR if a send failed
+ */
+uint8_t rtp_sdr_replay_run(rtp_sdr_replay_t *replay, uint32_t repeat, volatile bool *stop);
+
+/**
+ * @fn void rtp_sdr_replay_free(rtp_sdr_replay_t *replay)
+ * @brief Close the recording and free the replay. Samples already moved stay in the tx buffers.
+ *
+ * @param replay
+ */
+void rtp_sdr_replay_free(rtp_sdr_replay_t *replay);
+
+#endif /* RTP_SDR_REPLAY_H_ */
@@ -0,0 +1,139 @@
+/*
+ * Copyright 2023 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/rtp-sdr *
+ *
+ * This is based on other projects:
+ *      IDEA: https://github.com/OpenResearchInstitute/ka9q-sdr (not use any code of this)
+ *       RTP: https://github.com/Daxbot/librtp/
+ *       FEC: https://github.com/wesen/poc
+ *    SOCKET: https://github.com/njh/mast
+ *    OTHERS: see individual files
+ *
+ *    please contact their authors for more information.
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef RTP_SDR_RESAMPLE_H_
+#define RTP_SDR_RESAMPLE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define RTP_SDR_RESAMPLE_TAPS       16 /**< default filter taps per phase (multiple of RTP_SDR_RESAMPLE_LANES) */
+#define RTP_SDR_RESAMPLE_PHASES     64 /**< default filter phases, interpolated in between */
+#define RTP_SDR_RESAMPLE_LANES       8 /**< independent accumulators of the filter kernel (vector width) */
+#define RTP_SDR_RESAMPLE_SETTLE_S    1 /**< seconds of arrivals before the rate ratio is estimated */
+#define RTP_SDR_RESAMPLE_WINDOW_S   60 /**< longest span of arrivals the rate ratio is measured over */
+#define RTP_SDR_RESAMPLE_SMOOTH   1024 /**< packets the rate ratio estimate is averaged over */
+#define RTP_SDR_RESAMPLE_GAIN     1e-4 /**< step correction per unit of relative buffer depth error */
+#define RTP_SDR_RESAMPLE_MAX_PPM  1000 /**< largest step correction from the buffer depth */
+
+/**
+ * @struct rtp_sdr_resample_s
+ * @brief rx clock recovery and fractional resampler
+ *
+ */
+typedef struct rtp_sdr_resample_s {
+    unsigned int taps;      /**< filter taps per phase */
+    unsigned int phases;    /**< filter phases */
+           float *coef;     /**< phase p: taps coefficients, each duplicated for i and q */
+           float *delta;    /**< phase p + 1 minus phase p, same layout */
+           float *hist;     /**< last taps samples (interleaved i/q), written twice: the window is contiguous */
+    unsigned int pos;       /**< next history slot */
+          double mu;        /**< position of the next output after the oldest center sample (input samples) */
+          double step;      /**< input samples per output sample */
+          double ratio;     /**< estimated sender / receiver sample clock ratio */
+        uint32_t rate;      /**< nominal sample rate */
+            bool tracking;  /**< an arrival was seen */
+        uint32_t last_ts;   /**< rtp timestamp of the last arrival */
+         int64_t last_x;    /**< extended rtp timestamp of the last arrival */
+         int64_t x0;        /**< extended rtp timestamp of the measurement origin */
+        uint64_t t0;        /**< arrival of the measurement origin (ns) */
+         int64_t xm;        /**< extended rtp timestamp of the next origin */
+        uint64_t tm;        /**< arrival of the next origin (ns) */
+            bool mid;       /**< next origin recorded */
+} rtp_sdr_resample_t;       /**< resampler data type */
+
+/**
+ * @fn rtp_sdr_resample_t* rtp_sdr_resample_create(uint32_t rate, unsigned int taps, unsigned int phases)
+ * @brief Allocate a resampler: windowed sinc polyphase filter, linearly interpolated between phases.
+ *
+ * @param rate nominal sample rate
+ * @param taps taps per phase (0: RTP_SDR_RESAMPLE_TAPS), rounded up to RTP_SDR_RESAMPLE_LANES
+ * @param phases phases (0: RTP_SDR_RESAMPLE_PHASES)
+ * @return resampler or NULL on error
+ */
+rtp_sdr_resample_t* rtp_sdr_resample_create(uint32_t rate, unsigned int taps, unsigned int phases);
+
+/**
+ * @fn void rtp_sdr_resample_free(rtp_sdr_resample_t *rs)
+ * @brief Free a resampler.
+ *
+ * @param rs
+ */
+void rtp_sdr_resample_free(rtp_sdr_resample_t *rs);
+
+/**
+ * @fn void rtp_sdr_resample_reset(rtp_sdr_resample_t *rs)
+ * @brief Clear the filter history and the clock estimate (e.g. the sender restarted).
+ *
+ * @param rs
+ */
+void rtp_sdr_resample_reset(rtp_sdr_resample_t *rs);
+
+/**
+ * @fn void rtp_sdr_resample_track(rtp_sdr_resample_t *rs, uint32_t rtp_ts, uint64_t arrival)
+ * @brief Account the arrival of a packet to estimate the sender / receiver clock ratio.
+ *
+ * @param rs
+ * @param rtp_ts rtp timestamp of the packet
+ * @param arrival local arrival time (ns)
+ */
+void rtp_sdr_resample_track(rtp_sdr_resample_t *rs, uint32_t rtp_ts, uint64_t arrival);
+
+/**
+ * @fn void rtp_sdr_resample_servo(rtp_sdr_resample_t *rs, size_t depth, size_t target)
+ * @brief Set the step from the clock ratio, corrected to steer the output buffer depth to target.
+ *
+ * @param rs
+ * @param depth samples in the output buffer
+ * @param target wanted samples in the output buffer
+ */
+void rtp_sdr_resample_servo(rtp_sdr_resample_t *rs, size_t depth, size_t target);
+
+/**
+ * @fn unsigned int rtp_sdr_resample_process(rtp_sdr_resample_t *rs, const float *in, unsigned int count, float *out, unsigned int max)
+ * @brief Resample interleaved i/q samples by the current step.
+ *
+ * @param rs
+ * @param in input samples (i, q pairs)
+ * @param count input samples
+ * @param out output samples (i, q pairs)
+ * @param max room in out (count / step + 2 is enough)
+ * @return output samples
+ */
+unsigned int rtp_sdr_resample_process(rtp_sdr_resample_t *rs, const float *in, unsigned int count, float *out, unsigned int max);
+
+#endif /* RTP_SDR_RESAMPLE_H_ */
@@ -0,0 +1,87 @@
+/*
+ * Copyright 2023 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/rtp-sdr *
+ *
+ * This is based on other projects:
+ *      IDEA: https://github.com/OpenResearchInstitute/ka9q-sdr (not use any code of this)
+ *       RTP: https://github.com/Daxbot/librtp/
+ *       FEC: https://github.com/wesen/poc
+ *    SOCKET: https://github.com/njh/mast
+ *    OTHERS: see individual files
+ *
+ *    please contact their authors for more information.
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef RTP_SDR_RTCP_H_
+#define RTP_SDR_RTCP_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "rtp_sdr_iq.h"
+
+#define RTP_SDR_RTCP_LENGTH  1500 /**< largest compound rtcp packet sent or received */
+#define RTP_SDR_RTCP_BW_FRACTION 0.05 /**< rtcp share of the session bandwidth */
+#define RTP_SDR_RTCP_MEMBERS 64 /**< most other participants tracked */
+#define RTP_SDR_RTCP_TIMEOUT 5  /**< reporting intervals of silence before a participant times out (RFC 3550 6.3.5) */
+
+/**
+ * @fn uint8_t rcp_iq_rtcp_config(session_iq_t *session, bool mux, const char *cname)
+ * @brief Start the rtcp engine: compound SR (while sending) or RR plus SDES CNAME, at the
+ *        randomized RFC 3550 interval, with timer reconsideration and reverse reconsideration
+ *        when participants leave (BYE or timeout). Reports received are passed to rcp_iq_rtcp_feedback().
+ *        Everything runs from timers and sockets of the session event loop: attach the session
+ *        with rcp_iq_loop_attach() before or after this call.
+ *
+ * @param session
+ * @param mux rtcp on the rtp sockets (RFC 5761) instead of rx_port + 1 / tx_port + 1
+ * @param cname canonical name (NULL: user@host)
+ * @return
+ */
+uint8_t rcp_iq_rtcp_config(session_iq_t *session, bool mux, const char *cname);
+
+/**
+ * @fn void rcp_iq_rtcp_stop(session_iq_t *session)
+ * @brief Send a BYE and stop the rtcp engine.
+ *
+ * @param session
+ */
+void rcp_iq_rtcp_stop(session_iq_t *session);
+
+/**
+ * @fn uint8_t rcp_iq_rtcp_send(session_iq_t *session)
+ * @brief Send a report now, outside of the schedule.
+ *
+ * @param session
+ * @return
+ */
+uint8_t rcp_iq_rtcp_send(session_iq_t *session);
+
+// Internal: session event loop and rtp rx path hooks
+uint8_t rtp_sdr_rtcp_attach(session_iq_t *session);
+void rtp_sdr_rtcp_detach(session_iq_t *session);
+void rtp_sdr_rtcp_receive(session_iq_t *session, const uint8_t *data, unsigned int len);
+
+#endif /* RTP_SDR_RTCP_H_ */
@@ -0,0 +1,119 @@
+/*
+ * Copyright 2023 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/rtp-sdr *
+ *
+ * This is based on other projects:
+ *      IDEA: https://github.com/OpenResearchInstitute/ka9q-sdr (not use any code of this)
+ *       RTP: https://github.com/Daxbot/librtp/
+ *       FEC: https://github.com/wesen/poc
+ *    SOCKET: https://github.com/njh/mast
+ *    OTHERS: see individual files
+ *
+ *    please contact their authors for more information.
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef RTP_SDR_RUNNER_H_
+#define RTP_SDR_RUNNER_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "rtp_sdr_iq.h"
+
+#define RTP_SDR_RUNNER_CPU_ANY -1 /**< do not pin the thread */
+
+/**
+ * @struct rtp_sdr_runner_config_s
+ * @brief runner thread placement
+ *
+ */
+typedef struct rtp_sdr_runner_config_s {
+    int tx_cpu;   /**< cpu the tx thread is pinned to (RTP_SDR_RUNNER_CPU_ANY: any) */
+    int rx_cpu;   /**< cpu the rx thread is pinned to (RTP_SDR_RUNNER_CPU_ANY: any) */
+    int priority; /**< SCHED_FIFO priority of both threads, 1 to 99 (0: SCHED_OTHER) */
+} rtp_sdr_runner_config_t; /**< runner thread placement data type */
+
+typedef struct rtp_sdr_runner_s rtp_sdr_runner_t; /**< opaque session runner */
+
+/**
+ * @fn rtp_sdr_runner_t* rtp_sdr_runner_create(const rtp_sdr_runner_config_t *config)
+ * @brief Create a runner: one tx and one rx worker thread, each with an event loop, that service
+ *        any number of sessions. Both block in the kernel while there is nothing to do: rx waits for
+ *        datagrams, and the tx pacing timer of a session stops while its tx buffer is empty
+ *        (rcp_iq_tx_kick()), so CPU usage follows the traffic and not the number of sessions.
+ *
+ * @param config thread placement (NULL: any cpu, SCHED_OTHER)
+ * @return runner or NULL on failure
+ */
+rtp_sdr_runner_t* rtp_sdr_runner_create(const rtp_sdr_runner_config_t *config);
+
+/**
+ * @fn void rtp_sdr_runner_free(rtp_sdr_runner_t *runner)
+ * @brief Stop the threads, detach every session and free the runner.
+ *
+ * @param runner
+ */
+void rtp_sdr_runner_free(rtp_sdr_runner_t *runner);
+
+/**
+ * @fn uint8_t rtp_sdr_runner_add(rtp_sdr_runner_t *runner, session_iq_t *session)
+ * @brief Attach a session, rx and rtcp to the rx thread and the tx pacing to the tx thread.
+ *        Producers must call rcp_iq_tx_kick() after filling its tx buffer.
+ *        Sockets must be opened before. Only while the runner is stopped.
+ *
+ * @param runner
+ * @param session
+ * @return
+ */
+uint8_t rtp_sdr_runner_add(rtp_sdr_runner_t *runner, session_iq_t *session);
+
+/**
+ * @fn void rtp_sdr_runner_remove(rtp_sdr_runner_t *runner, session_iq_t *session)
+ * @brief Detach a session. Only while the runner is stopped.
+ *
+ * @param runner
+ * @param session
+ */
+void rtp_sdr_runner_remove(rtp_sdr_runner_t *runner, session_iq_t *session);
+
+/**
+ * @fn uint8_t rtp_sdr_runner_start(rtp_sdr_runner_t *runner)
+ * @brief Start the threads. Real-time priority needs CAP_SYS_NICE or an RLIMIT_RTPRIO allowance:
+ *        if the kernel refuses it or the pinning, the threads run anyway and RTP_SDR_WARNING is returned.
+ *
+ * @param runner
+ * @return
+ */
+uint8_t rtp_sdr_runner_start(rtp_sdr_runner_t *runner);
+
+/**
+ * @fn void rtp_sdr_runner_stop(rtp_sdr_runner_t *runner)
+ * @brief Stop and join the threads. Sessions stay attached.
+ *
+ * @param runner
+ */
+void rtp_sdr_runner_stop(rtp_sdr_runner_t *runner);
+
+#endif /* RTP_SDR_RUNNER_H_ */
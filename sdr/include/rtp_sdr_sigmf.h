@@ -0,0 +1,176 @@
+/*
+ * Copyright 2023 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/rtp-sdr *
+ *
+ * This is based on other projects:
+ *      IDEA: https://github.com/OpenResearchInstitute/ka9q-sdr (not use any code of this)
+ *       RTP: https://github.com/Daxbot/librtp/
+ *       FEC: https://github.com/wesen/poc
+ *    SOCKET: https://github.com/njh/mast
+ *    OTHERS: see individual files
+ *
+ *    please contact their authors for more information.
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+#ifndef RTP_SDR_SIGMF_H_
+#define RTP_SDR_SIGMF_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "rtp_sdr_iq.h"
+#include "rtp_sdr_capture.h"
+
+#define RTP_SDR_SIGMF_DATA  ".sigmf-data" /**< samples file name suffix */
+#define RTP_SDR_SIGMF_META  ".sigmf-meta" /**< metadata file name suffix */
+#define RTP_SDR_SIGMF_LABEL 32            /**< longest annotation label kept, terminator included */
+#define RTP_SDR_SIGMF_TEXT  128           /**< longest annotation comment kept, terminator included */
+
+/**
+ * @struct rtp_sdr_sigmf_annotation_s
+ * @brief annotation of a range of samples
+ *
+ */
+typedef struct rtp_sdr_sigmf_annotation_s {
+    uint64_t sample_start;                 /**< first sample concerned */
+    uint64_t sample_count;                 /**< samples concerned (0: a point in the recording) */
+        char label[RTP_SDR_SIGMF_LABEL];   /**< short label, e.g. "packet loss" */
+        char comment[RTP_SDR_SIGMF_TEXT];  /**< details */
+} rtp_sdr_sigmf_annotation_t;              /**< annotation data type */
+
+/**
+ * @struct rtp_sdr_sigmf_info_s
+ * @brief recording description
+ *
+ */
+typedef struct rtp_sdr_sigmf_info_s {
+    iq_type_t type;         /**< i/q type of the samples (IQ_PT32 for ci32_le, also used for 24 bits) */
+      uint8_t channels;     /**< channels interleaved per timestamp */
+       double sample_rate;  /**< samples per second of every channel */
+       double frequency;    /**< center frequency of channel 0 in Hz */
+         char datetime[32]; /**< ISO 8601 UTC time of the first sample ("": unknown) */
+     uint64_t samples;      /**< samples per channel in the data file */
+} rtp_sdr_sigmf_info_t;     /**< recording description data type */
+
+typedef struct rtp_sdr_sigmf_s rtp_sdr_sigmf_t;                /**< opaque recording writer */
+typedef struct rtp_sdr_sigmf_file_s rtp_sdr_sigmf_file_t;      /**< opaque recording reader */
+
+/**
+ * @fn rtp_sdr_sigmf_t* rtp_sdr_sigmf_create(const char *base, rtp_sdr_capture_mode_t mode, session_iq_t *session)
+ * @brief Record the rx channels of a session as a SigMF recording: base.sigmf-data holds the samples in the
+ *        capture sink format (ci8, ci16_le or ci32_le, channels interleaved per timestamp) and base.sigmf-meta,
+ *        written on close, the sample rate, rx_frequency, the time of the first sample (from the sender's SRs
+ *        when available, otherwise the local clock) and one annotation per rtp sequence gap and
+ *        capture overrun. Takes over the session rx event callback until closed.
+ *
+ * @param base path without suffix
+ * @param mode data file i/o
+ * @param session
+ * @return recording or NULL on failure
+ */
+rtp_sdr_sigmf_t* rtp_sdr_sigmf_create(const char *base, rtp_sdr_capture_mode_t mode, session_iq_t *session);
+
+/**
+ * @fn size_t rtp_sdr_sigmf_write(rtp_sdr_sigmf_t *sigmf)
+ * @brief Move the samples buffered by the session rx channels to the recording (see rtp_sdr_capture_write()).
+ *
+ * @param sigmf
+ * @return samples per channel written
+ */
+size_t rtp_sdr_sigmf_write(rtp_sdr_sigmf_t *sigmf);
+
+/**
+ * @fn uint8_t rtp_sdr_sigmf_annotate(rtp_sdr_sigmf_t *sigmf, uint64_t sample_start, uint64_t sample_count, const char *label, const char *comment)
+ * @brief Add an annotation. May be called from any thread.
+ *
+ * @param sigmf
+ * @param sample_start first sample concerned in the data file
+ * @param sample_count samples concerned (0: a point in the recording)
+ * @param label truncated to RTP_SDR_SIGMF_LABEL
+ * @param comment truncated to RTP_SDR_SIGMF_TEXT (NULL: none)
+ * @return RTP_SDR_ERROR on allocation failure
+ */
+uint8_t rtp_sdr_sigmf_annotate(rtp_sdr_sigmf_t *sigmf, uint64_t sample_start, uint64_t sample_count, const char *label, const char *comment);
+
+/**
+ * @fn uint8_t rtp_sdr_sigmf_close(rtp_sdr_sigmf_t *sigmf, uint64_t *samples, uint64_t *overruns)
+ * @brief Release the session rx event callback, close the data file, write the metadata and free the writer.
+ *
+ * @param sigmf
+ * @param samples samples per channel recorded (NULL: not needed)
+ * @param overruns samples lost to capture overruns (NULL: not needed)
+ * @return RTP_SDR_ERROR if a write failed
+ */
+uint8_t rtp_sdr_sigmf_close(rtp_sdr_sigmf_t *sigmf, uint64_t *samples, uint64_t *overruns);
+
+/**
+ * @fn rtp_sdr_sigmf_file_t* rtp_sdr_sigmf_open(const char *base)
+ * @brief Open a SigMF recording of complex integer samples (ci8, ci16_le, ci32_le) for replay. The data file
+ *        is mapped: samples are read in place, and seeking in a recording of any size costs nothing.
+ *
+ * @param base path without suffix
+ * @return recording or NULL if missing, unreadable or of an unsupported datatype
+ */
+rtp_sdr_sigmf_file_t* rtp_sdr_sigmf_open(const char *base);
+
+/**
+ * @fn const rtp_sdr_sigmf_info_t* rtp_sdr_sigmf_info(rtp_sdr_sigmf_file_t *file)
+ * @brief Recording description.
+ *
+ * @param file
+ * @return description, valid until rtp_sdr_sigmf_free()
+ */
+const rtp_sdr_sigmf_info_t* rtp_sdr_sigmf_info(rtp_sdr_sigmf_file_t *file);
+
+/**
+ * @fn const uint8_t* rtp_sdr_sigmf_samples(rtp_sdr_sigmf_file_t *file, uint64_t sample, uint64_t *count)
+ * @brief Samples from a position, in the data file format.
+ *
+ * @param file
+ * @param sample first sample (timestamp)
+ * @param count samples per channel available from there
+ * @return first sample or NULL past the end, valid until rtp_sdr_sigmf_free()
+ */
+const uint8_t* rtp_sdr_sigmf_samples(rtp_sdr_sigmf_file_t *file, uint64_t sample, uint64_t *count);
+
+/**
+ * @fn size_t rtp_sdr_sigmf_annotations(rtp_sdr_sigmf_file_t *file, const rtp_sdr_sigmf_annotation_t **annotations)
+ * @brief Annotations of the recording, sorted by sample_start.
+ *
+ * @param file
+ * @param annotations first annotation, valid until rtp_sdr_sigmf_free()
+ * @return annotations
+ */
+size_t rtp_sdr_sigmf_annotations(rtp_sdr_sigmf_file_t *file, const rtp_sdr_sigmf_annotation_t **annotations);
+
+/**
+ * @fn void rtp_sdr_sigmf_free(rtp_sdr_sigmf_file_t *file)
+ * @brief Unmap and free a recording.
+ *
+ * @param file
+ */
+void rtp_sdr_sigmf_free(rtp_sdr_sigmf_file_t *file);
+
+#endif /* RTP_SDR_SIGMF_H_ */
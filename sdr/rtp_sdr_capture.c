@@ -0,0 +1,436 @@
+/*
+ * Copyright 2023 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/rtp-sdr *
+ *
+ * This is based on other projects:
+ *      IDEA: https://github.com/OpenResearchInstitute/ka9q-sdr (not use any code of this)
+ *       RTP: https://github.com/Daxbot/librtp/
+ *       FEC: https://github.com/wesen/poc
+ *    SOCKET: https://github.com/njh/mast
+ *    OTHERS: see individual files
+ *
+ *    please contact their authors for more information.
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // O_DIRECT, sync_file_range, fallocate
+#endif
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "rtp_sdr_capture.h"
+#include "rtp_sdr_iq.h"
+#include "rtp_sdr_rbuf.h"
+
+struct rtp_sdr_capture_s {
+    rtp_sdr_capture_mode_t mode;     /**< file i/o */
+                       int fd;       /**< capture file */
+                 iq_type_t type;     /**< i/q type of the rings */
+                   uint8_t channels; /**< rings written together */
+                    size_t width;    /**< bytes per i or q component in the file */
+                    size_t frame;    /**< bytes per timestamp: every channel i and q */
+                    size_t chunk;    /**< bytes per buffer (direct) or window (mmap) */
+                   uint8_t *dest;    /**< buffer or window being filled */
+                    size_t fill;     /**< bytes of dest filled */
+                  uint64_t bytes;    /**< bytes captured */
+                  uint64_t overruns; /**< samples the rings dropped while capturing */
+                  uint64_t *dropped; /**< rtp_sdr_rbuf_dropped() of each ring when last seen (UINT64_MAX: not seen yet) */
+                      iq_t *block;   /**< samples taken from the rings, RTP_SDR_CAPTURE_BLOCK per channel */
+                   uint8_t *stage;   /**< packed block that straddles two buffers / windows */
+                      bool error;    /**< a write failed */
+                   uint8_t *buf[2];  /**< direct: aligned buffers */
+                       int cur;      /**< direct: buffer being filled */
+                       int pending;  /**< direct: buffer handed to the writer (-1: none) */
+                      bool stop;     /**< direct: writer must return */
+                  uint64_t offset;   /**< direct: file offset of the next write; mmap: of dest */
+                 pthread_t writer;   /**< direct: writer thread */
+           pthread_mutex_t lock;     /**< direct: protects pending, stop, offset, error */
+            pthread_cond_t cond;     /**< direct: pending changed */
+                   uint8_t *prev;    /**< mmap: previous window, being written back (NULL: none) */
+};
+
+// Bytes per i or q component stored: 24 bits are kept in 32.
+static size_t _width(iq_type_t type) {
+    switch (type) {
+        case IQ_PT8:
+            return 1;
+        case IQ_PT16:
+        case IQ_PTC16:
+            return 2;
+        case IQ_PT24:
+        case IQ_PT32:
+            return 4;
+        default:
+            return 0;
+    }
+}
+
+static bool _pwrite_all(int fd, const uint8_t *data, size_t len, uint64_t offset) {
+    ssize_t n;
+
+    while (len > 0) {
+        n = pwrite(fd, data, len, offset);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        data += n;
+        len -= n;
+        offset += n;
+    }
+
+    return true;
+}
+
+static void* _writer(void *arg) {
+    rtp_sdr_capture_t *cap = (rtp_sdr_capture_t*) arg;
+    uint64_t offset;
+    bool ok;
+    int idx;
+
+    pthread_mutex_lock(&(cap->lock));
+    while (1) {
+        while (cap->pending < 0 && !cap->stop)
+            pthread_cond_wait(&(cap->cond), &(cap->lock));
+        if (cap->pending < 0)
+            break;
+
+        idx = cap->pending;
+        offset = cap->offset;
+        pthread_mutex_unlock(&(cap->lock));
+
+        ok = _pwrite_all(cap->fd, cap->buf[idx], cap->chunk, offset);
+
+        pthread_mutex_lock(&(cap->lock));
+        if (!ok)
+            cap->error = true;
+        cap->offset += cap->chunk;
+        cap->pending = -1;
+        pthread_cond_broadcast(&(cap->cond));
+    }
+    pthread_mutex_unlock(&(cap->lock));
+
+    return NULL;
+}
+
+// Direct: hand the full buffer to the writer and continue in the other one.
+static void _direct_next(rtp_sdr_capture_t *cap) {
+    pthread_mutex_lock(&(cap->lock));
+    while (cap->pending >= 0)
+        pthread_cond_wait(&(cap->cond), &(cap->lock));
+    cap->pending = cap->cur;
+    pthread_cond_broadcast(&(cap->cond));
+    pthread_mutex_unlock(&(cap->lock));
+
+    cap->cur ^= 1;
+    cap->dest = cap->buf[cap->cur];
+    cap->fill = 0;
+}
+
+// Mmap: retire the window before the full one, start the writeback of the full one and map the next.
+static bool _mmap_next(rtp_sdr_capture_t *cap) {
+    uint64_t next = cap->dest != NULL ? cap->offset + cap->chunk : 0;
+
+    // Its writeback was started one window ago, so this rarely waits
+    if (cap->prev != NULL) {
+        msync(cap->prev, cap->chunk, MS_SYNC);
+        madvise(cap->prev, cap->chunk, MADV_DONTNEED);
+        munmap(cap->prev, cap->chunk);
+        posix_fadvise(cap->fd, cap->offset - cap->chunk, cap->chunk, POSIX_FADV_DONTNEED);
+        cap->prev = NULL;
+    }
+
+    // MS_ASYNC alone does not start any i/o on Linux, sync_file_range() does without waiting
+    if (cap->dest != NULL) {
+        msync(cap->dest, cap->chunk, MS_ASYNC);
+        sync_file_range(cap->fd, cap->offset, cap->chunk, SYNC_FILE_RANGE_WRITE);
+        cap->prev = cap->dest;
+        cap->dest = NULL;
+    }
+
+    // Allocate the blocks up front so that page faults do not allocate on the file system
+    if (fallocate(cap->fd, 0, next, cap->chunk) < 0 && ftruncate(cap->fd, next + cap->chunk) < 0)
+        return false;
+
+    void *map = mmap(NULL, cap->chunk, PROT_READ | PROT_WRITE, MAP_SHARED, cap->fd, next);
+    if (map == MAP_FAILED)
+        return false;
+    madvise(map, cap->chunk, MADV_SEQUENTIAL);
+
+    cap->dest = map;
+    cap->offset = next;
+    cap->fill = 0;
+
+    return true;
+}
+
+// Pack n samples of every channel from block, interleaved per timestamp, little endian.
+static void _pack(rtp_sdr_capture_t *cap, size_t n, uint8_t *out) {
+    const iq_t *in;
+    uint8_t *pos;
+    size_t k;
+    uint8_t ch;
+
+    for (ch = 0; ch < cap->channels; ch++) {
+        in = cap->block + ch * RTP_SDR_CAPTURE_BLOCK;
+        pos = out + ch * 2 * cap->width;
+        switch (cap->width) {
+            case 1:
+                for (k = 0; k < n; k++, pos += cap->frame) {
+                    pos[0] = (uint8_t) in[k].i.s8;
+                    pos[1] = (uint8_t) in[k].q.s8;
+                }
+                break;
+            case 2:
+                for (k = 0; k < n; k++, pos += cap->frame) {
+                    uint16_t i = (uint16_t) in[k].i.s16, q = (uint16_t) in[k].q.s16;
+                    pos[0] = i;
+                    pos[1] = i >> 8;
+                    pos[2] = q;
+                    pos[3] = q >> 8;
+                }
+                break;
+            default:
+                for (k = 0; k < n; k++, pos += cap->frame) {
+                    uint32_t i = (uint32_t) in[k].i.s24_s32, q = (uint32_t) in[k].q.s24_s32;
+                    pos[0] = i;
+                    pos[1] = i >> 8;
+                    pos[2] = i >> 16;
+                    pos[3] = i >> 24;
+                    pos[4] = q;
+                    pos[5] = q >> 8;
+                    pos[6] = q >> 16;
+                    pos[7] = q >> 24;
+                }
+                break;
+        }
+    }
+}
+
+// Move to the next buffer or window once dest is full.
+static bool _next(rtp_sdr_capture_t *cap) {
+    if (cap->mode == RTP_SDR_CAPTURE_MMAP)
+        return _mmap_next(cap);
+
+    _direct_next(cap);
+    return true;
+}
+
+rtp_sdr_capture_t* rtp_sdr_capture_open(const char *path, rtp_sdr_capture_mode_t mode, iq_type_t type, uint8_t channels, size_t chunk) {
+    rtp_sdr_capture_t *cap;
+
+    if (_width(type) == 0 || channels == 0)
+        return NULL;
+
+    cap = calloc(1, sizeof(rtp_sdr_capture_t));
+    if (cap == NULL)
+        return NULL;
+
+    if (chunk == 0)
+        chunk = RTP_SDR_CAPTURE_CHUNK;
+    cap->chunk = (chunk + RTP_SDR_CAPTURE_ALIGN - 1) / RTP_SDR_CAPTURE_ALIGN * RTP_SDR_CAPTURE_ALIGN;
+    cap->mode = mode;
+    cap->type = type;
+    cap->channels = channels;
+    cap->width = _width(type);
+    cap->frame = channels * 2 * cap->width;
+    cap->pending = -1;
+    cap->fd = -1;
+
+    cap->block = malloc(sizeof(iq_t) * RTP_SDR_CAPTURE_BLOCK * channels);
+    cap->stage = malloc(cap->frame * RTP_SDR_CAPTURE_BLOCK);
+    cap->dropped = malloc(sizeof(uint64_t) * channels);
+    if (cap->block == NULL || cap->stage == NULL || cap->dropped == NULL)
+        goto error;
+    memset(cap->dropped, 0xff, sizeof(uint64_t) * channels);
+
+    if (mode == RTP_SDR_CAPTURE_DIRECT) {
+        cap->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+        if (cap->fd < 0 && errno == EINVAL) {
+            fprintf(stderr, "capture: O_DIRECT not supported on %s, using buffered writes\n", path);
+            cap->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        }
+        if (cap->fd < 0)
+            goto error;
+
+        if (posix_memalign((void**) &(cap->buf[0]), RTP_SDR_CAPTURE_ALIGN, cap->chunk) != 0)
+            goto error;
+        if (posix_memalign((void**) &(cap->buf[1]), RTP_SDR_CAPTURE_ALIGN, cap->chunk) != 0)
+            goto error;
+        cap->dest = cap->buf[0];
+
+        pthread_mutex_init(&(cap->lock), NULL);
+        pthread_cond_init(&(cap->cond), NULL);
+        if (pthread_create(&(cap->writer), NULL, _writer, cap) != 0) {
+            pthread_cond_destroy(&(cap->cond));
+            pthread_mutex_destroy(&(cap->lock));
+            goto error;
+        }
+    } else {
+        cap->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (cap->fd < 0 || !_mmap_next(cap))
+            goto error;
+    }
+
+    return cap;
+
+    error:
+    if (cap->fd >= 0)
+        close(cap->fd);
+    free(cap->buf[0]);
+    free(cap->buf[1]);
+    free(cap->block);
+    free(cap->stage);
+    free(cap->dropped);
+    free(cap);
+    return NULL;
+}
+
+size_t rtp_sdr_capture_write(rtp_sdr_capture_t *cap, rbuf_handle_t *channel) {
+    size_t size, avail, n, len, room, part, total = 0;
+    uint64_t dropped;
+    uint8_t ch;
+
+    avail = rtp_sdr_rbuf_size(&channel[0]);
+    for (ch = 0; ch < cap->channels; ch++) {
+        // Only what the rings lost since the first call is the capture's fault
+        dropped = rtp_sdr_rbuf_dropped(&channel[ch]);
+        if (cap->dropped[ch] != UINT64_MAX)
+            cap->overruns += dropped - cap->dropped[ch];
+        cap->dropped[ch] = dropped;
+        size = rtp_sdr_rbuf_size(&channel[ch]);
+        if (size < avail)
+            avail = size;
+    }
+
+    while (avail > 0 && cap->dest != NULL) {
+        n = avail < RTP_SDR_CAPTURE_BLOCK ? avail : RTP_SDR_CAPTURE_BLOCK;
+        for (ch = 0; ch < cap->channels; ch++)
+            rtp_sdr_rbuf_read(&channel[ch], cap->block + ch * RTP_SDR_CAPTURE_BLOCK, n);
+
+        len = n * cap->frame;
+        room = cap->chunk - cap->fill;
+        if (len <= room) {
+            // Common case: packed straight into the buffer or window
+            _pack(cap, n, cap->dest + cap->fill);
+            cap->fill += len;
+        } else {
+            _pack(cap, n, cap->stage);
+            for (part = 0; part < len; part += room) {
+                room = cap->chunk - cap->fill;
+                if (room > len - part)
+                    room = len - part;
+                memcpy(cap->dest + cap->fill, cap->stage + part, room);
+                cap->fill += room;
+                if (cap->fill == cap->chunk && !_next(cap)) {
+                    cap->error = true;
+                    cap->dest = NULL;
+                    break;
+                }
+            }
+        }
+
+        if (cap->dest != NULL && cap->fill == cap->chunk && !_next(cap)) {
+            cap->error = true;
+            cap->dest = NULL;
+        }
+
+        cap->bytes += len;
+        avail -= n;
+        total += n;
+    }
+
+    return total;
+}
+
+void rtp_sdr_capture_stats(rtp_sdr_capture_t *cap, uint64_t *samples, uint64_t *overruns) {
+    if (samples != NULL)
+        *samples = cap->bytes / cap->frame;
+    if (overruns != NULL)
+        *overruns = cap->overruns;
+}
+
+uint8_t rtp_sdr_capture_close(rtp_sdr_capture_t *cap, uint64_t *samples, uint64_t *overruns) {
+    bool error;
+
+    if (cap->mode == RTP_SDR_CAPTURE_DIRECT) {
+        // Wait for the writer, then write the last partial buffer padded to the alignment
+        pthread_mutex_lock(&(cap->lock));
+        while (cap->pending >= 0)
+            pthread_cond_wait(&(cap->cond), &(cap->lock));
+        cap->stop = true;
+        pthread_cond_broadcast(&(cap->cond));
+        pthread_mutex_unlock(&(cap->lock));
+        pthread_join(cap->writer, NULL);
+
+        if (cap->fill > 0) {
+            size_t len = (cap->fill + RTP_SDR_CAPTURE_ALIGN - 1) / RTP_SDR_CAPTURE_ALIGN * RTP_SDR_CAPTURE_ALIGN;
+            memset(cap->dest + cap->fill, 0, len - cap->fill);
+            if (!_pwrite_all(cap->fd, cap->dest, len, cap->offset))
+                cap->error = true;
+        }
+        pthread_cond_destroy(&(cap->cond));
+        pthread_mutex_destroy(&(cap->lock));
+        free(cap->buf[0]);
+        free(cap->buf[1]);
+    } else {
+        if (cap->prev != NULL) {
+            msync(cap->prev, cap->chunk, MS_SYNC);
+            munmap(cap->prev, cap->chunk);
+        }
+        if (cap->dest != NULL) {
+            if (msync(cap->dest, cap->chunk, MS_SYNC) < 0)
+                cap->error = true;
+            munmap(cap->dest, cap->chunk);
+        }
+    }
+
+    // Drop the padding and the unused part of the last window
+    if (ftruncate(cap->fd, cap->bytes) < 0 || close(cap->fd) < 0)
+        cap->error = true;
+
+    if (samples != NULL)
+        *samples = cap->bytes / cap->frame;
+    if (overruns != NULL)
+        *overruns = cap->overruns;
+
+    error = cap->error;
+    free(cap->block);
+    free(cap->stage);
+    free(cap->dropped);
+    free(cap);
+
+    return error ? RTP_SDR_ERROR : RTP_SDR_OK;
+}
@@ -0,0 +1,400 @@
+/*
+ * Copyright 2023 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/rtp-sdr *
+ *
+ * This is based on other projects:
+ *      IDEA: https://github.com/OpenResearchInstitute/ka9q-sdr (not use any code of this)
+ *       RTP: https://github.com/Daxbot/librtp/
+ *       FEC: https://github.com/wesen/poc
+ *    SOCKET: https://github.com/njh/mast
+ *    OTHERS: see individual files
+ *
+ *    please contact their authors for more information.
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "rtp_sdr_codec.h"
+#include "rtp_sdr_rbuf.h"
+
+#define CODEC_VERBATIM   3  // stream header order of a stream sent raw
+#define CODEC_RAW_BITS  16  // bits per raw component
+#define CODEC_ESC_BITS  18  // bits per escaped residual: an order 2 residual of 16 bit samples zigzags to 18
+#define CODEC_K_MAX     (CODEC_ESC_BITS - 1)
+
+// Bit writer, least significant bit first.
+typedef struct bits_writer_s {
+    uint64_t acc;  // pending bits
+    unsigned bits; // pending bits count, less than 32 between calls
+     uint8_t *pos; // next byte
+} bits_writer_t;
+
+// Bit reader, least significant bit first. Reads past the end as zeros, see _consumed().
+typedef struct bits_reader_s {
+         uint64_t acc;   // bits not consumed yet
+         unsigned bits;  // bits in acc
+    const uint8_t *pos;  // next byte
+    const uint8_t *end;  // end of the payload
+           size_t extra; // zero bytes read past the end
+} bits_reader_t;
+
+static inline void _put(bits_writer_t *w, uint32_t value, unsigned n) {
+    w->acc |= (uint64_t) value << w->bits;
+    w->bits += n;
+    if (w->bits >= 32) {
+        w->pos[0] = w->acc;
+        w->pos[1] = w->acc >> 8;
+        w->pos[2] = w->acc >> 16;
+        w->pos[3] = w->acc >> 24;
+        w->pos += 4;
+        w->acc >>= 32;
+        w->bits -= 32;
+    }
+}
+
+static void _flush(bits_writer_t *w) {
+    while (w->bits > 0) {
+        *w->pos++ = w->acc;
+        w->acc >>= 8;
+        w->bits = w->bits > 8 ? w->bits - 8 : 0;
+    }
+}
+
+// Top up to at least 57 bits: enough for the longest code.
+static inline void _fill(bits_reader_t *r) {
+    if (r->bits <= 32 && r->end - r->pos >= 4) {
+        r->acc |= (uint64_t) (r->pos[0] | r->pos[1] << 8 | r->pos[2] << 16 | (uint32_t) r->pos[3] << 24) << r->bits;
+        r->pos += 4;
+        r->bits += 32;
+    }
+    while (r->bits <= 56) {
+        if (r->pos < r->end)
+            r->acc |= (uint64_t) *r->pos++ << r->bits;
+        else
+            r->extra++;
+        r->bits += 8;
+    }
+}
+
+static inline uint32_t _get(bits_reader_t *r, unsigned n) {
+    uint32_t value = (uint32_t) (r->acc & ((1ULL << n) - 1));
+
+    r->acc >>= n;
+    r->bits -= n;
+
+    return value;
+}
+
+// Whether more bits were consumed than the payload holds.
+static bool _overrun(const bits_reader_t *r) {
+    return r->extra * 8 > r->bits;
+}
+
+static inline uint32_t _zigzag(int32_t v) {
+    return ((uint32_t) v << 1) ^ (uint32_t) (v >> 31);
+}
+
+static inline int32_t _unzigzag(uint32_t v) {
+    return (int32_t) (v >> 1) ^ -(int32_t) (v & 1);
+}
+
+static inline int32_t _component(const iq_t *s, bool q) {
+    return q ? s->q.s16 : s->i.s16;
+}
+
+// Residual of sample n (n >= order) for a predictor order.
+static inline int32_t _residual(const iq_t *s, bool q, uint32_t n, unsigned order) {
+    int32_t x = _component(&s[n], q);
+
+    switch (order) {
+        case 0:
+            return x;
+        case 1:
+            return x - _component(&s[n - 1], q);
+        default:
+            return x - 2 * _component(&s[n - 1], q) + _component(&s[n - 2], q);
+    }
+}
+
+// Rice code length of a zigzagged residual.
+static inline uint32_t _rice_bits(uint32_t v, unsigned k) {
+    uint32_t quotient = v >> k;
+
+    return quotient < RTP_SDR_CODEC_ESCAPE ? quotient + 1 + k : RTP_SDR_CODEC_ESCAPE + CODEC_ESC_BITS;
+}
+
+// Choose the predictor order and rice parameter of a stream, returns the stream header.
+static uint8_t _choose(const iq_t *s, bool q, uint32_t samples) {
+    uint64_t sum[3] = { 0, 0, 0 }, bits;
+    unsigned order, best = 0, k = 0;
+    uint32_t n, mean;
+
+    // Smallest mean residual among the orders, over the samples all of them predict
+    for (n = 2; n < samples; n++) {
+        sum[0] += _zigzag(_residual(s, q, n, 0));
+        sum[1] += _zigzag(_residual(s, q, n, 1));
+        sum[2] += _zigzag(_residual(s, q, n, 2));
+    }
+    for (order = 1; order < 3; order++)
+        if (sum[order] < sum[best])
+            best = order;
+    if (samples <= best)
+        return CODEC_VERBATIM;
+
+    // Rice parameter near log2 of the mean
+    mean = samples > 2 ? (uint32_t) (sum[best] / (samples - 2)) : 0;
+    while (k < CODEC_K_MAX && (mean >> (k + 1)) > 0)
+        k++;
+
+    bits = (uint64_t) best * CODEC_RAW_BITS;
+    for (n = best; n < samples; n++)
+        bits += _rice_bits(_zigzag(_residual(s, q, n, best)), k);
+    if (bits >= (uint64_t) samples * CODEC_RAW_BITS)
+        return CODEC_VERBATIM;
+
+    return best | k << 2;
+}
+
+static void _encode_stream(bits_writer_t *w, const iq_t *s, bool q, uint32_t samples, uint8_t header) {
+    unsigned order = header & 3, k = header >> 2;
+    uint32_t n, v, quotient;
+
+    if (order == CODEC_VERBATIM) {
+        for (n = 0; n < samples; n++)
+            _put(w, (uint16_t) _component(&s[n], q), CODEC_RAW_BITS);
+        return;
+    }
+
+    for (n = 0; n < order; n++)
+        _put(w, (uint16_t) _component(&s[n], q), CODEC_RAW_BITS);
+
+    for (n = order; n < samples; n++) {
+        v = _zigzag(_residual(s, q, n, order));
+        quotient = v >> k;
+        if (quotient < RTP_SDR_CODEC_ESCAPE) {
+            _put(w, (1U << quotient) - 1, quotient + 1);
+            _put(w, v & ((1U << k) - 1), k);
+        } else {
+            _put(w, (1U << RTP_SDR_CODEC_ESCAPE) - 1, RTP_SDR_CODEC_ESCAPE);
+            _put(w, v, CODEC_ESC_BITS);
+        }
+    }
+}
+
+static bool _decode_stream(bits_reader_t *r, iq_t *s, bool q, uint32_t samples, uint8_t header) {
+    unsigned order = header & 3, k = header >> 2;
+    int32_t x, x1 = 0, x2 = 0;
+    uint32_t n, v, quotient;
+
+    if (order == CODEC_VERBATIM)
+        order = samples; // every sample raw
+    else if (k > CODEC_K_MAX)
+        return false;
+
+    for (n = 0; n < samples; n++) {
+        _fill(r);
+        if (n < order) {
+            x = (int16_t) _get(r, CODEC_RAW_BITS);
+        } else {
+            quotient = __builtin_ctzll(~r->acc | (1ULL << RTP_SDR_CODEC_ESCAPE));
+            if (quotient < RTP_SDR_CODEC_ESCAPE) {
+                _get(r, quotient + 1);
+                v = quotient << k | _get(r, k);
+            } else {
+                _get(r, RTP_SDR_CODEC_ESCAPE);
+                v = _get(r, CODEC_ESC_BITS);
+            }
+            x = _unzigzag(v);
+            if (order == 1)
+                x += x1;
+            else if (order == 2)
+                x += 2 * x1 - x2;
+        }
+
+        if (q)
+            s[n].q.s16 = (int16_t) x;
+        else
+            s[n].i.s16 = (int16_t) x;
+        x2 = x1;
+        x1 = (int16_t) x;
+    }
+
+    return !_overrun(r);
+}
+
+size_t rtp_sdr_codec_encode(const iq_t *block, uint32_t samples, uint8_t qty, uint8_t *payload) {
+    bits_writer_t w = { 0, 0, payload + RTP_SDR_CODEC_HEADER(qty) };
+    unsigned stream;
+
+    payload[0] = samples;
+    payload[1] = samples >> 8;
+
+    for (stream = 0; stream < 2U * qty; stream++)
+        payload[2 + stream] = _choose(block + (stream / 2) * samples, stream & 1, samples);
+    for (stream = 0; stream < 2U * qty; stream++)
+        _encode_stream(&w, block + (stream / 2) * samples, stream & 1, samples, payload[2 + stream]);
+    _flush(&w);
+
+    return w.pos - payload;
+}
+
+int rtp_sdr_codec_decode(const uint8_t *payload, size_t len, uint8_t qty, iq_t *block, uint32_t max) {
+    bits_reader_t r;
+    uint32_t samples;
+    unsigned stream;
+
+    if (qty == 0 || len < (size_t) RTP_SDR_CODEC_HEADER(qty))
+        return -1;
+
+    samples = payload[0] | payload[1] << 8;
+    if (samples > max)
+        return -1;
+
+    memset(&r, 0, sizeof(r));
+    r.pos = payload + RTP_SDR_CODEC_HEADER(qty);
+    r.end = payload + len;
+
+    for (stream = 0; stream < 2U * qty; stream++) {
+        if (!_decode_stream(&r, block + (stream / 2) * samples, stream & 1, samples, payload[2 + stream]))
+            return -1;
+    }
+
+    return samples;
+}
+
+#ifdef RTP_SDR_CODEC_TEST
+#include <stdio.h>
+#include <math.h>
+
+#define TEST_SAMPLES 256
+#define TEST_QTY_MAX 8
+
+void testit(char *name, int result, int should) {
+    if (result == should) {
+        printf("Test %s was successful\n", name);
+    }
+    else {
+        printf("Test %s was not successful, %d should have been %d\n", name, result, should);
+    }
+}
+
+// Fill every stream of a block. kind 0: random, 1: tone, 2: full scale alternating, 3: parabola with spikes.
+static void fill(iq_t *block, uint8_t qty, int kind) {
+    uint32_t n, ch;
+
+    for (ch = 0; ch < qty; ch++) {
+        for (n = 0; n < TEST_SAMPLES; n++) {
+            iq_t *s = &block[ch * TEST_SAMPLES + n];
+            switch (kind) {
+                case 0:
+                    s->i.s16 = (int16_t) rand();
+                    s->q.s16 = (int16_t) rand();
+                    break;
+                case 1:
+                    s->i.s16 = (int16_t) lrint(3000 * cos(0.05 * n + ch));
+                    s->q.s16 = (int16_t) lrint(3000 * sin(0.05 * n + ch));
+                    break;
+                case 2:
+                    s->i.s16 = n & 1 ? 32767 : -32767;
+                    s->q.s16 = n & 1 ? -32767 : 32767;
+                    break;
+                default:
+                    s->i.s16 = (int16_t) (n * n / 4 - 8192 + (n % 64 == 63 ? 50 : 0));
+                    s->q.s16 = (int16_t) (8192 - n * n / 4 - (n % 64 == 31 ? 50 : 0));
+                    break;
+            }
+        }
+    }
+}
+
+// Encode, check the length bound and decode back.
+static int roundtrip(const iq_t *block, uint8_t qty, uint8_t *payload, size_t *len) {
+    static iq_t out[TEST_SAMPLES * TEST_QTY_MAX];
+    uint32_t n;
+
+    *len = rtp_sdr_codec_encode(block, TEST_SAMPLES, qty, payload);
+    if (*len > (size_t) RTP_SDR_CODEC_HEADER(qty) + TEST_SAMPLES * qty * 4)
+        return 0;
+    if (rtp_sdr_codec_decode(payload, *len, qty, out, TEST_SAMPLES) != TEST_SAMPLES)
+        return 0;
+
+    for (n = 0; n < TEST_SAMPLES * qty; n++) {
+        if (out[n].i.s16 != block[n].i.s16 || out[n].q.s16 != block[n].q.s16)
+            return 0;
+    }
+
+    return 1;
+}
+
+int main(void) {
+    static iq_t block[TEST_SAMPLES * TEST_QTY_MAX], out[TEST_SAMPLES * TEST_QTY_MAX];
+    static uint8_t payload[RTP_SDR_CODEC_HEADER(TEST_QTY_MAX) + TEST_SAMPLES * TEST_QTY_MAX * 4];
+    const uint8_t qtys[] = { 1, 4, 8 };
+    const char *kinds[] = { "random", "tone", "extreme", "spiky parabola" };
+    char name[64];
+    size_t len;
+    int kind, q, ok;
+
+    srand(1);
+    for (kind = 0; kind < 4; kind++) {
+        for (q = 0; q < 3; q++) {
+            fill(block, qtys[q], kind);
+            snprintf(name, sizeof(name), "%s qty %u round trip", kinds[kind], qtys[q]);
+            testit(name, roundtrip(block, qtys[q], payload, &len), 1);
+        }
+    }
+
+    // A parabola is predicted by order 2 within a unit, its spikes take the escape code
+    fill(block, 1, 3);
+    roundtrip(block, 1, payload, &len);
+    testit("spiky parabola codes order 2", payload[2] & 3, 2);
+
+    fill(block, 1, 1);
+    roundtrip(block, 1, payload, &len);
+    testit("tone compresses", len < (size_t) TEST_SAMPLES * 4 / 2, 1);
+
+    // Malformed payloads
+    fill(block, 4, 1);
+    roundtrip(block, 4, payload, &len);
+    testit("truncated payload", rtp_sdr_codec_decode(payload, len - 1, 4, out, TEST_SAMPLES), -1);
+    testit("truncated header", rtp_sdr_codec_decode(payload, RTP_SDR_CODEC_HEADER(4) - 1, 4, out, TEST_SAMPLES), -1);
+    testit("more samples than room", rtp_sdr_codec_decode(payload, len, 4, out, TEST_SAMPLES - 1), -1);
+    testit("wrong channel count", rtp_sdr_codec_decode(payload, len, 8, out, TEST_SAMPLES) == TEST_SAMPLES, 0);
+
+    ok = payload[2];
+    payload[2] = (CODEC_K_MAX + 1) << 2;
+    testit("rice parameter out of range", rtp_sdr_codec_decode(payload, len, 4, out, TEST_SAMPLES), -1);
+    payload[2] = ok;
+
+    payload[0] = (TEST_SAMPLES + 44) & 0xff;
+    payload[1] = (TEST_SAMPLES + 44) >> 8;
+    testit("sample count past the payload", rtp_sdr_codec_decode(payload, len, 4, out, TEST_SAMPLES * TEST_QTY_MAX / 4), -1);
+
+    return 0;
+}
+
+#endif /* RTP_SDR_CODEC_TEST */
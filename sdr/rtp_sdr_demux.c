@@ -0,0 +1,321 @@
+/*
+ * Copyright 2023 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/rtp-sdr *
+ *
+ * This is based on other projects:
+ *      IDEA: https://github.com/OpenResearchInstitute/ka9q-sdr (not use any code of this)
+ *       RTP: https://github.com/Daxbot/librtp/
+ *       FEC: https://github.com/wesen/poc
+ *    SOCKET: https://github.com/njh/mast
+ *    OTHERS: see individual files
+ *
+ *    please contact their authors for more information.
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "rtp_sdr_demux.h"
+#include "rtp_header.h"
+#include "rtp_util.h"
+#include "rtcp_util.h"
+#include "rtcp_compound.h"
+#include "rtp_sdr_rtcp.h"
+
+#define DEMUX_SWEEP_NS  1000000000ULL                            // route expiry period
+#define DEMUX_TIMEOUT_NS (RTP_SDR_DEMUX_TIMEOUT_S * 1000000000ULL) // route and refusal lifetime
+
+// Fixed rtp header fields, without allocating csrc / extension lists. Returns the header length or -1.
+static int _parse_header(const uint8_t *data, unsigned int len, rtp_header *header) {
+    unsigned int header_len;
+
+    if (len < 12 || (data[0] >> 6) != 2)
+        return -1;
+
+    memset(header, 0, sizeof(*header));
+    header->version = 2;
+    header->x = (data[0] >> 4) & 0x1;
+    header->cc = data[0] & 0xf;
+    header->m = (data[1] >> 7) & 0x1;
+    header->pt = data[1] & 0x7f;
+    header->seq = read_u16(data + 2);
+    header->ts = read_u32(data + 4);
+    header->ssrc = read_u32(data + 8);
+
+    header_len = 12 + 4 * header->cc;
+    if (header->x) {
+        if (len < header_len + 4)
+            return -1;
+        header_len += 4 + 4 * read_u16(data + header_len + 2);
+    }
+
+    return len < header_len ? -1 : (int) header_len;
+}
+
+// Arrival clock of the routes: ns since the epoch, as the kernel rx timestamps.
+static uint64_t _now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Hand the session of a dropped route back to its owner.
+static void _release(rtp_source_entry *route, void *arg) {
+    rtp_sdr_demux_t *demux = (rtp_sdr_demux_t*) arg;
+
+    if (demux->release_cb != NULL)
+        demux->release_cb(route->source.id, (session_iq_t) route->user, demux->release_arg);
+}
+
+// The sources leaving in the BYE packets of an rtcp compound lose their routes.
+static void _bye(rtp_sdr_demux_t *demux, const uint8_t *data, unsigned int len) {
+    rtp_source_entry *route;
+    rtcp_view view;
+    size_t offset = 0;
+    uint8_t n;
+
+    while (rtcp_compound_next(data, len, &offset, &view) > 0) {
+        if (view.pt != RTCP_BYE)
+            continue;
+        for (n = 0; n < view.count; n++) {
+            route = rtp_source_table_find(demux->routes, rtcp_view_bye_source(&view, n));
+            if (route == NULL)
+                continue;
+            _release(route, demux);
+            rtp_source_table_remove(demux->routes, route->source.id);
+        }
+    }
+}
+
+// First packet of an unrouted ssrc: ask the owner, remember a refusal so the callback runs once per timeout, not per packet.
+static rtp_source_entry* _route_new(rtp_sdr_demux_t *demux, const rtp_header *header, uint64_t now) {
+    rtp_source_entry *route = NULL;
+    session_iq_t session;
+
+    if (demux->new_cb == NULL || rtp_source_table_find(demux->rejected, header->ssrc) != NULL)
+        return NULL;
+
+    session = demux->new_cb(header->ssrc, header->pt, demux->new_arg);
+    if (session != NULL)
+        route = rtp_source_table_add(demux->routes, header->ssrc, now);
+
+    if (route == NULL) {
+        // No room for the route: the session goes back to the owner
+        if (session != NULL && demux->release_cb != NULL)
+            demux->release_cb(header->ssrc, session, demux->release_arg);
+        rtp_source_table_add(demux->rejected, header->ssrc, now);
+        return NULL;
+    }
+
+    route->user = session;
+    rtp_source_init(&(route->source), header->ssrc, header->seq);
+
+    return route;
+}
+
+// Hand one packet to the session of its ssrc: samples unpacked straight from the socket buffer.
+// coalesced: a later segment of a UDP_GRO datagram, arrival is that of the datagram.
+static void _dispatch(rtp_sdr_demux_t *demux, const uint8_t *data, unsigned int len, uint64_t arrival, bool coalesced) {
+    rtp_header header;
+    rtp_source_entry *route;
+    session_iq_t session;
+
+    // RFC 5761: rtcp multiplexed on the rtp port, routed by the ssrc of its first packet
+    if (len >= 8 && rtcp_type(data, len) > 0) {
+        route = rtp_source_table_find(demux->routes, read_u32(data + 4));
+        if (route == NULL || (session = (session_iq_t) route->user) == NULL) {
+            demux->unrouted++;
+            return;
+        }
+        route->last_seen = arrival != 0 ? arrival : _now();
+        rtp_sdr_rtcp_receive(&session, data, len);
+        _bye(demux, data, len);
+        return;
+    }
+
+    // Fec parity carries no ssrc and is not decoded on this side
+    if (len >= FEC_PKT_HDR_SIZE && data[0] == FEC_PKT_MAGIC)
+        return;
+
+    int header_len = _parse_header(data, len, &header);
+    if (header_len < 0) {
+        demux->malformed++;
+        return;
+    }
+
+    if (arrival == 0)
+        arrival = _now();
+
+    route = rtp_source_table_find(demux->routes, header.ssrc);
+    if (route == NULL)
+        route = _route_new(demux, &header, arrival);
+
+    if (route == NULL || (session = (session_iq_t) route->user) == NULL || header.pt != session->rx_type) {
+        demux->unrouted++;
+        return;
+    }
+
+    // Per stream arrival and sequence accounting on the entry already found; the session still validates the sequence for itself
+    route->last_seen = arrival;
+    route->flags |= RTP_SOURCE_SENDER;
+    rtp_source_update_seq(&(route->source), header.seq);
+    session->rx_coalesced = coalesced;
+    rcp_iq_receive_payload(&session, &header, data + header_len, len - header_len, arrival);
+    session->rx_coalesced = false;
+}
+
+rtp_sdr_demux_t* rtp_sdr_demux_create(const char *host, uint16_t port, unsigned int max_streams) {
+    rtp_sdr_demux_t *demux = (rtp_sdr_demux_t*) malloc(sizeof(rtp_sdr_demux_t));
+    if (demux == NULL)
+        return NULL;
+
+    memset(demux, 0, sizeof(rtp_sdr_demux_t));
+    demux->socket.fd = -1;
+    demux->routes = rtp_source_table_create(max_streams);
+    demux->rejected = rtp_source_table_create(max_streams);
+    demux->buf = malloc(RTP_SOCKET_GSO_MAX_BYTES);
+    if (demux->routes == NULL || demux->rejected == NULL || demux->buf == NULL)
+        goto error;
+
+    if (rtp_socket_open_recv(&(demux->socket), host, port, NULL) != RTP_OK)
+        goto error;
+
+    // Coalesced datagrams: one recvmsg() for a burst of packets of the same stream
+    rtp_socket_set_gro(&(demux->socket), true);
+
+    return demux;
+
+    error:
+    rtp_sdr_demux_free(demux);
+    return NULL;
+}
+
+void rtp_sdr_demux_free(rtp_sdr_demux_t *demux) {
+    if (demux == NULL)
+        return;
+
+    rtp_sdr_demux_loop_detach(demux);
+    if (demux->socket.fd >= 0)
+        rtp_socket_close(&(demux->socket));
+    rtp_source_table_free(demux->routes);
+    rtp_source_table_free(demux->rejected);
+    free(demux->buf);
+    free(demux);
+}
+
+uint8_t rtp_sdr_demux_add(rtp_sdr_demux_t *demux, uint32_t ssrc, session_iq_t session) {
+    rtp_source_entry *route = rtp_source_table_add(demux->routes, ssrc, _now());
+    if (route == NULL)
+        return RTP_SDR_ERROR;
+
+    route->user = session;
+    rtp_source_table_remove(demux->rejected, ssrc);
+
+    return RTP_SDR_OK;
+}
+
+void rtp_sdr_demux_remove(rtp_sdr_demux_t *demux, uint32_t ssrc) {
+    rtp_source_table_remove(demux->routes, ssrc);
+}
+
+void rtp_sdr_demux_on_new(rtp_sdr_demux_t *demux, rtp_sdr_demux_new_cb cb, void *arg) {
+    demux->new_cb = cb;
+    demux->new_arg = arg;
+}
+
+void rtp_sdr_demux_on_release(rtp_sdr_demux_t *demux, rtp_sdr_demux_release_cb cb, void *arg) {
+    demux->release_cb = cb;
+    demux->release_arg = arg;
+}
+
+unsigned int rtp_sdr_demux_expire(rtp_sdr_demux_t *demux) {
+    uint64_t now = _now();
+
+    demux->swept = now;
+    rtp_source_table_expire(demux->rejected, now, DEMUX_TIMEOUT_NS, NULL, NULL);
+
+    return rtp_source_table_expire(demux->routes, now, DEMUX_TIMEOUT_NS, _release, demux);
+}
+
+int rtp_sdr_demux_poll(rtp_sdr_demux_t *demux) {
+    unsigned int segment, offset;
+    int len, count = 0;
+
+    while ((len = rtp_socket_try_recv_gro(&(demux->socket), demux->buf, RTP_SOCKET_GSO_MAX_BYTES, &segment)) > 0) {
+        // The segments of a coalesced datagram share the arrival time, only the first one feeds the jitter
+        for (offset = 0; offset < (unsigned int) len; offset += segment)
+            _dispatch(demux, demux->buf + offset, len - offset < segment ? len - offset : segment, demux->socket.rx_tstamp, offset > 0);
+        count++;
+    }
+
+    // Without a loop timer this is the only place routes age out
+    if (demux->timer == NULL && _now() - demux->swept >= DEMUX_SWEEP_NS)
+        rtp_sdr_demux_expire(demux);
+
+    return len < 0 ? -1 : count;
+}
+
+static void _loop_rx(rtp_loop_t *loop, rtp_socket_t *sock, uint32_t events, void *arg) {
+    // Edge triggered: drain the socket
+    rtp_sdr_demux_poll((rtp_sdr_demux_t*) arg);
+}
+
+static void _loop_expire(rtp_loop_t *loop, uint64_t expirations, void *arg) {
+    rtp_sdr_demux_expire((rtp_sdr_demux_t*) arg);
+}
+
+uint8_t rtp_sdr_demux_loop_attach(rtp_sdr_demux_t *demux, rtp_loop_t *loop) {
+    rtp_sdr_demux_loop_detach(demux);
+
+    demux->source = rtp_loop_add_socket(loop, &(demux->socket), RTP_LOOP_IN, _loop_rx, demux);
+    if (demux->source == NULL)
+        return RTP_SDR_ERROR;
+    demux->loop = loop;
+
+    // Idle streams expire even when no packet wakes the loop
+    demux->timer = rtp_loop_add_timer(loop, DEMUX_SWEEP_NS, DEMUX_SWEEP_NS, _loop_expire, demux);
+    if (demux->timer == NULL) {
+        rtp_sdr_demux_loop_detach(demux);
+        return RTP_SDR_ERROR;
+    }
+
+    return RTP_SDR_OK;
+}
+
+void rtp_sdr_demux_loop_detach(rtp_sdr_demux_t *demux) {
+    if (demux->loop == NULL)
+        return;
+
+    rtp_loop_remove(demux->loop, demux->source);
+    if (demux->timer != NULL)
+        rtp_loop_remove(demux->loop, demux->timer);
+    demux->source = NULL;
+    demux->timer = NULL;
+    demux->loop = NULL;
+}
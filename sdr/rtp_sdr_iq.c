@@ -42,51 +42,368 @@
 #include <string.h>
 #include <unistd.h>
 #include <sys/time.h>
+#include <time.h>
+#include <math.h>
 
 #include "rtp_sdr_iq.h"
+#include "rtp_sdr_rtcp.h"
+#include "rtp_sdr_codec.h"
 #include "rtp_header.h"
 #include "rtp_socket.h"
+#include "rtp_source.h"
 #include "rtp_util.h"
+#include "rtcp_util.h"
+#include "rtcp_header.h"
+#include "rtcp_compound.h"
 
-static void _pause(struct timeval start, int packet_len, sample_rate_t sample_rate) {
+// Wait until the frame of samples sent since start has lasted its nominal time at sample_rate.
+static void _pause(struct timeval start, int samples, sample_rate_t sample_rate) {
     struct timeval now;
-    double rate_now;
-    long duration_now;
+    long duration_now, int_delay;
 
     gettimeofday(&now, NULL);
 
     duration_now = ((now.tv_sec - start.tv_sec) * 1000000) + (now.tv_usec - start.tv_usec);
-    rate_now = (packet_len * 8 * 1000) / duration_now;
-
-    if (rate_now > sample_rate) {
-        long int_delay = packet_len * 8 * 1000;
-        int_delay = (int_delay / sample_rate) - duration_now;
-
-        if ((int_delay <= 0) || (int_delay > 10000000))
-            fprintf(stderr, "!!! BIG delay !!!  %ld\n", int_delay);
-        if (int_delay > 0) {
-            int diff;
-            struct timeval start, now;
-
-            gettimeofday(&start, NULL);
-            diff = 0;
-            while (diff < int_delay) {
-                /* If enough time to sleep, otherwise, busywait */
-                if (int_delay - diff > 200) {
-                    usleep(int_delay - 20);
-                }
-                gettimeofday(&now, NULL);
-                diff = now.tv_sec - start.tv_sec;
-                diff *= 1000000;
-                diff += now.tv_usec - start.tv_usec;
+    int_delay = (long) (((int64_t) samples * 1000000) / sample_rate) - duration_now;
+
+    if (int_delay > 10000000)
+        fprintf(stderr, "!!! BIG delay !!!  %ld\n", int_delay);
+    if (int_delay > 0) {
+        long diff;
+
+        gettimeofday(&start, NULL);
+        diff = 0;
+        while (diff < int_delay) {
+            /* If enough time to sleep, otherwise, busywait */
+            if (int_delay - diff > 200) {
+                usleep(int_delay - diff - 20);
             }
+            gettimeofday(&now, NULL);
+            diff = now.tv_sec - start.tv_sec;
+            diff *= 1000000;
+            diff += now.tv_usec - start.tv_usec;
+        }
+    }
+}
+
+// Bytes per i or q component on the wire (compressed: at most).
+static int _iq_sample_size(iq_type_t type) {
+    switch (type) {
+        case IQ_PT8:
+            return 1;
+        case IQ_PT16:
+        case IQ_PTC16:
+            return 2;
+        case IQ_PT24:
+        case IQ_PT32:
+            return 4;
+        default:
+            return 0;
+    }
+}
+
+// Sample buffer type holding an i/q payload type.
+static rtp_sdr_sbuf_type_t _rbuf_type(iq_type_t type) {
+    switch (type) {
+        case IQ_PT8:
+            return RTP_SDR_RBUF_S8;
+        case IQ_PT16:
+        case IQ_PTC16:
+            return RTP_SDR_RBUF_S16;
+        case IQ_PT24:
+            return RTP_SDR_RBUF_S24;
+        default:
+            return RTP_SDR_RBUF_S32;
+    }
+}
+
+// Write the samples of every channel interleaved per timestamp: channel ch sample n is block[ch * samples + n].
+// Returns the payload length.
+static uint32_t _interleave(iq_type_t type, const iq_t *block, uint32_t samples, uint8_t qty, uint8_t *payload) {
+    uint32_t n, stride = qty * 2 * _iq_sample_size(type);
+    const iq_t *in;
+    uint8_t *pos;
+    uint8_t ch;
+
+    for (ch = 0; ch < qty; ch++) {
+        in = block + ch * samples;
+        pos = payload + ch * 2 * _iq_sample_size(type);
+        switch (type) {
+            case IQ_PT8:
+                for (n = 0; n < samples; n++, pos += stride) {
+                    pos[0] = in[n].i.s8;
+                    pos[1] = in[n].q.s8;
+                }
+                break;
+            case IQ_PT16:
+                for (n = 0; n < samples; n++, pos += stride) {
+                    write_u16(pos, in[n].i.s16);
+                    write_u16(pos + 2, in[n].q.s16);
+                }
+                break;
+            case IQ_PT24:
+                for (n = 0; n < samples; n++, pos += stride) {
+                    write_u32(pos, 0);
+                    write_s24_s32(pos, in[n].i.s24_s32);
+                    write_u32(pos + 4, 0);
+                    write_s24_s32(pos + 4, in[n].q.s24_s32);
+                }
+                break;
+            case IQ_PT32:
+                for (n = 0; n < samples; n++, pos += stride) {
+                    write_u32(pos, in[n].i.s24_s32);
+                    write_u32(pos + 4, in[n].q.s24_s32);
+                }
+                break;
+            default:
+                return 0;
+        }
+    }
+
+    return samples * stride;
+}
+
+// Split a payload into the samples of every channel, the reverse of _interleave().
+// Each channel is one strided pass, bytes are swapped inline instead of calling read_u16() / read_u32()
+// so that the loops have no calls or branches and the compiler vectorizes them.
+static void _deinterleave(iq_type_t type, const uint8_t *payload, uint32_t samples, uint8_t qty, iq_t *block) {
+    uint32_t n, stride = qty * 2 * _iq_sample_size(type);
+    const uint8_t *pos;
+    iq_t *out;
+    uint8_t ch;
+
+    for (ch = 0; ch < qty; ch++) {
+        out = block + ch * samples;
+        pos = payload + ch * 2 * _iq_sample_size(type);
+        switch (type) {
+            case IQ_PT8:
+                for (n = 0; n < samples; n++, pos += stride) {
+                    out[n].i.s8 = pos[0];
+                    out[n].q.s8 = pos[1];
+                }
+                break;
+            case IQ_PT16:
+                for (n = 0; n < samples; n++, pos += stride) {
+                    out[n].i.s16 = (int16_t) (pos[0] << 8 | pos[1]);
+                    out[n].q.s16 = (int16_t) (pos[2] << 8 | pos[3]);
+                }
+                break;
+            case IQ_PT24:
+                for (n = 0; n < samples; n++, pos += stride) {
+                    out[n].i.s24_s32 = read_s24(pos);
+                    out[n].q.s24_s32 = read_s24(pos + 4);
+                }
+                break;
+            case IQ_PT32:
+                for (n = 0; n < samples; n++, pos += stride) {
+                    out[n].i.s24_s32 = (int32_t) ((uint32_t) pos[0] << 24 | pos[1] << 16 | pos[2] << 8 | pos[3]);
+                    out[n].q.s24_s32 = (int32_t) ((uint32_t) pos[4] << 24 | pos[5] << 16 | pos[6] << 8 | pos[7]);
+                }
+                break;
+            default:
+                return;
+        }
+    }
+}
+
+// I/Q samples carried by one tx packet, per channel.
+static uint32_t _tx_packet_samples(session_iq_t *session) {
+    uint32_t room = RTP_PACKET_LENGTH;
+
+    if ((*session)->xdp_tx && rtp_xdp_max_payload((*session)->xdp) < room)
+        room = rtp_xdp_max_payload((*session)->xdp);
+    if ((*session)->tx_type == IQ_PTC16)
+        room -= RTP_SDR_CODEC_HEADER((*session)->tx_qty);
+
+    uint32_t samples = (room - rtp_header_size((*session)->tx_header)) / ((*session)->tx_qty * 2 * _iq_sample_size((*session)->tx_type));
+
+    if ((*session)->tx_frame_samples > 0 && samples > (uint32_t) (*session)->tx_frame_samples)
+        samples = (*session)->tx_frame_samples;
+
+    return samples;
+}
+
+// Length of an uncompressed tx packet of samples per channel, header included.
+static uint32_t _tx_packet_len(session_iq_t *session, uint32_t samples) {
+    return rtp_header_size((*session)->tx_header) + samples * (*session)->tx_qty * 2 * _iq_sample_size((*session)->tx_type);
+}
+
+// Latch the fec parameters chosen by the controller for the next group. The code is only rebuilt here, on the tx thread.
+static void _fec_group_start(session_iq_t *session) {
+    uint32_t kn = __atomic_load_n(&((*session)->tx_fec_kn), __ATOMIC_ACQUIRE);
+    unsigned int k = kn >> 8, n = kn & 0xff;
+    fec_t *code = (*session)->tx_fec_code;
+
+    (*session)->tx_fec_count = 0;
+    (*session)->tx_fec_len = 0;
+
+    if (n == k) {
+        if (code != NULL)
+            fec_free(code);
+        (*session)->tx_fec_code = NULL;
+        return;
+    }
+
+    if (code != NULL && code->k == k && code->n == n)
+        return;
+
+    if (code != NULL)
+        fec_free(code);
+    (*session)->tx_fec_code = fec_new(k, n);
+}
+
+// Send a packet built outside the transport buffers (fec parity) the way _transmit_frame() sends rtp:
+// through a UMEM frame or registered buffer when one is free and large enough, else the socket.
+static int _send_copy(session_iq_t *session, uint8_t *packet, uint32_t len) {
+    unsigned int slot = 0, room = RTP_PACKET_LENGTH;
+    uint8_t *data = NULL;
+
+    if ((*session)->xdp_tx)
+        data = rtp_xdp_send_buffer((*session)->xdp, &slot, &room);
+    else if ((*session)->tx_uring != NULL)
+        data = rtp_uring_send_buffer((*session)->tx_uring, &slot);
+
+    if (data != NULL && len <= room) {
+        memcpy(data, packet, len);
+        if ((*session)->xdp_tx && rtp_xdp_send((*session)->xdp, slot, len) == RTP_OK)
+            return RTP_OK;
+        if (!(*session)->xdp_tx && rtp_uring_send((*session)->tx_uring, &((*session)->tx_socket), slot, len) == RTP_OK)
+            return RTP_OK;
+    } else if (data != NULL) {
+        if ((*session)->xdp_tx)
+            rtp_xdp_send_release((*session)->xdp, slot);
+        else
+            rtp_uring_send_release((*session)->tx_uring, slot);
+    }
+
+    return rtp_socket_send(&((*session)->tx_socket), packet, len);
+}
+
+// Send the next waiting parity packet of the last group.
+static uint8_t _fec_parity_send(session_iq_t *session) {
+    uint8_t *parity = (*session)->tx_fec_parity + (*session)->tx_fec_par_next * RTP_SDR_FEC_PARITY_SIZE;
+
+    (*session)->tx_fec_par_next++;
+
+    return _send_copy(session, parity, (*session)->tx_fec_par_len) < 0 ? RTP_SDR_WARNING : RTP_SDR_OK;
+}
+
+// Add a sent rtp packet to the current fec group. The parity of a complete group is queued and goes out one packet
+// after each source packet of the next group, so it keeps to the tx pacing instead of leaving in a burst.
+static uint8_t _fec_group_add(session_iq_t *session, const uint8_t *data, uint32_t len) {
+    fec_t *code = (*session)->tx_fec_code;
+    struct timeval now;
+    uint8_t ret = RTP_SDR_OK;
+
+    // No parity so far: pick up a new choice of the controller, this packet opens the group
+    if (code == NULL) {
+        _fec_group_start(session);
+        code = (*session)->tx_fec_code;
+    }
+    if (code == NULL) {
+        if ((*session)->tx_fec_par_next < (*session)->tx_fec_par_n)
+            ret = _fec_parity_send(session);
+        return ret;
+    }
+
+    if ((*session)->tx_fec_count == 0) {
+        gettimeofday(&now, NULL);
+        (*session)->tx_fec_tstamp = (uint32_t) ((uint64_t) now.tv_sec * 1000000 + now.tv_usec);
+    }
+
+    // Copied before any parity is sent: data may be a transport buffer the send reaps and reuses
+    uint8_t *row = (*session)->tx_fec_buf + (*session)->tx_fec_count * RTP_PACKET_LENGTH;
+    memcpy(row, data, len);
+    if (len < RTP_PACKET_LENGTH)
+        memset(row + len, 0, RTP_PACKET_LENGTH - len);
+    if (len > (*session)->tx_fec_len)
+        (*session)->tx_fec_len = len;
+
+    if ((*session)->tx_fec_par_next < (*session)->tx_fec_par_n)
+        ret = _fec_parity_send(session);
+
+    if (++(*session)->tx_fec_count < code->k)
+        return ret;
+
+    // More parity than source packets per group: what is left of the last group goes now
+    while ((*session)->tx_fec_par_next < (*session)->tx_fec_par_n) {
+        if (_fec_parity_send(session) != RTP_SDR_OK)
+            ret = RTP_SDR_WARNING;
+    }
+
+    gf *src[code->k];
+    unsigned int idx;
+    for (idx = 0; idx < code->k; idx++)
+        src[idx] = (*session)->tx_fec_buf + idx * RTP_PACKET_LENGTH;
+
+    fec_pkt_t *pkt = (*session)->tx_fec_pkt;
+
+    for (idx = code->k; idx < code->n; idx++) {
+        fec_pkt_init(pkt);
+        pkt->hdr.group_seq = (*session)->tx_fec_seq;
+        pkt->hdr.packet_seq = idx;
+        pkt->hdr.fec_k = code->k;
+        pkt->hdr.fec_n = code->n;
+        pkt->hdr.fec_len = (*session)->tx_fec_len;
+        pkt->hdr.len = (*session)->tx_fec_len;
+        pkt->hdr.group_tstamp = (*session)->tx_fec_tstamp;
+
+        fec_encode(code, src, pkt->payload, idx, (*session)->tx_fec_len);
+        (*session)->tx_fec_par_len = fec_pkt_pack(pkt);
+        memcpy((*session)->tx_fec_parity + (idx - code->k) * RTP_SDR_FEC_PARITY_SIZE, pkt->data, (*session)->tx_fec_par_len);
+    }
+    (*session)->tx_fec_par_n = code->n - code->k;
+    (*session)->tx_fec_par_next = 0;
+
+    (*session)->tx_fec_seq++;
+    _fec_group_start(session);
+
+    return ret;
+}
+
+// Channel buffers of one direction: first is the caller's buffer, the others share one allocation.
+static rbuf_handle_t* _channels_init(rbuf_handle_t first, iq_t **storage, size_t buffer_size, rtp_sdr_sbuf_type_t type, uint8_t qty) {
+    rbuf_handle_t *channel = malloc(sizeof(rbuf_handle_t) * qty);
+    uint8_t ch;
+
+    *storage = NULL;
+    if (channel == NULL)
+        return NULL;
+
+    channel[0] = first;
+    if (qty > 1) {
+        *storage = malloc(sizeof(iq_t) * buffer_size * (qty - 1));
+        if (*storage == NULL) {
+            free(channel);
+            return NULL;
         }
     }
+
+    for (ch = 1; ch < qty; ch++)
+        channel[ch] = rtp_sdr_rbuf_init(*storage + (ch - 1) * buffer_size, buffer_size, type);
+
+    return channel;
+}
+
+// Release what _channels_init() allocated, the first buffer is freed by the caller.
+static void _channels_free(rbuf_handle_t *channel, iq_t *storage, uint8_t qty) {
+    uint8_t ch;
+
+    if (channel == NULL)
+        return;
+
+    for (ch = 1; ch < qty; ch++)
+        rtp_sdr_rbuf_free(&channel[ch]);
+    free(channel);
+    free(storage);
 }
 
+// Drop the rx io_uring and go back to the socket path, e.g. if the kernel lacks multishot recvmsg.
+static void _rx_uring_fallback(session_iq_t *session);
+
 uint8_t rcp_iq_init(session_iq_t *session, iq_type_t txtype, iq_type_t rxtype, sample_rate_t tx_sample_rate, sample_rate_t rx_sample_rate, uint32_t duration,
         const char *host, uint16_t tx_port, uint16_t rx_port, bool use_fec, iq_t *tx_buffer, iq_t *rx_buffer, size_t buffer_size, uint8_t tx_qty,
-        uint8_t rx_qty) {
+        uint8_t rx_qty, rtp_sdr_transport_t transport) {
 
     (*session)->tx_enabled = false;
     (*session)->tx_frame_samples = (tx_sample_rate * duration) / 1000;
@@ -96,157 +413,1322 @@ uint8_t rcp_iq_init(session_iq_t *session, iq_type_t txtype, iq_type_t rxtype, s
     (*session)->rx_type = rxtype;
     (*session)->tx_sample_rate = tx_sample_rate;
     (*session)->rx_sample_rate = rx_sample_rate;
-    (*session)->tx_qty = tx_qty;
-    (*session)->rx_qty = rx_qty;
-    (*session)->tx_frequency = malloc(sizeof(double) * tx_qty);
-    (*session)->rx_frequency = malloc(sizeof(double) * rx_qty);
+    (*session)->tx_qty = tx_qty > 0 ? tx_qty : 1;
+    (*session)->rx_qty = rx_qty > 0 ? rx_qty : 1;
+    (*session)->tx_frequency = calloc((*session)->tx_qty, sizeof(double));
+    (*session)->rx_frequency = calloc((*session)->rx_qty, sizeof(double));
     (*session)->host = host;
     (*session)->tx_port = tx_port;
     (*session)->rx_port = rx_port;
-    (*session)->tx_iq_buffer = rtp_sdr_rbuf_init(tx_buffer, buffer_size, txtype);
-    (*session)->rx_iq_buffer = rtp_sdr_rbuf_init(rx_buffer, buffer_size, rxtype);
+    (*session)->tx_iq_buffer = rtp_sdr_rbuf_init(tx_buffer, buffer_size, _rbuf_type(txtype));
+    (*session)->rx_iq_buffer = rtp_sdr_rbuf_init(rx_buffer, buffer_size, _rbuf_type(rxtype));
+    (*session)->tx_iq_channel = _channels_init((*session)->tx_iq_buffer, &((*session)->tx_iq_storage), buffer_size, _rbuf_type(txtype), (*session)->tx_qty);
+    (*session)->rx_iq_channel = _channels_init((*session)->rx_iq_buffer, &((*session)->rx_iq_storage), buffer_size, _rbuf_type(rxtype), (*session)->rx_qty);
     (*session)->rx_header = NULL;
     (*session)->tx_header = rtp_header_create();
     rtp_header_init((*session)->tx_header, txtype, rand(), rand(), rand());
+    (*session)->tx_fec_code = NULL;
+    (*session)->tx_fec_pkt = NULL;
+    (*session)->tx_fec_buf = NULL;
+    (*session)->tx_fec_parity = NULL;
+    (*session)->tx_fec_par_len = 0;
+    (*session)->tx_fec_par_n = 0;
+    (*session)->tx_fec_par_next = 0;
+    (*session)->tx_fec_seq = 0;
+    (*session)->tx_fec_kn = 0;
+    (*session)->tx_sent_seq = 0;
+    (*session)->tx_sent_ntp = 0;
+    (*session)->tx_sent_ts = 0;
+    (*session)->tx_socket.fd = -1;
+    (*session)->rx_socket.fd = -1;
+    (*session)->loop = NULL;
+    (*session)->tx_loop = NULL;
+    (*session)->tx_park = false;
+    (*session)->tx_parked = 0;
+    (*session)->tx_source = NULL;
+    (*session)->rx_source = NULL;
+    (*session)->transport = RTP_SDR_SOCKET;
+    (*session)->tx_uring = NULL;
+    (*session)->rx_uring = NULL;
+    (*session)->tx_gso_segments = 0;
+    (*session)->tx_gso_buf = NULL;
+    (*session)->rx_gro_buf = NULL;
+    (*session)->xdp = NULL;
+    (*session)->xdp_tx = false;
+    (*session)->tx_zerocopy = false;
+    (*session)->tx_zc_pool = NULL;
+    (*session)->tx_zc_busy = 0;
+    (*session)->rx_src = NULL;
+    (*session)->rx_coalesced = false;
+    (*session)->tx_packets = 0;
+    (*session)->tx_octets = 0;
+    (*session)->rtcp = NULL;
+    (*session)->rx_clock = NULL;
+    (*session)->rx_clock_seq = 0;
+    (*session)->rx_next_ts = 0;
+    (*session)->rx_next_valid = false;
+    (*session)->rx_resample = NULL;
+    (*session)->rx_resample_depth = 0;
+    (*session)->rx_samples = 0;
+    (*session)->rx_seq = 0;
+    (*session)->rx_event_cb = NULL;
+    (*session)->rx_event_arg = NULL;
+    (*session)->rx_busy_spin_us = 50;
+    (*session)->rx_busy_sleep_us = 1000;
+
+    if ((*session)->tx_iq_channel == NULL || (*session)->rx_iq_channel == NULL)
+        return RTP_SDR_ERROR;
+
+    if (transport != RTP_SDR_SOCKET) {
+        uint32_t flags = transport == RTP_SDR_URING_SQPOLL ? RTP_URING_SQPOLL : 0;
+
+        // One ring per direction: tx and rx may be driven from different threads
+        (*session)->tx_uring = rtp_uring_create(RTP_SDR_URING_ENTRIES, RTP_SDR_URING_BUFFERS, RTP_PACKET_LENGTH, flags);
+        (*session)->rx_uring = rtp_uring_create(RTP_SDR_URING_ENTRIES, RTP_SDR_URING_BUFFERS, RTP_PACKET_LENGTH, flags);
+        if ((*session)->tx_uring != NULL && (*session)->rx_uring != NULL) {
+            (*session)->transport = transport;
+        } else {
+            fprintf(stderr, "io_uring not available, using sockets\n");
+            if ((*session)->tx_uring != NULL)
+                rtp_uring_free((*session)->tx_uring);
+            if ((*session)->rx_uring != NULL)
+                rtp_uring_free((*session)->rx_uring);
+            (*session)->tx_uring = NULL;
+            (*session)->rx_uring = NULL;
+        }
+    }
+
+    if (use_fec)
+        return rcp_iq_fec_config(session, RTP_SDR_FEC_K, RTP_SDR_FEC_N_MAX, FEC_ADAPT_TARGET);
+
+    return RTP_SDR_OK;
+}
+
+uint8_t rcp_iq_fec_config(session_iq_t *session, uint8_t k, uint8_t n_max, double target) {
+    if (k == 0 || n_max < k)
+        return RTP_SDR_ERROR;
+
+    if ((*session)->tx_fec_code != NULL)
+        fec_free((*session)->tx_fec_code);
+    (*session)->tx_fec_code = NULL;
+
+    free((*session)->tx_fec_buf);
+    free((*session)->tx_fec_parity);
+    (*session)->tx_fec_buf = malloc(k * RTP_PACKET_LENGTH);
+    (*session)->tx_fec_parity = malloc((n_max - k + 1) * RTP_SDR_FEC_PARITY_SIZE);
+    (*session)->tx_fec_par_n = 0;
+    (*session)->tx_fec_par_next = 0;
+    if ((*session)->tx_fec_pkt == NULL)
+        (*session)->tx_fec_pkt = malloc(sizeof(fec_pkt_t));
+    if ((*session)->tx_fec_buf == NULL || (*session)->tx_fec_parity == NULL || (*session)->tx_fec_pkt == NULL)
+        return RTP_SDR_ERROR;
+
+    fec_adapt_init(&((*session)->tx_fec), k, n_max, target);
+    __atomic_store_n(&((*session)->tx_fec_kn), (uint32_t) (k << 8 | k), __ATOMIC_RELEASE);
+    (*session)->use_fec = true;
+    _fec_group_start(session);
 
     return RTP_SDR_OK;
 }
 
+// Feed the NTP/RTP pair of an SR from the rx sender to its clock mapping.
+static void _rx_clock_update(session_iq_t *session, const rtcp_view *view) {
+    uint32_t ssrc = rtcp_view_ssrc(view), rtp_ts;
+    ntp_tv ntp;
+
+    if (ssrc == (*session)->tx_header->ssrc || ((*session)->rx_src != NULL && (*session)->rx_src->id != ssrc))
+        return;
+    if (rtcp_view_sender(view, &ntp, &rtp_ts, NULL, NULL) != RTCP_OK)
+        return;
+
+    if ((*session)->rx_clock == NULL) {
+        (*session)->rx_clock = rtp_clock_create();
+        if ((*session)->rx_clock == NULL)
+            return;
+        rtp_clock_init((*session)->rx_clock, ssrc, (*session)->rx_sample_rate);
+    } else if ((*session)->rx_clock->id != ssrc) {
+        // Sender restarted
+        rtp_clock_init((*session)->rx_clock, ssrc, (*session)->rx_sample_rate);
+    }
+
+    rtp_clock_update((*session)->rx_clock, ntp_pack(ntp), rtp_ts);
+
+    // Publish a copy: readers retry while it is being written
+    uint32_t seq = (*session)->rx_clock_seq;
+    __atomic_store_n(&((*session)->rx_clock_seq), seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(&((*session)->rx_clock_snap), (*session)->rx_clock, sizeof(rtp_clock));
+    __atomic_store_n(&((*session)->rx_clock_seq), seq + 2, __ATOMIC_RELEASE);
+}
+
+// Consistent copy of the rx clock mapping. Returns false before the first SR.
+static bool _rx_clock_read(session_iq_t *session, rtp_clock *clock) {
+    uint32_t seq;
+
+    do {
+        seq = __atomic_load_n(&((*session)->rx_clock_seq), __ATOMIC_ACQUIRE);
+        if (seq == 0)
+            return false;
+        memcpy(clock, &((*session)->rx_clock_snap), sizeof(rtp_clock));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((seq & 1) || seq != __atomic_load_n(&((*session)->rx_clock_seq), __ATOMIC_RELAXED));
+
+    return true;
+}
+
+uint8_t rcp_iq_rtcp_feedback(session_iq_t *session, const uint8_t *buffer, size_t size) {
+    rtcp_view view;
+    rtcp_report report;
+    size_t offset = 0;
+    int ret;
+
+    // Walk the compound packet
+    while ((ret = rtcp_compound_next(buffer, size, &offset, &view)) > 0) {
+        if (view.pt == RTCP_SR)
+            _rx_clock_update(session, &view);
+        if (view.pt != RTCP_SR && view.pt != RTCP_RR)
+            continue;
+
+        // The tx thread picks the new parameters up at its next group
+        if (rtcp_view_find_report(&view, (*session)->tx_header->ssrc, &report) == RTCP_OK && (*session)->use_fec
+                && fec_adapt_update(&((*session)->tx_fec), report.fraction))
+            __atomic_store_n(&((*session)->tx_fec_kn), (uint32_t) ((*session)->tx_fec.k << 8 | (*session)->tx_fec.n), __ATOMIC_RELEASE);
+    }
+
+    return ret < 0 ? RTP_SDR_WARNING : RTP_SDR_OK;
+}
+
 void rcp_iq_deinit(session_iq_t *session) {
+    rcp_iq_rtcp_stop(session);
+    rcp_iq_loop_detach(session);
     rtp_sdr_rbuf_free(&((*session)->tx_iq_buffer));
     rtp_sdr_rbuf_free(&((*session)->rx_iq_buffer));
+    _channels_free((*session)->tx_iq_channel, (*session)->tx_iq_storage, (*session)->tx_qty);
+    _channels_free((*session)->rx_iq_channel, (*session)->rx_iq_storage, (*session)->rx_qty);
     free((*session)->tx_frequency);
     free((*session)->rx_frequency);
     rtp_header_free((*session)->tx_header);
+    if ((*session)->tx_fec_code != NULL)
+        fec_free((*session)->tx_fec_code);
+    free((*session)->tx_fec_pkt);
+    free((*session)->tx_fec_buf);
+    free((*session)->tx_fec_parity);
+    if ((*session)->tx_uring != NULL)
+        rtp_uring_free((*session)->tx_uring);
+    if ((*session)->rx_uring != NULL)
+        rtp_uring_free((*session)->rx_uring);
+    free((*session)->tx_gso_buf);
+    free((*session)->rx_gro_buf);
+    if ((*session)->xdp != NULL)
+        rtp_xdp_free((*session)->xdp);
+    free((*session)->tx_zc_pool);
+    if ((*session)->rx_src != NULL)
+        rtp_source_free((*session)->rx_src);
+    if ((*session)->rx_clock != NULL)
+        rtp_clock_free((*session)->rx_clock);
+    rtp_sdr_resample_free((*session)->rx_resample);
 }
 
-uint8_t rcp_iq_transmit(session_iq_t *session) {
-    char err[200];
-    int32_t n;
-    uint8_t data[RTP_PACKET_LENGTH];
-    struct timeval start;
+// Build one packet of samples from the tx channel buffers into data. Returns the packet length or -1 on error.
+static int _pack_frame(session_iq_t *session, uint8_t *data, uint32_t samples) {
+    iq_t block[RTP_PACKET_LENGTH / 2];
+    uint8_t ch, qty = (*session)->tx_qty;
     int header_size;
-    uint32_t iq_len;
-    int packet_len = 0;
 
-    gettimeofday(&start, NULL);
+    if (_iq_sample_size((*session)->tx_type) == 0 || samples * qty > RTP_PACKET_LENGTH / 2)
+        return RTP_SDR_ERROR;
 
     (*session)->tx_header->seq += 1;
-    (*session)->tx_header->ts += (*session)->tx_frame_samples;
+    header_size = rtp_header_serialize((*session)->tx_header, data, RTP_PACKET_LENGTH);
+    (*session)->tx_header->ts += samples;
 
-    header_size = rtp_header_serialize((*session)->tx_header, data, sizeof(data));
-    iq_len = sizeof(RTP_PACKET_LENGTH - header_size) / 2;
-    iq_t iq_frame[iq_len];
+    for (ch = 0; ch < qty; ch++)
+        rtp_sdr_rbuf_read(&((*session)->tx_iq_channel[ch]), block + ch * samples, samples);
 
-    if (rtp_sdr_rbuf_peek(&((*session)->tx_iq_buffer), iq_frame, iq_len) == RTP_SDR_RBUF_ERROR)
-        return RTP_SDR_ERROR;
+    uint8_t *pos = data + header_size;
+    if ((*session)->tx_type == IQ_PTC16)
+        pos += rtp_sdr_codec_encode(block, samples, qty, pos);
+    else
+        pos += _interleave((*session)->tx_type, block, samples, qty, pos);
 
-    switch ((*session)->tx_type) {
-        case IQ_PT8:
-            packet_len = iq_len;
-            for (n = 0; n < packet_len; n++) {
-                data[header_size++] = iq_frame[n].i.s8;
-                data[header_size++] = iq_frame[n].q.s8;
-            }
-            break;
-        case IQ_PT16:
-            packet_len = iq_len / 2;
-            for (n = 0; n < packet_len; n++) {
-                write_u16(data + header_size, iq_frame[n].i.s16);
-                header_size += 2;
-                write_u16(data + header_size, iq_frame[n].q.s16);
-                header_size += 2;
-            }
-            break;
-        case IQ_PT24:
-        case IQ_PT32:
-            packet_len = iq_len / 4;
-            for (n = 0; n < packet_len; n++) {
-                write_s24_s32(data + header_size, iq_frame[n].i.s24_s32);
-                header_size += 4;
-                write_s24_s32(data + header_size, iq_frame[n].q.s24_s32);
-                header_size += 4;
-            }
-            break;
+    (*session)->tx_packets += 1;
+    (*session)->tx_octets += pos - data - header_size;
+
+    return pos - data;
+}
+
+// Samples held by every tx channel buffer.
+static size_t _tx_available(session_iq_t *session) {
+    size_t size, available = rtp_sdr_rbuf_size(&((*session)->tx_iq_channel[0]));
+    uint8_t ch;
+
+    for (ch = 1; ch < (*session)->tx_qty; ch++) {
+        size = rtp_sdr_rbuf_size(&((*session)->tx_iq_channel[ch]));
+        if (size < available)
+            available = size;
+    }
+
+    return available;
+}
+
+// Build and send one packet from the tx buffer.
+// Returns the number of samples sent, 0 if the buffer does not hold a full packet, -1 on error.
+static int _transmit_frame(session_iq_t *session) {
+    char err[200];
+    uint8_t frame[RTP_PACKET_LENGTH], *data = frame;
+    uint32_t samples = _tx_packet_samples(session);
+    unsigned int slot = 0, room;
+
+    if (_tx_available(session) < samples)
+        return 0;
+
+    // Build the packet in place in a UMEM frame or registered buffer, or locally if they are all in flight
+    if ((*session)->xdp_tx) {
+        data = rtp_xdp_send_buffer((*session)->xdp, &slot, &room);
+        if (data == NULL)
+            data = frame;
+    } else if ((*session)->tx_uring != NULL) {
+        data = rtp_uring_send_buffer((*session)->tx_uring, &slot);
+        if (data == NULL)
+            data = frame;
+    }
+
+    int packet_len = _pack_frame(session, data, samples);
+    if (packet_len < 0) {
+        // The frame or buffer goes back, or repeated failures would use them all up
+        if (data != frame && (*session)->xdp_tx)
+            rtp_xdp_send_release((*session)->xdp, slot);
+        else if (data != frame)
+            rtp_uring_send_release((*session)->tx_uring, slot);
+        return RTP_SDR_ERROR;
     }
 
-    int error = rtp_socket_send(&((*session)->tx_socket), data, RTP_PACKET_LENGTH);
+    int error = -1;
+    if (data != frame && (*session)->xdp_tx)
+        error = rtp_xdp_send((*session)->xdp, slot, packet_len);
+    else if (data != frame)
+        error = rtp_uring_send((*session)->tx_uring, &((*session)->tx_socket), slot, packet_len);
+    if (error < 0)
+        error = rtp_socket_send(&((*session)->tx_socket), data, packet_len);
     if (error < 0) {
         sprintf(err, "Failed to send packet: %s\n", strerror(errno));
         perror(err);
         return RTP_SDR_ERROR;
     }
 
-    // pause by rate
-    _pause(start, packet_len, (*session)->tx_sample_rate);
+    if ((*session)->use_fec)
+        _fec_group_add(session, data, packet_len);
 
-    return RTP_SDR_OK;
+    return samples;
 }
 
-uint8_t rcp_iq_receive(session_iq_t *session) {
+// Release the zerocopy super-buffers whose sends the kernel reports as complete.
+static void _zc_reap(session_iq_t *session) {
+    uint32_t lo, hi;
+    bool copied;
+    int idx;
+
+    while ((*session)->tx_zc_busy && rtp_socket_zc_reap(&((*session)->tx_socket), &lo, &hi, &copied) > 0) {
+        for (idx = 0; idx < RTP_SDR_ZC_BUFFERS; idx++) {
+            if (((*session)->tx_zc_busy & (1 << idx)) && (*session)->tx_zc_id[idx] - lo <= hi - lo)
+                (*session)->tx_zc_busy &= ~(1 << idx);
+        }
+
+        // The kernel copied the data after all: pinning only adds cost on this route
+        if (copied)
+            (*session)->tx_zerocopy = false;
+    }
+}
+
+// Free zerocopy super-buffer or -1 if all are pinned.
+static int _zc_buffer(session_iq_t *session) {
+    int idx;
+
+    _zc_reap(session);
+    for (idx = 0; idx < RTP_SDR_ZC_BUFFERS; idx++) {
+        if (!((*session)->tx_zc_busy & (1 << idx)))
+            return idx;
+    }
+
+    return -1;
+}
+
+// Build up to tx_gso_segments packets back to back and send them with one UDP_SEGMENT call.
+// Returns the number of samples sent, 0 if the buffer does not hold a full packet, -1 on error.
+static int _transmit_gso(session_iq_t *session) {
     char err[200];
-    uint8_t data[RTP_PACKET_LENGTH];
-    int n, pos = 0;
-    iq_t iq_data;
+    uint32_t n, samples = _tx_packet_samples(session);
+    uint32_t packets = _tx_available(session) / samples;
+    uint8_t *data = (*session)->tx_gso_buf, *pos;
+    int packet_len = 0, zc = -1;
+    uint32_t id;
 
-    int packet_len = rtp_socket_recv(&((*session)->rx_socket), data, sizeof(data));
-    if (packet_len < 0) {
-        sprintf(err, "Failed to receive packet: %s\n", strerror(errno));
+    if (packets > (*session)->tx_gso_segments)
+        packets = (*session)->tx_gso_segments;
+    // Super-buffers and zerocopy slots hold RTP_SOCKET_GSO_MAX_BYTES
+    if (packets > RTP_SOCKET_GSO_MAX_BYTES / _tx_packet_len(session, samples))
+        packets = RTP_SOCKET_GSO_MAX_BYTES / _tx_packet_len(session, samples);
+    if (packets == 0)
+        return 0;
+
+    // Pin only batches big enough to beat the copy
+    if ((*session)->tx_zerocopy && packets * _tx_packet_len(session, samples) >= RTP_SDR_ZC_MIN_BYTES) {
+        zc = _zc_buffer(session);
+        if (zc >= 0)
+            data = (*session)->tx_zc_pool + zc * RTP_SOCKET_GSO_MAX_BYTES;
+    }
+    pos = data;
+
+    // Every packet carries the same number of samples, so all segments have the same size
+    for (n = 0; n < packets; n++) {
+        packet_len = _pack_frame(session, pos, samples);
+        if (packet_len < 0)
+            return RTP_SDR_ERROR;
+        pos += packet_len;
+    }
+    if (pos - data > RTP_SOCKET_GSO_MAX_BYTES) {
+        errno = EMSGSIZE;
+        perror("Super-buffer overflow");
+        return RTP_SDR_ERROR;
+    }
+
+    if (zc >= 0 && rtp_socket_send_zc(&((*session)->tx_socket), data, pos - data, packet_len, &id) >= 0) {
+        (*session)->tx_zc_id[zc] = id;
+        (*session)->tx_zc_busy |= 1 << zc;
+    } else if (rtp_socket_send_gso(&((*session)->tx_socket), data, pos - data, packet_len) < 0) {
+        sprintf(err, "Failed to send packet: %s\n", strerror(errno));
         perror(err);
-        return RTP_SDR_WARNING;
+        return RTP_SDR_ERROR;
+    }
+
+    if ((*session)->use_fec) {
+        for (n = 0; n < packets; n++)
+            _fec_group_add(session, data + n * packet_len, packet_len);
     }
 
+    return packets * samples;
+}
+
+// Packets sent per tx period.
+static uint32_t _tx_batch_packets(session_iq_t *session) {
+    if ((*session)->tx_gso_segments > 1 && (*session)->tx_uring == NULL && !(*session)->xdp_tx)
+        return (*session)->tx_gso_segments;
+
+    return 1;
+}
+
+// Tx timer period: the duration of one tx period's packets.
+static uint64_t _tx_period(session_iq_t *session) {
+    uint64_t samples = (uint64_t) _tx_packet_samples(session) * _tx_batch_packets(session);
+
+    return (samples * 1000000000ULL) / (*session)->tx_sample_rate;
+}
+
+// Publish when the rtp timestamp ts went out, for the SRs built on the rtcp thread.
+static void _tx_sent_update(session_iq_t *session, uint32_t ts) {
+    uint32_t seq = (*session)->tx_sent_seq;
+
+    __atomic_store_n(&((*session)->tx_sent_seq), seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&((*session)->tx_sent_ntp), ntp_ts_now(CLOCK_REALTIME), __ATOMIC_RELAXED);
+    __atomic_store_n(&((*session)->tx_sent_ts), ts, __ATOMIC_RELAXED);
+    __atomic_store_n(&((*session)->tx_sent_seq), seq + 2, __ATOMIC_RELEASE);
+}
+
+static int _transmit(session_iq_t *session) {
+    uint32_t ts = (*session)->tx_header->ts;
+    int samples;
+
+    if (_tx_batch_packets(session) > 1)
+        samples = _transmit_gso(session);
+    else
+        samples = _transmit_frame(session);
+
+    if (samples > 0)
+        _tx_sent_update(session, ts);
+
+    return samples;
+}
+
+// Track sequence and interarrival jitter of the sender. arrival: ns since the epoch.
+// Returns the packets lost just before this one.
+static uint32_t _rx_source_update(session_iq_t *session, const rtp_header *header, uint64_t arrival) {
+    rtp_source *src = (*session)->rx_src;
+    uint16_t delta;
+    uint32_t lost = 0;
+
+    if (header->pt != (*session)->rx_type)
+        return 0;
+
+    if (src == NULL) {
+        src = rtp_source_create();
+        if (src == NULL)
+            return 0;
+        rtp_source_init(src, header->ssrc, header->seq);
+        (*session)->rx_src = src;
+    } else if (src->id != header->ssrc) {
+        // Sender restarted
+        rtp_source_init(src, header->ssrc, header->seq);
+    } else if (src->probation == 0) {
+        // Reordered packets and sequence jumps (restart) are not losses
+        delta = header->seq - (uint16_t) (src->max_seq + 1);
+        if (delta > 0 && delta < LIBRTP_MAX_DROPOUT)
+            lost = delta;
+    }
+
+    // Arrival in rtp timestamp units: one per i/q sample at the rx sample rate
+    uint32_t rate = (*session)->rx_sample_rate;
+    uint32_t units = (uint32_t) ((arrival / 1000000000ULL) * rate + (arrival % 1000000000ULL) * rate / 1000000000ULL);
+
+    // Jitter is only estimated once the source is valid, the first transit times just seed it.
+    // Later segments of a coalesced datagram carry its arrival time, not their own: sequence only.
+    if (rtp_source_update_seq(src, header->seq) != RTP_OK)
+        src->transit = (int) (units - header->ts);
+    else if (!(*session)->rx_coalesced)
+        rtp_source_update_jitter(src, header->ts, units);
+
+    return lost;
+}
+
+// Unpack one received rtp packet into the rx buffer. arrival: ns since the epoch, 0 if the kernel gave no timestamp.
+static uint8_t _receive_packet(session_iq_t *session, const uint8_t *data, int packet_len, uint64_t arrival) {
+    uint8_t ret;
+
+    // RFC 5761: rtcp multiplexed on the rtp port
+    if (packet_len >= 8 && rtcp_type(data, packet_len) > 0) {
+        rtp_sdr_rtcp_receive(session, data, packet_len);
+        return RTP_SDR_OK;
+    }
+
+    // Fec parity of the sender (rtp version bits 3): there is no group decoder on this side
+    if (packet_len >= FEC_PKT_HDR_SIZE && data[0] == FEC_PKT_MAGIC)
+        return RTP_SDR_OK;
+
     (*session)->rx_header = rtp_header_create();
     if (rtp_header_parse((*session)->rx_header, data, packet_len) < 0) {
         perror("Bad packet - dropping\n");
+        rtp_header_free((*session)->rx_header);
+        (*session)->rx_header = NULL;
         return RTP_SDR_WARNING;
     }
 
     int header_size = rtp_header_size((*session)->rx_header);
-    uint8_t *payload = data + header_size;
-    int payload_size = packet_len - header_size;
+    ret = rcp_iq_receive_payload(session, (*session)->rx_header, data + header_size, packet_len - header_size, arrival);
+
+    rtp_header_free((*session)->rx_header);
+    (*session)->rx_header = NULL;
+
+    return ret;
+}
+
+// rx_samples moves with the rx channel buffers: other threads reading both retry while rx_seq is odd or moved.
+static void _rx_write_begin(session_iq_t *session) {
+    __atomic_store_n(&((*session)->rx_seq), (*session)->rx_seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void _rx_write_end(session_iq_t *session, uint32_t samples) {
+    __atomic_store_n(&((*session)->rx_samples), (*session)->rx_samples + samples, __ATOMIC_RELAXED);
+    __atomic_store_n(&((*session)->rx_seq), (*session)->rx_seq + 1, __ATOMIC_RELEASE);
+}
+
+// Round and saturate a resampled sample to the i/q type.
+static iq_t _iq_from_float(iq_type_t type, float i, float q) {
+    double limit = type == IQ_PT8 ? INT8_MAX : type == IQ_PT16 ? INT16_MAX : type == IQ_PT24 ? 0x7fffff : INT32_MAX;
+    double vi = fmin(fmax(rint(i), -limit), limit);
+    double vq = fmin(fmax(rint(q), -limit), limit);
+    iq_t iq;
 
-    switch ((*session)->rx_type) {
+    switch (type) {
         case IQ_PT8:
-            for (n = 0; n < payload_size; n++) {
-                iq_data.i.s8 = payload[pos++];
-                iq_data.i.s8 = payload[pos++];
-                rtp_sdr_rbuf_put(&((*session)->rx_iq_buffer), iq_data);
-            }
+            iq.i.s8 = (int8_t) vi;
+            iq.q.s8 = (int8_t) vq;
             break;
         case IQ_PT16:
-            for (n = 0; n < payload_size; n++) {
-                iq_data.i.s16 = read_u16(payload + pos);
-                pos += 2;
-                iq_data.q.s16 = read_u16(payload + pos);
-                pos += 2;
-                rtp_sdr_rbuf_put(&((*session)->rx_iq_buffer), iq_data);
-            }
-            break;
-        case IQ_PT24:
-            for (n = 0; n < payload_size; n++) {
-                iq_data.i.s24_s32 = read_s24(payload + pos);
-                pos += 4;
-                iq_data.q.s24_s32 = read_s24(payload + pos);
-                pos += 4;
-                rtp_sdr_rbuf_put(&((*session)->rx_iq_buffer), iq_data);
-            }
-            break;
-        case IQ_PT32:
-            for (n = 0; n < payload_size; n++) {
-                iq_data.i.s24_s32 = read_u32(payload + pos);
-                pos += 4;
-                iq_data.q.s24_s32 = read_u32(payload + pos);
-                pos += 4;
-                rtp_sdr_rbuf_put(&((*session)->rx_iq_buffer), iq_data);
-            }
+            iq.i.s16 = (int16_t) vi;
+            iq.q.s16 = (int16_t) vq;
             break;
         default:
-            return RTP_SDR_ERROR;
+            iq.i.s24_s32 = (int32_t) vi;
+            iq.q.s24_s32 = (int32_t) vq;
+            break;
     }
 
-    rtp_header_free((*session)->rx_header);
-    (*session)->rx_header = NULL;
+    return iq;
+}
+
+// Unpack, resample to the local clock and buffer the samples of one packet.
+static uint8_t _receive_resampled(session_iq_t *session, const rtp_header *header, const uint8_t *payload, uint32_t samples, uint64_t arrival) {
+    rtp_sdr_resample_t *rs = (*session)->rx_resample;
+    float in[RTP_PACKET_LENGTH], out[RTP_PACKET_LENGTH + 64];
+    unsigned int n, count;
+    iq_t iq_data;
+
+    if (samples > RTP_PACKET_LENGTH / 2)
+        samples = RTP_PACKET_LENGTH / 2;
+
+    for (n = 0; n < 2 * samples; n++) {
+        switch ((*session)->rx_type) {
+            case IQ_PT8:
+                in[n] = (int8_t) payload[n];
+                break;
+            case IQ_PT16:
+                in[n] = (int16_t) read_u16(payload + 2 * n);
+                break;
+            case IQ_PT24:
+                in[n] = read_s24(payload + 4 * n);
+                break;
+            default:
+                in[n] = (int32_t) read_u32(payload + 4 * n);
+                break;
+        }
+    }
+
+    rtp_sdr_resample_track(rs, header->ts, arrival);
+    rtp_sdr_resample_servo(rs, rtp_sdr_rbuf_size(&((*session)->rx_iq_buffer)), (*session)->rx_resample_depth);
+    count = rtp_sdr_resample_process(rs, in, samples, out, (RTP_PACKET_LENGTH + 64) / 2);
+
+    _rx_write_begin(session);
+    for (n = 0; n < count; n++) {
+        iq_data = _iq_from_float((*session)->rx_type, out[2 * n], out[2 * n + 1]);
+        rtp_sdr_rbuf_put(&((*session)->rx_iq_buffer), iq_data);
+    }
+    _rx_write_end(session, count);
+
+    (*session)->rx_next_ts = header->ts + samples;
+    (*session)->rx_next_valid = true;
 
     return RTP_SDR_OK;
 }
+
+// Zero fill a gap of lost samples in every rx channel buffer, keeping the channels and rx_next_ts aligned. Returns the samples filled.
+static uint32_t _rx_conceal(session_iq_t *session, uint32_t gap) {
+    static const iq_t zero[RTP_PACKET_LENGTH / 2];
+    size_t capacity = rtp_sdr_rbuf_capacity(&((*session)->rx_iq_channel[0]));
+    uint32_t chunk, left;
+    uint8_t ch;
+
+    // Past a full buffer only zeros would be left anyway
+    if (gap > capacity)
+        gap = capacity;
+
+    _rx_write_begin(session);
+    for (left = gap; left > 0; left -= chunk) {
+        chunk = left < RTP_PACKET_LENGTH / 2 ? left : RTP_PACKET_LENGTH / 2;
+        for (ch = 0; ch < (*session)->rx_qty; ch++)
+            rtp_sdr_rbuf_write(&((*session)->rx_iq_channel[ch]), zero, chunk);
+    }
+    _rx_write_end(session, gap);
+
+    return gap;
+}
+
+uint8_t rcp_iq_receive_payload(session_iq_t *session, const rtp_header *header, const uint8_t *payload, int payload_size, uint64_t arrival) {
+    iq_t block[RTP_PACKET_LENGTH / 2];
+    uint8_t ch, qty = (*session)->rx_qty;
+    uint32_t chunk, samples, width, lost, filled = 0;
+    uint64_t position = (*session)->rx_samples;
+    struct timespec now;
+    int32_t gap;
+    int decoded;
+
+    if (arrival == 0) {
+        clock_gettime(CLOCK_REALTIME, &now);
+        arrival = (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+    }
+
+    lost = _rx_source_update(session, header, arrival);
+
+    if (_iq_sample_size((*session)->rx_type) == 0)
+        return RTP_SDR_ERROR;
+    width = qty * 2 * _iq_sample_size((*session)->rx_type);
+    samples = payload_size / width;
+
+    // Compressed payloads are decoded whole, each on its own
+    if ((*session)->rx_type == IQ_PTC16) {
+        decoded = header->pt == IQ_PTC16 ? rtp_sdr_codec_decode(payload, payload_size, qty, block, RTP_PACKET_LENGTH / 2 / qty) : -1;
+        if (decoded < 0)
+            return RTP_SDR_WARNING;
+        samples = decoded;
+    }
+
+    if ((*session)->rx_resample != NULL && header->pt == (*session)->rx_type) {
+        if (lost > 0 && (*session)->rx_event_cb != NULL)
+            (*session)->rx_event_cb(RCP_IQ_RX_LOSS, position, 0, header->seq - lost, lost, (*session)->rx_event_arg);
+        return _receive_resampled(session, header, payload, samples, arrival);
+    }
+
+    // Channels are only meaningful together: a loss must leave the same hole in all of them
+    if (qty > 1 && header->pt == (*session)->rx_type && (*session)->rx_next_valid) {
+        gap = (int32_t) (header->ts - (*session)->rx_next_ts);
+        if (gap < 0)
+            return RTP_SDR_WARNING; // late or duplicate, its place was already filled
+        filled = _rx_conceal(session, gap);
+    }
+
+    if (lost > 0 && (*session)->rx_event_cb != NULL)
+        (*session)->rx_event_cb(RCP_IQ_RX_LOSS, position, filled, header->seq - lost, lost, (*session)->rx_event_arg);
+
+    _rx_write_begin(session);
+    if ((*session)->rx_type == IQ_PTC16) {
+        for (ch = 0; ch < qty; ch++)
+            rtp_sdr_rbuf_write(&((*session)->rx_iq_channel[ch]), block + ch * samples, samples);
+    }
+
+    // Packets larger than RTP_PACKET_LENGTH are split to fit the deinterleave block
+    for (chunk = 0; (*session)->rx_type != IQ_PTC16 && chunk < samples; chunk += RTP_PACKET_LENGTH / 2 / qty) {
+        uint32_t count = samples - chunk < RTP_PACKET_LENGTH / 2 / qty ? samples - chunk : RTP_PACKET_LENGTH / 2 / qty;
+
+        _deinterleave((*session)->rx_type, payload + chunk * width, count, qty, block);
+        for (ch = 0; ch < qty; ch++)
+            rtp_sdr_rbuf_write(&((*session)->rx_iq_channel[ch]), block + ch * count, count);
+    }
+    _rx_write_end(session, samples);
+
+    if (header->pt == (*session)->rx_type) {
+        (*session)->rx_next_ts = header->ts + samples;
+        (*session)->rx_next_valid = true;
+    }
+
+    return RTP_SDR_OK;
+}
+
+// Submit the packets queued on the tx io_uring. Returns RTP_SDR_ERROR if the kernel failed earlier sends.
+static uint8_t _transmit_flush(session_iq_t *session) {
+    if ((*session)->xdp_tx)
+        rtp_xdp_submit((*session)->xdp);
+
+    if ((*session)->tx_uring == NULL)
+        return RTP_SDR_OK;
+
+    if (rtp_uring_submit((*session)->tx_uring) < 0) {
+        perror("io_uring submit failed, using sockets");
+        rtp_uring_free((*session)->tx_uring);
+        (*session)->tx_uring = NULL;
+        if ((*session)->rx_uring == NULL)
+            (*session)->transport = RTP_SDR_SOCKET;
+        return RTP_SDR_OK;
+    }
+
+    // Sends complete asynchronously: report the failures reaped so far
+    if (rtp_uring_poll((*session)->tx_uring, NULL, NULL, false) < 0 || rtp_uring_send_errors((*session)->tx_uring) > 0) {
+        perror("Failed to send packet");
+        return RTP_SDR_ERROR;
+    }
+
+    return RTP_SDR_OK;
+}
+
+static void _rx_datagram(const uint8_t *data, unsigned int len, void *arg) {
+    session_iq_t session = (session_iq_t) arg;
+
+    // AF_XDP frames bypass the kernel timestamping, their arrival is taken on receipt
+    _receive_packet(&session, data, len, session->xdp != NULL ? 0 : rtp_uring_rx_tstamp(session->rx_uring));
+}
+
+// Arm the multishot receive of the rx io_uring on the open rx socket.
+static uint8_t _rx_uring_start(session_iq_t *session) {
+    if ((*session)->rx_uring == NULL)
+        return RTP_SDR_ERROR;
+
+    if (rtp_uring_recv_start((*session)->rx_uring, &((*session)->rx_socket)) < 0) {
+        _rx_uring_fallback(session);
+        return RTP_SDR_ERROR;
+    }
+
+    return RTP_SDR_OK;
+}
+
+// Unpack a received datagram, split back into rtp packets if the kernel coalesced it (UDP_GRO).
+// The segments share the arrival time of the coalesced datagram: only the first one feeds the jitter.
+static void _receive_segments(session_iq_t *session, const uint8_t *data, unsigned int len, unsigned int segment, uint64_t arrival) {
+    unsigned int offset;
+
+    for (offset = 0; offset < len; offset += segment) {
+        (*session)->rx_coalesced = offset > 0;
+        _receive_packet(session, data + offset, len - offset < segment ? len - offset : segment, arrival);
+    }
+    (*session)->rx_coalesced = false;
+}
+
+uint8_t rcp_iq_gso_config(session_iq_t *session, uint8_t segments) {
+    uint32_t samples = _tx_packet_samples(session);
+    uint32_t packet_len = _tx_packet_len(session, samples);
+
+    // Segments must all have the same size, compressed packets do not
+    if ((*session)->tx_type == IQ_PTC16 && segments > 1)
+        return RTP_SDR_ERROR;
+
+    if (segments > RTP_SOCKET_GSO_MAX_SEGMENTS)
+        segments = RTP_SOCKET_GSO_MAX_SEGMENTS;
+    if (packet_len > 0 && segments > RTP_SOCKET_GSO_MAX_BYTES / packet_len)
+        segments = RTP_SOCKET_GSO_MAX_BYTES / packet_len;
+
+    free((*session)->tx_gso_buf);
+    free((*session)->rx_gro_buf);
+    (*session)->tx_gso_buf = NULL;
+    (*session)->rx_gro_buf = NULL;
+    (*session)->tx_gso_segments = 0;
+
+    if (segments <= 1) {
+        if ((*session)->rx_socket.fd >= 0)
+            rtp_socket_set_gro(&((*session)->rx_socket), false);
+        return RTP_SDR_OK;
+    }
+
+    (*session)->tx_gso_buf = malloc(segments * RTP_PACKET_LENGTH);
+    if ((*session)->tx_gso_buf == NULL)
+        return RTP_SDR_ERROR;
+    (*session)->tx_gso_segments = segments;
+
+    // io_uring rx buffers hold one packet: no coalescing there
+    if ((*session)->rx_uring == NULL && (*session)->rx_socket.fd >= 0 && rtp_socket_set_gro(&((*session)->rx_socket), true) == RTP_OK) {
+        (*session)->rx_gro_buf = malloc(RTP_SOCKET_GSO_MAX_BYTES);
+        if ((*session)->rx_gro_buf == NULL) {
+            rtp_socket_set_gro(&((*session)->rx_socket), false);
+            return RTP_SDR_ERROR;
+        }
+    }
+
+    // Re-arm the pacing timer for the new batch size
+    if ((*session)->loop != NULL)
+        return rcp_iq_loop_attach(session, (*session)->loop);
+
+    return RTP_SDR_OK;
+}
+
+uint8_t rcp_iq_zerocopy_config(session_iq_t *session, bool enable) {
+    if ((*session)->tx_socket.fd < 0)
+        return RTP_SDR_ERROR;
+
+    if (!enable) {
+        // Pinned buffers stay allocated until deinit, the kernel may still read them
+        (*session)->tx_zerocopy = false;
+        return RTP_SDR_OK;
+    }
+
+    if (rtp_socket_set_zerocopy(&((*session)->tx_socket), true) != RTP_OK)
+        return RTP_SDR_ERROR;
+
+    if ((*session)->tx_zc_pool == NULL) {
+        (*session)->tx_zc_pool = malloc(RTP_SDR_ZC_BUFFERS * RTP_SOCKET_GSO_MAX_BYTES);
+        if ((*session)->tx_zc_pool == NULL)
+            return RTP_SDR_ERROR;
+    }
+    (*session)->tx_zerocopy = true;
+
+    return RTP_SDR_OK;
+}
+
+uint8_t rcp_iq_xdp_config(session_iq_t *session, const char *ifname, uint32_t queue, uint32_t flags, const uint8_t *mac) {
+    rtp_loop_t *loop = (*session)->loop;
+    uint16_t port = (*session)->rx_port;
+
+    // Steer the port the rx socket is bound to
+    if ((*session)->rx_socket.fd >= 0) {
+        if ((*session)->rx_socket.dest_addr.ss_family == AF_INET)
+            port = ntohs(((struct sockaddr_in*) &((*session)->rx_socket.dest_addr))->sin_port);
+        else if ((*session)->rx_socket.dest_addr.ss_family == AF_INET6)
+            port = ntohs(((struct sockaddr_in6*) &((*session)->rx_socket.dest_addr))->sin6_port);
+    }
+
+    // The loop must not watch the old socket while it is replaced
+    rcp_iq_loop_detach(session);
+    if ((*session)->xdp != NULL)
+        rtp_xdp_free((*session)->xdp);
+    (*session)->xdp_tx = false;
+
+    (*session)->xdp = rtp_xdp_create(ifname, queue, port, 0, 0, flags);
+    if ((*session)->xdp == NULL) {
+        if (loop != NULL)
+            rcp_iq_loop_attach(session, loop);
+        return RTP_SDR_ERROR;
+    }
+
+    // Without a usable destination tx stays on the kernel stack
+    if ((*session)->tx_socket.fd >= 0 && rtp_xdp_set_dest((*session)->xdp, &((*session)->tx_socket), mac) == RTP_OK)
+        (*session)->xdp_tx = true;
+
+    if (loop != NULL)
+        return rcp_iq_loop_attach(session, loop);
+
+    return RTP_SDR_OK;
+}
+
+uint8_t rcp_iq_transmit(session_iq_t *session) {
+    struct timeval start;
+
+    gettimeofday(&start, NULL);
+
+    int samples = _transmit(session);
+    uint8_t flushed = _transmit_flush(session);
+    if (samples <= 0)
+        return RTP_SDR_ERROR;
+
+    // pause by rate
+    _pause(start, samples, (*session)->tx_sample_rate);
+
+    return flushed;
+}
+
+uint32_t rcp_iq_tx_packet_samples(session_iq_t *session) {
+    return _tx_packet_samples(session);
+}
+
+uint8_t rcp_iq_transmit_unpaced(session_iq_t *session) {
+    int samples, sent = 0;
+    uint32_t packets = 0;
+    uint8_t flushed = RTP_SDR_OK;
+
+    // Submit every submission queue worth, before the registered buffers run out
+    while ((samples = _transmit(session)) > 0) {
+        sent += samples;
+        if (++packets % RTP_SDR_URING_ENTRIES == 0 && _transmit_flush(session) != RTP_SDR_OK)
+            flushed = RTP_SDR_ERROR;
+    }
+    if (_transmit_flush(session) != RTP_SDR_OK)
+        flushed = RTP_SDR_ERROR;
+
+    if (samples < 0 || flushed != RTP_SDR_OK)
+        return RTP_SDR_ERROR;
+
+    return sent > 0 ? RTP_SDR_OK : RTP_SDR_WARNING;
+}
+
+uint8_t rcp_iq_receive(session_iq_t *session) {
+    char err[200];
+    uint8_t data[RTP_PACKET_LENGTH];
+
+    if ((*session)->xdp != NULL) {
+        int received = rtp_xdp_recv((*session)->xdp, _rx_datagram, *session, true);
+        return received > 0 ? RTP_SDR_OK : RTP_SDR_WARNING;
+    }
+
+    if (_rx_uring_start(session) == RTP_SDR_OK) {
+        // Blocks until completions are pending, every datagram already received is unpacked
+        int received = rtp_uring_poll((*session)->rx_uring, _rx_datagram, *session, true);
+        if (received < 0) {
+            _rx_uring_fallback(session);
+            return RTP_SDR_WARNING;
+        }
+
+        return received > 0 ? RTP_SDR_OK : RTP_SDR_WARNING;
+    }
+
+    if ((*session)->rx_gro_buf != NULL) {
+        unsigned int segment;
+        int len = rtp_socket_recv_gro(&((*session)->rx_socket), (*session)->rx_gro_buf, RTP_SOCKET_GSO_MAX_BYTES, &segment);
+        if (len <= 0)
+            return RTP_SDR_WARNING;
+
+        _receive_segments(session, (*session)->rx_gro_buf, len, segment, (*session)->rx_socket.rx_tstamp);
+        return RTP_SDR_OK;
+    }
+
+    int packet_len = rtp_socket_recv(&((*session)->rx_socket), data, sizeof(data));
+    if (packet_len < 0) {
+        sprintf(err, "Failed to receive packet: %s\n", strerror(errno));
+        perror(err);
+        return RTP_SDR_WARNING;
+    }
+
+    if (packet_len == 0)
+        return RTP_SDR_WARNING;
+
+    return _receive_packet(session, data, packet_len, (*session)->rx_socket.rx_tstamp);
+}
+
+// Unpack every datagram already queued on the rx socket. Returns the datagrams read.
+static int _rx_drain_socket(session_iq_t *session) {
+    rtp_socket_t *sock = &((*session)->rx_socket);
+    uint8_t data[RTP_PACKET_LENGTH];
+    int packet_len, count = 0;
+
+    if ((*session)->rx_gro_buf != NULL) {
+        unsigned int segment;
+        while ((packet_len = rtp_socket_try_recv_gro(sock, (*session)->rx_gro_buf, RTP_SOCKET_GSO_MAX_BYTES, &segment)) > 0) {
+            _receive_segments(session, (*session)->rx_gro_buf, packet_len, segment, sock->rx_tstamp);
+            count++;
+        }
+        return count;
+    }
+
+    while ((packet_len = rtp_socket_try_recv(sock, data, sizeof(data))) > 0) {
+        _receive_packet(session, data, packet_len, sock->rx_tstamp);
+        count++;
+    }
+
+    return count;
+}
+
+static void _loop_rx(rtp_loop_t *loop, rtp_socket_t *sock, uint32_t events, void *arg) {
+    session_iq_t session = (session_iq_t) arg;
+
+    // Edge triggered: drain the socket
+    _rx_drain_socket(&session);
+}
+
+static void _loop_rx_uring(rtp_loop_t *loop, rtp_socket_t *sock, uint32_t events, void *arg) {
+    session_iq_t session = (session_iq_t) arg;
+
+    if (rtp_uring_poll(session->rx_uring, _rx_datagram, session, false) < 0)
+        _rx_uring_fallback(&session);
+}
+
+static void _loop_rx_xdp(rtp_loop_t *loop, rtp_socket_t *sock, uint32_t events, void *arg) {
+    session_iq_t session = (session_iq_t) arg;
+
+    rtp_xdp_recv(session->xdp, _rx_datagram, session, false);
+}
+
+static void _loop_tx(rtp_loop_t *loop, uint64_t expirations, void *arg) {
+    session_iq_t session = (session_iq_t) arg;
+
+    // Catch up if the loop fell behind, stop when the tx buffer runs dry
+    while (expirations-- > 0) {
+        if (_transmit(&session) <= 0)
+            break;
+    }
+
+    // One submission for the whole batch
+    _transmit_flush(&session);
+
+    if (!session->tx_park || _tx_available(&session) >= _tx_packet_samples(&session))
+        return;
+
+    // Nothing to send: stop waking up until rcp_iq_tx_kick(). Data put before the flag was
+    // raised is seen by the second check, data put after it by the kick.
+    rtp_loop_timer_set(session->tx_source, 0, 0);
+    __atomic_store_n(&(session->tx_parked), 1, __ATOMIC_SEQ_CST);
+    if (_tx_available(&session) >= _tx_packet_samples(&session) && __atomic_exchange_n(&(session->tx_parked), 0, __ATOMIC_SEQ_CST)) {
+        uint64_t period = _tx_period(&session);
+        rtp_loop_timer_set(session->tx_source, period, period);
+    }
+}
+
+// Socket buffer bytes holding latency_ms of a stream. The kernel charges its bookkeeping
+// (roughly the size of the datagram again) against the buffer too.
+static uint32_t _socket_buffer_size(sample_rate_t rate, iq_type_t type, uint8_t qty, uint32_t latency_ms) {
+    uint64_t bytes = (uint64_t) rate * latency_ms / 1000 * qty * 2 * _iq_sample_size(type) * 2;
+
+    if (bytes < RTP_SDR_SOCKET_BUF_MIN)
+        bytes = RTP_SDR_SOCKET_BUF_MIN;
+    if (bytes > INT32_MAX / 2)
+        bytes = INT32_MAX / 2;
+
+    return bytes;
+}
+
+uint8_t rcp_iq_buffer_config(session_iq_t *session, uint32_t latency_ms) {
+    uint8_t ret = RTP_SDR_OK;
+    uint32_t want;
+    int got;
+
+    if ((*session)->rx_socket.fd < 0 && (*session)->tx_socket.fd < 0)
+        return RTP_SDR_ERROR;
+
+    if ((*session)->rx_socket.fd >= 0) {
+        want = _socket_buffer_size((*session)->rx_sample_rate, (*session)->rx_type, (*session)->rx_qty, latency_ms);
+        got = rtp_socket_set_rcvbuf(&((*session)->rx_socket), want);
+        if (got < 0 || (uint32_t) got < want)
+            ret = RTP_SDR_WARNING;
+    }
+
+    if ((*session)->tx_socket.fd >= 0) {
+        want = _socket_buffer_size((*session)->tx_sample_rate, (*session)->tx_type, (*session)->tx_qty, latency_ms);
+        got = rtp_socket_set_sndbuf(&((*session)->tx_socket), want);
+        if (got < 0 || (uint32_t) got < want)
+            ret = RTP_SDR_WARNING;
+    }
+
+    return ret;
+}
+
+uint8_t rcp_iq_rx_stats(session_iq_t *session, rcp_iq_rx_stats_t *stats) {
+    rtp_source *src = (*session)->rx_src;
+
+    memset(stats, 0, sizeof(*stats));
+    stats->dropped = (*session)->rx_socket.rx_dropped;
+    if (src == NULL)
+        return RTP_SDR_WARNING;
+
+    stats->received = src->received;
+    stats->lost = (int32_t) (src->cycles + src->max_seq - src->base_seq + 1) - src->received;
+    stats->jitter = src->jitter;
+
+    return RTP_SDR_OK;
+}
+
+uint8_t rcp_iq_rx_time(session_iq_t *session, uint32_t rtp_ts, ntp_ts *time) {
+    rtp_clock clock;
+
+    if (!_rx_clock_read(session, &clock))
+        return RTP_SDR_WARNING;
+
+    *time = rtp_clock_to_ntp(&clock, rtp_ts);
+
+    return RTP_SDR_OK;
+}
+
+uint8_t rcp_iq_rx_buffer_time(session_iq_t *session, uint32_t *rtp_ts, ntp_ts *time) {
+    *rtp_ts = (*session)->rx_next_ts - (uint32_t) rtp_sdr_rbuf_size(&((*session)->rx_iq_buffer));
+    if (time == NULL)
+        return __atomic_load_n(&((*session)->rx_clock_seq), __ATOMIC_ACQUIRE) == 0 ? RTP_SDR_WARNING : RTP_SDR_OK;
+
+    return rcp_iq_rx_time(session, *rtp_ts, time);
+}
+
+uint8_t rcp_iq_drift_config(session_iq_t *session, uint32_t depth_ms) {
+    size_t capacity = rtp_sdr_rbuf_capacity(&((*session)->rx_iq_buffer));
+    uint64_t depth = (uint64_t) (*session)->rx_sample_rate * depth_ms / 1000;
+
+    rtp_sdr_resample_free((*session)->rx_resample);
+    (*session)->rx_resample = NULL;
+    if (depth_ms == 0)
+        return RTP_SDR_OK;
+
+    if (depth == 0 || depth > capacity / 2 || (*session)->rx_qty > 1 || (*session)->rx_type == IQ_PTC16)
+        return RTP_SDR_ERROR;
+
+    (*session)->rx_resample = rtp_sdr_resample_create((*session)->rx_sample_rate, 0, 0);
+    if ((*session)->rx_resample == NULL)
+        return RTP_SDR_ERROR;
+    (*session)->rx_resample_depth = (uint32_t) depth;
+
+    return RTP_SDR_OK;
+}
+
+uint8_t rcp_iq_rx_event_config(session_iq_t *session, rcp_iq_rx_event_cb cb, void *arg) {
+    (*session)->rx_event_cb = cb;
+    (*session)->rx_event_arg = arg;
+
+    return RTP_SDR_OK;
+}
+
+uint8_t rcp_iq_busy_poll_config(session_iq_t *session, uint32_t spin_us, uint32_t sleep_us) {
+    if ((*session)->rx_socket.fd < 0)
+        return RTP_SDR_ERROR;
+
+    (*session)->rx_busy_spin_us = spin_us;
+    (*session)->rx_busy_sleep_us = sleep_us;
+
+    if (rtp_socket_set_busy_poll(&((*session)->rx_socket), spin_us, true) != RTP_OK)
+        return RTP_SDR_WARNING;
+
+    return RTP_SDR_OK;
+}
+
+uint8_t rcp_iq_busy_poll(session_iq_t *session, volatile bool *stop) {
+    struct timespec now, nap, idle_since = { 0, 0 };
+    uint32_t sleep_us = 0;
+    bool idle = false;
+    int received;
+
+    if ((*session)->xdp == NULL && (*session)->rx_socket.fd < 0)
+        return RTP_SDR_ERROR;
+
+    if ((*session)->xdp == NULL)
+        _rx_uring_start(session);
+
+    while (!*stop) {
+        if ((*session)->xdp != NULL) {
+            received = rtp_xdp_recv((*session)->xdp, _rx_datagram, *session, false);
+        } else if ((*session)->rx_uring != NULL) {
+            received = rtp_uring_poll((*session)->rx_uring, _rx_datagram, *session, false);
+            if (received < 0)
+                _rx_uring_fallback(session);
+        } else {
+            received = _rx_drain_socket(session);
+        }
+
+        if (received > 0) {
+            idle = false;
+            sleep_us = 0;
+            continue;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (!idle) {
+            idle = true;
+            idle_since = now;
+            continue;
+        }
+
+        // Spin while traffic is likely to resume, then back off exponentially
+        uint64_t idle_us = (now.tv_sec - idle_since.tv_sec) * 1000000ULL + (now.tv_nsec - idle_since.tv_nsec) / 1000;
+        if (idle_us < (*session)->rx_busy_spin_us || (*session)->rx_busy_sleep_us == 0)
+            continue;
+
+        sleep_us = sleep_us == 0 ? 1 : sleep_us * 2;
+        if (sleep_us > (*session)->rx_busy_sleep_us)
+            sleep_us = (*session)->rx_busy_sleep_us;
+        nap.tv_sec = sleep_us / 1000000;
+        nap.tv_nsec = (sleep_us % 1000000) * 1000;
+        nanosleep(&nap, NULL);
+    }
+
+    return RTP_SDR_OK;
+}
+
+uint8_t rcp_iq_loop_attach(session_iq_t *session, rtp_loop_t *loop) {
+    return rcp_iq_loop_attach_split(session, loop, loop);
+}
+
+uint8_t rcp_iq_loop_attach_split(session_iq_t *session, rtp_loop_t *rx_loop, rtp_loop_t *tx_loop) {
+    rcp_iq_loop_detach(session);
+
+    (*session)->loop = rx_loop;
+    (*session)->tx_loop = tx_loop;
+
+    if ((*session)->xdp != NULL) {
+        (*session)->rx_source = rtp_loop_add_socket(rx_loop, rtp_xdp_notify((*session)->xdp), RTP_LOOP_IN, _loop_rx_xdp, *session);
+        if ((*session)->rx_source == NULL)
+            goto error;
+    } else if ((*session)->rx_socket.fd >= 0) {
+        if (_rx_uring_start(session) == RTP_SDR_OK)
+            (*session)->rx_source = rtp_loop_add_socket(rx_loop, rtp_uring_notify((*session)->rx_uring), RTP_LOOP_IN, _loop_rx_uring, *session);
+        else
+            (*session)->rx_source = rtp_loop_add_socket(rx_loop, &((*session)->rx_socket), RTP_LOOP_IN, _loop_rx, *session);
+        if ((*session)->rx_source == NULL)
+            goto error;
+    }
+
+    if ((*session)->tx_enabled && (*session)->tx_socket.fd >= 0) {
+        uint64_t period = _tx_period(session);
+        __atomic_store_n(&((*session)->tx_parked), 0, __ATOMIC_SEQ_CST);
+        (*session)->tx_source = rtp_loop_add_timer(tx_loop, period, period, _loop_tx, *session);
+        if ((*session)->tx_source == NULL)
+            goto error;
+    }
+
+    if (rtp_sdr_rtcp_attach(session) != RTP_SDR_OK)
+        goto error;
+
+    return RTP_SDR_OK;
+
+    error:
+    rcp_iq_loop_detach(session);
+    return RTP_SDR_ERROR;
+}
+
+void rcp_iq_loop_detach(session_iq_t *session) {
+    if ((*session)->loop == NULL)
+        return;
+
+    rtp_sdr_rtcp_detach(session);
+    rtp_loop_remove((*session)->loop, (*session)->rx_source);
+    rtp_loop_remove((*session)->tx_loop, (*session)->tx_source);
+    (*session)->rx_source = NULL;
+    (*session)->tx_source = NULL;
+    (*session)->loop = NULL;
+    (*session)->tx_loop = NULL;
+}
+
+void rcp_iq_tx_kick(session_iq_t *session) {
+    uint64_t period;
+
+    // Only the side that finds the timer parked restarts it, the common case is one atomic load
+    if (!(*session)->tx_park || !__atomic_load_n(&((*session)->tx_parked), __ATOMIC_SEQ_CST))
+        return;
+    if (!__atomic_exchange_n(&((*session)->tx_parked), 0, __ATOMIC_SEQ_CST))
+        return;
+
+    // Send right away, then at the packet rate
+    period = _tx_period(session);
+    rtp_loop_timer_set((*session)->tx_source, 1, period);
+}
+
+static void _rx_uring_fallback(session_iq_t *session) {
+    perror("io_uring receive failed, using sockets");
+
+    if ((*session)->loop != NULL && (*session)->rx_source != NULL) {
+        rtp_loop_remove((*session)->loop, (*session)->rx_source);
+        (*session)->rx_source = rtp_loop_add_socket((*session)->loop, &((*session)->rx_socket), RTP_LOOP_IN, _loop_rx, *session);
+    }
+
+    rtp_uring_free((*session)->rx_uring);
+    (*session)->rx_uring = NULL;
+    if ((*session)->tx_uring == NULL)
+        (*session)->transport = RTP_SDR_SOCKET;
+}
+
+#ifdef RTP_SDR_IQ_TEST
+
+#define TEST_BUFFER 65536
+
+void testit(char *name, int result, int should) {
+    if (result == should) {
+        printf("Test %s was successful\n", name);
+    }
+    else {
+        printf("Test %s was not successful, %d should have been %d\n", name, result, should);
+    }
+}
+
+int main(void) {
+    static iq_t tx_buffer[TEST_BUFFER], rx_buffer[TEST_BUFFER], block[TEST_BUFFER];
+    static uint8_t batch[RTP_SOCKET_GSO_MAX_BYTES + RTP_PACKET_LENGTH];
+    const uint8_t qtys[] = { 1, 2, 4, 8 };
+    session_iq_t session;
+    uint32_t samples, n, len;
+    uint64_t arrival, first = 0;
+    uint8_t q, ch;
+    int packet_len = 0, ok;
+    char name[80];
+
+    memset(block, 0, sizeof(block));
+    for (q = 0; q < sizeof(qtys); q++) {
+        session = malloc(sizeof(struct session_iq_s));
+        rcp_iq_init(&session, IQ_PT16, IQ_PT16, SR_1536K, SR_1536K, 0, "127.0.0.1", 5004, 5006, false, tx_buffer, rx_buffer, TEST_BUFFER, qtys[q], qtys[q],
+                RTP_SDR_SOCKET);
+        samples = _tx_packet_samples(&session);
+
+        sprintf(name, "gso config qty %u", qtys[q]);
+        testit(name, rcp_iq_gso_config(&session, 64), RTP_SDR_OK);
+        sprintf(name, "gso batch fits qty %u", qtys[q]);
+        testit(name, session->tx_gso_segments > 1 && session->tx_gso_segments * _tx_packet_len(&session, samples) <= RTP_SOCKET_GSO_MAX_BYTES, 1);
+
+        // Pack a full batch the way _transmit_gso does
+        for (ch = 0; ch < qtys[q]; ch++)
+            rtp_sdr_rbuf_write(&(session->tx_iq_channel[ch]), block, samples * session->tx_gso_segments);
+        for (n = 0, len = 0, ok = 1; n < session->tx_gso_segments; n++) {
+            packet_len = _pack_frame(&session, batch + len, samples);
+            if (packet_len < 0 || (uint32_t) packet_len != _tx_packet_len(&session, samples))
+                ok = 0;
+            len += packet_len;
+        }
+        sprintf(name, "packet length qty %u", qtys[q]);
+        testit(name, ok, 1);
+        sprintf(name, "packed batch fits qty %u", qtys[q]);
+        testit(name, len <= RTP_SOCKET_GSO_MAX_BYTES, 1);
+
+        rcp_iq_deinit(&session);
+        free(session);
+    }
+
+    // A paced stream read back through a coalesced datagram: one arrival time for the batch, no jitter
+    session = malloc(sizeof(struct session_iq_s));
+    rcp_iq_init(&session, IQ_PT16, IQ_PT16, SR_1536K, SR_1536K, 0, "127.0.0.1", 5004, 5006, false, tx_buffer, rx_buffer, TEST_BUFFER, 1, 1, RTP_SDR_SOCKET);
+    samples = _tx_packet_samples(&session);
+    rtp_sdr_rbuf_write(&(session->tx_iq_channel[0]), block, samples * 16);
+    for (n = 0, len = 0; n < 16; n++) {
+        packet_len = _pack_frame(&session, batch + len, samples);
+        // Arrival rounded up to the ns, so it reads back as exactly n * samples rtp units
+        arrival = 1000000000000ULL + ((uint64_t) n * samples * 1000000000ULL + SR_1536K - 1) / SR_1536K;
+        if (n < 8)
+            _receive_packet(&session, batch + len, packet_len, arrival);
+        else if (n == 8)
+            first = arrival;
+        len += packet_len;
+    }
+    ok = session->rx_src != NULL ? session->rx_src->received : -1;
+    _receive_segments(&session, batch + len / 2, len / 2, packet_len, first);
+    testit("coalesced segments jitter", session->rx_src != NULL && session->rx_src->jitter == 0, 1);
+    testit("coalesced segments received", session->rx_src != NULL ? session->rx_src->received - ok : -1, 8);
+    rcp_iq_deinit(&session);
+    free(session);
+
+    return 0;
+}
+
+#endif /* RTP_SDR_IQ_TEST */
@@ -40,18 +40,37 @@
 #include <stddef.h>
 #include <assert.h>
 #include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <linux/futex.h>
 
 #include "rtp_sdr_rbuf.h"
 
 // This implementation is thread safe for a single producer and single consumer
 
+// Blocking support, allocated by rtp_sdr_rbuf_wait_config(). Index RTP_SDR_RBUF_DATA / RTP_SDR_RBUF_ROOM.
+typedef struct rbuf_wait_s {
+      size_t low;      // room: satisfied at or below this many values
+      size_t high;     // data: satisfied at or above this many values
+    uint32_t armed[2]; // a waiter is present (atomic)
+    uint32_t seq[2];   // futex word, bumped on every notification
+         int fd[2];    // eventfd also signalled (-1: none yet)
+} rbuf_wait_t;
+
 // The definition of our circular buffer structure is hidden from the user
 struct rbuf_s {
     rtp_sdr_sbuf_type_t type;    //
                    iq_t *buffer; //
-                 size_t head;    //
-                 size_t tail;    //
+                 size_t head;    // written by the producer only, release / acquire
+                 size_t tail;    // written by the consumer only, release / acquire
                  size_t max;     // of the buffer
+            rbuf_wait_t *wait;   // blocking support (NULL: off)
+               uint64_t dropped; // values overwritten before they were read
 };
 
 static inline size_t _advance_headtail_value(size_t value, size_t max) {
@@ -62,6 +81,50 @@ static inline size_t _advance_headtail_value(size_t value, size_t max) {
     return value;
 }
 
+// Head and tail are published with release after the data copy and read with acquire before it:
+// the consumer sees the values behind a new head, the producer only reuses slots behind a new tail.
+static inline size_t _load(const size_t *index) {
+    return __atomic_load_n(index, __ATOMIC_ACQUIRE);
+}
+
+static inline void _store(size_t *index, size_t value) {
+    __atomic_store_n(index, value, __ATOMIC_RELEASE);
+}
+
+// Whether a wait on one side would return now.
+static bool _wait_ready(rbuf_handle_t *me, int which) {
+    size_t size = rtp_sdr_rbuf_size(me);
+
+    if (which == RTP_SDR_RBUF_DATA)
+        return size >= (*me)->wait->high;
+
+    return size <= (*me)->wait->low;
+}
+
+// Wake the waiter of one side if there is one and its watermark was reached.
+// Without waiters this is a fence and one load: no lock and no syscall.
+static void _wait_notify(rbuf_handle_t *me, int which) {
+    rbuf_wait_t *wait = (*me)->wait;
+    uint64_t one = 1;
+
+    if (wait == NULL)
+        return;
+
+    // Pairs with the fence in rtp_sdr_rbuf_wait(): either the waiter sees the new head / tail
+    // or this sees it armed
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (!__atomic_load_n(&(wait->armed[which]), __ATOMIC_RELAXED) || !_wait_ready(me, which))
+        return;
+    if (!__atomic_exchange_n(&(wait->armed[which]), 0, __ATOMIC_SEQ_CST))
+        return;
+
+    __atomic_add_fetch(&(wait->seq[which]), 1, __ATOMIC_SEQ_CST);
+    syscall(SYS_futex, &(wait->seq[which]), FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+    if (wait->fd[which] >= 0 && write(wait->fd[which], &one, sizeof(one)) < 0) {
+        // counter overflow only, the fd is readable anyway
+    }
+}
+
 rbuf_handle_t rtp_sdr_rbuf_init(iq_t *buffer, size_t size, rtp_sdr_sbuf_type_t type) {
     assert(buffer && size > 1);
 
@@ -71,6 +134,8 @@ rbuf_handle_t rtp_sdr_rbuf_init(iq_t *buffer, size_t size, rtp_sdr_sbuf_type_t t
     cbuf->type = type;
     cbuf->buffer = buffer;
     cbuf->max = size;
+    cbuf->wait = NULL;
+    cbuf->dropped = 0;
     rtp_sdr_rbuf_reset(&cbuf);
 
     assert(rtp_sdr_rbuf_empty(&cbuf));
@@ -80,6 +145,14 @@ rbuf_handle_t rtp_sdr_rbuf_init(iq_t *buffer, size_t size, rtp_sdr_sbuf_type_t t
 
 void rtp_sdr_rbuf_free(rbuf_handle_t *me) {
     assert(*me);
+
+    if ((*me)->wait != NULL) {
+        if ((*me)->wait->fd[RTP_SDR_RBUF_DATA] >= 0)
+            close((*me)->wait->fd[RTP_SDR_RBUF_DATA]);
+        if ((*me)->wait->fd[RTP_SDR_RBUF_ROOM] >= 0)
+            close((*me)->wait->fd[RTP_SDR_RBUF_ROOM]);
+        free((*me)->wait);
+    }
     free(*me);
 }
 
@@ -95,12 +168,14 @@ size_t rtp_sdr_rbuf_size(rbuf_handle_t *me) {
 
     // We account for the space we can't use for thread safety
     size_t size = (*me)->max - 1;
+    size_t head = _load(&((*me)->head));
+    size_t tail = _load(&((*me)->tail));
 
-    if (!rtp_sdr_rbuf_full(me)) {
-        if ((*me)->head >= (*me)->tail) {
-            size = ((*me)->head - (*me)->tail);
+    if (_advance_headtail_value(head, (*me)->max) != tail) {
+        if (head >= tail) {
+            size = (head - tail);
         } else {
-            size = ((*me)->max + (*me)->head - (*me)->tail);
+            size = ((*me)->max + head - tail);
         }
     }
 
@@ -124,10 +199,12 @@ void rtp_sdr_rbuf_put(rbuf_handle_t *me, iq_t data) {
     (*me)->buffer[(*me)->head] = data;
     if (rtp_sdr_rbuf_full(me)) {
         // THIS CONDITION IS NOT THREAD SAFE
-        (*me)->tail = _advance_headtail_value((*me)->tail, (*me)->max);
+        _store(&((*me)->tail), _advance_headtail_value((*me)->tail, (*me)->max));
+        (*me)->dropped++;
     }
 
-    (*me)->head = _advance_headtail_value((*me)->head, (*me)->max);
+    _store(&((*me)->head), _advance_headtail_value((*me)->head, (*me)->max));
+    _wait_notify(me, RTP_SDR_RBUF_DATA);
 }
 
 int rtp_sdr_rbuf_try_put(rbuf_handle_t *me, iq_t data) {
@@ -138,13 +215,83 @@ int rtp_sdr_rbuf_try_put(rbuf_handle_t *me, iq_t data) {
 
     if (!rtp_sdr_rbuf_full(me)) {
         (*me)->buffer[(*me)->head] = data;
-        (*me)->head = _advance_headtail_value((*me)->head, (*me)->max);
+        _store(&((*me)->head), _advance_headtail_value((*me)->head, (*me)->max));
         r = RTP_SDR_RBUF_OK;
+        _wait_notify(me, RTP_SDR_RBUF_DATA);
     }
 
     return r;
 }
 
+void rtp_sdr_rbuf_write(rbuf_handle_t *me, const iq_t *data, size_t count) {
+    assert(*me && (*me)->buffer && (data || count == 0));
+
+    size_t capacity = (*me)->max - 1;
+    size_t room = capacity - rtp_sdr_rbuf_size(me);
+
+    // Only the newest capacity values survive
+    if (count > capacity) {
+        (*me)->dropped += count - capacity;
+        data += count - capacity;
+        count = capacity;
+    }
+
+    // At most two spans: up to the end of the storage, then from its start
+    size_t first = (*me)->max - (*me)->head;
+    if (first > count)
+        first = count;
+    memcpy((*me)->buffer + (*me)->head, data, first * sizeof(iq_t));
+    memcpy((*me)->buffer, data + first, (count - first) * sizeof(iq_t));
+    _store(&((*me)->head), ((*me)->head + count) % (*me)->max);
+
+    // Same as put: the oldest values were overwritten, THIS IS NOT THREAD SAFE
+    if (count > room) {
+        _store(&((*me)->tail), _advance_headtail_value((*me)->head, (*me)->max));
+        (*me)->dropped += count - room;
+    }
+
+    _wait_notify(me, RTP_SDR_RBUF_DATA);
+}
+
+size_t rtp_sdr_rbuf_reserve(rbuf_handle_t *me, iq_t **span) {
+    assert(*me && (*me)->buffer && span);
+
+    size_t room = (*me)->max - 1 - rtp_sdr_rbuf_size(me);
+    size_t first = (*me)->max - (*me)->head;
+
+    *span = (*me)->buffer + (*me)->head;
+
+    return room < first ? room : first;
+}
+
+void rtp_sdr_rbuf_commit(rbuf_handle_t *me, size_t count) {
+    assert(*me && count < (*me)->max - rtp_sdr_rbuf_size(me));
+
+    if (count == 0)
+        return;
+
+    _store(&((*me)->head), ((*me)->head + count) % (*me)->max);
+    _wait_notify(me, RTP_SDR_RBUF_DATA);
+}
+
+size_t rtp_sdr_rbuf_read(rbuf_handle_t *me, iq_t *data, size_t count) {
+    assert(*me && (*me)->buffer && (data || count == 0));
+
+    size_t size = rtp_sdr_rbuf_size(me);
+    if (count > size)
+        count = size;
+
+    size_t first = (*me)->max - (*me)->tail;
+    if (first > count)
+        first = count;
+    memcpy(data, (*me)->buffer + (*me)->tail, first * sizeof(iq_t));
+    memcpy(data + first, (*me)->buffer, (count - first) * sizeof(iq_t));
+    _store(&((*me)->tail), ((*me)->tail + count) % (*me)->max);
+    _wait_notify(me, RTP_SDR_RBUF_ROOM);
+
+    return count;
+}
+
 int rtp_sdr_rbuf_get(rbuf_handle_t *me, iq_t *data) {
     assert(*me);
     assert(data);
@@ -154,8 +301,9 @@ int rtp_sdr_rbuf_get(rbuf_handle_t *me, iq_t *data) {
 
     if (!rtp_sdr_rbuf_empty(me)) {
         *data = (*me)->buffer[(*me)->tail];
-        (*me)->tail = _advance_headtail_value((*me)->tail, (*me)->max);
+        _store(&((*me)->tail), _advance_headtail_value((*me)->tail, (*me)->max));
         r = RTP_SDR_RBUF_OK;
+        _wait_notify(me, RTP_SDR_RBUF_ROOM);
     }
 
     return r;
@@ -163,12 +311,18 @@ int rtp_sdr_rbuf_get(rbuf_handle_t *me, iq_t *data) {
 
 bool rtp_sdr_rbuf_empty(rbuf_handle_t *me) {
     assert(*me);
-    return (*me)->head == (*me)->tail;
+    return _load(&((*me)->head)) == _load(&((*me)->tail));
 }
 
 bool rtp_sdr_rbuf_full(rbuf_handle_t *me) {
     // We want to check, not advance, so we don't save the output here
-    return _advance_headtail_value((*me)->head, (*me)->max) == (*me)->tail;
+    return _advance_headtail_value(_load(&((*me)->head)), (*me)->max) == _load(&((*me)->tail));
+}
+
+uint64_t rtp_sdr_rbuf_dropped(rbuf_handle_t *me) {
+    assert(*me);
+
+    return (*me)->dropped;
 }
 
 int rtp_sdr_rbuf_peek(rbuf_handle_t *me, iq_t *data, unsigned int look_ahead_counter) {
@@ -189,3 +343,105 @@ int rtp_sdr_rbuf_peek(rbuf_handle_t *me, iq_t *data, unsigned int look_ahead_cou
 
     return RTP_SDR_RBUF_OK;
 }
+
+int rtp_sdr_rbuf_wait_config(rbuf_handle_t *me, size_t low, size_t high) {
+    assert(*me);
+
+    size_t capacity = (*me)->max - 1;
+    if (low >= capacity || high > capacity)
+        return RTP_SDR_RBUF_ERROR;
+
+    if ((*me)->wait == NULL) {
+        (*me)->wait = calloc(1, sizeof(rbuf_wait_t));
+        if ((*me)->wait == NULL)
+            return RTP_SDR_RBUF_ERROR;
+        (*me)->wait->fd[RTP_SDR_RBUF_DATA] = -1;
+        (*me)->wait->fd[RTP_SDR_RBUF_ROOM] = -1;
+    }
+
+    (*me)->wait->low = low;
+    (*me)->wait->high = high > 0 ? high : 1;
+
+    return RTP_SDR_RBUF_OK;
+}
+
+int rtp_sdr_rbuf_wait(rbuf_handle_t *me, int which, int timeout_ms) {
+    assert(*me && (which == RTP_SDR_RBUF_DATA || which == RTP_SDR_RBUF_ROOM));
+
+    rbuf_wait_t *wait = (*me)->wait;
+    struct timespec now, deadline, left, *timeout = NULL;
+    uint32_t seq;
+
+    if (wait == NULL)
+        return RTP_SDR_RBUF_ERROR;
+
+    if (timeout_ms >= 0) {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (timeout_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec += 1;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        timeout = &left;
+    }
+
+    while (!_wait_ready(me, which)) {
+        // Arm, then look again: a notification sent in between bumps seq and the futex does not sleep
+        seq = __atomic_load_n(&(wait->seq[which]), __ATOMIC_SEQ_CST);
+        __atomic_store_n(&(wait->armed[which]), 1, __ATOMIC_SEQ_CST);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (_wait_ready(me, which)) {
+            __atomic_store_n(&(wait->armed[which]), 0, __ATOMIC_SEQ_CST);
+            break;
+        }
+
+        if (timeout != NULL) {
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            left.tv_sec = deadline.tv_sec - now.tv_sec;
+            left.tv_nsec = deadline.tv_nsec - now.tv_nsec;
+            if (left.tv_nsec < 0) {
+                left.tv_sec -= 1;
+                left.tv_nsec += 1000000000L;
+            }
+            if (left.tv_sec < 0) {
+                __atomic_store_n(&(wait->armed[which]), 0, __ATOMIC_SEQ_CST);
+                return _wait_ready(me, which) ? RTP_SDR_RBUF_OK : RTP_SDR_RBUF_ERROR;
+            }
+        }
+
+        syscall(SYS_futex, &(wait->seq[which]), FUTEX_WAIT_PRIVATE, seq, timeout, NULL, 0);
+    }
+
+    return RTP_SDR_RBUF_OK;
+}
+
+int rtp_sdr_rbuf_wait_fd(rbuf_handle_t *me, int which) {
+    assert(*me && (which == RTP_SDR_RBUF_DATA || which == RTP_SDR_RBUF_ROOM));
+
+    if ((*me)->wait == NULL)
+        return -1;
+
+    if ((*me)->wait->fd[which] < 0)
+        (*me)->wait->fd[which] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    return (*me)->wait->fd[which];
+}
+
+int rtp_sdr_rbuf_wait_arm(rbuf_handle_t *me, int which) {
+    assert(*me && (which == RTP_SDR_RBUF_DATA || which == RTP_SDR_RBUF_ROOM));
+
+    rbuf_wait_t *wait = (*me)->wait;
+    uint64_t value;
+
+    if (wait == NULL || wait->fd[which] < 0)
+        return RTP_SDR_RBUF_ERROR;
+
+    // Consume the previous notification, then arm as rtp_sdr_rbuf_wait() does
+    while (read(wait->fd[which], &value, sizeof(value)) == sizeof(value))
+        ;
+    __atomic_store_n(&(wait->armed[which]), 1, __ATOMIC_SEQ_CST);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    return _wait_ready(me, which) ? 1 : 0;
+}
@@ -0,0 +1,247 @@
+/*
+ * Copyright 2023 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/rtp-sdr *
+ *
+ * This is based on other projects:
+ *      IDEA: https://github.com/OpenResearchInstitute/ka9q-sdr (not use any code of this)
+ *       RTP: https://github.com/Daxbot/librtp/
+ *       FEC: https://github.com/wesen/poc
+ *    SOCKET: https://github.com/njh/mast
+ *    OTHERS: see individual files
+ *
+ *    please contact their authors for more information.
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "rtp_sdr_replay.h"
+#include "rtp_sdr_sigmf.h"
+#include "rtp_sdr_iq.h"
+#include "rtp_sdr_rbuf.h"
+
+struct rtp_sdr_replay_s {
+            session_iq_t *session;  /**< session sending the recording */
+   rtp_sdr_replay_pace_t pace;      /**< timing */
+    rtp_sdr_sigmf_file_t *file;     /**< recording */
+           const uint8_t *data;     /**< mapped samples */
+                uint64_t samples;   /**< samples per channel in the recording */
+                uint64_t position;  /**< next sample moved */
+                  size_t width;     /**< bytes per i or q component in the file */
+                  size_t frame;     /**< bytes per timestamp */
+                 uint8_t channels;  /**< channels interleaved per timestamp */
+};
+
+// Unpack n samples of one channel, frame bytes apart, into a span of its tx buffer.
+static void _unpack(const rtp_sdr_replay_t *replay, const uint8_t *in, iq_t *out, size_t n) {
+    size_t k;
+
+    switch (replay->width) {
+        case 1:
+            for (k = 0; k < n; k++, in += replay->frame) {
+                out[k].i.s8 = (int8_t) in[0];
+                out[k].q.s8 = (int8_t) in[1];
+            }
+            break;
+        case 2:
+            for (k = 0; k < n; k++, in += replay->frame) {
+                out[k].i.s16 = (int16_t) (in[0] | in[1] << 8);
+                out[k].q.s16 = (int16_t) (in[2] | in[3] << 8);
+            }
+            break;
+        default:
+            for (k = 0; k < n; k++, in += replay->frame) {
+                out[k].i.s24_s32 = (int32_t) ((uint32_t) in[0] | (uint32_t) in[1] << 8 | (uint32_t) in[2] << 16 | (uint32_t) in[3] << 24);
+                out[k].q.s24_s32 = (int32_t) ((uint32_t) in[4] | (uint32_t) in[5] << 8 | (uint32_t) in[6] << 16 | (uint32_t) in[7] << 24);
+            }
+            break;
+    }
+}
+
+// Room of the tx buffers in common up to the first wrap, span of each.
+static size_t _reserve(rtp_sdr_replay_t *replay, iq_t **span) {
+    session_iq_t *session = replay->session;
+    size_t n, room = SIZE_MAX;
+    uint8_t ch;
+
+    for (ch = 0; ch < replay->channels; ch++) {
+        n = rtp_sdr_rbuf_reserve(&((*session)->tx_iq_channel[ch]), &span[ch]);
+        if (n < room)
+            room = n;
+    }
+
+    return room;
+}
+
+static void _commit(rtp_sdr_replay_t *replay, size_t n) {
+    session_iq_t *session = replay->session;
+    uint8_t ch;
+
+    for (ch = 0; ch < replay->channels; ch++)
+        rtp_sdr_rbuf_commit(&((*session)->tx_iq_channel[ch]), n);
+}
+
+rtp_sdr_replay_t* rtp_sdr_replay_open(const char *base, session_iq_t *session, rtp_sdr_replay_pace_t pace) {
+    const rtp_sdr_sigmf_info_t *info;
+    rtp_sdr_replay_t *replay;
+    iq_type_t type;
+    size_t capacity;
+
+    replay = calloc(1, sizeof(rtp_sdr_replay_t));
+    if (replay == NULL)
+        return NULL;
+
+    replay->file = rtp_sdr_sigmf_open(base);
+    if (replay->file == NULL) {
+        free(replay);
+        return NULL;
+    }
+
+    // 24 bits are recorded in 32, compressed streams as the samples they carry
+    info = rtp_sdr_sigmf_info(replay->file);
+    type = (*session)->tx_type == IQ_PT24 ? IQ_PT32 : (*session)->tx_type == IQ_PTC16 ? IQ_PT16 : (*session)->tx_type;
+    if (info->type != type || info->channels != (*session)->tx_qty) {
+        rtp_sdr_sigmf_free(replay->file);
+        free(replay);
+        return NULL;
+    }
+
+    replay->session = session;
+    replay->pace = pace;
+    replay->channels = info->channels;
+    replay->width = info->type == IQ_PT8 ? 1 : info->type == IQ_PT16 ? 2 : 4;
+    replay->frame = replay->channels * 2 * replay->width;
+    replay->data = rtp_sdr_sigmf_samples(replay->file, 0, &(replay->samples));
+
+    // Refill once half of the tx buffer was sent
+    capacity = rtp_sdr_rbuf_capacity(&((*session)->tx_iq_channel[0]));
+    rtp_sdr_rbuf_wait_config(&((*session)->tx_iq_channel[0]), capacity / 2, 0);
+
+    return replay;
+}
+
+uint8_t rtp_sdr_replay_seek(rtp_sdr_replay_t *replay, uint64_t sample) {
+    if (sample > replay->samples)
+        return RTP_SDR_ERROR;
+
+    replay->position = sample;
+
+    return RTP_SDR_OK;
+}
+
+size_t rtp_sdr_replay_feed(rtp_sdr_replay_t *replay) {
+    iq_t *span[UINT8_MAX];
+    size_t n, total = 0;
+    uint64_t left;
+    uint8_t ch;
+
+    // At most two rounds: up to the end of the tx buffers storage, then from its start
+    while ((left = replay->samples - replay->position) > 0) {
+        n = _reserve(replay, span);
+        if (n > left)
+            n = left;
+        if (n == 0)
+            break;
+
+        for (ch = 0; ch < replay->channels; ch++)
+            _unpack(replay, replay->data + replay->position * replay->frame + ch * 2 * replay->width, span[ch], n);
+        _commit(replay, n);
+
+        replay->position += n;
+        total += n;
+    }
+
+    if (total > 0 && replay->pace == RTP_SDR_REPLAY_PACED)
+        rcp_iq_tx_kick(replay->session);
+
+    return total;
+}
+
+// Block until the tx buffers have room: the tx thread sends (paced) or this one does (fast).
+static uint8_t _drain(rtp_sdr_replay_t *replay) {
+    session_iq_t *session = replay->session;
+
+    if (replay->pace == RTP_SDR_REPLAY_FAST)
+        return rcp_iq_transmit_unpaced(session) == (uint8_t) RTP_SDR_ERROR ? RTP_SDR_ERROR : RTP_SDR_OK;
+
+    rtp_sdr_rbuf_wait(&((*session)->tx_iq_channel[0]), RTP_SDR_RBUF_ROOM, 100);
+
+    return RTP_SDR_OK;
+}
+
+uint8_t rtp_sdr_replay_run(rtp_sdr_replay_t *replay, uint32_t repeat, volatile bool *stop) {
+    session_iq_t *session = replay->session;
+    uint32_t packet = rcp_iq_tx_packet_samples(session);
+    size_t pad, n;
+    iq_t *span[UINT8_MAX];
+    uint32_t played = 0;
+    uint8_t ch;
+
+    for (;;) {
+        if (stop != NULL && *stop)
+            return RTP_SDR_WARNING;
+
+        if (replay->position == replay->samples) {
+            if (replay->samples == 0 || (repeat != 0 && ++played == repeat))
+                break;
+            replay->position = 0;
+        }
+
+        rtp_sdr_replay_feed(replay);
+        if (_drain(replay) != RTP_SDR_OK)
+            return RTP_SDR_ERROR;
+    }
+
+    // Complete the last packet so that every sample of the recording is sent
+    pad = (packet - rtp_sdr_rbuf_size(&((*session)->tx_iq_channel[0])) % packet) % packet;
+    while (pad > 0) {
+        if (stop != NULL && *stop)
+            return RTP_SDR_WARNING;
+
+        n = _reserve(replay, span);
+        if (n > pad)
+            n = pad;
+        for (ch = 0; ch < replay->channels; ch++)
+            memset(span[ch], 0, n * sizeof(iq_t));
+        _commit(replay, n);
+        pad -= n;
+
+        if (pad > 0 && _drain(replay) != RTP_SDR_OK)
+            return RTP_SDR_ERROR;
+    }
+
+    if (replay->pace == RTP_SDR_REPLAY_PACED) {
+        rcp_iq_tx_kick(session);
+        return RTP_SDR_OK;
+    }
+
+    return rcp_iq_transmit_unpaced(session) == (uint8_t) RTP_SDR_ERROR ? RTP_SDR_ERROR : RTP_SDR_OK;
+}
+
+void rtp_sdr_replay_free(rtp_sdr_replay_t *replay) {
+    rtp_sdr_sigmf_free(replay->file);
+    free(replay);
+}
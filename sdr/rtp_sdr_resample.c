@@ -0,0 +1,339 @@
+/*
+ * Copyright 2023 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/rtp-sdr *
+ *
+ * This is based on other projects:
+ *      IDEA: https://github.com/OpenResearchInstitute/ka9q-sdr (not use any code of this)
+ *       RTP: https://github.com/Daxbot/librtp/
+ *       FEC: https://github.com/wesen/poc
+ *    SOCKET: https://github.com/njh/mast
+ *    OTHERS: see individual files
+ *
+ *    please contact their authors for more information.
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+#include "rtp_sdr_resample.h"
+
+#define RESAMPLE_CUTOFF 0.45 // filter cutoff, cycles per input sample
+
+// Windowed sinc prototype at x input samples from the center, support (-taps / 2, taps / 2).
+static double _prototype(double x, unsigned int taps) {
+    double half = taps / 2.0;
+
+    if (fabs(x) >= half)
+        return 0;
+
+    double w = 0.42 + 0.5 * cos(M_PI * x / half) + 0.08 * cos(2 * M_PI * x / half);
+    double s = x == 0 ? 1.0 : sin(2 * M_PI * RESAMPLE_CUTOFF * x) / (2 * M_PI * RESAMPLE_CUTOFF * x);
+
+    return 2 * RESAMPLE_CUTOFF * s * w;
+}
+
+// Coefficients of phase p (of phases, p == phases is one input sample later) over the window,
+// oldest sample first, normalized to unity gain and duplicated for i and q.
+static void _phase(float *row, unsigned int p, unsigned int taps, unsigned int phases) {
+    double h[taps], sum = 0;
+    double mu = (double) p / phases;
+
+    for (unsigned int k = 0; k < taps; k++) {
+        h[k] = _prototype(taps / 2.0 - 1 + mu - k, taps);
+        sum += h[k];
+    }
+
+    for (unsigned int k = 0; k < taps; k++)
+        row[2 * k] = row[2 * k + 1] = (float) (h[k] / sum);
+}
+
+// One output sample: the window filtered by phase c + a * d. Each lane accumulates independently,
+// so the loop vectorizes without reassociating floating point sums. Even lanes are i, odd lanes q.
+static void _kernel(const float *restrict c, const float *restrict d, float a, const float *restrict x, unsigned int n, float *out) {
+    float acc[RTP_SDR_RESAMPLE_LANES] = { 0 };
+
+    for (unsigned int k = 0; k < n; k += RTP_SDR_RESAMPLE_LANES)
+        for (unsigned int l = 0; l < RTP_SDR_RESAMPLE_LANES; l++)
+            acc[l] += (c[k + l] + a * d[k + l]) * x[k + l];
+
+    out[0] = out[1] = 0;
+    for (unsigned int l = 0; l < RTP_SDR_RESAMPLE_LANES; l += 2) {
+        out[0] += acc[l];
+        out[1] += acc[l + 1];
+    }
+}
+
+rtp_sdr_resample_t* rtp_sdr_resample_create(uint32_t rate, unsigned int taps, unsigned int phases) {
+    rtp_sdr_resample_t *rs;
+
+    if (taps == 0)
+        taps = RTP_SDR_RESAMPLE_TAPS;
+    if (phases == 0)
+        phases = RTP_SDR_RESAMPLE_PHASES;
+    taps = (taps + RTP_SDR_RESAMPLE_LANES - 1) / RTP_SDR_RESAMPLE_LANES * RTP_SDR_RESAMPLE_LANES;
+
+    rs = calloc(1, sizeof(rtp_sdr_resample_t));
+    if (rs == NULL)
+        return NULL;
+
+    rs->taps = taps;
+    rs->phases = phases;
+    rs->rate = rate;
+    rs->coef = malloc(sizeof(float) * 2 * taps * phases);
+    rs->delta = malloc(sizeof(float) * 2 * taps * phases);
+    rs->hist = malloc(sizeof(float) * 4 * taps);
+    if (rs->coef == NULL || rs->delta == NULL || rs->hist == NULL) {
+        rtp_sdr_resample_free(rs);
+        return NULL;
+    }
+
+    float next[2 * taps];
+    _phase(rs->coef, 0, taps, phases);
+    for (unsigned int p = 0; p < phases; p++) {
+        float *row = rs->coef + 2 * taps * p;
+        _phase(p + 1 < phases ? row + 2 * taps : next, p + 1, taps, phases);
+        const float *up = p + 1 < phases ? row + 2 * taps : next;
+        for (unsigned int k = 0; k < 2 * taps; k++)
+            rs->delta[2 * taps * p + k] = up[k] - row[k];
+    }
+
+    rtp_sdr_resample_reset(rs);
+
+    return rs;
+}
+
+void rtp_sdr_resample_free(rtp_sdr_resample_t *rs) {
+    if (rs == NULL)
+        return;
+
+    free(rs->coef);
+    free(rs->delta);
+    free(rs->hist);
+    free(rs);
+}
+
+void rtp_sdr_resample_reset(rtp_sdr_resample_t *rs) {
+    memset(rs->hist, 0, sizeof(float) * 4 * rs->taps);
+    rs->pos = 0;
+    rs->mu = 0;
+    rs->step = 1.0;
+    rs->ratio = 1.0;
+    rs->tracking = false;
+    rs->mid = false;
+}
+
+void rtp_sdr_resample_track(rtp_sdr_resample_t *rs, uint32_t rtp_ts, uint64_t arrival) {
+    if (!rs->tracking) {
+        rs->last_x = rs->x0 = rtp_ts;
+        rs->last_ts = rtp_ts;
+        rs->t0 = arrival;
+        rs->tracking = true;
+        return;
+    }
+
+    int32_t delta = (int32_t) (rtp_ts - rs->last_ts);
+    if (delta < 0)
+        return; // reordered
+
+    // Sender restart or a long outage: measure again from here
+    if ((uint32_t) delta > 10 * rs->rate) {
+        rs->tracking = false;
+        rs->mid = false;
+        rtp_sdr_resample_track(rs, rtp_ts, arrival);
+        return;
+    }
+
+    rs->last_x += delta;
+    rs->last_ts = rtp_ts;
+
+    uint64_t elapsed = arrival - rs->t0;
+    if (elapsed < RTP_SDR_RESAMPLE_SETTLE_S * 1000000000ULL)
+        return;
+
+    // Samples sent per local second over the whole span: the arrival jitter of the end points shrinks
+    // as the span grows and is averaged over packets. More than 1% off is a sender at another nominal
+    // rate, not drift: left alone.
+    double ratio = (double) (rs->last_x - rs->x0) * 1e9 / ((double) elapsed * rs->rate);
+    if (fabs(ratio - 1.0) <= 0.01)
+        rs->ratio += (ratio - rs->ratio) / RTP_SDR_RESAMPLE_SMOOTH;
+
+    // Slide the span, so the estimate follows slow clock changes (temperature)
+    if (!rs->mid && elapsed >= RTP_SDR_RESAMPLE_WINDOW_S * 1000000000ULL / 2) {
+        rs->xm = rs->last_x;
+        rs->tm = arrival;
+        rs->mid = true;
+    } else if (rs->mid && elapsed >= RTP_SDR_RESAMPLE_WINDOW_S * 1000000000ULL) {
+        rs->x0 = rs->xm;
+        rs->t0 = rs->tm;
+        rs->mid = false;
+    }
+}
+
+void rtp_sdr_resample_servo(rtp_sdr_resample_t *rs, size_t depth, size_t target) {
+    double correction = 0;
+
+    if (target > 0)
+        correction = RTP_SDR_RESAMPLE_GAIN * ((double) depth - (double) target) / target;
+    if (correction > RTP_SDR_RESAMPLE_MAX_PPM * 1e-6)
+        correction = RTP_SDR_RESAMPLE_MAX_PPM * 1e-6;
+    if (correction < -RTP_SDR_RESAMPLE_MAX_PPM * 1e-6)
+        correction = -RTP_SDR_RESAMPLE_MAX_PPM * 1e-6;
+
+    // A fuller buffer: consume the input faster, fewer output samples
+    rs->step = rs->ratio * (1.0 + correction);
+}
+
+unsigned int rtp_sdr_resample_process(rtp_sdr_resample_t *rs, const float *in, unsigned int count, float *out, unsigned int max) {
+    const unsigned int n = 2 * rs->taps;
+    unsigned int produced = 0;
+
+    for (unsigned int i = 0; i < count; i++) {
+        float *slot = rs->hist + 2 * rs->pos;
+        slot[0] = slot[n] = in[2 * i];
+        slot[1] = slot[n + 1] = in[2 * i + 1];
+        const float *window = slot + 2;
+        rs->pos = rs->pos + 1 == rs->taps ? 0 : rs->pos + 1;
+
+        while (rs->mu < 1.0 && produced < max) {
+            double fp = rs->mu * rs->phases;
+            unsigned int p = (unsigned int) fp;
+            float a = (float) (fp - p);
+            if (p >= rs->phases) {
+                p = rs->phases - 1;
+                a = 1.0f;
+            }
+            _kernel(rs->coef + n * p, rs->delta + n * p, a, window, n, out + 2 * produced);
+            produced++;
+            rs->mu += rs->step;
+        }
+        rs->mu -= 1.0;
+    }
+
+    return produced;
+}
+
+#ifdef RTP_SDR_RESAMPLE_TEST
+#include <stdio.h>
+
+#define TEST_RATE    48000
+#define TEST_PACKET  1000
+#define TEST_BLOCK   4096
+
+void testit(char *name, int result, int should) {
+    if (result == should) {
+        printf("Test %s was successful\n", name);
+    }
+    else {
+        printf("Test %s was not successful, %d should have been %d\n", name, result, should);
+    }
+}
+
+// Output samples for count inputs at a fixed step, fed in blocks.
+static unsigned long _produced(rtp_sdr_resample_t *rs, double step, unsigned long count) {
+    static float in[2 * TEST_BLOCK], out[4 * TEST_BLOCK];
+    unsigned long total = 0;
+
+    memset(in, 0, sizeof(in));
+    rtp_sdr_resample_reset(rs);
+    rs->step = step;
+    for (; count >= TEST_BLOCK; count -= TEST_BLOCK)
+        total += rtp_sdr_resample_process(rs, in, TEST_BLOCK, out, 2 * TEST_BLOCK);
+
+    return total;
+}
+
+int main(void) {
+    rtp_sdr_resample_t *rs = rtp_sdr_resample_create(TEST_RATE, 0, 0), *small;
+    float in[2 * TEST_BLOCK], out[2 * TEST_BLOCK];
+    unsigned int produced, i, delay;
+    uint32_t restart;
+    unsigned long n, expect;
+    double err, worst = 0;
+    int ok;
+
+    testit("create", rs != NULL, 1);
+    small = rtp_sdr_resample_create(TEST_RATE, 3, 0);
+    testit("taps rounded to lanes", small->taps, RTP_SDR_RESAMPLE_LANES);
+    rtp_sdr_resample_free(small);
+
+    // Unity step: one output per input, a delayed copy of a tone well inside the passband.
+    for (i = 0; i < TEST_BLOCK; i++) {
+        in[2 * i] = (float) cos(2 * M_PI * 0.05 * i);
+        in[2 * i + 1] = (float) sin(2 * M_PI * 0.05 * i);
+    }
+    produced = rtp_sdr_resample_process(rs, in, TEST_BLOCK, out, TEST_BLOCK);
+    testit("unity step count", produced, TEST_BLOCK);
+    delay = rs->taps / 2;
+    for (i = rs->taps; i < TEST_BLOCK; i++) {
+        err = fabs(out[2 * i] - in[2 * (i - delay)]) + fabs(out[2 * i + 1] - in[2 * (i - delay) + 1]);
+        if (err > worst)
+            worst = err;
+    }
+    testit("unity step passes the tone", worst < 1e-3, 1);
+
+    // The output count follows the step, nothing is lost or duplicated across blocks.
+    n = 1000UL * TEST_BLOCK;
+    expect = (unsigned long) (n / 1.001);
+    testit("faster step conserves samples", labs((long) _produced(rs, 1.001, n) - (long) expect) <= 1, 1);
+    expect = (unsigned long) (n / 0.999);
+    testit("slower step conserves samples", labs((long) _produced(rs, 0.999, n) - (long) expect) <= 1, 1);
+
+    rtp_sdr_resample_reset(rs);
+    rs->step = 0.5;
+    testit("output bounded by max", rtp_sdr_resample_process(rs, in, 100, out, 150), 150);
+
+    // A sender 100 ppm fast, packets arriving on time.
+    rtp_sdr_resample_reset(rs);
+    for (n = 0; n < 20000; n++)
+        rtp_sdr_resample_track(rs, (uint32_t) (0xfff00000u + n * TEST_PACKET), (uint64_t) (n * TEST_PACKET * 1e9 / (TEST_RATE * 1.0001)));
+    testit("ratio within 2 ppm", fabs(rs->ratio - 1.0001) < 2e-6, 1);
+
+    // A reordered packet is ignored, a sender restart measures again.
+    rtp_sdr_resample_track(rs, (uint32_t) (0xfff00000u + (n - 5) * TEST_PACKET), (uint64_t) (n * TEST_PACKET * 1e9 / TEST_RATE));
+    testit("reordered ignored", (int) (rs->last_ts == (uint32_t) (0xfff00000u + (n - 1) * TEST_PACKET)), 1);
+    restart = rs->last_ts + 0x10000000u;
+    rtp_sdr_resample_track(rs, restart, (uint64_t) (n * TEST_PACKET * 1e9 / TEST_RATE));
+    testit("restart tracks again", rs->tracking && rs->x0 == restart && !rs->mid, 1);
+
+    // The servo trims the ratio by the buffer depth, within its clamp.
+    rs->ratio = 1.0;
+    rtp_sdr_resample_servo(rs, 1000, 1000);
+    testit("servo on target", rs->step == 1.0, 1);
+    rtp_sdr_resample_servo(rs, 1500, 1000);
+    testit("servo fuller buffer", rs->step > 1.0, 1);
+    rtp_sdr_resample_servo(rs, 1000000000, 1);
+    ok = fabs(rs->step - (1.0 + RTP_SDR_RESAMPLE_MAX_PPM * 1e-6)) < 1e-12;
+    rtp_sdr_resample_servo(rs, 0, 1000);
+    testit("servo clamp", ok && rs->step < 1.0 && rs->step >= 1.0 - RTP_SDR_RESAMPLE_MAX_PPM * 1e-6, 1);
+
+    rtp_sdr_resample_free(rs);
+
+    return 0;
+}
+
+#endif /* RTP_SDR_RESAMPLE_TEST */
@@ -0,0 +1,469 @@
+/*
+ * Copyright 2023 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/rtp-sdr *
+ *
+ * This is based on other projects:
+ *      IDEA: https://github.com/OpenResearchInstitute/ka9q-sdr (not use any code of this)
+ *       RTP: https://github.com/Daxbot/librtp/
+ *       FEC: https://github.com/wesen/poc
+ *    SOCKET: https://github.com/njh/mast
+ *    OTHERS: see individual files
+ *
+ *    please contact their authors for more information.
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "rtp_sdr_rtcp.h"
+#include "rtp_sdr_iq.h"
+#include "rtp_socket.h"
+#include "rtp_source.h"
+#include "rtp_source_table.h"
+#include "rtp_ntp.h"
+#include "rtp_util.h"
+#include "rtcp_util.h"
+#include "rtcp_report.h"
+#include "rtcp_compound.h"
+
+#define RTCP_UDP_OVERHEAD 28 // IPv4 + UDP header, counted in the average rtcp packet size (RFC 3550 6.2)
+
+struct rtp_sdr_rtcp_s {
+                 bool mux;            /**< rtcp shares the rtp sockets (RFC 5761) */
+         rtp_socket_t rx_socket;      /**< rtcp rx socket on rx_port + 1 (not mux) */
+         rtp_socket_t tx_socket;      /**< rtcp tx socket to tx_port + 1 (not mux) */
+           rtp_loop_t *loop;          /**< event loop servicing the engine */
+    rtp_loop_source_t *timer;         /**< report timer */
+    rtp_loop_source_t *rx_source;     /**< rtcp rx socket source */
+                 char cname[256];     /**< SDES CNAME */
+               double tp;             /**< last time a report was sent (s, monotonic) */
+               double tn;             /**< next scheduled report (s, monotonic) */
+                  int pmembers;       /**< members when tn was last computed */
+                  int members;        /**< current members, us included */
+                  int senders;        /**< current senders, us included */
+               double avg_rtcp_size;  /**< average compound packet size, sent and received (octets) */
+                 bool initial;        /**< no report sent yet */
+                 bool we_sent;        /**< rtp sent since the report before last */
+             uint32_t tx_packets;     /**< session tx_packets at the last report */
+             uint32_t rx_received;    /**< peer packets received at the last report */
+   rtp_source_table_t *sources;       /**< other participants: last rtcp (or rtp) heard, RTP_SOURCE_SENDER if they sent since our last report */
+               ntp_ts sr_arrival;     /**< arrival of the last SR from the peer (CLOCK_MONOTONIC) */
+               ntp_tv sr_ntp;         /**< ntp timestamp of the last SR from the peer */
+              uint8_t buffer[RTP_SDR_RTCP_LENGTH]; /**< compound packet */
+};
+
+static double _now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Time of the source table (ns, monotonic).
+static uint64_t _ns(double t) {
+    return (uint64_t) (t * 1e9);
+}
+
+// RTCP share of the session bandwidth in octets per second: 5% of the i/q payload rate of the stream
+// we send or, for a receiver only session, of the stream we receive.
+static double _rtcp_bw(session_iq_t *session) {
+    sample_rate_t rate = (*session)->tx_enabled ? (*session)->tx_sample_rate : (*session)->rx_sample_rate;
+    iq_type_t type = (*session)->tx_enabled ? (*session)->tx_type : (*session)->rx_type;
+    int sample_size;
+
+    switch (type) {
+        case IQ_PT8:
+            sample_size = 1;
+            break;
+        case IQ_PT16:
+        case IQ_PTC16:
+            sample_size = 2;
+            break;
+        default:
+            sample_size = 4;
+            break;
+    }
+
+    return RTP_SDR_RTCP_BW_FRACTION * rate * 2 * sample_size;
+}
+
+static double _interval(session_iq_t *session) {
+    rtp_sdr_rtcp_t *rtcp = (*session)->rtcp;
+
+    return rtcp_interval(rtcp->members, rtcp->senders, _rtcp_bw(session), rtcp->we_sent, rtcp->avg_rtcp_size, rtcp->initial);
+}
+
+// Refresh the member and sender counts: us plus the participants tracked. The peer of the rx stream
+// is a member and a sender while its rtp keeps arriving, even if it sends no rtcp.
+static void _update_members(session_iq_t *session) {
+    rtp_sdr_rtcp_t *rtcp = (*session)->rtcp;
+    rtp_source *src = (*session)->rx_src;
+    rtp_source_entry *entry;
+    uint64_t now = _ns(_now());
+
+    if (src != NULL && (uint32_t) src->received != rtcp->rx_received && (entry = rtp_source_table_add(rtcp->sources, src->id, now)) != NULL) {
+        entry->last_seen = now;
+        entry->flags |= RTP_SOURCE_SENDER;
+    }
+
+    rtcp->we_sent = (*session)->tx_packets != rtcp->tx_packets;
+    rtcp->members = 1 + rtp_source_table_count(rtcp->sources);
+    rtcp->senders = rtcp->we_sent;
+    for (entry = rtp_source_table_next(rtcp->sources, NULL); entry != NULL; entry = rtp_source_table_next(rtcp->sources, entry))
+        rtcp->senders += (entry->flags & RTP_SOURCE_SENDER) != 0;
+}
+
+static void _arm(session_iq_t *session, double now) {
+    rtp_sdr_rtcp_t *rtcp = (*session)->rtcp;
+    double delay = rtcp->tn - now;
+
+    if (rtcp->timer == NULL)
+        return;
+
+    // A zero expiry would disarm the timer
+    rtp_loop_timer_set(rtcp->timer, delay > 1e-6 ? (uint64_t) (delay * 1e9) : 1000, 0);
+}
+
+// Report block about the peer, DLSR measured from the arrival of its last SR.
+static bool _report_block(session_iq_t *session, rtcp_report *report) {
+    rtp_sdr_rtcp_t *rtcp = (*session)->rtcp;
+    rtp_source *src = (*session)->rx_src;
+
+    if (src == NULL)
+        return false;
+
+    rtp_source_update_lost(src);
+    rtcp_report_init(report, src, (ntp_tv) { 0, 0 });
+    report->dlsr = report->lsr ? ntp_ts_short(ntp_ts_now(CLOCK_MONOTONIC) - rtcp->sr_arrival) : 0;
+    rtcp->rx_received = src->received;
+
+    return true;
+}
+
+// RTP timestamp of the wallclock instant now: the timestamp of the last packets sent,
+// advanced at the tx sample rate by the time elapsed since they went out.
+static uint32_t _sr_rtp_ts(session_iq_t *session, ntp_ts now) {
+    uint32_t seq, ts;
+    ntp_ts sent;
+
+    do {
+        seq = __atomic_load_n(&((*session)->tx_sent_seq), __ATOMIC_ACQUIRE);
+        sent = __atomic_load_n(&((*session)->tx_sent_ntp), __ATOMIC_RELAXED);
+        ts = __atomic_load_n(&((*session)->tx_sent_ts), __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((seq & 1) || seq != __atomic_load_n(&((*session)->tx_sent_seq), __ATOMIC_RELAXED));
+
+    uint64_t elapsed = ntp_ts_to_ns(ntp_ts_cmp(now, sent) > 0 ? ntp_ts_sub(now, sent) : ntp_ts_sub(sent, now));
+    uint32_t units = (uint32_t) ((elapsed / 1000000000ULL) * (*session)->tx_sample_rate + (elapsed % 1000000000ULL) * (*session)->tx_sample_rate / 1000000000ULL);
+
+    return ntp_ts_cmp(now, sent) > 0 ? ts + units : ts - units;
+}
+
+// Build the compound packet: SR while sending or RR, SDES CNAME, then BYE when leaving.
+// Returns its length or -1 on error.
+static int _build(session_iq_t *session, bool bye) {
+    rtp_sdr_rtcp_t *rtcp = (*session)->rtcp;
+    uint32_t ssrc = (*session)->tx_header->ssrc;
+    rtcp_compound packet;
+    rtcp_report report;
+
+    rtcp_compound_init(&packet, rtcp->buffer, sizeof(rtcp->buffer));
+
+    if (rtcp->we_sent) {
+        ntp_ts now = ntp_ts_now(CLOCK_REALTIME);
+        rtcp_compound_sr(&packet, ssrc, ntp_unpack(now), _sr_rtp_ts(session, now), (*session)->tx_packets, (*session)->tx_octets);
+    } else {
+        rtcp_compound_rr(&packet, ssrc);
+    }
+    if (_report_block(session, &report))
+        rtcp_compound_report(&packet, &report);
+
+    rtcp_compound_sdes(&packet);
+    rtcp_compound_sdes_chunk(&packet, ssrc);
+    rtcp_compound_sdes_item(&packet, RTCP_SDES_CNAME, rtcp->cname, strlen(rtcp->cname));
+
+    if (bye)
+        rtcp_compound_bye(&packet, &ssrc, 1, NULL);
+
+    return rtcp_compound_finish(&packet);
+}
+
+static uint8_t _send(session_iq_t *session, bool bye) {
+    rtp_sdr_rtcp_t *rtcp = (*session)->rtcp;
+    rtp_socket_t *sock = rtcp->mux ? &((*session)->tx_socket) : &(rtcp->tx_socket);
+    rtp_source_entry *entry;
+    int len;
+
+    _update_members(session);
+    len = _build(session, bye);
+    if (len < 0 || sock->fd < 0)
+        return RTP_SDR_ERROR;
+
+    // Senders are counted anew over each reporting interval
+    for (entry = rtp_source_table_next(rtcp->sources, NULL); entry != NULL; entry = rtp_source_table_next(rtcp->sources, entry))
+        entry->flags &= ~RTP_SOURCE_SENDER;
+
+    if (rtp_socket_send(sock, rtcp->buffer, len) < 0)
+        return RTP_SDR_WARNING;
+
+    rtcp->avg_rtcp_size = (1.0 / 16.0) * (len + RTCP_UDP_OVERHEAD) + (15.0 / 16.0) * rtcp->avg_rtcp_size;
+    rtcp->tx_packets = (*session)->tx_packets;
+
+    return RTP_SDR_OK;
+}
+
+// Timer expiry, RFC 3550 A.7 OnExpire with timer reconsideration.
+static void _loop_timer(rtp_loop_t *loop, uint64_t expirations, void *arg) {
+    session_iq_t session = (session_iq_t) arg;
+    rtp_sdr_rtcp_t *rtcp = session->rtcp;
+    double now = _now();
+
+    _update_members(&session);
+
+    // RFC 3550 6.3.5: participants silent for RTP_SDR_RTCP_TIMEOUT deterministic receiver intervals Td have left
+    double td = rtcp_interval_deterministic(rtcp->members, rtcp->senders, _rtcp_bw(&session), false, rtcp->avg_rtcp_size, false);
+    uint64_t timeout = (uint64_t) (RTP_SDR_RTCP_TIMEOUT * td * 1e9);
+    if (rtp_source_table_expire(rtcp->sources, _ns(now), timeout, NULL, NULL) > 0) {
+        _update_members(&session);
+        if (rtcp->members < rtcp->pmembers) {
+            rtcp_reverse_reconsider(&(rtcp->tp), &(rtcp->tn), now, rtcp->pmembers, rtcp->members);
+            rtcp->pmembers = rtcp->members;
+        }
+    }
+
+    double t = _interval(&session);
+    double tn = rtcp->tp + t;
+
+    if (tn <= now) {
+        _send(&session, false);
+        rtcp->tp = now;
+        rtcp->initial = false;
+        rtcp->tn = now + _interval(&session);
+        rtcp->pmembers = rtcp->members;
+    } else {
+        // Reconsidered: the group changed since the report was scheduled
+        rtcp->tn = tn;
+    }
+
+    _arm(&session, now);
+}
+
+static void _loop_rx(rtp_loop_t *loop, rtp_socket_t *sock, uint32_t events, void *arg) {
+    session_iq_t session = (session_iq_t) arg;
+    uint8_t data[RTP_SDR_RTCP_LENGTH];
+    int len;
+
+    // Edge triggered: drain the socket
+    while ((len = rtp_socket_try_recv(sock, data, sizeof(data))) > 0)
+        rtp_sdr_rtcp_receive(&session, data, len);
+}
+
+void rtp_sdr_rtcp_receive(session_iq_t *session, const uint8_t *data, unsigned int len) {
+    rtp_sdr_rtcp_t *rtcp = (*session)->rtcp;
+    rtp_source_entry *entry;
+    rtcp_view view;
+    size_t offset = 0;
+    int ret;
+
+    if (rtcp_type(data, len) < 0)
+        return;
+
+    if (rtcp == NULL) {
+        rcp_iq_rtcp_feedback(session, data, len);
+        return;
+    }
+
+    double now = _now();
+    rtcp->avg_rtcp_size = (1.0 / 16.0) * (len + RTCP_UDP_OVERHEAD) + (15.0 / 16.0) * rtcp->avg_rtcp_size;
+
+    while ((ret = rtcp_compound_next(data, len, &offset, &view)) > 0) {
+        uint32_t ssrc = rtcp_view_ssrc(&view);
+        if (ssrc == (*session)->tx_header->ssrc)
+            continue;
+
+        switch (view.pt) {
+            case RTCP_SR:
+                if (rtcp_view_sender(&view, &(rtcp->sr_ntp), NULL, NULL, NULL) == RTCP_OK) {
+                    rtcp->sr_arrival = ntp_ts_now(CLOCK_MONOTONIC);
+                    if ((*session)->rx_src != NULL && (*session)->rx_src->id == ssrc)
+                        rtp_source_update_lsr((*session)->rx_src, rtcp->sr_ntp);
+                    rtp_source_table_sr(rtcp->sources, ssrc, rtcp->sr_ntp, _ns(now));
+                    break;
+                }
+                /* fall through */
+            case RTCP_RR:
+            case RTCP_SDES:
+                if ((entry = rtp_source_table_add(rtcp->sources, ssrc, _ns(now))) != NULL)
+                    entry->last_seen = _ns(now);
+                break;
+
+            case RTCP_BYE:
+                if (view.count > 0 && rtp_source_table_find(rtcp->sources, ssrc) != NULL) {
+                    // RFC 3550 6.3.4 reverse reconsideration: report sooner to the smaller group
+                    rtp_source_table_remove(rtcp->sources, ssrc);
+                    if ((*session)->rx_src != NULL)
+                        rtcp->rx_received = (*session)->rx_src->received;
+                    _update_members(session);
+                    if (rtcp->members < rtcp->pmembers) {
+                        rtcp_reverse_reconsider(&(rtcp->tp), &(rtcp->tn), now, rtcp->pmembers, rtcp->members);
+                        rtcp->pmembers = rtcp->members;
+                        _arm(session, now);
+                    }
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    // Reception reports about our stream
+    if (ret == 0)
+        rcp_iq_rtcp_feedback(session, data, len);
+}
+
+uint8_t rcp_iq_rtcp_config(session_iq_t *session, bool mux, const char *cname) {
+    rtp_sdr_rtcp_t *rtcp;
+
+    rcp_iq_rtcp_stop(session);
+
+    rtcp = calloc(1, sizeof(rtp_sdr_rtcp_t));
+    if (rtcp == NULL)
+        return RTP_SDR_ERROR;
+
+    rtcp->mux = mux;
+    rtcp->rx_socket.fd = -1;
+    rtcp->tx_socket.fd = -1;
+    rtcp->sources = rtp_source_table_create(RTP_SDR_RTCP_MEMBERS);
+    if (rtcp->sources == NULL) {
+        free(rtcp);
+        return RTP_SDR_ERROR;
+    }
+    if (!mux) {
+        if (rtp_socket_open_recv(&(rtcp->rx_socket), (*session)->host, (*session)->rx_port + 1, NULL) != RTP_OK
+                || rtp_socket_open_send(&(rtcp->tx_socket), (*session)->host, (*session)->tx_port + 1, NULL) != RTP_OK) {
+            if (rtcp->rx_socket.fd >= 0)
+                rtp_socket_close(&(rtcp->rx_socket));
+            rtp_source_table_free(rtcp->sources);
+            free(rtcp);
+            return RTP_SDR_ERROR;
+        }
+    }
+
+    if (cname != NULL) {
+        strncpy(rtcp->cname, cname, sizeof(rtcp->cname) - 1);
+    } else {
+        char host[128] = "localhost";
+        const char *user = getenv("USER");
+        gethostname(host, sizeof(host) - 1);
+        snprintf(rtcp->cname, sizeof(rtcp->cname), "%s@%s", user != NULL ? user : "sdr", host);
+    }
+
+    // RFC 3550 A.7 initialization
+    rtcp->tp = _now();
+    rtcp->initial = true;
+    rtcp->avg_rtcp_size = RTCP_UDP_OVERHEAD + 28 + 24 + 8 + strlen(rtcp->cname);
+    rtcp->tx_packets = (*session)->tx_packets;
+    (*session)->rtcp = rtcp;
+    _update_members(session);
+    rtcp->pmembers = rtcp->members;
+    rtcp->tn = rtcp->tp + _interval(session);
+
+    if ((*session)->loop != NULL && rtp_sdr_rtcp_attach(session) != RTP_SDR_OK) {
+        rcp_iq_rtcp_stop(session);
+        return RTP_SDR_ERROR;
+    }
+
+    return RTP_SDR_OK;
+}
+
+void rcp_iq_rtcp_stop(session_iq_t *session) {
+    rtp_sdr_rtcp_t *rtcp = (*session)->rtcp;
+
+    if (rtcp == NULL)
+        return;
+
+    _send(session, true);
+    rtp_sdr_rtcp_detach(session);
+    if (rtcp->rx_socket.fd >= 0)
+        rtp_socket_close(&(rtcp->rx_socket));
+    if (rtcp->tx_socket.fd >= 0)
+        rtp_socket_close(&(rtcp->tx_socket));
+    rtp_source_table_free(rtcp->sources);
+    free(rtcp);
+    (*session)->rtcp = NULL;
+}
+
+uint8_t rcp_iq_rtcp_send(session_iq_t *session) {
+    if ((*session)->rtcp == NULL)
+        return RTP_SDR_ERROR;
+
+    return _send(session, false);
+}
+
+uint8_t rtp_sdr_rtcp_attach(session_iq_t *session) {
+    rtp_sdr_rtcp_t *rtcp = (*session)->rtcp;
+    double now = _now();
+
+    if (rtcp == NULL)
+        return RTP_SDR_OK;
+
+    rtp_sdr_rtcp_detach(session);
+    rtcp->loop = (*session)->loop;
+
+    rtcp->timer = rtp_loop_add_timer(rtcp->loop, rtcp->tn > now ? (uint64_t) ((rtcp->tn - now) * 1e9) : 1000, 0, _loop_timer, *session);
+    if (rtcp->timer == NULL)
+        goto error;
+
+    if (!rtcp->mux) {
+        rtcp->rx_source = rtp_loop_add_socket(rtcp->loop, &(rtcp->rx_socket), RTP_LOOP_IN, _loop_rx, *session);
+        if (rtcp->rx_source == NULL)
+            goto error;
+    }
+
+    return RTP_SDR_OK;
+
+    error:
+    rtp_sdr_rtcp_detach(session);
+    return RTP_SDR_ERROR;
+}
+
+void rtp_sdr_rtcp_detach(session_iq_t *session) {
+    rtp_sdr_rtcp_t *rtcp = (*session)->rtcp;
+
+    if (rtcp == NULL || rtcp->loop == NULL)
+        return;
+
+    rtp_loop_remove(rtcp->loop, rtcp->timer);
+    rtp_loop_remove(rtcp->loop, rtcp->rx_source);
+    rtcp->timer = NULL;
+    rtcp->rx_source = NULL;
+    rtcp->loop = NULL;
+}
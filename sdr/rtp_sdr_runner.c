@@ -0,0 +1,248 @@
+/*
+ * Copyright 2023 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/rtp-sdr *
+ *
+ * This is based on other projects:
+ *      IDEA: https://github.com/OpenResearchInstitute/ka9q-sdr (not use any code of this)
+ *       RTP: https://github.com/Daxbot/librtp/
+ *       FEC: https://github.com/wesen/poc
+ *    SOCKET: https://github.com/njh/mast
+ *    OTHERS: see individual files
+ *
+ *    please contact their authors for more information.
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // pthread_attr_setaffinity_np
+#endif
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "rtp_sdr_runner.h"
+#include "rtp_sdr_iq.h"
+#include "rtp_loop.h"
+
+// One worker thread and the event loop it runs.
+typedef struct rtp_sdr_worker_s {
+    rtp_loop_t *loop;    /**< event loop */
+     pthread_t thread;   /**< thread running the loop */
+          bool running;  /**< thread started and not joined yet */
+          bool stop;     /**< ask the thread to return (atomic) */
+           int cpu;      /**< cpu the thread is pinned to (RTP_SDR_RUNNER_CPU_ANY: any) */
+} rtp_sdr_worker_t;
+
+struct rtp_sdr_runner_s {
+    rtp_sdr_worker_t tx;         /**< tx pacing thread */
+    rtp_sdr_worker_t rx;         /**< rx and rtcp thread */
+                 int priority;   /**< SCHED_FIFO priority (0: SCHED_OTHER) */
+        session_iq_t *sessions;  /**< attached sessions */
+            uint32_t count;      /**< attached sessions */
+};
+
+static void* _worker_run(void *arg) {
+    rtp_sdr_worker_t *worker = (rtp_sdr_worker_t*) arg;
+
+    // Not rtp_loop_run(): a stop issued before the thread got here must not be lost
+    while (!__atomic_load_n(&(worker->stop), __ATOMIC_ACQUIRE)) {
+        if (rtp_loop_run_once(worker->loop, -1) < 0)
+            break;
+    }
+
+    return NULL;
+}
+
+// Create the worker thread with its placement in the attributes: it never runs unpinned or at SCHED_OTHER first.
+// Returns the pthread_create() error; a priority out of range counts as refused (EPERM).
+static int _worker_create(rtp_sdr_worker_t *worker, int cpu, int priority) {
+    struct sched_param param = { .sched_priority = priority };
+    pthread_attr_t attr;
+    cpu_set_t set;
+    int error = 0;
+
+    if (pthread_attr_init(&attr) != 0)
+        return ENOMEM;
+
+    if (cpu != RTP_SDR_RUNNER_CPU_ANY) {
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        error = pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+    }
+
+    if (error == 0 && priority > 0) {
+        if (pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED) != 0 || pthread_attr_setschedpolicy(&attr, SCHED_FIFO) != 0
+                || pthread_attr_setschedparam(&attr, &param) != 0)
+            error = EPERM;
+    }
+
+    if (error == 0)
+        error = pthread_create(&(worker->thread), &attr, _worker_run, worker);
+    pthread_attr_destroy(&attr);
+
+    return error;
+}
+
+// Start a worker thread and place it. RTP_SDR_WARNING if it runs without the requested placement.
+static uint8_t _worker_start(rtp_sdr_worker_t *worker, int priority) {
+    uint8_t ret = RTP_SDR_OK;
+    int cpu = worker->cpu;
+    int error;
+
+    worker->stop = false;
+
+    // The kernel checks the placement when the thread is created: drop the policy, then the pinning, until it starts
+    while ((error = _worker_create(worker, cpu, priority)) != 0) {
+        if (error == EPERM && priority > 0) {
+            fprintf(stderr, "runner: SCHED_FIFO %d refused: %s\n", priority, strerror(error));
+            priority = 0;
+        } else if (error == EINVAL && cpu != RTP_SDR_RUNNER_CPU_ANY) {
+            fprintf(stderr, "runner: can't pin thread to cpu %d\n", cpu);
+            cpu = RTP_SDR_RUNNER_CPU_ANY;
+        } else {
+            return RTP_SDR_ERROR;
+        }
+        ret = RTP_SDR_WARNING;
+    }
+    worker->running = true;
+
+    return ret;
+}
+
+static void _worker_stop(rtp_sdr_worker_t *worker) {
+    if (!worker->running)
+        return;
+
+    __atomic_store_n(&(worker->stop), true, __ATOMIC_RELEASE);
+    rtp_loop_stop(worker->loop);
+    pthread_join(worker->thread, NULL);
+    worker->running = false;
+}
+
+rtp_sdr_runner_t* rtp_sdr_runner_create(const rtp_sdr_runner_config_t *config) {
+    rtp_sdr_runner_t *runner = calloc(1, sizeof(rtp_sdr_runner_t));
+
+    if (runner == NULL)
+        return NULL;
+
+    runner->tx.cpu = config != NULL ? config->tx_cpu : RTP_SDR_RUNNER_CPU_ANY;
+    runner->rx.cpu = config != NULL ? config->rx_cpu : RTP_SDR_RUNNER_CPU_ANY;
+    runner->priority = config != NULL ? config->priority : 0;
+    runner->tx.loop = rtp_loop_create();
+    runner->rx.loop = rtp_loop_create();
+    if (runner->tx.loop == NULL || runner->rx.loop == NULL) {
+        rtp_sdr_runner_free(runner);
+        return NULL;
+    }
+
+    return runner;
+}
+
+void rtp_sdr_runner_free(rtp_sdr_runner_t *runner) {
+    if (runner == NULL)
+        return;
+
+    rtp_sdr_runner_stop(runner);
+    while (runner->count > 0)
+        rtp_sdr_runner_remove(runner, &(runner->sessions[runner->count - 1]));
+    free(runner->sessions);
+    if (runner->tx.loop != NULL)
+        rtp_loop_free(runner->tx.loop);
+    if (runner->rx.loop != NULL)
+        rtp_loop_free(runner->rx.loop);
+    free(runner);
+}
+
+uint8_t rtp_sdr_runner_add(rtp_sdr_runner_t *runner, session_iq_t *session) {
+    session_iq_t *sessions;
+
+    if (runner->tx.running || runner->rx.running)
+        return RTP_SDR_ERROR;
+
+    sessions = realloc(runner->sessions, sizeof(session_iq_t) * (runner->count + 1));
+    if (sessions == NULL)
+        return RTP_SDR_ERROR;
+    runner->sessions = sessions;
+
+    (*session)->tx_park = true;
+    if (rcp_iq_loop_attach_split(session, runner->rx.loop, runner->tx.loop) != RTP_SDR_OK) {
+        (*session)->tx_park = false;
+        return RTP_SDR_ERROR;
+    }
+
+    runner->sessions[runner->count++] = *session;
+
+    return RTP_SDR_OK;
+}
+
+void rtp_sdr_runner_remove(rtp_sdr_runner_t *runner, session_iq_t *session) {
+    uint32_t n;
+
+    if (runner->tx.running || runner->rx.running)
+        return;
+
+    for (n = 0; n < runner->count; n++) {
+        if (runner->sessions[n] != *session)
+            continue;
+
+        rcp_iq_loop_detach(session);
+        (*session)->tx_park = false;
+        runner->sessions[n] = runner->sessions[--runner->count];
+        return;
+    }
+}
+
+uint8_t rtp_sdr_runner_start(rtp_sdr_runner_t *runner) {
+    uint8_t ret = RTP_SDR_OK, error;
+
+    if (runner->tx.running || runner->rx.running)
+        return RTP_SDR_ERROR;
+
+    error = _worker_start(&(runner->rx), runner->priority);
+    if (error == (uint8_t) RTP_SDR_ERROR)
+        return RTP_SDR_ERROR;
+    if (error != RTP_SDR_OK)
+        ret = RTP_SDR_WARNING;
+
+    error = _worker_start(&(runner->tx), runner->priority);
+    if (error == (uint8_t) RTP_SDR_ERROR) {
+        _worker_stop(&(runner->rx));
+        return RTP_SDR_ERROR;
+    }
+    if (error != RTP_SDR_OK)
+        ret = RTP_SDR_WARNING;
+
+    return ret;
+}
+
+void rtp_sdr_runner_stop(rtp_sdr_runner_t *runner) {
+    _worker_stop(&(runner->tx));
+    _worker_stop(&(runner->rx));
+}
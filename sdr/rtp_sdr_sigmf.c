@@ -0,0 +1,606 @@
+/*
+ * Copyright 2023 Emiliano Gonzalez LU3VEA (lu3vea @ gmail . com))
+ * * Project Site: https://github.com/hiperiondev/rtp-sdr *
+ *
+ * This is based on other projects:
+ *      IDEA: https://github.com/OpenResearchInstitute/ka9q-sdr (not use any code of this)
+ *       RTP: https://github.com/Daxbot/librtp/
+ *       FEC: https://github.com/wesen/poc
+ *    SOCKET: https://github.com/njh/mast
+ *    OTHERS: see individual files
+ *
+ *    please contact their authors for more information.
+ *
+ * The MIT License (MIT)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "rtp_sdr_sigmf.h"
+#include "rtp_sdr_capture.h"
+#include "rtp_sdr_iq.h"
+#include "rtp_sdr_rbuf.h"
+#include "rtp_ntp.h"
+
+// Session rx event, kept until close: the file position of the first sample is not known before then
+typedef struct sigmf_event_s {
+    rcp_iq_rx_event_t event;    /**< event */
+             uint64_t position; /**< session rx_samples at the event */
+             uint64_t overruns; /**< capture overruns per channel at the event */
+             uint32_t samples;  /**< samples zero filled for it */
+             uint16_t seq;      /**< first packet concerned */
+             uint32_t packets;  /**< packets concerned */
+} sigmf_event_t;
+
+struct rtp_sdr_sigmf_s {
+                  session_iq_t *session;    /**< session recorded */
+             rtp_sdr_capture_t *capture;    /**< data file */
+                          char *meta;       /**< metadata file path */
+                          bool started;     /**< the first sample was seen */
+                      uint64_t start;       /**< session rx_samples of the first sample recorded */
+                      uint32_t start_ts;    /**< rtp timestamp of the first sample recorded */
+               struct timespec start_local; /**< local estimate of the time of the first sample */
+                      uint64_t overruns;    /**< capture overruns when last written (summed over the channels) */
+    rtp_sdr_sigmf_annotation_t *annotation; /**< annotations added */
+                        size_t annotations; /**< annotations added */
+                 sigmf_event_t *event;      /**< session rx events */
+                        size_t events;      /**< session rx events */
+               pthread_mutex_t lock;        /**< protects annotation and event */
+};
+
+struct rtp_sdr_sigmf_file_s {
+          rtp_sdr_sigmf_info_t info;        /**< recording description */
+                 const uint8_t *data;       /**< mapped data file (NULL: empty) */
+                        size_t length;      /**< data file bytes */
+                        size_t frame;       /**< bytes per timestamp */
+    rtp_sdr_sigmf_annotation_t *annotation; /**< annotations */
+                        size_t annotations; /**< annotations */
+};
+
+static const char* _datatype(iq_type_t type) {
+    switch (type) {
+        case IQ_PT8:
+            return "ci8";
+        case IQ_PT16:
+        case IQ_PTC16:
+            return "ci16_le";
+        default:
+            return "ci32_le";
+    }
+}
+
+static char* _path(const char *base, const char *suffix) {
+    char *path = malloc(strlen(base) + strlen(suffix) + 1);
+
+    if (path != NULL)
+        sprintf(path, "%s%s", base, suffix);
+
+    return path;
+}
+
+// Make room for one more element: the allocation starts at 8 and doubles whenever count reaches it.
+static void* _append(void *array, size_t count, size_t size) {
+    if (count < 8 ? count > 0 : (count & (count - 1)) != 0)
+        return array;
+
+    return realloc(array, (count > 0 ? 2 * count : 8) * size);
+}
+
+static void _copy(char *dest, const char *src, size_t size) {
+    if (src == NULL)
+        src = "";
+    strncpy(dest, src, size - 1);
+    dest[size - 1] = '\0';
+}
+
+static int _compare(const void *a, const void *b) {
+    uint64_t x = ((const rtp_sdr_sigmf_annotation_t*) a)->sample_start;
+    uint64_t y = ((const rtp_sdr_sigmf_annotation_t*) b)->sample_start;
+
+    return x < y ? -1 : x > y;
+}
+
+static void _event(rcp_iq_rx_event_t event, uint64_t sample, uint32_t samples, uint16_t seq, uint32_t packets, void *arg) {
+    rtp_sdr_sigmf_t *sigmf = (rtp_sdr_sigmf_t*) arg;
+    sigmf_event_t *ev;
+
+    pthread_mutex_lock(&(sigmf->lock));
+    ev = _append(sigmf->event, sigmf->events, sizeof(sigmf_event_t));
+    if (ev != NULL) {
+        sigmf->event = ev;
+        ev += sigmf->events++;
+        ev->event = event;
+        ev->position = sample;
+        ev->overruns = __atomic_load_n(&(sigmf->overruns), __ATOMIC_RELAXED) / (*(sigmf->session))->rx_qty;
+        ev->samples = samples;
+        ev->seq = seq;
+        ev->packets = packets;
+    }
+    pthread_mutex_unlock(&(sigmf->lock));
+}
+
+rtp_sdr_sigmf_t* rtp_sdr_sigmf_create(const char *base, rtp_sdr_capture_mode_t mode, session_iq_t *session) {
+    rtp_sdr_sigmf_t *sigmf = calloc(1, sizeof(rtp_sdr_sigmf_t));
+    char *data;
+
+    if (sigmf == NULL)
+        return NULL;
+
+    data = _path(base, RTP_SDR_SIGMF_DATA);
+    sigmf->meta = _path(base, RTP_SDR_SIGMF_META);
+    if (data != NULL && sigmf->meta != NULL)
+        sigmf->capture = rtp_sdr_capture_open(data, mode, (*session)->rx_type, (*session)->rx_qty, 0);
+    free(data);
+    if (sigmf->capture == NULL) {
+        free(sigmf->meta);
+        free(sigmf);
+        return NULL;
+    }
+
+    sigmf->session = session;
+    pthread_mutex_init(&(sigmf->lock), NULL);
+    rcp_iq_rx_event_config(session, _event, sigmf);
+
+    return sigmf;
+}
+
+size_t rtp_sdr_sigmf_write(rtp_sdr_sigmf_t *sigmf) {
+    session_iq_t *session = sigmf->session;
+    uint64_t position, samples, overruns;
+    size_t size, count;
+    uint32_t seq;
+    char comment[RTP_SDR_SIGMF_TEXT];
+
+    if (!sigmf->started) {
+        // The first sample captured is the oldest one buffered. A packet received meanwhile makes it retry.
+        do {
+            seq = __atomic_load_n(&((*session)->rx_seq), __ATOMIC_ACQUIRE);
+            size = rtp_sdr_rbuf_size(&((*session)->rx_iq_channel[0]));
+            position = __atomic_load_n(&((*session)->rx_samples), __ATOMIC_RELAXED);
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        } while ((seq & 1) || seq != __atomic_load_n(&((*session)->rx_seq), __ATOMIC_RELAXED));
+        if (size == 0)
+            return 0;
+
+        sigmf->started = true;
+        sigmf->start = position - size;
+        rcp_iq_rx_buffer_time(session, &(sigmf->start_ts), NULL);
+        clock_gettime(CLOCK_REALTIME, &(sigmf->start_local));
+        sigmf->start_local.tv_sec -= size / (*session)->rx_sample_rate;
+        sigmf->start_local.tv_nsec -= (long) (size % (*session)->rx_sample_rate * 1000000000ULL / (*session)->rx_sample_rate);
+        if (sigmf->start_local.tv_nsec < 0) {
+            sigmf->start_local.tv_nsec += 1000000000L;
+            sigmf->start_local.tv_sec--;
+        }
+    }
+
+    rtp_sdr_capture_stats(sigmf->capture, &samples, NULL);
+    count = rtp_sdr_capture_write(sigmf->capture, (*session)->rx_iq_channel);
+    rtp_sdr_capture_stats(sigmf->capture, NULL, &overruns);
+
+    // The rings overwrote samples since the last write: the hole is just before what was written now
+    if (overruns > sigmf->overruns) {
+        snprintf(comment, sizeof(comment), "%llu samples overwritten in the rx buffers before capture",
+                (unsigned long long) ((overruns - sigmf->overruns) / (*session)->rx_qty));
+        rtp_sdr_sigmf_annotate(sigmf, samples, 0, "capture overrun", comment);
+        __atomic_store_n(&(sigmf->overruns), overruns, __ATOMIC_RELAXED);
+    }
+
+    return count;
+}
+
+uint8_t rtp_sdr_sigmf_annotate(rtp_sdr_sigmf_t *sigmf, uint64_t sample_start, uint64_t sample_count, const char *label, const char *comment) {
+    rtp_sdr_sigmf_annotation_t *an;
+
+    pthread_mutex_lock(&(sigmf->lock));
+    an = _append(sigmf->annotation, sigmf->annotations, sizeof(rtp_sdr_sigmf_annotation_t));
+    if (an != NULL) {
+        sigmf->annotation = an;
+        an += sigmf->annotations++;
+        an->sample_start = sample_start;
+        an->sample_count = sample_count;
+        _copy(an->label, label, sizeof(an->label));
+        _copy(an->comment, comment, sizeof(an->comment));
+    }
+    pthread_mutex_unlock(&(sigmf->lock));
+
+    return an != NULL ? RTP_SDR_OK : RTP_SDR_ERROR;
+}
+
+static void _json_string(FILE *f, const char *s) {
+    fputc('"', f);
+    for (; *s != '\0'; s++) {
+        if (*s == '"' || *s == '\\')
+            fprintf(f, "\\%c", *s);
+        else if ((unsigned char) *s < 0x20)
+            fprintf(f, "\\u%04x", *s);
+        else
+            fputc(*s, f);
+    }
+    fputc('"', f);
+}
+
+static bool _write_meta(rtp_sdr_sigmf_t *sigmf, uint64_t samples) {
+    session_iq_t *session = sigmf->session;
+    rtp_sdr_sigmf_annotation_t *an;
+    struct timespec ts = sigmf->start_local;
+    double frequency = (*session)->rx_frequency[0];
+    char datetime[32];
+    struct tm tm;
+    ntp_ts time;
+    size_t n;
+    FILE *f;
+
+    // Sender time when its SRs were received, otherwise the local arrival time
+    if (sigmf->started && rcp_iq_rx_time(session, sigmf->start_ts, &time) == RTP_SDR_OK)
+        ntp_ts_to_timespec(CLOCK_REALTIME, time, &ts);
+    gmtime_r(&ts.tv_sec, &tm);
+    n = strftime(datetime, sizeof(datetime), "%Y-%m-%dT%H:%M:%S", &tm);
+    snprintf(datetime + n, sizeof(datetime) - n, ".%06ldZ", ts.tv_nsec / 1000);
+
+    f = fopen(sigmf->meta, "w");
+    if (f == NULL)
+        return false;
+
+    fprintf(f, "{\n    \"global\": {\n");
+    fprintf(f, "        \"core:datatype\": \"%s\",\n", _datatype((*session)->rx_type));
+    fprintf(f, "        \"core:sample_rate\": %u,\n", (unsigned) (*session)->rx_sample_rate);
+    fprintf(f, "        \"core:num_channels\": %u,\n", (unsigned) (*session)->rx_qty);
+    fprintf(f, "        \"core:recorder\": \"rtp-sdr\",\n");
+    fprintf(f, "        \"core:version\": \"1.0.0\"\n    },\n");
+    fprintf(f, "    \"captures\": [\n        {\n");
+    fprintf(f, "            \"core:sample_start\": 0,\n");
+    fprintf(f, "            \"core:frequency\": %.17g,\n", isfinite(frequency) ? frequency : 0.0);
+    fprintf(f, "            \"core:datetime\": \"%s\"\n        }\n    ],\n", datetime);
+    fprintf(f, "    \"annotations\": [");
+
+    qsort(sigmf->annotation, sigmf->annotations, sizeof(rtp_sdr_sigmf_annotation_t), _compare);
+    for (n = 0; n < sigmf->annotations; n++) {
+        an = &(sigmf->annotation[n]);
+        if (an->sample_start > samples)
+            an->sample_start = samples;
+        fprintf(f, "%s\n        {\n            \"core:sample_start\": %llu,\n", n > 0 ? "," : "", (unsigned long long) an->sample_start);
+        if (an->sample_count > 0)
+            fprintf(f, "            \"core:sample_count\": %llu,\n", (unsigned long long) an->sample_count);
+        fprintf(f, "            \"core:label\": ");
+        _json_string(f, an->label);
+        if (an->comment[0] != '\0') {
+            fprintf(f, ",\n            \"core:comment\": ");
+            _json_string(f, an->comment);
+        }
+        fprintf(f, "\n        }");
+    }
+    fprintf(f, "%s]\n}\n", sigmf->annotations > 0 ? "\n    " : "");
+
+    return fclose(f) == 0;
+}
+
+uint8_t rtp_sdr_sigmf_close(rtp_sdr_sigmf_t *sigmf, uint64_t *samples, uint64_t *overruns) {
+    uint64_t recorded, position, skipped;
+    char comment[RTP_SDR_SIGMF_TEXT];
+    sigmf_event_t *ev;
+    uint8_t ret;
+    size_t n;
+
+    rcp_iq_rx_event_config(sigmf->session, NULL, NULL);
+    ret = rtp_sdr_capture_close(sigmf->capture, &recorded, overruns);
+
+    // Events were counted in session rx samples: drop what came before the recording and the overruns
+    for (n = 0; n < sigmf->events; n++) {
+        ev = &(sigmf->event[n]);
+        skipped = sigmf->start + ev->overruns;
+        position = ev->position > skipped ? ev->position - skipped : 0;
+        if (ev->event == RCP_IQ_RX_LOSS) {
+            snprintf(comment, sizeof(comment), "%u rtp packets lost from seq %u, %s", ev->packets, ev->seq,
+                    ev->samples > 0 ? "zero filled" : "not filled");
+            rtp_sdr_sigmf_annotate(sigmf, position, ev->samples, "packet loss", comment);
+        }
+    }
+
+    if (!_write_meta(sigmf, recorded))
+        ret = RTP_SDR_ERROR;
+
+    if (samples != NULL)
+        *samples = recorded;
+
+    pthread_mutex_destroy(&(sigmf->lock));
+    free(sigmf->annotation);
+    free(sigmf->event);
+    free(sigmf->meta);
+    free(sigmf);
+
+    return ret;
+}
+
+static const char* _json_skip(const char *p) {
+    while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+        p++;
+
+    return p;
+}
+
+// Past the value at p (string, number, literal, object or array).
+static const char* _json_next(const char *p) {
+    bool string = false;
+    int depth = 0;
+
+    for (; *p != '\0'; p++) {
+        if (string) {
+            if (*p == '\\' && p[1] != '\0') {
+                p++;
+            } else if (*p == '"') {
+                string = false;
+                if (depth == 0)
+                    return p + 1;
+            }
+        } else if (*p == '"') {
+            string = true;
+        } else if (*p == '{' || *p == '[') {
+            depth++;
+        } else if (*p == '}' || *p == ']') {
+            if (depth == 0)
+                return p; // end of the enclosing container
+            if (--depth == 0)
+                return p + 1;
+        } else if (depth == 0 && (*p == ',' || *p == ':' || *p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) {
+            return p;
+        }
+    }
+
+    return p;
+}
+
+// Copy the string value at p, escapes resolved (other than ASCII \u are replaced with '?').
+static void _json_copy(const char *p, char *out, size_t size) {
+    size_t n = 0;
+
+    if (*p++ != '"') {
+        out[0] = '\0';
+        return;
+    }
+    for (; *p != '\0' && *p != '"'; p++) {
+        char c = *p;
+        if (c == '\\' && p[1] != '\0') {
+            c = *++p;
+            if (c == 'n')
+                c = '\n';
+            else if (c == 't')
+                c = '\t';
+            else if (c == 'u') {
+                unsigned code = 0;
+                sscanf(p + 1, "%4x", &code);
+                c = code < 0x80 ? (char) code : '?';
+                p += strnlen(p + 1, 4);
+            }
+        }
+        if (n + 1 < size)
+            out[n++] = c;
+    }
+    out[n] = '\0';
+}
+
+// Value of the member key of the object at p (NULL: absent).
+static const char* _json_member(const char *p, const char *key) {
+    size_t len = strlen(key);
+    const char *name;
+
+    p = _json_skip(p);
+    if (*p != '{')
+        return NULL;
+    p = _json_skip(p + 1);
+
+    while (*p == '"') {
+        name = p + 1;
+        p = _json_skip(_json_next(p));
+        if (*p != ':')
+            return NULL;
+        p = _json_skip(p + 1);
+        if (strncmp(name, key, len) == 0 && name[len] == '"')
+            return p;
+        p = _json_skip(_json_next(p));
+        if (*p == ',')
+            p = _json_skip(p + 1);
+    }
+
+    return NULL;
+}
+
+// Element after the one at p of an array, or the first one if p is the array (NULL: no more).
+static const char* _json_element(const char *p, bool first) {
+    p = _json_skip(p);
+    if (first) {
+        if (*p != '[')
+            return NULL;
+    } else {
+        p = _json_skip(_json_next(p));
+        if (*p != ',')
+            return NULL;
+    }
+    p = _json_skip(p + 1);
+
+    return *p == ']' || *p == '\0' ? NULL : p;
+}
+
+static char* _read_all(const char *path) {
+    FILE *f = fopen(path, "r");
+    char *text = NULL;
+    long size;
+
+    if (f == NULL)
+        return NULL;
+    if (fseek(f, 0, SEEK_END) == 0 && (size = ftell(f)) >= 0 && fseek(f, 0, SEEK_SET) == 0) {
+        text = malloc(size + 1);
+        if (text != NULL && fread(text, 1, size, f) != (size_t) size) {
+            free(text);
+            text = NULL;
+        }
+        if (text != NULL)
+            text[size] = '\0';
+    }
+    fclose(f);
+
+    return text;
+}
+
+static bool _parse_meta(rtp_sdr_sigmf_file_t *file, const char *text) {
+    rtp_sdr_sigmf_annotation_t *an;
+    const char *global, *value, *el;
+    char datatype[16];
+
+    global = _json_member(text, "global");
+    value = global != NULL ? _json_member(global, "core:datatype") : NULL;
+    if (value == NULL)
+        return false;
+
+    _json_copy(value, datatype, sizeof(datatype));
+    if (strcmp(datatype, "ci8") == 0)
+        file->info.type = IQ_PT8;
+    else if (strcmp(datatype, "ci16_le") == 0)
+        file->info.type = IQ_PT16;
+    else if (strcmp(datatype, "ci32_le") == 0)
+        file->info.type = IQ_PT32;
+    else
+        return false;
+
+    value = _json_member(global, "core:sample_rate");
+    file->info.sample_rate = value != NULL ? strtod(value, NULL) : 0;
+    value = _json_member(global, "core:num_channels");
+    file->info.channels = value != NULL ? strtoul(value, NULL, 10) : 1;
+    if (file->info.channels == 0)
+        return false;
+
+    value = _json_member(text, "captures");
+    el = value != NULL ? _json_element(value, true) : NULL;
+    if (el != NULL) {
+        value = _json_member(el, "core:frequency");
+        file->info.frequency = value != NULL ? strtod(value, NULL) : 0;
+        value = _json_member(el, "core:datetime");
+        if (value != NULL)
+            _json_copy(value, file->info.datetime, sizeof(file->info.datetime));
+    }
+
+    value = _json_member(text, "annotations");
+    for (el = value != NULL ? _json_element(value, true) : NULL; el != NULL; el = _json_element(el, false)) {
+        value = _json_member(el, "core:sample_start");
+        if (value == NULL)
+            continue;
+        an = _append(file->annotation, file->annotations, sizeof(rtp_sdr_sigmf_annotation_t));
+        if (an == NULL)
+            return false;
+        file->annotation = an;
+        an += file->annotations++;
+        memset(an, 0, sizeof(*an));
+        an->sample_start = strtoull(value, NULL, 10);
+        if ((value = _json_member(el, "core:sample_count")) != NULL)
+            an->sample_count = strtoull(value, NULL, 10);
+        if ((value = _json_member(el, "core:label")) != NULL)
+            _json_copy(value, an->label, sizeof(an->label));
+        if ((value = _json_member(el, "core:comment")) != NULL)
+            _json_copy(value, an->comment, sizeof(an->comment));
+    }
+    qsort(file->annotation, file->annotations, sizeof(rtp_sdr_sigmf_annotation_t), _compare);
+
+    return true;
+}
+
+rtp_sdr_sigmf_file_t* rtp_sdr_sigmf_open(const char *base) {
+    rtp_sdr_sigmf_file_t *file = calloc(1, sizeof(rtp_sdr_sigmf_file_t));
+    char *meta = _path(base, RTP_SDR_SIGMF_META);
+    char *data = _path(base, RTP_SDR_SIGMF_DATA);
+    char *text = meta != NULL ? _read_all(meta) : NULL;
+    struct stat st;
+    void *map;
+    int fd = -1;
+
+    if (file == NULL || text == NULL || data == NULL || !_parse_meta(file, text))
+        goto error;
+
+    file->frame = file->info.channels * 2 * (file->info.type == IQ_PT8 ? 1 : file->info.type == IQ_PT16 ? 2 : 4);
+    fd = open(data, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) < 0)
+        goto error;
+
+    // Mapped whole: the page cache serves any position, nothing is read until touched
+    file->length = st.st_size;
+    if (file->length > 0) {
+        map = mmap(NULL, file->length, PROT_READ, MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED)
+            goto error;
+        file->data = map;
+    }
+    file->info.samples = file->length / file->frame;
+
+    close(fd);
+    free(text);
+    free(meta);
+    free(data);
+    return file;
+
+error:
+    if (fd >= 0)
+        close(fd);
+    if (file != NULL)
+        free(file->annotation);
+    free(file);
+    free(text);
+    free(meta);
+    free(data);
+    return NULL;
+}
+
+const rtp_sdr_sigmf_info_t* rtp_sdr_sigmf_info(rtp_sdr_sigmf_file_t *file) {
+    return &(file->info);
+}
+
+const uint8_t* rtp_sdr_sigmf_samples(rtp_sdr_sigmf_file_t *file, uint64_t sample, uint64_t *count) {
+    if (sample >= file->info.samples) {
+        *count = 0;
+        return NULL;
+    }
+
+    *count = file->info.samples - sample;
+    return file->data + sample * file->frame;
+}
+
+size_t rtp_sdr_sigmf_annotations(rtp_sdr_sigmf_file_t *file, const rtp_sdr_sigmf_annotation_t **annotations) {
+    *annotations = file->annotation;
+
+    return file->annotations;
+}
+
+void rtp_sdr_sigmf_free(rtp_sdr_sigmf_file_t *file) {
+    if (file->data != NULL)
+        munmap((void*) file->data, file->length);
+    free(file->annotation);
+    free(file);
+}
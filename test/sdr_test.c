@@ -43,8 +43,14 @@
 #include <string.h>
 #include <errno.h>
 #include <getopt.h>
+#include <net/if.h>
 
 #include "rtp_sdr_iq.h"
+#include "rtp_sdr_rtcp.h"
+#include "rtp_sdr_runner.h"
+#include "rtp_sdr_capture.h"
+#include "rtp_sdr_sigmf.h"
+#include "rtp_sdr_replay.h"
 #include "rtp_util.h"
 
 #define DEFAULT_HOST     "127.0.0.1"
@@ -55,7 +61,9 @@
 #define DEFAULT_DURATION (20)    // 2 0ms
 #define DEFAULT_TYPE     (16)    // 16 bits
 
-static sig_atomic_t shutdown_flag = false;
+static volatile sig_atomic_t shutdown_flag = false;
+static volatile bool replay_stop = false;
+static rtp_sdr_capture_mode_t capture_mode = RTP_SDR_CAPTURE_DIRECT;
 
 char exit_signal[33][17] = {
         "NOSIGNAL",
@@ -104,60 +112,68 @@ static struct option opts_long[] = {
         { "txtype",   1, NULL, 't' },
         { "rxtype",   1, NULL, 'y' },
         { "only",     1, NULL, 'n' },
+        { "transport",1, NULL, 'u' },
+        { "gso",      1, NULL, 'g' },
+        { "zerocopy", 0, NULL, 'z' },
+        { "xdp",      1, NULL, 'X' },
+        { "rtcp",     1, NULL, 'R' },
+        { "drift",    1, NULL, 'D' },
+        { "txcpu",    1, NULL, 'T' },
+        { "rxcpu",    1, NULL, 'C' },
+        { "priority", 1, NULL, 'P' },
+        { "capture",  1, NULL, 'w' },
+        { "replay",   1, NULL, 'L' },
+        { "fast",     0, NULL, 'A' },
+        { "compress", 0, NULL, 'Z' },
         { "help",     0, NULL, 'H' },
         { NULL,       0, NULL, 0   },
 };
 
 static void signal_cb(int signal) {
     (void) signal;
+    // A second signal does not wait for the capture to be flushed
+    if (shutdown_flag)
+        exit(1);
     shutdown_flag = true;
+    replay_stop = true;
     fprintf(stderr, "Caught signal - Terminating 0x%x/%d(%s)\n", signal, signal, exit_signal[signal]);
-    exit(1);
-}
-
-void* rcp_iq_transmit_handler(void *arg) {
-    session_iq_t *session = (session_iq_t*) arg;
-
-    if (rtp_socket_open_send(&((*session)->tx_socket), (*session)->host, (*session)->tx_port, NULL) == RTP_ERROR) {
-        perror("TX SOCKET error");
-        exit(2);
-    }
-
-    while (1) {
-        if (rtp_sdr_rbuf_empty(&((*session)->tx_iq_buffer)))
-            continue;
-
-        rcp_iq_transmit(session);
-    }
-
-    return NULL;
 }
 
 void* rcp_iq_receive_handler(void *arg) {
-    FILE *rxptr;
     session_iq_t *session = (session_iq_t*) arg;
-
-    if (rtp_socket_open_recv(&((*session)->rx_socket), (*session)->host, (*session)->tx_port, NULL) == RTP_ERROR) {
-        perror("RX SOCKET error");
-        exit(2);
-    }
+    const rtp_sdr_sigmf_annotation_t *annotation;
+    rtp_sdr_sigmf_file_t *file;
+    rtp_sdr_sigmf_t *capture;
+    uint64_t samples, overruns;
+    size_t n;
 
     char filename[254];
-    sprintf(filename, "test_%d.bin", (*session)->rx_port);
-    rxptr = fopen(filename, "wb");
-
-    while (1) {
-        if (rcp_iq_receive(session) == RTP_SDR_ERROR)
-            continue;
+    sprintf(filename, "test_%d", (*session)->rx_port);
+    capture = rtp_sdr_sigmf_create(filename, capture_mode, session);
+    if (capture == NULL) {
+        perror("Capture error");
+        return NULL;
+    }
 
-        if (rtp_sdr_rbuf_empty(&((*session)->rx_iq_buffer)))
-            continue;
+    // Sleep until a block is buffered instead of spinning on an empty buffer
+    rtp_sdr_rbuf_wait_config(&((*session)->rx_iq_buffer), 0, RTP_PACKET_LENGTH / 4);
 
-        fwrite((*session)->rx_iq_buffer, sizeof(iq_t), 1, rxptr);
-        fflush(rxptr);
+    while (!shutdown_flag) {
+        rtp_sdr_rbuf_wait(&((*session)->rx_iq_buffer), RTP_SDR_RBUF_DATA, 100);
+        rtp_sdr_sigmf_write(capture);
     }
 
-    fclose(rxptr);
+    rtp_sdr_sigmf_write(capture);
+    if (rtp_sdr_sigmf_close(capture, &samples, &overruns) != RTP_SDR_OK)
+        perror("Capture error");
+    printf("Captured %lu samples to %s%s, %lu lost to overruns\n", (unsigned long) samples, filename, RTP_SDR_SIGMF_DATA, (unsigned long) overruns);
+
+    file = rtp_sdr_sigmf_open(filename);
+    if (file == NULL)
+        return NULL;
+    for (n = rtp_sdr_sigmf_annotations(file, &annotation); n > 0; n--, annotation++)
+        printf("  @%lu +%lu %s: %s\n", (unsigned long) annotation->sample_start, (unsigned long) annotation->sample_count, annotation->label, annotation->comment);
+    rtp_sdr_sigmf_free(file);
 
     return NULL;
 }
@@ -173,15 +189,27 @@ int main(int argc, char *argv[]) {
     uint32_t duration = DEFAULT_DURATION;
     uint8_t txtype = DEFAULT_TYPE;
     uint8_t rxtype = DEFAULT_TYPE;
+    uint8_t transport = RTP_SDR_SOCKET;
+    uint8_t gso = 0;
+    bool zerocopy = false;
+    bool compress = false;
+    uint8_t rtcp = 0;
+    uint32_t drift = 0;
+    rtp_sdr_runner_config_t runner_config = { RTP_SDR_RUNNER_CPU_ANY, RTP_SDR_RUNNER_CPU_ANY, 0 };
+    char xdp_ifname[IF_NAMESIZE] = "";
     char host[256];
+    char replay_base[256] = "";
+    rtp_sdr_replay_pace_t replay_pace = RTP_SDR_REPLAY_PACED;
+    rtp_sdr_replay_t *replay;
     session_iq_t session;
     iq_t tx_buff[RTP_PACKET_LENGTH], rx_buff[RTP_PACKET_LENGTH];
-    pthread_t rcp_iq_transmit_handler_id, rcp_iq_receive_handler_id;
+    pthread_t rcp_iq_receive_handler_id;
+    rtp_sdr_runner_t *runner;
 
     snprintf(host, sizeof(host), "%s", DEFAULT_HOST);
 
     while (1) {
-        int c = getopt_long(argc, argv, "h:p:o:x:r:d:t:y:n:H", opts_long, &status);
+        int c = getopt_long(argc, argv, "h:p:o:x:r:d:t:y:n:u:g:zX:R:D:T:C:P:w:L:AZH", opts_long, &status);
         if (c == -1)
             break;
 
@@ -200,6 +228,19 @@ int main(int argc, char *argv[]) {
                 printf("  -t, --txtype      TX RTP data type (8, 16, 24 or 32 bits), e.g. --txtype=%d\n", DEFAULT_TYPE);
                 printf("  -y, --rxtype      RX RTP data type (8, 16, 24 or 32 bits), e.g. --rxtype=%d\n", DEFAULT_TYPE);
                 printf("  -n, --only        0: tx/tx, 1: only tx, 2: only rx e.g. --type=0");
+                printf("  -u, --transport   0: sockets, 1: io_uring, 2: io_uring with sq polling, e.g. --transport=0\n");
+                printf("  -g, --gso         Packets per UDP segmentation offload send (0: off), e.g. --gso=0\n");
+                printf("  -z, --zerocopy    Send GSO batches with MSG_ZEROCOPY when the kernel does not copy them anyway\n");
+                printf("  -X, --xdp         Bypass the kernel with AF_XDP (generic mode) on this interface, e.g. --xdp=eth0\n");
+                printf("  -R, --rtcp        0: off, 1: on port + 1, 2: multiplexed on the rtp port, e.g. --rtcp=1\n");
+                printf("  -D, --drift       Resample rx to the local clock keeping this many ms buffered (0: off), e.g. --drift=20\n");
+                printf("  -T, --txcpu       Pin the tx thread to this cpu, e.g. --txcpu=2\n");
+                printf("  -C, --rxcpu       Pin the rx thread to this cpu, e.g. --rxcpu=3\n");
+                printf("  -P, --priority    SCHED_FIFO priority of the tx/rx threads (0: normal scheduling), e.g. --priority=50\n");
+                printf("  -w, --capture     RX capture file writes (0: O_DIRECT, 1: mmap), e.g. --capture=0\n");
+                printf("  -L, --replay      TX a SigMF recording instead of test.tx, e.g. --replay=test_5003\n");
+                printf("  -A, --fast        TX the recording as fast as possible, no pacing\n");
+                printf("  -Z, --compress    Lossless compressed payloads (16 bits types only)\n");
                 printf("  -d, --duration    Frame duration in ms (only transmission), e.g. --duration=%d\n", DEFAULT_DURATION);
                 printf("\n");
                 exit(1);
@@ -243,6 +284,71 @@ int main(int argc, char *argv[]) {
                 printf("default only: %d\n", only);
                 break;
 
+            case 'u':
+                transport = strtoul(optarg, NULL, 0);
+                printf("Transport set to %d\n", transport);
+                break;
+
+            case 'g':
+                gso = strtoul(optarg, NULL, 0);
+                printf("GSO set to %d packets\n", gso);
+                break;
+
+            case 'z':
+                zerocopy = true;
+                printf("Zerocopy enabled\n");
+                break;
+
+            case 'X':
+                snprintf(xdp_ifname, sizeof(xdp_ifname), "%s", optarg);
+                printf("AF_XDP interface set to %s\n", xdp_ifname);
+                break;
+
+            case 'R':
+                rtcp = strtoul(optarg, NULL, 0);
+                printf("RTCP set to %d\n", rtcp);
+                break;
+
+            case 'D':
+                drift = strtoul(optarg, NULL, 0);
+                printf("RX drift compensation set to %d ms\n", drift);
+                break;
+
+            case 'T':
+                runner_config.tx_cpu = strtol(optarg, NULL, 0);
+                printf("TX cpu set to %d\n", runner_config.tx_cpu);
+                break;
+
+            case 'C':
+                runner_config.rx_cpu = strtol(optarg, NULL, 0);
+                printf("RX cpu set to %d\n", runner_config.rx_cpu);
+                break;
+
+            case 'P':
+                runner_config.priority = strtol(optarg, NULL, 0);
+                printf("Priority set to %d\n", runner_config.priority);
+                break;
+
+            case 'w':
+                capture_mode = strtoul(optarg, NULL, 0) == 1 ? RTP_SDR_CAPTURE_MMAP : RTP_SDR_CAPTURE_DIRECT;
+                printf("Capture set to %s\n", capture_mode == RTP_SDR_CAPTURE_MMAP ? "mmap" : "O_DIRECT");
+                break;
+
+            case 'L':
+                snprintf(replay_base, sizeof(replay_base), "%s", optarg);
+                printf("Replay set to %s\n", replay_base);
+                break;
+
+            case 'A':
+                replay_pace = RTP_SDR_REPLAY_FAST;
+                printf("Replay set to as fast as possible\n");
+                break;
+
+            case 'Z':
+                compress = true;
+                printf("Compression enabled\n");
+                break;
+
             case 'd':
                 duration = strtoul(optarg, NULL, 0);
                 printf("Frame duration set to %d ms\n", duration);
@@ -255,6 +361,11 @@ int main(int argc, char *argv[]) {
         status = 1;
     }
 
+    if (transport > RTP_SDR_URING_SQPOLL) {
+        fprintf(stderr, "--- transport unknown value ---\n");
+        status = 1;
+    }
+
     if (!(rxrate == SR_48K || rxrate == SR_96K || rxrate == SR_192K || rxrate == SR_384K || rxrate == SR_768K || rxrate == SR_1536K)) {
         fprintf(stderr, "RX sample rate must be 48000, 96000, 192000, 384000, 768000 or 1536000\n");
         status = 1;
@@ -279,6 +390,14 @@ int main(int argc, char *argv[]) {
         rxtype = (rxtype / 8) + 96;
     }
 
+    if (compress && (txtype != IQ_PT16 || rxtype != IQ_PT16)) {
+        fprintf(stderr, "Compression needs 16 bits types\n");
+        status = 1;
+    } else if (compress) {
+        txtype = IQ_PTC16;
+        rxtype = IQ_PTC16;
+    }
+
     if (status)
         exit(EXIT_FAILURE);
 
@@ -294,23 +413,26 @@ int main(int argc, char *argv[]) {
     ////////////////////////////////////////////
 
     session = malloc(sizeof(struct session_iq_s));
-    rcp_iq_init(&session, txtype, rxtype, txrate, rxrate, duration, host, tx_port, rx_port, 0, tx_buff, rx_buff, RTP_PACKET_LENGTH, 1, 1);
-    (*session).tx_enabled = true;
+    rcp_iq_init(&session, txtype, rxtype, txrate, rxrate, duration, host, tx_port, rx_port, 0, tx_buff, rx_buff, RTP_PACKET_LENGTH, 1, 1, transport);
+    // Unpaced replays are sent from this thread, not by the runner
+    (*session).tx_enabled = !(replay_base[0] && replay_pace == RTP_SDR_REPLAY_FAST);
     printf("-- START --\n");
 
     PRINT_SESION((&session));
 
     if (only == 0 || only == 1) {
-        pthread_create(
-                &rcp_iq_transmit_handler_id,
-                NULL,
-                &rcp_iq_transmit_handler,
-                (void*) &session
-                );
-       //pthread_detach(rcp_iq_transmit_handler_id);
+        if (rtp_socket_open_send(&(session->tx_socket), session->host, session->tx_port, NULL) == RTP_ERROR) {
+            perror("TX SOCKET error");
+            exit(2);
+        }
     }
 
     if (only == 0 || only == 2) {
+        if (rtp_socket_open_recv(&(session->rx_socket), session->host, session->tx_port, NULL) == RTP_ERROR) {
+            perror("RX SOCKET error");
+            exit(2);
+        }
+
         pthread_create(
                 &rcp_iq_receive_handler_id,
                 NULL,
@@ -320,7 +442,51 @@ int main(int argc, char *argv[]) {
         //pthread_detach(rcp_iq_receive_handler_id);
     }
 
-    if (only == 0 || only == 1) {
+    if (gso > 1 && rcp_iq_gso_config(&session, gso) != RTP_SDR_OK) {
+        perror("GSO error");
+        exit(2);
+    }
+
+    if (zerocopy && gso > 1 && rcp_iq_zerocopy_config(&session, true) != RTP_SDR_OK) {
+        perror("Zerocopy error");
+        exit(2);
+    }
+
+    if (xdp_ifname[0] && rcp_iq_xdp_config(&session, xdp_ifname, 0, RTP_XDP_SKB_MODE, NULL) != RTP_SDR_OK) {
+        perror("XDP error");
+        exit(2);
+    }
+
+    runner = rtp_sdr_runner_create(&runner_config);
+    if (runner == NULL || rtp_sdr_runner_add(runner, &session) != RTP_SDR_OK) {
+        perror("RUNNER error");
+        exit(2);
+    }
+
+    if (drift > 0 && rcp_iq_drift_config(&session, drift) != RTP_SDR_OK) {
+        perror("Drift compensation error");
+        exit(2);
+    }
+
+    if (rtcp > 0 && rcp_iq_rtcp_config(&session, rtcp == 2, NULL) != RTP_SDR_OK) {
+        perror("RTCP error");
+        exit(2);
+    }
+
+    if (rtp_sdr_runner_start(runner) == (uint8_t) RTP_SDR_ERROR) {
+        perror("RUNNER error");
+        exit(2);
+    }
+
+    if ((only == 0 || only == 1) && replay_base[0]) {
+        if ((replay = rtp_sdr_replay_open(replay_base, &session, replay_pace)) == NULL) {
+            printf("--- ERROR: can't replay %s ---\n", replay_base);
+            exit(2);
+        }
+        if (rtp_sdr_replay_run(replay, 1, &replay_stop) == (uint8_t) RTP_SDR_ERROR)
+            perror("Replay error");
+        rtp_sdr_replay_free(replay);
+    } else if (only == 0 || only == 1) {
         if ((txptr = fopen("test.tx", "rb")) == NULL) {
             printf("--- ERROR: can't open file ---\n");
             rcp_iq_deinit(&session);
@@ -328,19 +494,32 @@ int main(int argc, char *argv[]) {
             exit(2);
         }
 
-        while (fread(&data, sizeof(iq_t), 1, txptr) != EOF)
+        // Refill as the tx thread drains the buffer instead of overwriting what was not sent yet
+        rtp_sdr_rbuf_wait_config(&(session->tx_iq_buffer), RTP_PACKET_LENGTH / 2, 0);
+        while (fread(&data, sizeof(iq_t), 1, txptr) == 1) {
+            if (rtp_sdr_rbuf_full(&(session->tx_iq_buffer))) {
+                rcp_iq_tx_kick(&session);
+                rtp_sdr_rbuf_wait(&(session->tx_iq_buffer), RTP_SDR_RBUF_ROOM, -1);
+            }
             rtp_sdr_rbuf_put(&(session->tx_iq_buffer), data);
+        }
         fclose(txptr);
+        rcp_iq_tx_kick(&session);
     }
 
-    while (1) {
+    while (!shutdown_flag) {
         sleep(1);
     }
 
     ////////////////////////////////////////////
 
     printf("Shutting down\n");
+    rtp_sdr_runner_stop(runner);
+    if (only == 0 || only == 2)
+        pthread_join(rcp_iq_receive_handler_id, NULL);
+    rtp_sdr_runner_remove(runner, &session);
     rcp_iq_deinit(&session);
+    rtp_sdr_runner_free(runner);
     free(session);
 
     return 0;